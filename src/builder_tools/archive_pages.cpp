@@ -0,0 +1,219 @@
+#include "archive_pages.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+const size_t DEFAULT_ARCHIVE_PAGE_SIZE = 50;
+
+static const fs::path ARCHIVE_DIR = "archive"; // Relative to PUBLIC_DIR
+
+static const char* const MONTH_NAMES[] = {"January", "February", "March", "April", "May", "June", "July",
+                                          "August", "September", "October", "November", "December"};
+
+// --- Listings ---
+
+// One listing (every post, a year or a month) before it is split into pages.
+struct ArchiveListing {
+    std::string key; // "", "2025" or "2025-03"
+    fs::path dir;    // Relative to PUBLIC_DIR
+    std::string title;
+    std::vector<const PostMetadata*> posts;
+    bool month_headings = false;
+    std::vector<const ArchiveListing*> months; // Of a year, newest first
+};
+
+// "2025-03-14" -> "2025-03"; "" when the date has no valid year and month.
+static std::string year_month_of(const PostMetadata& post) {
+    const std::string& date = post.date;
+    if (date.size() < 7 || date[4] != '-') return "";
+    for (size_t i : {0, 1, 2, 3, 5, 6}) {
+        if (!std::isdigit(static_cast<unsigned char>(date[i]))) return "";
+    }
+    int month = (date[5] - '0') * 10 + (date[6] - '0');
+    if (month < 1 || month > 12) return "";
+    return date.substr(0, 7);
+}
+
+static std::string month_title(const std::string& year_month) {
+    int month = (year_month[5] - '0') * 10 + (year_month[6] - '0');
+    return std::string(MONTH_NAMES[month - 1]) + " " + year_month.substr(0, 4);
+}
+
+// --- Pagination ---
+
+static fs::path listing_page_path(const fs::path& listing_dir, size_t page_number) {
+    if (page_number == 1) return listing_dir / "index.html";
+    return listing_dir / "page" / std::to_string(page_number) / "index.html";
+}
+
+// "../" per directory between PUBLIC_DIR and the page.
+static std::string root_of(const fs::path& relative_page_path) {
+    std::string root;
+    fs::path directory = relative_page_path.parent_path();
+    for (auto it = directory.begin(); it != directory.end(); ++it) root += "../";
+    return root;
+}
+
+static std::string link(const std::string& root, const fs::path& target, const std::string& text, const char* rel = nullptr) {
+    std::string html = "<a href=\"" + root + target.generic_string() + "\"";
+    if (rel) html += std::string(" rel=\"") + rel + "\"";
+    return html + ">" + text + "</a>";
+}
+
+static std::string join(const std::vector<std::string>& parts, const char* separator) {
+    std::string joined;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i > 0) joined += separator;
+        joined += parts[i];
+    }
+    return joined;
+}
+
+// Appends listing's pages. newer/older are the adjacent years or months, year
+// the year a month belongs to, current_period its index in all_periods.
+static void add_listing_pages(std::vector<ArchivePage>& pages, const ArchiveListing& listing, size_t page_size,
+                              const ArchiveListing* newer, const ArchiveListing* older, const ArchiveListing* year,
+                              const std::shared_ptr<const std::vector<ArchiveLink>>& all_periods, size_t current_period) {
+    std::vector<ArchiveLink> periods;
+    if (newer) periods.push_back({listing_page_path(newer->dir, 1), "← " + newer->title});
+    if (year) periods.push_back({listing_page_path(year->dir, 1), year->title});
+    if (older) periods.push_back({listing_page_path(older->dir, 1), older->title + " →"});
+    std::vector<ArchiveLink> months;
+    for (const ArchiveListing* month : listing.months) months.push_back({listing_page_path(month->dir, 1), month->title});
+
+    const size_t page_count = std::max<size_t>(1, (listing.posts.size() + page_size - 1) / page_size);
+    for (size_t page_number = 1; page_number <= page_count; ++page_number) {
+        ArchivePage page;
+        fs::path relative_path = listing_page_path(listing.dir, page_number);
+        page.output_path = PUBLIC_DIR / relative_path;
+        page.root = root_of(relative_path);
+        page.title = listing.title;
+        if (page_count > 1) page.title += " (Page " + std::to_string(page_number) + " of " + std::to_string(page_count) + ")";
+        size_t first = (page_number - 1) * page_size;
+        size_t last = std::min(listing.posts.size(), first + page_size);
+        page.posts.assign(listing.posts.begin() + first, listing.posts.begin() + last);
+        page.month_headings = listing.month_headings;
+
+        page.listing_dir = listing.dir;
+        page.page_number = page_number;
+        page.page_count = page_count;
+        page.periods = periods;
+        page.months = months;
+        page.all_periods = all_periods;
+        page.current_period = current_period;
+        pages.push_back(std::move(page));
+    }
+}
+
+std::vector<ArchivePage> plan_archive_pages(const std::vector<const PostMetadata*>& sorted_posts, size_t page_size) {
+    if (page_size == 0) page_size = DEFAULT_ARCHIVE_PAGE_SIZE;
+
+    ArchiveListing all{"", ARCHIVE_DIR, "All Posts", sorted_posts, true, {}};
+    // Newest first, so every year and month is one contiguous run of posts.
+    std::vector<ArchiveListing> years;
+    std::vector<ArchiveListing> months;
+    std::vector<size_t> year_of_month;
+    for (const PostMetadata* post : sorted_posts) {
+        std::string year_month = year_month_of(*post);
+        if (year_month.empty()) continue;
+        std::string year = year_month.substr(0, 4);
+        if (years.empty() || years.back().key != year) {
+            years.push_back({year, ARCHIVE_DIR / year, year, {}, true, {}});
+        }
+        years.back().posts.push_back(post);
+        if (months.empty() || months.back().key != year_month) {
+            months.push_back({year_month, ARCHIVE_DIR / year / year_month.substr(5), month_title(year_month), {}, false, {}});
+            year_of_month.push_back(years.size() - 1);
+        }
+        months.back().posts.push_back(post);
+    }
+    for (size_t m = 0; m < months.size(); ++m) years[year_of_month[m]].months.push_back(&months[m]);
+
+    auto all_periods = std::make_shared<std::vector<ArchiveLink>>();
+    all_periods->push_back({listing_page_path(all.dir, 1), all.title});
+    for (const auto& year : years) all_periods->push_back({listing_page_path(year.dir, 1), year.title});
+
+    std::vector<ArchivePage> pages;
+    add_listing_pages(pages, all, page_size, nullptr, nullptr, nullptr, all_periods, 0);
+    for (size_t y = 0; y < years.size(); ++y) {
+        add_listing_pages(pages, years[y], page_size, y > 0 ? &years[y - 1] : nullptr,
+                          y + 1 < years.size() ? &years[y + 1] : nullptr, nullptr, all_periods, y + 1);
+    }
+    for (size_t m = 0; m < months.size(); ++m) {
+        add_listing_pages(pages, months[m], page_size, m > 0 ? &months[m - 1] : nullptr,
+                          m + 1 < months.size() ? &months[m + 1] : nullptr, &years[year_of_month[m]], all_periods,
+                          year_of_month[m] + 1);
+    }
+    return pages;
+}
+
+// --- Rendering ---
+
+static std::string archive_path_of(const ArchivePage& page) {
+    return page.output_path.parent_path().lexically_relative(PUBLIC_DIR).generic_string() + "/";
+}
+
+std::string archive_page_nav(const ArchivePage& page) {
+    std::string nav = "<nav class=\"archive-nav\">";
+    if (page.page_count > 1) {
+        std::vector<std::string> parts;
+        if (page.page_number > 1) parts.push_back(link(page.root, listing_page_path(page.listing_dir, page.page_number - 1), "← Newer", "prev"));
+        parts.push_back("Page " + std::to_string(page.page_number) + " of " + std::to_string(page.page_count));
+        if (page.page_number < page.page_count) parts.push_back(link(page.root, listing_page_path(page.listing_dir, page.page_number + 1), "Older →", "next"));
+        nav += "<p class=\"archive-pages\">" + join(parts, " · ") + "</p>";
+    }
+    auto links = [&](const std::vector<ArchiveLink>& targets) {
+        std::vector<std::string> parts;
+        for (const ArchiveLink& target : targets) parts.push_back(link(page.root, target.target, target.text));
+        return join(parts, " · ");
+    };
+    if (!page.periods.empty()) nav += "<p class=\"archive-periods\">" + links(page.periods) + "</p>";
+    if (!page.months.empty()) nav += "<p class=\"archive-months\">" + links(page.months) + "</p>";
+    std::vector<std::string> parts;
+    for (size_t i = 0; page.all_periods && i < page.all_periods->size(); ++i) {
+        const ArchiveLink& period = (*page.all_periods)[i];
+        parts.push_back(i == page.current_period ? "<strong>" + period.text + "</strong>"
+                                                 : link(page.root, period.target, period.text));
+    }
+    return nav + "<p class=\"archive-years\">" + join(parts, " · ") + "</p></nav>";
+}
+
+std::string archive_page_state(const ArchivePage& page) {
+    std::string state = archive_path_of(page) + '\n' + page.title + '\n' + archive_page_nav(page) + '\n';
+    state += page.month_headings ? "months\n" : "\n";
+    for (const PostMetadata* post : page.posts) {
+        state += post->id + '\t' + post->title + '\t' + post->date + '\t' + post->permalink + '\n';
+    }
+    return state;
+}
+
+std::string render_archive_page(const PageTemplates& templates, const ArchivePage& page) {
+    std::string archive_posts_html_list;
+    std::string current_month;
+    for (const PostMetadata* post : page.posts) {
+        if (page.month_headings) {
+            std::string year_month = year_month_of(*post);
+            if (!year_month.empty() && year_month != current_month) {
+                current_month = year_month;
+                archive_posts_html_list += "<li class=\"month-header\"><h3>" + month_title(year_month) + "</h3></li>";
+            }
+        }
+        archive_posts_html_list += "<li><h2><a href=\"" + page.root + post->permalink + "\">" + post->title + "</a></h2><p class=\"post-meta\">" + post->date + "</p></li>";
+    }
+    std::string rendered = templates.archive.render({SITE_TITLE, BASE_URL, archive_posts_html_list, page.title,
+                                                     archive_page_nav(page), archive_path_of(page), page.root});
+    if (templates.archive_css) templates.archive_css->inline_into(rendered);
+    return rendered;
+}
+
+bool write_archive_page(const ArchivePage& page, const std::string& rendered_html) {
+    std::error_code ec;
+    fs::create_directories(page.output_path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "Error creating directory for " << page.output_path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return write_page(page.output_path, rendered_html);
+}
@@ -0,0 +1,59 @@
+#ifndef ARCHIVE_PAGES_H
+#define ARCHIVE_PAGES_H
+
+#include "build_stages.h"
+#include <memory>
+
+// --- Archive Pages ---
+// The archive is a set of listings, each split into pages of at most
+// page_size posts (newest first):
+//   archive/index.html, archive/page/N/index.html        every post
+//   archive/YYYY/index.html, .../YYYY/page/N/...         one year
+//   archive/YYYY/MM/index.html, .../MM/page/N/...        one month
+// Every page links to its newer/older page, to the adjacent year or month and
+// to every year, so page weight is bounded by page_size instead of the size of
+// the blog. Planning only reads post metadata (no bodies) and each page renders
+// independently of the others, so pages can be written in parallel.
+// Posts whose date is not YYYY-MM-DD only appear in the "every post" listing.
+
+extern const size_t DEFAULT_ARCHIVE_PAGE_SIZE;
+
+// A link between archive pages: target is relative to PUBLIC_DIR.
+struct ArchiveLink {
+    fs::path target;
+    std::string text;
+};
+
+// Every page links to every year, so the navigation is kept as links and only
+// rendered (archive_page_nav) when the page is: on a long-running blog, the
+// rendered navigation of every page is far bigger than the posts it lists.
+struct ArchivePage {
+    fs::path output_path;                   // .../index.html under PUBLIC_DIR
+    std::string title;                      // "All Posts", "2025", "March 2025" (+ page number)
+    std::string root;                       // Relative path from the page back to PUBLIC_DIR ("../../")
+    std::vector<const PostMetadata*> posts; // This page's slice, newest first
+    bool month_headings = false;            // Group entries under month headings
+
+    // Navigation
+    fs::path listing_dir;                   // Relative to PUBLIC_DIR: the listing's pages are under it
+    size_t page_number = 1;
+    size_t page_count = 1;
+    std::vector<ArchiveLink> periods;       // Adjacent years or months and a month's year
+    std::vector<ArchiveLink> months;        // A year's months
+    std::shared_ptr<const std::vector<ArchiveLink>> all_periods; // "All Posts" and every year: shared by every page
+    size_t current_period = 0;              // In all_periods: shown unlinked
+};
+
+// sorted_posts must be newest first (sort_by_date). archive/index.html is
+// always planned, even without posts.
+std::vector<ArchivePage> plan_archive_pages(const std::vector<const PostMetadata*>& sorted_posts, size_t page_size);
+// Everything render_archive_page reads besides the template; hashed into the
+// build manifest so only pages whose content moved are regenerated.
+std::string archive_page_state(const ArchivePage& page);
+// Pagination and year/month links.
+std::string archive_page_nav(const ArchivePage& page);
+std::string render_archive_page(const PageTemplates& templates, const ArchivePage& page);
+// write_page() for a rendered archive page, creating its directory first.
+bool write_archive_page(const ArchivePage& page, const std::string& rendered_html);
+
+#endif // ARCHIVE_PAGES_H
@@ -0,0 +1,86 @@
+#include "asset_manifest.h"
+#include <algorithm>
+
+const fs::path ASSET_MANIFEST_PATH = "asset-manifest.json";
+
+static bool is_attribute_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-';
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+std::string_view asset_reference_path(std::string_view value) {
+    size_t prefix = 0;
+    while (true) {
+        std::string_view rest = value.substr(prefix);
+        if (rest.substr(0, 8) == "{{ROOT}}") prefix += 8;
+        else if (rest.substr(0, 3) == "../") prefix += 3;
+        else if (rest.substr(0, 2) == "./") prefix += 2;
+        else break;
+    }
+    if (prefix == 0 && value.size() > 1 && value[0] == '/' && value[1] != '/') prefix = 1;
+    size_t path_end = std::min(value.find_first_of("?#", prefix), value.size());
+    return value.substr(prefix, path_end - prefix);
+}
+
+void AssetManifest::add(const fs::path& output_path, const fs::path& published_path) {
+    std::string path = output_path.lexically_relative(PUBLIC_DIR).generic_string();
+    std::string published = published_path.lexically_relative(PUBLIC_DIR).generic_string();
+    auto inserted = by_file_name_.emplace(output_path.filename().string(), published);
+    if (!inserted.second) inserted.first->second.clear(); // Two assets share the name: only full paths match
+    published_[path] = std::move(published);
+}
+
+const std::string* AssetManifest::find(std::string_view reference) const {
+    if (reference.find('/') != std::string_view::npos) {
+        auto it = published_.find(std::string(reference));
+        return it == published_.end() ? nullptr : &it->second;
+    }
+    auto it = by_file_name_.find(std::string(reference));
+    return it == by_file_name_.end() || it->second.empty() ? nullptr : &it->second;
+}
+
+std::string AssetManifest::rewrite_references(std::string_view html) const {
+    std::string out;
+    out.reserve(html.size() + 256);
+    size_t copied = 0;
+    size_t at = 0;
+    while ((at = html.find('=', at)) != std::string_view::npos) {
+        size_t name_start = at;
+        while (name_start > 0 && is_attribute_name_char(html[name_start - 1])) --name_start;
+        std::string_view name = html.substr(name_start, at - name_start);
+        ++at;
+        if ((name != "href" && name != "src") || name_start == 0 || !is_space(html[name_start - 1])) continue;
+        if (at >= html.size() || (html[at] != '"' && html[at] != '\'')) continue;
+        const size_t value_start = at + 1;
+        const size_t value_end = html.find(html[at], value_start);
+        if (value_end == std::string_view::npos) break;
+        at = value_end + 1;
+
+        std::string_view value = html.substr(value_start, value_end - value_start);
+        std::string_view reference = asset_reference_path(value);
+        const std::string* published = reference.empty() ? nullptr : find(reference);
+        if (!published) continue;
+        const size_t prefix = static_cast<size_t>(reference.data() - value.data());
+        out.append(html, copied, value_start + prefix - copied);
+        out += *published;
+        copied = value_start + prefix + reference.size();
+    }
+    out.append(html, copied, std::string_view::npos);
+    return out;
+}
+
+std::string AssetManifest::to_json() const {
+    std::string json = "{";
+    for (const auto& entry : published_) {
+        json += json.size() > 1 ? ",\n  \"" : "\n  \"";
+        append_json_escaped(json, entry.first);
+        json += "\": \"";
+        append_json_escaped(json, entry.second);
+        json += "\"";
+    }
+    json += published_.empty() ? "}\n" : "\n}\n";
+    return json;
+}
@@ -0,0 +1,44 @@
+#ifndef ASSET_MANIFEST_H
+#define ASSET_MANIFEST_H
+
+#include "build_stages.h"
+
+// --- Asset Manifest ---
+// build --fingerprint-assets publishes minified CSS/JS under content-hashed
+// names (css/shared.1a2b3c4d.css), so they can be served with year-long
+// immutable cache headers: a changed file is a new URL. The manifest maps
+// each asset's plain output path to the name it was published under; it is
+// written to public/asset-manifest.json for deploy tooling and used to
+// rewrite the templates' references.
+
+extern const fs::path ASSET_MANIFEST_PATH; // Relative to PUBLIC_DIR
+
+// The part of an href/src value that names a file under public/: a relative
+// prefix ("../", "./", "/" or "{{ROOT}}") and any query or fragment set aside,
+// so "{{ROOT}}shared.css?v=2" gives "shared.css". Absolute URLs give "".
+std::string_view asset_reference_path(std::string_view value);
+
+class AssetManifest {
+public:
+    // Both paths are under PUBLIC_DIR.
+    void add(const fs::path& output_path, const fs::path& published_path);
+    bool empty() const { return published_.empty(); }
+
+    // Rewrites every href="..." / src="..." value that names an asset to its
+    // published name. A value names an asset when, after a relative prefix
+    // ("../", "./", "/" or "{{ROOT}}") is set aside, it is the asset's path
+    // under public/ or, if no other asset shares it, its file name; so
+    // "../shared.css" becomes "../css/shared.1a2b3c4d.css". Query strings and
+    // fragments are kept; absolute URLs are left alone.
+    std::string rewrite_references(std::string_view html) const;
+    // {"css/shared.css": "css/shared.1a2b3c4d.css", ...}, sorted.
+    std::string to_json() const;
+
+private:
+    const std::string* find(std::string_view reference) const;
+
+    std::map<std::string, std::string> published_;      // Path under public/ -> published path
+    std::map<std::string, std::string> by_file_name_;   // File name -> published path ("" if ambiguous)
+};
+
+#endif // ASSET_MANIFEST_H
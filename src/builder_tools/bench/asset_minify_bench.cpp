@@ -0,0 +1,771 @@
+// Micro-benchmark: the lexer-based CSS and JS minifiers against the previous
+// character-loop ones, on the real static assets, after a fuzz check on
+// seeded random stylesheets and scripts:
+//   CSS  minify_css(old(x)) == minify_css(x), and minify_css is idempotent
+//   JS   without renaming, minify_js keeps every token of x; the tokens of
+//        minify_js(old(x)) and minify_js(x) are the same; with --node, x and
+//        minify_js(x) print the same output when run
+// and on fixed scripts the random ones do not produce, against their
+// expected minified form.
+// Run from the repository root:
+//   ./asset_minify_bench [iterations] [--cases N] [--seed S] [--node]
+#include "build_stages.h"
+#include "css_minifier.h"
+#include "js_minifier.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// --- Previous Minifiers ---
+
+// minify_css before the tokenizer (whitespace and comments only).
+static std::string minify_css_by_chars(const std::string& css) {
+    std::string minified_css;
+    minified_css.reserve(css.length());
+
+    bool in_multi_comment = false;
+    for (size_t i = 0; i < css.length(); ++i) {
+        if (i + 1 < css.length() && css[i] == '/' && css[i+1] == '*') {
+            in_multi_comment = true;
+            i++; // Skip '*'
+            continue;
+        }
+        if (in_multi_comment) {
+            if (i + 1 < css.length() && css[i] == '*' && css[i+1] == '/') {
+                in_multi_comment = false;
+                i++; // Skip '/'
+            }
+            continue;
+        }
+        if (!in_multi_comment) {
+            char c = css[i];
+            if (std::isspace(c)) {
+                if (!minified_css.empty() && (minified_css.back() == '{' || minified_css.back() == '}' || minified_css.back() == ':' || minified_css.back() == ';')) {
+                    // Do nothing
+                } else if (i + 1 < css.length() && (css[i+1] == '{' || css[i+1] == '}' || css[i+1] == ':' || css[i+1] == ';')) {
+                    // Do nothing
+                } else if (!minified_css.empty() && !std::isspace(minified_css.back())) {
+                    minified_css += ' ';
+                }
+            } else if (c == ';' && i + 1 < css.length() && css[i+1] == '}') {
+                // Remove semicolon if it's the last char before closing brace
+            } else if (c == '{' || c == '}' || c == ':' || c == ';') {
+                if (!minified_css.empty() && minified_css.back() == ' ') {
+                    minified_css.pop_back();
+                }
+                minified_css += c;
+            } else {
+                minified_css += c;
+            }
+        }
+    }
+    size_t first = minified_css.find_first_not_of(" \t\n\r\f\v");
+    size_t last = minified_css.find_last_not_of(" \t\n\r\f\v");
+    if (std::string::npos == first) return "";
+    return minified_css.substr(first, (last - first + 1));
+}
+
+// minify_js before the tokenizer (no regular expressions, templates or
+// escaped quotes; whitespace next to brackets and separators dropped).
+static std::string minify_js_by_chars(const std::string& js) {
+    std::string minified_js;
+    minified_js.reserve(js.length());
+
+    bool in_single_comment = false;
+    bool in_multi_comment = false;
+    bool in_string_single = false;
+    bool in_string_double = false;
+
+    for (size_t i = 0; i < js.length(); ++i) {
+        char c = js[i];
+
+        if (c == '\'' && !in_string_double && !in_multi_comment && !in_single_comment) {
+            in_string_single = !in_string_single;
+        } else if (c == '\"' && !in_string_single && !in_multi_comment && !in_single_comment) {
+            in_string_double = !in_string_double;
+        }
+
+        if (in_string_single || in_string_double) {
+            minified_js += c;
+            continue;
+        }
+
+        if (i + 1 < js.length() && c == '/' && js[i+1] == '/') {
+            in_single_comment = true;
+            continue;
+        }
+        if (i + 1 < js.length() && c == '/' && js[i+1] == '*') {
+            in_multi_comment = true;
+            i++; // Skip '*'
+            continue;
+        }
+        if (in_single_comment) {
+            if (c == '\n') {
+                in_single_comment = false;
+                minified_js += c;
+            }
+            continue;
+        }
+        if (in_multi_comment) {
+            if (i + 1 < js.length() && c == '*' && js[i+1] == '/') {
+                in_multi_comment = false;
+                i++; // Skip '/'
+            }
+            continue;
+        }
+
+        if (std::isspace(c)) {
+            if (!minified_js.empty() && !std::isspace(minified_js.back()) &&
+                !(minified_js.back() == '(' || minified_js.back() == '[' || minified_js.back() == '{' ||
+                  c == ')' || c == ']' || c == '}') &&
+                !(i + 1 < js.length() && (js[i+1] == ')' || js[i+1] == ']' || js[i+1] == '}'))) {
+                minified_js += ' ';
+            }
+        } else {
+            if (!minified_js.empty() && minified_js.back() == ' ' &&
+                (c == ';' || c == ',' || c == '{' || c == '}' || c == '(' || c == ')' ||
+                 c == '[' || c == ']' || c == ':')) {
+                minified_js.pop_back();
+            }
+            minified_js += c;
+        }
+    }
+    if (!minified_js.empty() && std::isspace(minified_js.front())) {
+        minified_js.erase(0, minified_js.find_first_not_of(" \t\n\r\f\v"));
+    }
+    if (!minified_js.empty() && std::isspace(minified_js.back())) {
+        minified_js.pop_back();
+    }
+    return minified_js;
+}
+
+// --- Random Stylesheets ---
+
+class CssGenerator {
+public:
+    explicit CssGenerator(uint32_t seed) : rng_(seed) {}
+
+    std::string stylesheet() {
+        out_.clear();
+        const int rules = pick(3, 12);
+        for (int r = 0; r < rules; ++r) {
+            const int kind = pick(0, 9);
+            if (kind == 0) {
+                out_ += "@media (max-width:";
+                space();
+                out_ += choose({"600px", "48em", "0px"});
+                out_ += ")";
+                space();
+                out_ += "{";
+                for (int n = pick(0, 3); n > 0; --n) rule();
+                space();
+                out_ += "}";
+            } else if (kind == 1) {
+                out_ += "@keyframes fade";
+                space();
+                out_ += "{";
+                for (const char* step : {"from", "50%", "100%"}) {
+                    space();
+                    out_ += step;
+                    space();
+                    out_ += "{opacity:";
+                    space();
+                    out_ += choose({"0", "0.50", "1.0", ".25"});
+                    out_ += "}";
+                }
+                out_ += "}";
+            } else if (kind == 2 && r > 0) {
+                out_ += repeated_; // A rule seen before
+            } else {
+                rule();
+            }
+            space();
+        }
+        return out_;
+    }
+
+private:
+    int pick(int low, int high) { return std::uniform_int_distribution<int>(low, high)(rng_); }
+    const char* choose(std::initializer_list<const char*> options) { return options.begin()[pick(0, static_cast<int>(options.size()) - 1)]; }
+
+    void space() {
+        switch (pick(0, 5)) {
+        case 0: out_ += " "; break;
+        case 1: out_ += "\n  "; break;
+        case 2: out_ += "/* note */"; break;
+        case 3: out_ += "\t\n"; break;
+        default: break;
+        }
+    }
+
+    void rule() {
+        const size_t start = out_.size();
+        space();
+        out_ += choose({".card", "#main", "div > p", "ul li", "a:hover", ".post::before", "[data-x=\"1\"]", "h1, h2", ".a.b"});
+        space();
+        out_ += "{";
+        for (int n = pick(0, 4); n > 0; --n) {
+            space();
+            out_ += choose({"color", "background", "margin", "padding", "border", "opacity", "width", "--accent", "font"});
+            space();
+            out_ += ":";
+            space();
+            out_ += choose({"#FFFFFF", "#aabbcc", "#ff0000", "rgb(255, 0, 0)", "0px", "0.50em", "10px 0px",
+                            "url(img/x.png)", "'Open Sans', serif", "0 auto", "1px solid #000000", "calc(100% - 0px)",
+                            "100%", "navy", "1.0"});
+            if (pick(0, 6) == 0) out_ += " !important";
+            space();
+            out_ += ";";
+        }
+        space();
+        out_ += "}";
+        if (pick(0, 2) == 0) repeated_ = out_.substr(start);
+    }
+
+    std::mt19937 rng_;
+    std::string out_;
+    std::string repeated_ = ".x{color:red}";
+};
+
+// --- Random Scripts ---
+// Functions over local variables (declarations, shadowing, destructuring,
+// arrow functions, shorthand properties, nested functions) whose results the
+// script prints. Every statement ends in ';' and strings hold no escapes, so
+// the previous minifier handles them too.
+
+class JsGenerator {
+public:
+    explicit JsGenerator(uint32_t seed) : rng_(seed) {}
+
+    std::string script() {
+        out_.clear();
+        functions_.clear();
+        const int count = pick(1, 4);
+        for (int f = 0; f < count; ++f) {
+            const std::string name = "compute_" + std::to_string(f);
+            function(name);
+            functions_.push_back(name);
+        }
+        for (const auto& name : functions_) {
+            emit("console");
+            emit(".log");
+            emit("(");
+            emit(name);
+            emit("(");
+            emit(std::to_string(pick(0, 9)));
+            emit(",");
+            emit("'arg'");
+            emit(")");
+            emit(")");
+            emit(";");
+        }
+        return out_;
+    }
+
+private:
+    struct Local {
+        std::string name;
+        bool assignable;
+    };
+
+    int pick(int low, int high) { return std::uniform_int_distribution<int>(low, high)(rng_); }
+
+    // Tokens are separated by random whitespace and comments; never a line
+    // break after return or before ++ (automatic semicolon insertion) or =>.
+    void emit(const std::string& token) {
+        if (!out_.empty()) {
+            const bool line_break_ok = last_ != "return" && token != "++" && token != "=>";
+            switch (pick(0, 7)) {
+            case 0: out_ += line_break_ok ? "\n    " : "  "; break;
+            case 1: out_ += " /* step */ "; break;
+            case 2: out_ += line_break_ok ? " // note\n" : " "; break;
+            case 3: out_ += "\t"; break;
+            default: out_ += " "; break;
+            }
+        }
+        out_ += token;
+        last_ = token;
+    }
+
+    std::string fresh(const char* stem) { return std::string(stem) + "_" + std::to_string(counter_++); }
+
+    void function(const std::string& name) {
+        scopes_.assign(1, {});
+        emit("function");
+        emit(name);
+        emit("(");
+        emit("amount");
+        emit(",");
+        emit("label");
+        emit(")");
+        emit("{");
+        scopes_.push_back({{"amount", true}, {"label", true}});
+        for (int n = pick(2, 6); n > 0; --n) statement(2);
+        emit("return");
+        expression(3);
+        emit(";");
+        emit("}");
+        scopes_.clear();
+    }
+
+    void declare(const std::string& name, bool assignable) { scopes_.back().push_back({name, assignable}); }
+
+    std::vector<const Local*> visible(bool assignable_only) const {
+        std::vector<const Local*> locals;
+        std::vector<std::string_view> shadowed;
+        for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+            for (const auto& local : *scope) {
+                if (std::find(shadowed.begin(), shadowed.end(), local.name) != shadowed.end()) continue;
+                shadowed.push_back(local.name);
+                if (!assignable_only || local.assignable) locals.push_back(&local);
+            }
+        }
+        return locals;
+    }
+
+    void block(int depth) {
+        emit("{");
+        scopes_.emplace_back();
+        block_start_ = true;
+        for (int n = pick(1, 3); n > 0; --n) statement(depth - 1);
+        scopes_.pop_back();
+        emit("}");
+    }
+
+    void statement(int depth) {
+        // Shadowing only as a block's first statement, before any use of the outer name
+        const bool block_start = block_start_;
+        block_start_ = false;
+        const int kind = depth > 0 ? pick(0, 8) : pick(0, 3);
+        switch (kind) {
+        case 0:
+        case 1: { // Declaration; sometimes shadowing an outer name
+            const char* keyword = kind == 0 ? "let" : (pick(0, 1) ? "const" : "var");
+            const auto locals = visible(true); // Variables, not helper(n) calls
+            bool shadowing = block_start && !locals.empty() && std::strcmp(keyword, "var") != 0 && pick(0, 2) == 0;
+            std::string name = shadowing ? locals[pick(0, static_cast<int>(locals.size()) - 1)]->name : fresh("total");
+            for (const auto& local : scopes_.back()) {
+                if (local.name == name) {
+                    name = fresh("total");
+                    shadowing = false;
+                }
+            }
+            emit(keyword);
+            emit(name);
+            emit("=");
+            if (shadowing) {
+                emit(std::to_string(pick(0, 9))); // Not the outer name: still uninitialized here
+            } else {
+                expression(3);
+            }
+            emit(";");
+            declare(name, std::strcmp(keyword, "const") != 0);
+            break;
+        }
+        case 2: { // Assignment
+            const auto locals = visible(true);
+            if (locals.empty()) return;
+            emit(locals[pick(0, static_cast<int>(locals.size()) - 1)]->name);
+            if (pick(0, 2) == 0) {
+                emit("++");
+            } else {
+                emit(pick(0, 1) ? "+=" : "=");
+                expression(3);
+            }
+            emit(";");
+            break;
+        }
+        case 3: { // Destructuring
+            const std::string first = fresh("first"), second = fresh("second");
+            if (pick(0, 1)) {
+                emit("const");
+                emit("{");
+                emit(first);
+                emit(",");
+                emit("key");
+                emit(":");
+                emit(second);
+                emit("}");
+                emit("=");
+                emit("{");
+                emit(first);
+                emit(":");
+                expression(2);
+                emit(",");
+                emit("key");
+                emit(":");
+                expression(2);
+                emit("}");
+            } else {
+                emit("let");
+                emit("[");
+                emit(first);
+                emit(",");
+                emit(second);
+                emit("]");
+                emit("=");
+                emit("[");
+                expression(2);
+                emit(",");
+                expression(2);
+                emit("]");
+            }
+            emit(";");
+            declare(first, false);
+            declare(second, false);
+            break;
+        }
+        case 4:
+        case 5: // if / else
+            emit("if");
+            emit("(");
+            expression(2);
+            emit(")");
+            block(depth);
+            if (pick(0, 1)) {
+                emit("else");
+                block(depth);
+            }
+            break;
+        case 6: { // Counted loop with a block-scoped counter
+            const std::string counter = fresh("index");
+            emit("for");
+            emit("(");
+            emit("let");
+            emit(counter);
+            emit("=");
+            emit("0");
+            emit(";");
+            emit(counter);
+            emit("<");
+            emit(std::to_string(pick(1, 4)));
+            emit(";");
+            emit(counter);
+            emit("++");
+            emit(")");
+            scopes_.push_back({{counter, false}});
+            block(depth);
+            scopes_.pop_back();
+            break;
+        }
+        case 7: { // Nested function, called later
+            const std::string name = fresh("helper"), parameter = fresh("value");
+            emit("function");
+            emit(name);
+            emit("(");
+            emit(parameter);
+            emit(")");
+            emit("{");
+            scopes_.push_back({{parameter, true}});
+            statement(depth - 1);
+            emit("return");
+            expression(2);
+            emit(";");
+            scopes_.pop_back();
+            emit("}");
+            declare(name + "(" + std::to_string(pick(0, 5)) + ")", false);
+            break;
+        }
+        default:
+            block(depth);
+            break;
+        }
+    }
+
+    void expression(int depth) {
+        const int kind = depth > 0 ? pick(0, 10) : pick(0, 2);
+        switch (kind) {
+        case 0: {
+            const auto locals = visible(false);
+            if (!locals.empty()) {
+                const std::string& name = locals[pick(0, static_cast<int>(locals.size()) - 1)]->name;
+                const size_t call = name.find('(');
+                if (call == std::string::npos) {
+                    emit(name);
+                } else { // helper(3)
+                    emit(name.substr(0, call));
+                    emit("(");
+                    emit(name.substr(call + 1, name.size() - call - 2));
+                    emit(")");
+                }
+                return;
+            }
+            [[fallthrough]];
+        }
+        case 1: {
+            static const char* const NUMBERS[] = {"0", "1", "2.5", "0x1f", "1e3", ".5", "7"};
+            emit(NUMBERS[pick(0, 6)]);
+            return;
+        }
+        case 2: {
+            static const char* const STRINGS[] = {"'a b'", "\"x, y\"", "'// not a comment'", "\"{ }\"", "'it /* is */'"};
+            emit(STRINGS[pick(0, 4)]);
+            return;
+        }
+        case 3:
+        case 4: { // Binary, parenthesized
+            static const char* const OPERATORS[] = {"+", "-", "*", "/", "%", "<", ">=", "===", "!=", "&&", "||", "??", "+", "-"};
+            emit("(");
+            expression(depth - 1);
+            emit(OPERATORS[pick(0, 13)]);
+            expression(depth - 1);
+            emit(")");
+            return;
+        }
+        case 5: { // Unary
+            static const char* const OPERATORS[] = {"-", "+", "!", "typeof"};
+            emit("(");
+            emit(OPERATORS[pick(0, 3)]);
+            expression(depth - 1);
+            emit(")");
+            return;
+        }
+        case 6: // Conditional
+            emit("(");
+            expression(depth - 1);
+            emit("?");
+            expression(depth - 1);
+            emit(":");
+            expression(depth - 1);
+            emit(")");
+            return;
+        case 7: // Array length
+            emit("[");
+            expression(depth - 1);
+            emit(",");
+            expression(depth - 1);
+            emit("]");
+            emit(".length");
+            return;
+        case 8: { // Object with a shorthand property, read back
+            const auto locals = visible(false);
+            std::string name;
+            for (const Local* local : locals) {
+                if (local->name.find('(') == std::string::npos) name = local->name;
+            }
+            if (name.empty()) name = "amount";
+            emit("(");
+            emit("{");
+            emit(name);
+            emit(",");
+            emit("extra");
+            emit(":");
+            expression(depth - 1);
+            emit("}");
+            emit(")");
+            emit(".");
+            emit(pick(0, 1) ? name : "extra");
+            return;
+        }
+        case 9: { // Arrow function, called at once
+            const std::string parameter = fresh("item");
+            emit("(");
+            emit("(");
+            emit(parameter);
+            emit(")");
+            emit("=>");
+            scopes_.push_back({{parameter, true}});
+            expression(depth - 1);
+            scopes_.pop_back();
+            emit(")");
+            emit("(");
+            expression(depth - 1);
+            emit(")");
+            return;
+        }
+        default: { // An earlier function
+            if (functions_.empty()) {
+                emit("label");
+                return;
+            }
+            emit(functions_[pick(0, static_cast<int>(functions_.size()) - 1)]);
+            emit("(");
+            expression(depth - 1);
+            emit(",");
+            emit("'x'");
+            emit(")");
+            return;
+        }
+        }
+    }
+
+    std::mt19937 rng_;
+    std::string out_;
+    std::string last_;
+    std::vector<std::vector<Local>> scopes_;
+    std::vector<std::string> functions_;
+    size_t counter_ = 0;
+    bool block_start_ = false;
+};
+
+// --- Checks ---
+
+static std::vector<std::string_view> tokens_of(std::string_view js) {
+    std::vector<std::string_view> tokens;
+    if (!js_tokens(js, tokens)) tokens.clear();
+    return tokens;
+}
+
+static std::string run_node(const std::string& script, const fs::path& directory, int case_number) {
+    const fs::path script_path = directory / ("case_" + std::to_string(case_number) + ".js");
+    const fs::path output_path = directory / ("case_" + std::to_string(case_number) + ".out");
+    {
+        std::ofstream file(script_path, std::ios::binary);
+        file << script;
+    }
+    const std::string command = "node " + script_path.string() + " > " + output_path.string() + " 2>&1";
+    const int status = std::system(command.c_str());
+    std::ifstream output(output_path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << output.rdbuf() << "\n(exit " << status << ")";
+    return buffer.str();
+}
+
+static void report_failure(const char* check, int case_number, const std::string& input) {
+    std::cerr << "Error: " << check << " failed for case " << case_number << ":\n" << input << std::endl;
+}
+
+// Script, then what minify_js makes of it.
+static const std::pair<const char*, const char*> FIXED_JS_CASES[] = {
+    // A var redeclaring a catch parameter assigns the parameter (Annex B.3.5): t(1) is 1.
+    {"function t(e){try{throw 2}catch(e){var e=5}return e}", "function t(a){try{throw 2}catch(a){var a=5}return a}"},
+    {"function t(){try{throw 2}catch(e){try{throw 3}catch(e){var e=5}return e}}",
+     "function t(){try{throw 2}catch(b){try{throw 3}catch(a){var a=5}return b}}"},
+    {"try{throw 2}catch(e){var e=5}", "try{throw 2}catch(e){var e=5}"},
+};
+
+int main(int argc, char* argv[]) {
+    int iterations = 200;
+    int cases = 500;
+    uint32_t seed = 1;
+    bool use_node = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--cases" && i + 1 < argc) {
+            cases = std::atoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--node") {
+            use_node = true;
+        } else {
+            iterations = std::max(1, std::atoi(arg.c_str()));
+        }
+    }
+
+    size_t fixed_failures = 0;
+    for (const auto& [js, expected] : FIXED_JS_CASES) {
+        const std::string minified = minify_js(js);
+        if (minified != expected) {
+            std::cerr << "Error: JS: fixed case " << js << "\n  expected " << expected << "\n  got      " << minified << std::endl;
+            ++fixed_failures;
+        }
+    }
+    std::cout << std::size(FIXED_JS_CASES) << " fixed scripts: " << fixed_failures << " failed" << std::endl;
+
+    // Fuzz check
+    size_t failures = 0;
+    CssGenerator css_generator(seed);
+    JsGenerator js_generator(seed);
+    const fs::path node_directory = fs::temp_directory_path() / "asset_minify_bench";
+    if (use_node) fs::create_directories(node_directory);
+    size_t renamed = 0;
+    for (int c = 0; c < cases; ++c) {
+        const std::string css = css_generator.stylesheet();
+        const std::string css_minified = minify_css(css);
+        if (minify_css(minify_css_by_chars(css)) != css_minified) {
+            report_failure("CSS: minify_css(old(x)) == minify_css(x)", c, css);
+            ++failures;
+        } else if (minify_css(css_minified) != css_minified) {
+            report_failure("CSS: idempotence", c, css);
+            ++failures;
+        }
+
+        const std::string js = js_generator.script();
+        JsMinifyStats stats;
+        const std::string js_minified = minify_js_with(js, true, stats);
+        renamed += stats.renamed;
+        JsMinifyStats unrenamed_stats;
+        const auto original_tokens = tokens_of(js);
+        if (!stats.tokenized || !stats.mangled) {
+            report_failure("JS: tokenizing and renaming", c, js);
+            ++failures;
+        } else if (tokens_of(minify_js_with(js, false, unrenamed_stats)) != original_tokens) {
+            report_failure("JS: tokens kept", c, js);
+            ++failures;
+        } else if (tokens_of(minify_js(minify_js_by_chars(js))) != tokens_of(js_minified)) {
+            report_failure("JS: tokens of minify_js(old(x)) == tokens of minify_js(x)", c, js);
+            ++failures;
+        } else if (minify_js(js_minified) != js_minified) {
+            report_failure("JS: idempotence", c, js);
+            ++failures;
+        } else if (use_node && run_node(js, node_directory, c) != run_node(js_minified, node_directory, c)) {
+            report_failure("JS: same output under node", c, js);
+            ++failures;
+        }
+    }
+    if (use_node) fs::remove_all(node_directory);
+    std::cout << cases << " random stylesheets and scripts (seed " << seed << "): " << failures << " failed, "
+              << renamed << " local variables renamed" << (use_node ? ", run under node" : "") << std::endl;
+
+    // Throughput on the real assets
+    std::vector<std::pair<fs::path, std::string>> stylesheets, scripts;
+    for (const auto& source_path : list_static_assets()) {
+        if (static_asset_kind(source_path) != AssetKind::Minified) continue;
+        const fs::path type_path = static_asset_output_path(source_path);
+        (type_path.extension() == ".css" ? stylesheets : scripts).emplace_back(source_path, read_file(source_path));
+    }
+    if (stylesheets.empty() && scripts.empty()) {
+        std::cerr << "Error: No CSS or JS assets found in " << STATIC_SOURCE_DIR << std::endl;
+        return 1;
+    }
+
+    auto measure = [&](const char* label, const std::vector<std::pair<fs::path, std::string>>& assets,
+                       std::string (*minify)(const std::string&)) {
+        size_t input_bytes = 0, output_bytes = 0;
+        for (const auto& [path, content] : assets) input_bytes += content.size();
+        auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (const auto& [path, content] : assets) output_bytes += minify(content).size();
+        }
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const double total_mb = static_cast<double>(input_bytes) * iterations / 1048576.0;
+        std::cout << label << ": " << ms << " ms total, " << total_mb / (ms / 1000.0) << " MB/s, "
+                  << input_bytes << " -> " << output_bytes / iterations << " bytes" << std::endl;
+        return ms;
+    };
+
+    std::cout << stylesheets.size() << " stylesheets, " << scripts.size() << " scripts x " << iterations << " iterations" << std::endl;
+    const double old_css_ms = measure("CSS, character loop (previous)", stylesheets, minify_css_by_chars);
+    const double css_ms = measure("CSS, tokenizer", stylesheets, minify_css);
+    std::cout << "  speedup: " << old_css_ms / css_ms << "x" << std::endl;
+    const double old_js_ms = measure("JS, character loop (previous)", scripts, minify_js_by_chars);
+    const double js_ms = measure("JS, tokenizer + renaming", scripts, minify_js);
+    std::cout << "  speedup: " << old_js_ms / js_ms << "x" << std::endl;
+
+    for (const auto& [path, content] : stylesheets) {
+        CssMinifyStats stats;
+        minify_css_with_stats(content, stats);
+        std::cout << path.filename().string() << ": " << stats.numbers << " numbers and " << stats.colors
+                  << " colors shortened, " << stats.duplicates << " duplicates dropped, " << stats.merged_rules
+                  << " rules merged, " << stats.empty_rules << " empty rules dropped" << std::endl;
+    }
+    for (const auto& [path, content] : scripts) {
+        JsMinifyStats stats;
+        minify_js_with(content, true, stats);
+        std::cout << path.filename().string() << ": " << stats.tokens << " tokens, " << stats.renamed
+                  << " local variables renamed" << (stats.mangled ? "" : " (renaming skipped)") << std::endl;
+    }
+
+    if (failures != 0 || fixed_failures != 0) {
+        std::cerr << "Error: " << failures << " random and " << fixed_failures << " fixed cases failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
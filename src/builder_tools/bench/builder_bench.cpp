@@ -0,0 +1,655 @@
+// Benchmark suite: every builder stage on a synthetic corpus (see
+// corpus_generator.h), then whole-site builds at several corpus sizes, each in
+// a forked process so its peak RSS can be measured on its own. Results are
+// printed and, with --json, written as a machine-readable file. Run from the
+// repository root (templates and static assets are taken from there):
+//   ./builder_bench [--stages-only | --pipeline-only] [--sizes 1000,10000,100000] [--json FILE]
+// With --max-rss, a build whose peak RSS goes over the ceiling fails the run:
+//   ./builder_bench --pipeline-only --sizes 100000 --max-memory 256 --max-rss 768
+#include "pipeline.h"
+#include "cmark_arena.h"
+#include "corpus_generator.h"
+#include "front_matter.h"
+#include "related_posts.h"
+#include "search_index.h"
+#include "stream_writer.h"
+#include "syntax_highlight.h"
+#include "task_graph.h"
+#include "tokenizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef BUILDER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+struct BenchOptions {
+    bool run_stages = true;
+    bool run_pipeline = true;
+    double min_seconds = 0.5; // Per stage: repeat passes until at least this long
+    std::vector<size_t> pipeline_sizes = {1000, 10000, 100000};
+    unsigned jobs = 0;
+    bool release = false; // Pipeline runs use the dev compression profile unless set
+    fs::path work_dir = fs::temp_directory_path() / "blog-builder-bench";
+    bool keep_sites = false;
+    fs::path json_path;
+    size_t max_memory = 0; // BuildOptions::max_memory of the builds, in bytes
+    long max_rss_kb = 0;   // Peak RSS ceiling of the builds; 0 for none
+};
+
+struct StageResult {
+    std::string name;
+    size_t items = 0; // Per pass
+    size_t bytes = 0; // Input bytes per pass
+    size_t passes = 0;
+    double seconds = 0; // All passes
+    double allocations_per_item = -1; // System allocations, where measured
+};
+
+struct PipelineResult {
+    size_t posts = 0;
+    size_t markdown_bytes = 0;
+    bool ok = false;
+    double seconds = 0;
+    double noop_seconds = 0; // Incremental rebuild with nothing changed
+    long peak_rss_kb = 0;
+};
+
+// Counts bytes without storing them, so only the producer is timed.
+class CountingSink : public ByteSink {
+public:
+    bool write(const char*, size_t size) override {
+        bytes += size;
+        return true;
+    }
+    size_t bytes = 0;
+};
+
+// Silences std::cout while alive (stage functions print progress lines).
+class QuietStdout {
+public:
+    QuietStdout() : saved_(std::cout.rdbuf(nullptr)) {}
+    ~QuietStdout() {
+        std::cout.rdbuf(saved_);
+        std::cout.clear();
+    }
+private:
+    std::streambuf* saved_;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs pass() until min_seconds have elapsed (at least once) and prints the
+// stage's throughput.
+template <typename Pass>
+StageResult measure_stage(const std::string& name, size_t items, size_t bytes, double min_seconds, Pass&& pass) {
+    StageResult result{name, items, bytes, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    do {
+        pass();
+        ++result.passes;
+        result.seconds = seconds_since(start);
+    } while (result.seconds < min_seconds);
+
+    double per_pass = result.seconds / static_cast<double>(result.passes);
+    std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << per_pass * 1000.0 << " ms/pass " << std::setw(9)
+              << static_cast<double>(bytes) / 1048576.0 / per_pass << " MB/s " << std::setw(11)
+              << static_cast<double>(items) / per_pass << " items/s" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    return result;
+}
+
+// Fastest pass of each of two variants of a stage, alternating between them
+// until min_seconds have elapsed: a difference of a few percent is lost in the
+// drift between two stages measured one after the other.
+template <typename PassA, typename PassB>
+std::pair<double, double> fastest_interleaved(double min_seconds, PassA&& pass_a, PassB&& pass_b) {
+    std::pair<double, double> fastest{1e9, 1e9};
+    auto start = std::chrono::steady_clock::now();
+    do {
+        auto pass_start = std::chrono::steady_clock::now();
+        pass_a();
+        fastest.first = std::min(fastest.first, seconds_since(pass_start));
+        pass_start = std::chrono::steady_clock::now();
+        pass_b();
+        fastest.second = std::min(fastest.second, seconds_since(pass_start));
+    } while (seconds_since(start) < min_seconds);
+    return fastest;
+}
+
+// cmark's default malloc-backed allocator, counting calloc/realloc calls: the
+// baseline the arena in convert_markdown_to_html is compared with.
+size_t malloc_allocations = 0;
+void* counting_calloc(size_t count, size_t size) {
+    ++malloc_allocations;
+    return std::calloc(count, size);
+}
+void* counting_realloc(void* pointer, size_t size) {
+    ++malloc_allocations;
+    return std::realloc(pointer, size);
+}
+cmark_mem counting_malloc_mem = {counting_calloc, counting_realloc, std::free};
+
+std::string markdown_to_html_with_malloc(std::string_view markdown) {
+    cmark_parser* parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, &counting_malloc_mem);
+    cmark_parser_feed(parser, markdown.data(), markdown.size());
+    cmark_node* document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    char* rendered = cmark_render_html_with_mem(document, CMARK_OPT_DEFAULT, nullptr, &counting_malloc_mem);
+    std::string html(rendered);
+    counting_malloc_mem.free(rendered);
+    cmark_node_free(document);
+    return html;
+}
+
+// convert_markdown_to_html with fenced code left as cmark writes it: what
+// highlighting adds to markdown_to_html is measured against this.
+std::string markdown_to_html_unhighlighted(std::string_view markdown) {
+    cmark_parser* parser = cmark_parser_new_with_mem(CMARK_OPT_DEFAULT, CmarkArena::mem());
+    cmark_parser_feed(parser, markdown.data(), markdown.size());
+    cmark_node* document = cmark_parser_finish(parser);
+    std::string html(cmark_render_html_with_mem(document, CMARK_OPT_DEFAULT, nullptr, CmarkArena::mem()));
+    CmarkArena::for_this_thread().reset();
+    return html;
+}
+
+// The std::regex title/date extraction read_post_source used before
+// front_matter.cpp: the baseline scan_post_source is compared with.
+void post_metadata_with_regex(std::string_view markdown, PostMetadata& post) {
+    static const std::regex title_regex("^# (.+)\n");
+    static const std::regex date_regex("^Date: (\\d{4}-\\d{2}-\\d{2})\n");
+    std::cmatch match;
+    const char* begin = markdown.data();
+    const char* end = begin + markdown.size();
+    post.title = std::regex_search(begin, end, match, title_regex) ? match[1].str() : "Untitled Post " + post.id;
+    post.date = std::regex_search(begin, end, match, date_regex) ? match[1].str() : "2000-01-01";
+}
+
+std::string compress_brotli(const std::string& content, CompressionSettings settings) {
+    std::string compressed(BrotliEncoderMaxCompressedSize(content.size()), '\0');
+    size_t compressed_size = compressed.size();
+    if (!BrotliEncoderCompress(settings.quality, settings.lgwin, BROTLI_MODE_TEXT, content.size(),
+                               reinterpret_cast<const uint8_t*>(content.data()), &compressed_size,
+                               reinterpret_cast<uint8_t*>(compressed.data()))) {
+        return {};
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+// zlib framing rather than gzip's: the deflate work is the same.
+std::string compress_gzip(const std::string& content, CompressionSettings settings) {
+    uLongf compressed_size = compressBound(content.size());
+    std::string compressed(compressed_size, '\0');
+    if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+                  reinterpret_cast<const Bytef*>(content.data()), content.size(), settings.gzip_level) != Z_OK) {
+        return {};
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+#ifdef BUILDER_HAVE_ZSTD
+std::string compress_zstd(const std::string& content, CompressionSettings settings) {
+    std::string compressed(ZSTD_compressBound(content.size()), '\0');
+    size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), content.data(), content.size(), settings.zstd_level);
+    if (ZSTD_isError(compressed_size)) return {};
+    compressed.resize(compressed_size);
+    return compressed;
+}
+#endif
+
+// --- Stage Micro-benchmarks ---
+
+bool run_stage_benchmarks(const CorpusOptions& corpus_options, const BenchOptions& options, std::vector<StageResult>& results) {
+    CorpusGenerator generator(corpus_options);
+    std::vector<std::string> markdown_sources;
+    std::vector<PostMetadata> posts;
+    std::vector<fs::path> file_names;
+    size_t markdown_bytes = 0;
+    for (size_t index = 0; index < corpus_options.post_count; ++index) {
+        markdown_sources.push_back(generator.generate_post(index));
+        markdown_bytes += markdown_sources.back().size();
+
+        file_names.push_back(generator.post_file_name(index));
+        PostMetadata post;
+        post.id = file_names.back().stem().string();
+        post.permalink = "p/" + post.id + ".html";
+        if (!scan_post_source(file_names.back(), markdown_sources.back(), post)) return false;
+        posts.push_back(std::move(post));
+    }
+    if (posts.empty()) {
+        std::cerr << "Error: The stage benchmarks need at least one post (--posts)." << std::endl;
+        return false;
+    }
+    PageTemplates templates;
+    if (!load_page_templates(templates)) return false;
+
+    std::cout << "⏱️  Stages: " << posts.size() << " synthetic posts, " << markdown_bytes / 1024 << " KB of markdown" << std::endl;
+    const size_t post_count = posts.size();
+    const double min_seconds = options.min_seconds;
+
+    std::vector<PostMetadata> scanned(post_count);
+    for (size_t i = 0; i < post_count; ++i) scanned[i].id = posts[i].id;
+    results.push_back(measure_stage("post_metadata_regex", post_count, markdown_bytes, min_seconds, [&] {
+        for (size_t i = 0; i < post_count; ++i) post_metadata_with_regex(markdown_sources[i], scanned[i]);
+    }));
+    results.push_back(measure_stage("scan_post_source", post_count, markdown_bytes, min_seconds, [&] {
+        for (size_t i = 0; i < post_count; ++i) scan_post_source(file_names[i], markdown_sources[i], scanned[i]);
+    }));
+
+    malloc_allocations = 0;
+    results.push_back(measure_stage("markdown_to_html_malloc", post_count, markdown_bytes, min_seconds, [&] {
+        for (size_t i = 0; i < post_count; ++i) posts[i].html_body = markdown_to_html_with_malloc(markdown_sources[i]);
+    }));
+    results.back().allocations_per_item = static_cast<double>(malloc_allocations) / static_cast<double>(results.back().passes * post_count);
+    const double malloc_allocations_per_post = results.back().allocations_per_item;
+    // The same conversion without highlighting, into the same bodies.
+    auto convert_plain = [&] {
+        for (size_t i = 0; i < post_count; ++i) posts[i].html_body = markdown_to_html_unhighlighted(markdown_sources[i]);
+    };
+    results.push_back(measure_stage("markdown_to_html_plain", post_count, markdown_bytes, min_seconds, convert_plain));
+    const CmarkArena::Stats arena_before = CmarkArena::for_this_thread().stats();
+    auto convert = [&] {
+        for (size_t i = 0; i < post_count; ++i) posts[i].html_body = convert_markdown_to_html(markdown_sources[i]);
+    };
+    results.push_back(measure_stage("markdown_to_html", post_count, markdown_bytes, min_seconds, convert));
+    const CmarkArena::Stats& arena_after = CmarkArena::for_this_thread().stats();
+    const double arena_posts = static_cast<double>(results.back().passes * post_count);
+    results.back().allocations_per_item = static_cast<double>(arena_after.blocks - arena_before.blocks) / arena_posts;
+    std::cout << std::fixed << std::setprecision(2) << "    allocations per post: " << malloc_allocations_per_post
+              << " with malloc, " << static_cast<double>(arena_after.requests - arena_before.requests) / arena_posts
+              << " arena requests served by " << results.back().allocations_per_item << " system allocations" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+
+    // Fenced code blocks of the corpus, highlighted on their own.
+    std::vector<std::pair<std::string, std::string>> code_blocks; // Language, code
+    size_t code_bytes = 0;
+    for (const auto& source : markdown_sources) {
+        std::istringstream lines(source);
+        std::string line;
+        while (std::getline(lines, line)) {
+            if (line.compare(0, 3, "```") != 0) continue;
+            std::pair<std::string, std::string> block{line.substr(3), ""};
+            while (std::getline(lines, line) && line.compare(0, 3, "```") != 0) block.second += line + '\n';
+            code_bytes += block.second.size();
+            if (can_highlight(block.first)) code_blocks.push_back(std::move(block));
+        }
+    }
+    results.push_back(measure_stage("highlight_code", code_blocks.size(), code_bytes, min_seconds, [&] {
+        std::string html;
+        for (const auto& block : code_blocks) {
+            html.clear();
+            highlight_code(block.first, block.second, html);
+        }
+    }));
+    // What highlighting adds to markdown_to_html; convert runs last so the
+    // bodies the later stages use are highlighted.
+    const auto [plain_seconds, markdown_seconds] = fastest_interleaved(min_seconds, convert_plain, convert);
+    std::cout << std::fixed << std::setprecision(1) << "    highlighting: " << 100.0 * (markdown_seconds - plain_seconds) / markdown_seconds
+              << "% of markdown_to_html, " << 100.0 * static_cast<double>(code_bytes) / static_cast<double>(markdown_bytes)
+              << "% of the markdown is code" << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+
+    size_t body_bytes = 0;
+    for (const auto& post : posts) body_bytes += post.html_body.size();
+    std::vector<std::string> pages(post_count);
+    results.push_back(measure_stage("render_post_page", post_count, body_bytes, min_seconds, [&] {
+        for (size_t i = 0; i < post_count; ++i) pages[i] = render_post_page(templates, posts[i], "");
+    }));
+
+    size_t page_bytes = 0;
+    for (const auto& page : pages) page_bytes += page.size();
+    results.push_back(measure_stage("minify_html", post_count, page_bytes, min_seconds, [&] {
+        CountingSink sink;
+        for (const auto& page : pages) minify_html_to(page, sink);
+    }));
+
+    std::vector<std::string> stylesheets;
+    std::vector<std::string> scripts;
+    for (const auto& asset_path : list_static_assets()) {
+        fs::path type_path = asset_path.extension() == ".source" ? asset_path.stem() : asset_path;
+        if (type_path.extension() == ".css") stylesheets.push_back(read_file(asset_path));
+        else if (type_path.extension() == ".js") scripts.push_back(read_file(asset_path));
+    }
+    auto total_size = [](const std::vector<std::string>& contents) {
+        size_t total = 0;
+        for (const auto& content : contents) total += content.size();
+        return total;
+    };
+    if (!stylesheets.empty()) {
+        results.push_back(measure_stage("minify_css", stylesheets.size(), total_size(stylesheets), min_seconds, [&] {
+            for (const auto& css : stylesheets) minify_css(css);
+        }));
+    }
+    if (!scripts.empty()) {
+        results.push_back(measure_stage("minify_js", scripts.size(), total_size(scripts), min_seconds, [&] {
+            for (const auto& js : scripts) minify_js(js);
+        }));
+    }
+
+    std::vector<std::string> minified_pages;
+    size_t minified_bytes = 0;
+    for (const auto& page : pages) {
+        minified_pages.push_back(minify_html(page));
+        minified_bytes += minified_pages.back().size();
+    }
+    for (bool dev : {true, false}) {
+        set_dev_compression(dev);
+        CompressionSettings settings = compression_settings_for(OutputClass::PostPage);
+        const std::string profile = dev ? "_dev" : "_release";
+        results.push_back(measure_stage("brotli_q" + std::to_string(settings.quality) + profile, post_count, minified_bytes, min_seconds, [&] {
+            for (const auto& page : minified_pages) compress_brotli(page, settings);
+        }));
+#ifdef BUILDER_HAVE_ZSTD
+        results.push_back(measure_stage("zstd_l" + std::to_string(settings.zstd_level) + profile, post_count, minified_bytes, min_seconds, [&] {
+            for (const auto& page : minified_pages) compress_zstd(page, settings);
+        }));
+#endif
+        results.push_back(measure_stage("gzip_l" + std::to_string(settings.gzip_level) + profile, post_count, minified_bytes, min_seconds, [&] {
+            for (const auto& page : minified_pages) compress_gzip(page, settings);
+        }));
+    }
+    set_dev_compression(false);
+
+    const TokenizerOptions tokenizer_options;
+    results.push_back(measure_stage("tokenize", post_count, body_bytes, min_seconds, [&] {
+        for (const auto& post : posts) {
+            SearchTokenizer tokenizer(post.html_body, TextKind::Html, tokenizer_options);
+            std::string_view token;
+            uint32_t position;
+            while (tokenizer.next(token, position)) {}
+        }
+    }));
+
+    SearchIndexBuilder search_index;
+    results.push_back(measure_stage("search_index_add", post_count, body_bytes, min_seconds, [&] {
+        search_index.clear();
+        for (const auto& post : posts) search_index.add_document(post.id, post.title, post.html_body);
+    }));
+    std::vector<const PostMetadata*> sorted_posts = sorted_by_date(posts);
+    results.push_back(measure_stage("search_index_encode", post_count, body_bytes, min_seconds, [&] {
+        QuietStdout quiet;
+        SearchIndexFiles files;
+        search_index.encode(sorted_posts, {}, files);
+    }));
+
+    // Related posts from the index's term counts, on one thread and then on
+    // every job: how close to linear the neighbour search scales.
+    RelatedPosts related;
+    for (const auto& post : posts) related.set_terms(post.id, "", search_index.count_terms(post.title, post.html_body));
+    const unsigned related_jobs = options.jobs == 0 ? default_job_count() : options.jobs;
+    double single_job_seconds = 0;
+    for (unsigned jobs : {1u, related_jobs}) {
+        if (jobs == 1 && single_job_seconds > 0) break;
+        results.push_back(measure_stage("related_posts_j" + std::to_string(jobs), post_count, body_bytes, min_seconds, [&] {
+            related.compute(sorted_posts, jobs);
+        }));
+        const double seconds = results.back().seconds / static_cast<double>(results.back().passes);
+        if (jobs == 1) {
+            single_job_seconds = seconds;
+            continue;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "    related posts: " << single_job_seconds / seconds
+                  << "x faster on " << jobs << " jobs" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+    }
+    std::cout << "    related posts: " << related.summary() << std::endl;
+
+    std::vector<std::string> json_records(post_count);
+    size_t json_bytes = 0;
+    results.push_back(measure_stage("post_metadata_to_json", post_count, body_bytes, min_seconds, [&] {
+        for (size_t i = 0; i < post_count; ++i) json_records[i] = post_metadata_to_json(posts[i], posts[i].html_body);
+    }));
+    for (const auto& record : json_records) json_bytes += record.size();
+    results.push_back(measure_stage("post_metadata_from_json", post_count, json_bytes, min_seconds, [&] {
+        for (const auto& record : json_records) post_metadata_from_json(record);
+    }));
+    return true;
+}
+
+// --- Whole-site Builds ---
+
+// Builds the site in site_dir in a child process. Returns false if the build
+// failed; peak_rss_kb is the child's own high-water mark (wait4 reports it per
+// child, unlike RUSAGE_CHILDREN which keeps the maximum over all of them).
+bool run_build_in_child(const fs::path& site_dir, const BuildOptions& build_options, double& seconds, long& peak_rss_kb) {
+    std::cout.flush();
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        int dev_null = open("/dev/null", O_WRONLY);
+        if (dev_null >= 0) dup2(dev_null, STDOUT_FILENO);
+        if (chdir(site_dir.c_str()) != 0) _exit(2);
+        bool ok = build_site(build_options);
+        std::cout.flush();
+        _exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    struct rusage usage {};
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        std::perror("wait4");
+        return false;
+    }
+    seconds = seconds_since(start);
+    peak_rss_kb = usage.ru_maxrss;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Error: Build in " << site_dir << " failed (status " << status << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+PipelineResult run_pipeline_benchmark(CorpusOptions corpus_options, size_t post_count, const BenchOptions& options) {
+    PipelineResult result;
+    result.posts = post_count;
+    corpus_options.post_count = post_count;
+    fs::path site_dir = options.work_dir / ("site-" + std::to_string(post_count));
+
+    std::error_code ec;
+    fs::remove_all(site_dir, ec);
+    CorpusGenerator generator(corpus_options);
+    result.markdown_bytes = generator.write_site(site_dir, fs::current_path());
+    if (result.markdown_bytes == 0) return result;
+
+    BuildOptions build_options;
+    build_options.jobs = options.jobs;
+    build_options.dev = !options.release;
+    build_options.clean = true;
+    build_options.max_memory = options.max_memory;
+    long noop_rss_kb = 0;
+    result.ok = run_build_in_child(site_dir, build_options, result.seconds, result.peak_rss_kb);
+    if (result.ok) {
+        build_options.clean = false;
+        result.ok = run_build_in_child(site_dir, build_options, result.noop_seconds, noop_rss_kb);
+    }
+
+    if (result.ok) {
+        std::cout << "  " << std::setw(7) << post_count << " posts: " << std::fixed << std::setprecision(2)
+                  << result.seconds << " s, " << std::setprecision(0) << static_cast<double>(post_count) / result.seconds
+                  << " posts/s, " << std::setprecision(2) << static_cast<double>(result.markdown_bytes) / 1048576.0 / result.seconds
+                  << " MB/s, peak RSS " << result.peak_rss_kb / 1024 << " MB; no-op rebuild " << result.noop_seconds
+                  << " s" << std::endl;
+        std::cout.unsetf(std::ios::floatfield);
+        if (options.max_rss_kb > 0 && std::max(result.peak_rss_kb, noop_rss_kb) > options.max_rss_kb) {
+            std::cerr << "Error: The " << post_count << "-post build peaked at "
+                      << std::max(result.peak_rss_kb, noop_rss_kb) / 1024 << " MB RSS, over the "
+                      << options.max_rss_kb / 1024 << " MB ceiling." << std::endl;
+            result.ok = false;
+        }
+    }
+    if (!options.keep_sites) fs::remove_all(site_dir, ec);
+    return result;
+}
+
+// --- Results File ---
+
+std::string results_json(const CorpusOptions& corpus_options, const BenchOptions& options,
+                         const std::vector<StageResult>& stages, const std::vector<PipelineResult>& builds) {
+    std::ostringstream json;
+    json << std::setprecision(6);
+    json << "{\"builderVersion\":\"" << BUILDER_VERSION << "\",\"hardwareThreads\":" << std::thread::hardware_concurrency()
+         << ",\"corpus\":{\"seed\":" << corpus_options.seed << ",\"meanWords\":" << corpus_options.mean_words
+         << ",\"sizeSigma\":" << corpus_options.size_sigma << ",\"codeBlockDensity\":" << corpus_options.code_block_density
+         << ",\"vocabulary\":" << corpus_options.vocabulary_size << ",\"zipf\":" << corpus_options.zipf_s
+         << ",\"unicodeRatio\":" << corpus_options.unicode_ratio << "},\"stages\":[";
+    for (size_t i = 0; i < stages.size(); ++i) {
+        const StageResult& stage = stages[i];
+        double per_pass = stage.seconds / static_cast<double>(stage.passes);
+        json << (i ? "," : "") << "{\"name\":\"" << stage.name << "\",\"posts\":" << corpus_options.post_count
+             << ",\"items\":" << stage.items << ",\"bytes\":" << stage.bytes << ",\"passes\":" << stage.passes
+             << ",\"secondsPerPass\":" << per_pass << ",\"mbPerSecond\":" << static_cast<double>(stage.bytes) / 1048576.0 / per_pass
+             << ",\"itemsPerSecond\":" << static_cast<double>(stage.items) / per_pass;
+        if (stage.allocations_per_item >= 0) json << ",\"allocationsPerItem\":" << stage.allocations_per_item;
+        json << "}";
+    }
+    json << "],\"builds\":[";
+    for (size_t i = 0; i < builds.size(); ++i) {
+        const PipelineResult& build = builds[i];
+        json << (i ? "," : "") << "{\"posts\":" << build.posts << ",\"markdownBytes\":" << build.markdown_bytes
+             << ",\"jobs\":" << options.jobs << ",\"maxMemory\":" << options.max_memory
+             << ",\"profile\":\"" << (options.release ? "release" : "dev")
+             << "\",\"ok\":" << (build.ok ? "true" : "false") << ",\"seconds\":" << build.seconds
+             << ",\"postsPerSecond\":" << (build.ok ? static_cast<double>(build.posts) / build.seconds : 0.0)
+             << ",\"mbPerSecond\":" << (build.ok ? static_cast<double>(build.markdown_bytes) / 1048576.0 / build.seconds : 0.0)
+             << ",\"peakRssKb\":" << build.peak_rss_kb << ",\"noopRebuildSeconds\":" << build.noop_seconds << "}";
+    }
+    struct rusage self_usage {};
+    getrusage(RUSAGE_SELF, &self_usage);
+    json << "],\"benchPeakRssKb\":" << self_usage.ru_maxrss << "}\n";
+    return json.str();
+}
+
+bool parse_sizes(const std::string& list, std::vector<size_t>& sizes) {
+    sizes.clear();
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char* end = nullptr;
+        unsigned long long size = std::strtoull(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || size == 0) return false;
+        sizes.push_back(static_cast<size_t>(size));
+    }
+    return !sizes.empty();
+}
+
+// "256" (megabytes) -> 256; 0 if not a positive number.
+size_t parse_megabytes(const char* value) {
+    char* end = nullptr;
+    unsigned long long megabytes = std::strtoull(value, &end, 10);
+    return end == value || *end != '\0' ? 0 : static_cast<size_t>(megabytes);
+}
+
+void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [options] [corpus options]" << std::endl;
+    std::cout << "  --stages-only       Only the per-stage micro-benchmarks (on --posts posts)" << std::endl;
+    std::cout << "  --pipeline-only     Only the whole-site builds" << std::endl;
+    std::cout << "  --sizes LIST        Post counts of the whole-site builds (default 1000,10000,100000)" << std::endl;
+    std::cout << "  --min-time S        Minimum seconds per stage benchmark (default 0.5)" << std::endl;
+    std::cout << "  -j, --jobs N        Worker threads for the builds (default: one per hardware thread)" << std::endl;
+    std::cout << "  --release           Release compression settings for the builds (default: --dev settings)" << std::endl;
+    std::cout << "  --work-dir DIR      Where the synthetic sites are generated (default: $TMPDIR/blog-builder-bench)" << std::endl;
+    std::cout << "  --keep              Keep the generated sites" << std::endl;
+    std::cout << "  --json FILE         Also write the results as JSON" << std::endl;
+    std::cout << "  --max-memory MB     Build with --max-memory MB (streaming mode)" << std::endl;
+    std::cout << "  --max-rss MB        Fail if a build's peak RSS goes over MB" << std::endl;
+    std::cout << corpus_flags_usage();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    CorpusOptions corpus_options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool error = false;
+        if (parse_corpus_flag(argc, argv, i, corpus_options, error)) {
+            if (error) return 1;
+        } else if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--stages-only") {
+            options.run_pipeline = false;
+        } else if (arg == "--pipeline-only") {
+            options.run_stages = false;
+        } else if (arg == "--sizes" && i + 1 < argc) {
+            if (!parse_sizes(argv[++i], options.pipeline_sizes)) {
+                std::cerr << "Error: --sizes expects a comma-separated list of post counts." << std::endl;
+                return 1;
+            }
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            options.min_seconds = std::atof(argv[++i]);
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            int jobs = std::atoi(argv[++i]);
+            if (jobs <= 0) {
+                std::cerr << "Error: --jobs expects a positive number." << std::endl;
+                return 1;
+            }
+            options.jobs = static_cast<unsigned>(jobs);
+        } else if (arg == "--release") {
+            options.release = true;
+        } else if (arg == "--work-dir" && i + 1 < argc) {
+            options.work_dir = fs::absolute(argv[++i]);
+        } else if (arg == "--keep") {
+            options.keep_sites = true;
+        } else if (arg == "--json" && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else if ((arg == "--max-memory" || arg == "--max-rss") && i + 1 < argc) {
+            size_t megabytes = parse_megabytes(argv[++i]);
+            if (megabytes == 0) {
+                std::cerr << "Error: " << arg << " expects a positive number of megabytes." << std::endl;
+                return 1;
+            }
+            if (arg == "--max-memory") options.max_memory = megabytes << 20;
+            else options.max_rss_kb = static_cast<long>(megabytes) * 1024;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    std::vector<StageResult> stages;
+    std::vector<PipelineResult> builds;
+    // Builds first: they fork, and the stage benchmarks leave state behind
+    // (compression profile, thread-local pools) that children need not inherit.
+    if (options.run_pipeline) {
+        std::cout << "🏗️  Whole-site builds (" << (options.release ? "release" : "dev") << " compression) in "
+                  << options.work_dir << std::endl;
+        for (size_t post_count : options.pipeline_sizes) {
+            builds.push_back(run_pipeline_benchmark(corpus_options, post_count, options));
+            ok = ok && builds.back().ok;
+        }
+        std::error_code ec;
+        if (!options.keep_sites) fs::remove(options.work_dir, ec); // Only if empty
+    }
+    if (options.run_stages) ok = run_stage_benchmarks(corpus_options, options, stages) && ok;
+
+    if (!options.json_path.empty()) {
+        if (!write_file(options.json_path, results_json(corpus_options, options, stages, builds)) || !flush_output_files()) return 1;
+        std::cout << "📄 Results written to " << options.json_path << std::endl;
+    }
+    return ok ? 0 : 1;
+}
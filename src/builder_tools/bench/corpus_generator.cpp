@@ -0,0 +1,367 @@
+#include "corpus_generator.h"
+#include "build_stages.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// --- Random Numbers ---
+// SplitMix64: tiny, fast and fully specified, unlike the std:: distributions
+// (whose output differs between standard libraries).
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, 1).
+    double uniform() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+    // Uniform in [low, high].
+    size_t between(size_t low, size_t high) { return low + static_cast<size_t>(next() % (high - low + 1)); }
+    bool chance(double probability) { return uniform() < probability; }
+    // Approximately standard normal (Irwin-Hall sum of 12 uniforms).
+    double normal() {
+        double sum = 0;
+        for (int i = 0; i < 12; ++i) sum += uniform();
+        return sum - 6.0;
+    }
+
+private:
+    uint64_t state_;
+};
+
+// Seed of post `index`: every post has its own stream, so a post's content does
+// not depend on the corpus size.
+uint64_t post_seed(uint64_t seed, size_t index) {
+    Random mixer(seed ^ (0xD1B54A32D192ED03ULL * (index + 1)));
+    return mixer.next();
+}
+
+// Most frequent ranks are real English function words, so stopword removal sees
+// realistic input; the rest of the vocabulary is made-up words.
+const char* const COMMON_WORDS[] = {
+    "the", "of", "and", "to", "a", "in", "is", "that", "for", "it", "with", "as", "on", "this",
+    "was", "be", "are", "by", "not", "or", "from", "at", "but", "an", "have", "we", "you", "can",
+    "which", "more", "build", "file", "data", "time", "code", "system", "memory", "server",
+};
+
+const char* const SYLLABLES[] = {
+    "ba", "ce", "di", "fo", "gu", "ha", "je", "ki", "lo", "mu", "na", "pe", "qui", "ra", "se",
+    "ti", "vo", "wa", "xe", "yo", "ze", "bra", "cle", "dri", "fla", "gro", "pla", "stri", "tho",
+    "ver", "an", "el", "in", "or", "ux", "ing", "tion", "ment", "er", "ly",
+};
+
+const char* const UNICODE_WORDS[] = {
+    "café", "naïve", "über", "Straße", "résumé", "façade", "jalapeño", "Ελλάδα", "Москва",
+    "東京", "日本語", "한국어", "😀",
+};
+
+const char* const CODE_LANGUAGES[] = {"cpp", "js", "python", "bash", ""};
+
+template <size_t N>
+const char* pick(Random& random, const char* const (&items)[N]) {
+    return items[random.next() % N];
+}
+
+// In place: returning the moved-in string made GCC warn (-Wmaybe-uninitialized)
+// about the short-string buffer of the temporary.
+void capitalize(std::string& word) {
+    if (!word.empty() && word[0] >= 'a' && word[0] <= 'z') word[0] = static_cast<char>(word[0] - 'a' + 'A');
+}
+
+// Days since 1970-01-01 to YYYY-MM-DD (proleptic Gregorian).
+std::string civil_date(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t day_of_era = days - era * 146097;
+    int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64_t mp = (5 * day_of_year + 2) / 153;
+    int64_t day = day_of_year - (153 * mp + 2) / 5 + 1;
+    int64_t month = mp < 10 ? mp + 3 : mp - 9;
+    int64_t year = year_of_era + era * 400 + (month <= 2);
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", static_cast<int>(year), static_cast<int>(month), static_cast<int>(day));
+    return buffer;
+}
+
+// Emits prose for one post, counting down its word budget.
+class PostWriter {
+public:
+    PostWriter(const CorpusGenerator& generator, const std::vector<std::string>& vocabulary,
+               const std::vector<double>& zipf_cdf, Random& random)
+        : options_(generator.options()), vocabulary_(vocabulary), zipf_cdf_(zipf_cdf), random_(random) {}
+
+    // Calls draw from the random stream, so never make two in one expression
+    // (their order would be unspecified).
+    std::string word() {
+        if (options_.unicode_ratio > 0 && random_.chance(options_.unicode_ratio)) return pick(random_, UNICODE_WORDS);
+        double u = random_.uniform();
+        size_t rank = static_cast<size_t>(std::upper_bound(zipf_cdf_.begin(), zipf_cdf_.end(), u) - zipf_cdf_.begin());
+        return vocabulary_[std::min(rank, vocabulary_.size() - 1)];
+    }
+
+    std::string words(size_t count, bool capitalize_first) {
+        std::string text;
+        for (size_t i = 0; i < count; ++i) {
+            if (i != 0) text += ' ';
+            std::string w = word();
+            if (i == 0 && capitalize_first) capitalize(w);
+            text += w;
+        }
+        return text;
+    }
+
+    // A sentence with occasional inline code, emphasis, links and entities.
+    void sentence(std::string& out, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            if (i != 0) out += ' ';
+            std::string w = word();
+            if (i == 0) capitalize(w);
+            double roll = random_.uniform();
+            if (roll < 0.02) {
+                out += '`' + w + "()`";
+            } else if (roll < 0.035) {
+                out += "**" + w + "**";
+            } else if (roll < 0.05) {
+                out += '*' + w + '*';
+            } else if (roll < 0.06) {
+                std::string second = word();
+                out += '[' + w + ' ' + second + "](https://example.com/" + w + ')';
+            } else if (roll < 0.065) {
+                std::string second = word();
+                out += w + " & " + second;
+            } else {
+                out += w;
+            }
+        }
+        double end = random_.uniform();
+        out += end < 0.85 ? ". " : end < 0.95 ? "? " : "! ";
+        words_left_ -= std::min(words_left_, length);
+    }
+
+    void paragraph(std::string& out) {
+        size_t sentences = random_.between(2, 6);
+        for (size_t i = 0; i < sentences && words_left_ > 0; ++i) sentence(out, random_.between(6, 20));
+        if (!out.empty() && out.back() == ' ') out.pop_back();
+        out += "\n\n";
+    }
+
+    void list(std::string& out) {
+        bool ordered = random_.chance(0.3);
+        size_t items = random_.between(3, 6);
+        for (size_t i = 0; i < items && words_left_ > 0; ++i) {
+            out += ordered ? std::to_string(i + 1) + ". " : "- ";
+            size_t length = random_.between(3, 12);
+            out += words(length, true);
+            out += '\n';
+            words_left_ -= std::min(words_left_, length);
+        }
+        out += '\n';
+    }
+
+    void quote(std::string& out) {
+        out += "> ";
+        sentence(out, random_.between(8, 24));
+        out.pop_back();
+        out += "\n\n";
+    }
+
+    // Code lines in the rough shape of the block's language; the identifiers
+    // come from the vocabulary so the tokenizer sees them too.
+    void code_block(std::string& out) {
+        std::string language = pick(random_, CODE_LANGUAGES);
+        out += "```" + language + '\n';
+        size_t lines = random_.between(4, 20);
+        for (size_t i = 0; i < lines; ++i) {
+            std::string name = word();
+            name += '_' + word();
+            std::string first = word();
+            std::string second = word();
+            size_t indent = random_.between(0, 2) * 4;
+            out.append(indent, ' ');
+            switch (random_.next() % 4) {
+                case 0: out += "int " + name + " = " + std::to_string(first.size() * 37 % 1000) + ";"; break;
+                case 1: out += name + "(\"" + first + "\", " + second + ");"; break;
+                case 2: out += "if (" + name + " < " + first + ") { return " + second + "; }"; break;
+                default: out += "// " + words(random_.between(3, 8), false); break;
+            }
+            out += '\n';
+        }
+        out += "```\n\n";
+    }
+
+    void set_word_budget(size_t words) { words_left_ = words; }
+    size_t words_left() const { return words_left_; }
+
+private:
+    const CorpusOptions& options_;
+    const std::vector<std::string>& vocabulary_;
+    const std::vector<double>& zipf_cdf_;
+    Random& random_;
+    size_t words_left_ = 0;
+};
+
+bool copy_tree(const fs::path& source, const fs::path& destination) {
+    std::error_code ec;
+    fs::create_directories(destination, ec);
+    if (!ec) fs::copy(source, destination, fs::copy_options::recursive | fs::copy_options::overwrite_existing, ec);
+    if (ec) {
+        std::cerr << "Error copying " << source << " to " << destination << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// --- Corpus Generator ---
+
+CorpusGenerator::CorpusGenerator(const CorpusOptions& options) : options_(options) {
+    options_.vocabulary_size = std::max<size_t>(options_.vocabulary_size, std::size(COMMON_WORDS));
+
+    // Made-up words are numbers written in base "syllable", shortest first, so
+    // they are distinct by construction (frequent ranks get shorter words, like
+    // natural language). Within each length the order is scrambled by a seeded
+    // affine permutation, odd and not a multiple of 5, hence coprime to 40^n.
+    Random random(options_.seed);
+    vocabulary_.reserve(options_.vocabulary_size);
+    for (const char* word : COMMON_WORDS) vocabulary_.emplace_back(word);
+    static_assert(std::size(SYLLABLES) == 40, "the permutation multiplier below assumes 40 syllables");
+    const uint64_t radix = std::size(SYLLABLES);
+    uint64_t block_size = radix;
+    while (vocabulary_.size() < options_.vocabulary_size) {
+        uint64_t multiplier = random.next() | 1;
+        if (multiplier % 5 == 0) multiplier += 2;
+        uint64_t offset = random.next();
+        for (uint64_t j = 0; j < block_size && vocabulary_.size() < options_.vocabulary_size; ++j) {
+            uint64_t number = (j * multiplier + offset) % block_size;
+            std::string word;
+            for (uint64_t digits = block_size; digits > 1; digits /= radix) {
+                word += SYLLABLES[number % radix];
+                number /= radix;
+            }
+            vocabulary_.push_back(std::move(word));
+        }
+        block_size *= radix;
+    }
+
+    zipf_cdf_.resize(vocabulary_.size());
+    double total = 0;
+    for (size_t rank = 0; rank < vocabulary_.size(); ++rank) {
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_s);
+        zipf_cdf_[rank] = total;
+    }
+    for (double& cumulative : zipf_cdf_) cumulative /= total;
+}
+
+std::string CorpusGenerator::post_file_name(size_t index) const {
+    // One post every 1-3 days going back from 2026-01-01, like a busy blog.
+    Random random(post_seed(options_.seed, index));
+    int64_t days_back = static_cast<int64_t>(index) * 2 + static_cast<int64_t>(random.next() % 2);
+    return civil_date(20454 - days_back) + "-post-" + std::to_string(index) + ".md";
+}
+
+std::string CorpusGenerator::generate_post(size_t index) const {
+    Random random(post_seed(options_.seed, index) ^ 0xA5A5A5A5A5A5A5A5ULL);
+    PostWriter writer(*this, vocabulary_, zipf_cdf_, random);
+
+    double scale = options_.size_sigma > 0 ? std::exp(options_.size_sigma * random.normal()) : 1.0;
+    size_t body_words = std::max<size_t>(20, static_cast<size_t>(static_cast<double>(options_.mean_words) * scale + 0.5));
+    writer.set_word_budget(body_words);
+
+    std::string markdown;
+    markdown.reserve(body_words * 8 + 256);
+    markdown += "# " + writer.words(random.between(3, 8), true) + "\n\n";
+    writer.paragraph(markdown);
+    while (writer.words_left() > 0) {
+        markdown += "## " + writer.words(random.between(2, 5), true) + "\n\n";
+        size_t paragraphs = random.between(1, 4);
+        for (size_t i = 0; i < paragraphs && writer.words_left() > 0; ++i) writer.paragraph(markdown);
+        if (random.chance(0.25)) writer.list(markdown);
+        if (random.chance(0.1)) writer.quote(markdown);
+        if (random.chance(options_.code_block_density)) writer.code_block(markdown);
+    }
+    markdown.pop_back(); // Single trailing newline
+    return markdown;
+}
+
+size_t CorpusGenerator::write_site(const fs::path& site_root, const fs::path& template_site_root) const {
+    std::error_code ec;
+    fs::path posts_dir = site_root / POSTS_SOURCE_DIR;
+    fs::remove_all(posts_dir, ec);
+    fs::create_directories(posts_dir, ec);
+    if (ec) {
+        std::cerr << "Error creating " << posts_dir << ": " << ec.message() << std::endl;
+        return 0;
+    }
+    if (!copy_tree(template_site_root / TEMPLATES_DIR, site_root / TEMPLATES_DIR) ||
+        !copy_tree(template_site_root / STATIC_SOURCE_DIR, site_root / STATIC_SOURCE_DIR)) {
+        return 0;
+    }
+
+    // Plain ofstream rather than write_file: the corpus is not build output,
+    // and the benchmark forks builds after this (no output queue must exist yet).
+    size_t total_bytes = 0;
+    for (size_t index = 0; index < options_.post_count; ++index) {
+        std::string markdown = generate_post(index);
+        fs::path path = posts_dir / post_file_name(index);
+        std::ofstream out(path, std::ios::binary);
+        out.write(markdown.data(), static_cast<std::streamsize>(markdown.size()));
+        if (!out) {
+            std::cerr << "Error writing " << path << std::endl;
+            return 0;
+        }
+        total_bytes += markdown.size();
+    }
+    return total_bytes;
+}
+
+// --- Command Line ---
+
+bool parse_corpus_flag(int argc, char* argv[], int& i, CorpusOptions& options, bool& error) {
+    std::string arg = argv[i];
+    const char* const flags[] = {"--posts", "--seed", "--mean-words", "--size-sigma", "--code-density", "--vocabulary", "--zipf", "--unicode-ratio"};
+    if (std::find(std::begin(flags), std::end(flags), arg) == std::end(flags)) return false;
+    if (i + 1 >= argc) {
+        std::cerr << "Error: " << arg << " expects a value." << std::endl;
+        error = true;
+        return true;
+    }
+    const char* value = argv[++i];
+    char* end = nullptr;
+    double number = std::strtod(value, &end);
+    if (end == value || *end != '\0' || number < 0) {
+        std::cerr << "Error: " << arg << " expects a non-negative number, got '" << value << "'." << std::endl;
+        error = true;
+        return true;
+    }
+    if (arg == "--posts") options.post_count = static_cast<size_t>(number);
+    else if (arg == "--seed") options.seed = std::strtoull(value, nullptr, 10);
+    else if (arg == "--mean-words") options.mean_words = static_cast<size_t>(number);
+    else if (arg == "--size-sigma") options.size_sigma = number;
+    else if (arg == "--code-density") options.code_block_density = number;
+    else if (arg == "--vocabulary") options.vocabulary_size = static_cast<size_t>(number);
+    else if (arg == "--zipf") options.zipf_s = number;
+    else options.unicode_ratio = number;
+    return true;
+}
+
+const char* corpus_flags_usage() {
+    return "  --posts N           Number of posts (default 1000)\n"
+           "  --seed N            Corpus seed (default 1)\n"
+           "  --mean-words N      Median body length in words (default 450)\n"
+           "  --size-sigma S      Log-normal spread of post lengths, 0 = uniform (default 0.6)\n"
+           "  --code-density P    Probability a section has a code block (default 0.35)\n"
+           "  --vocabulary N      Distinct words (default 20000)\n"
+           "  --zipf S            Zipf exponent of word frequencies (default 1.07)\n"
+           "  --unicode-ratio P   Fraction of non-ASCII words (default 0.01)\n";
+}
@@ -0,0 +1,60 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include "common_utils.h"
+#include <cstdint>
+
+// --- Synthetic Corpus ---
+// Deterministic markdown posts for benchmarks: the same options and seed give
+// the same corpus on a given platform. Posts look like the real ones (H1
+// title, headings, paragraphs with inline markup, lists, quotes and fenced
+// code blocks; the date is the file name prefix) so every stage sees
+// realistic input.
+
+struct CorpusOptions {
+    size_t post_count = 1000;
+    uint64_t seed = 1;
+    // Body length in words is log-normal: median mean_words, spread size_sigma
+    // (0 = every post the same length).
+    size_t mean_words = 450;
+    double size_sigma = 0.6;
+    // Probability that a section ends with a fenced code block.
+    double code_block_density = 0.35;
+    // Distinct words, drawn with a Zipf distribution (exponent zipf_s).
+    size_t vocabulary_size = 20000;
+    double zipf_s = 1.07;
+    // Fraction of words taken from a small set of non-ASCII words.
+    double unicode_ratio = 0.01;
+};
+
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusOptions& options);
+
+    // File name (without directory) and markdown of post `index` (0-based).
+    // Independent of which other posts were generated.
+    std::string post_file_name(size_t index) const;
+    std::string generate_post(size_t index) const;
+
+    // Writes a buildable site under site_root: every post into
+    // site_root/POSTS_SOURCE_DIR, plus the templates and static assets copied
+    // from template_site_root (normally the repository root). Returns the total
+    // markdown bytes written, or 0 on failure.
+    size_t write_site(const fs::path& site_root, const fs::path& template_site_root) const;
+
+    const CorpusOptions& options() const { return options_; }
+
+private:
+    CorpusOptions options_;
+    std::vector<std::string> vocabulary_;
+    std::vector<double> zipf_cdf_;
+};
+
+// Parses "--posts N"-style corpus flags shared by corpus_gen and builder_bench.
+// Returns true if argv[i] was one of them (advancing i past its value); sets
+// error on a malformed value.
+bool parse_corpus_flag(int argc, char* argv[], int& i, CorpusOptions& options, bool& error);
+// Help text for the flags above.
+const char* corpus_flags_usage();
+
+#endif // CORPUS_GENERATOR_H
@@ -0,0 +1,157 @@
+// Micro-benchmark: HTML minifier throughput on the real post pages (every post
+// rendered through the real post template), for each scan kernel the CPU
+// supports and for the previous substr-based minifier. Run from the repository
+// root:
+//   ./html_minify_bench [iterations]
+#include "build_stages.h"
+#include "html_minifier.h"
+#include <chrono>
+#include <iostream>
+
+// The minifier generate_pages used before the state machine (four substr
+// allocations per input byte; collapses <pre> and <code> whitespace).
+static std::string minify_html_with_substr(const std::string& html) {
+    std::string minified_html;
+    minified_html.reserve(html.length());
+
+    bool in_tag = false;
+    bool in_script = false;
+    bool in_style = false;
+    bool in_comment = false;
+
+    for (size_t i = 0; i < html.length(); ++i) {
+        char c = html[i];
+
+        if (i + 3 < html.length() && html[i] == '<' && html[i+1] == '!' && html[i+2] == '-' && html[i+3] == '-') {
+            in_comment = true;
+            i += 3;
+            continue;
+        }
+        if (in_comment) {
+            if (i + 2 < html.length() && html[i] == '-' && html[i+1] == '-' && html[i+2] == '>') {
+                in_comment = false;
+                i += 2;
+            }
+            continue;
+        }
+
+        if (i + 6 < html.length() && html.substr(i, 7) == "<script") in_script = true;
+        if (i + 7 < html.length() && html.substr(i, 8) == "</script") in_script = false;
+        if (i + 5 < html.length() && html.substr(i, 6) == "<style") in_style = true;
+        if (i + 6 < html.length() && html.substr(i, 7) == "</style") in_style = false;
+
+        if (c == '<') {
+            in_tag = true;
+            minified_html += c;
+        } else if (c == '>') {
+            in_tag = false;
+            minified_html += c;
+        } else if (std::isspace(c)) {
+            if (!in_tag && !in_script && !in_style) {
+                if (minified_html.empty() || !std::isspace(minified_html.back())) {
+                    minified_html += ' ';
+                }
+            } else {
+                if (minified_html.empty() || (!std::isspace(minified_html.back()) || !std::isspace(c))) {
+                    minified_html += c;
+                }
+            }
+        } else {
+            minified_html += c;
+        }
+    }
+    if (!minified_html.empty() && std::isspace(minified_html.front())) {
+        minified_html.erase(0, minified_html.find_first_not_of(" \t\n\r\f\v"));
+    }
+    if (!minified_html.empty() && std::isspace(minified_html.back())) {
+        minified_html.pop_back();
+    }
+    return minified_html;
+}
+
+// Counts bytes without storing them, so only the minifier itself is timed.
+class CountingSink : public ByteSink {
+public:
+    bool write(const char*, size_t size) override {
+        bytes += size;
+        return true;
+    }
+    size_t bytes = 0;
+};
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (iterations <= 0) iterations = 1;
+
+    PageTemplates templates;
+    if (!load_page_templates(templates)) return 1;
+
+    std::vector<std::string> pages;
+    size_t input_bytes = 0;
+    for (const auto& md_file_path : list_markdown_files(POSTS_SOURCE_DIR)) {
+        PostMetadata post;
+        if (!process_markdown_file(md_file_path, post)) continue;
+        pages.push_back(render_post_page(templates, post, ""));
+        input_bytes += pages.back().size();
+    }
+    if (pages.empty()) {
+        std::cerr << "Error: No posts found in " << POSTS_SOURCE_DIR << std::endl;
+        return 1;
+    }
+
+    const HtmlScanKernel kernels[] = {HtmlScanKernel::Scalar, HtmlScanKernel::SSE2, HtmlScanKernel::AVX2};
+
+    // Sanity check: every kernel produces the same bytes.
+    size_t mismatches = 0;
+    for (const auto& page : pages) {
+        std::string reference;
+        StringSink reference_sink(reference);
+        minify_html_with(page, reference_sink, HtmlScanKernel::Scalar);
+        for (HtmlScanKernel kernel : kernels) {
+            if (!html_scan_kernel_supported(kernel)) continue;
+            std::string output;
+            StringSink sink(output);
+            minify_html_with(page, sink, kernel);
+            if (output != reference) ++mismatches;
+        }
+    }
+
+    const double total_mb = static_cast<double>(input_bytes) * iterations / 1048576.0;
+    auto report = [&](const std::string& label, double ms, size_t output_bytes) {
+        std::cout << label << ": " << ms << " ms total, " << total_mb / (ms / 1000.0) << " MB/s"
+                  << " (" << output_bytes / iterations << " bytes out per pass)" << std::endl;
+    };
+    std::cout << pages.size() << " post pages, " << input_bytes / 1024 << " KB x " << iterations << " iterations" << std::endl;
+
+    double substr_ms = 0;
+    {
+        size_t output_bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (const auto& page : pages) output_bytes += minify_html_with_substr(page).size();
+        }
+        substr_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        report("substr (previous)", substr_ms, output_bytes);
+    }
+
+    for (HtmlScanKernel kernel : kernels) {
+        if (!html_scan_kernel_supported(kernel)) {
+            std::cout << html_scan_kernel_name(kernel) << ": not supported on this CPU" << std::endl;
+            continue;
+        }
+        CountingSink sink;
+        auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (const auto& page : pages) minify_html_with(page, sink, kernel);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        report(std::string("state machine, ") + html_scan_kernel_name(kernel), ms, sink.bytes);
+        std::cout << "  speedup vs substr: " << substr_ms / ms << "x" << std::endl;
+    }
+
+    if (mismatches != 0) {
+        std::cerr << "Error: " << mismatches << " pages differ between scan kernels" << std::endl;
+        return 1;
+    }
+    return 0;
+}
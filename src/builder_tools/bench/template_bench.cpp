@@ -0,0 +1,80 @@
+// Micro-benchmark: compiled template rendering vs. the previous
+// per-placeholder std::regex_replace path, on the real post template and the
+// real post corpus. Run from the repository root:
+//   ./template_bench [iterations]
+#include "build_stages.h"
+#include <chrono>
+#include <iostream>
+#include <regex>
+
+namespace fs = std::filesystem;
+
+// The rendering code generate_pages used before templates were compiled.
+static std::string render_post_with_regex(const std::string& post_template_content, const PostMetadata& post) {
+    std::string final_post_html = post_template_content;
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{SITE_TITLE\\}\\}"), SITE_TITLE);
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{BASE_URL\\}\\}"), BASE_URL);
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{POST_TITLE\\}\\}"), post.title);
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{POST_DATE\\}\\}"), post.date);
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{POST_BODY_HTML\\}\\}"), post.html_body);
+    final_post_html = std::regex_replace(final_post_html, std::regex("\\{\\{PERMALINK\\}\\}"), post.permalink);
+    return final_post_html;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 3;
+    if (iterations <= 0) iterations = 1;
+
+    std::string post_template_content = read_file(TEMPLATES_DIR / "post.html.template.html");
+    PageTemplates templates;
+    if (post_template_content.empty() || !load_page_templates(templates)) return 1;
+
+    std::vector<PostMetadata> posts;
+    for (const auto& md_file_path : list_markdown_files(POSTS_SOURCE_DIR)) {
+        PostMetadata post;
+        if (process_markdown_file(md_file_path, post)) posts.push_back(std::move(post));
+    }
+    if (posts.empty()) {
+        std::cerr << "Error: No posts found in " << POSTS_SOURCE_DIR << std::endl;
+        return 1;
+    }
+
+    // Sanity check: both paths agree on bodies without regex replacement syntax.
+    size_t mismatches = 0;
+    for (const auto& post : posts) {
+        if (post.html_body.find('$') != std::string::npos) continue;
+        std::string compiled = templates.post.render({SITE_TITLE, BASE_URL, post.title, post.date, post.html_body, post.permalink});
+        if (compiled != render_post_with_regex(post_template_content, post)) ++mismatches;
+    }
+
+    auto time_ms = [&](auto&& render_one) {
+        size_t output_bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (const auto& post : posts) output_bytes += render_one(post).size();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(ms, output_bytes);
+    };
+
+    auto regex_result = time_ms([&](const PostMetadata& post) { return render_post_with_regex(post_template_content, post); });
+    auto compiled_result = time_ms([&](const PostMetadata& post) {
+        return templates.post.render({SITE_TITLE, BASE_URL, post.title, post.date, post.html_body, post.permalink});
+    });
+
+    const double renders = static_cast<double>(posts.size()) * iterations;
+    auto report = [&](const char* label, const std::pair<double, size_t>& result) {
+        std::cout << label << ": " << result.first << " ms total, "
+                  << (result.first * 1000.0 / renders) << " us/page, "
+                  << (result.second / 1048576.0) / (result.first / 1000.0) << " MB/s" << std::endl;
+    };
+    std::cout << posts.size() << " posts x " << iterations << " iterations" << std::endl;
+    report("regex_replace", regex_result);
+    report("compiled     ", compiled_result);
+    std::cout << "speedup: " << regex_result.first / compiled_result.first << "x" << std::endl;
+    if (mismatches != 0) {
+        std::cerr << "Error: " << mismatches << " pages differ between the two paths" << std::endl;
+        return 1;
+    }
+    return 0;
+}
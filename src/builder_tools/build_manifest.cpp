@@ -0,0 +1,167 @@
+#include "build_manifest.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// On-disk format: one tab-separated record per line.
+//   tool    <version>
+//   input   <key>     <hash>
+//   output  <path>    <input-key> [<input-key>...]
+static const char MANIFEST_HEADER[] = "# dee-blogger build manifest";
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) break;
+        start = tab + 1;
+    }
+    return fields;
+}
+
+bool BuildManifest::load(const fs::path& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false; // No previous build
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    tool_version_.clear();
+    input_hashes_.clear();
+    output_inputs_.clear();
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> fields = split_tabs(line);
+        if (fields[0] == "tool" && fields.size() == 2) {
+            tool_version_ = fields[1];
+        } else if (fields[0] == "input" && fields.size() == 3) {
+            input_hashes_[fields[1]] = fields[2];
+        } else if (fields[0] == "output" && fields.size() >= 3) {
+            output_inputs_[fields[1]].assign(fields.begin() + 2, fields.end());
+        } else {
+            std::cerr << "Warning: Ignoring malformed build manifest " << path << " (line " << line_number << ")" << std::endl;
+            tool_version_.clear(); // Forces a full rebuild
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BuildManifest::save(const fs::path& path) const {
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "Error creating directory for " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::ostringstream out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out << MANIFEST_HEADER << "\n";
+        out << "tool\t" << tool_version_ << "\n";
+        for (const auto& pair : input_hashes_) {
+            out << "input\t" << pair.first << "\t" << pair.second << "\n";
+        }
+        for (const auto& pair : output_inputs_) {
+            out << "output\t" << pair.first;
+            for (const auto& input_key : pair.second) out << "\t" << input_key;
+            out << "\n";
+        }
+    }
+
+    // Write to a temporary file first so an interrupted build never leaves a
+    // truncated manifest that claims outputs are up to date.
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not create file " << temp_path << std::endl;
+            return false;
+        }
+        file << out.str();
+    }
+    fs::rename(temp_path, path, ec);
+    if (ec) {
+        std::cerr << "Error replacing build manifest " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void BuildManifest::set_tool_version(const std::string& version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tool_version_ = version;
+}
+
+std::string BuildManifest::tool_version() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tool_version_;
+}
+
+void BuildManifest::set_input_hash(const std::string& input_key, const std::string& hash) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_hashes_[input_key] = hash;
+}
+
+std::string BuildManifest::input_hash(const std::string& input_key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = input_hashes_.find(input_key);
+    return it == input_hashes_.end() ? std::string() : it->second;
+}
+
+void BuildManifest::add_output(const std::string& output_path, std::vector<std::string> input_keys) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_inputs_[output_path] = std::move(input_keys);
+}
+
+bool BuildManifest::has_output(const std::string& output_path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_inputs_.count(output_path) != 0;
+}
+
+std::vector<std::string> BuildManifest::outputs_with_input(const std::string& input_key) const {
+    std::vector<std::string> outputs;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& pair : output_inputs_) {
+        if (std::find(pair.second.begin(), pair.second.end(), input_key) != pair.second.end()) outputs.push_back(pair.first);
+    }
+    return outputs;
+}
+
+std::vector<std::string> BuildManifest::outputs() const {
+    std::vector<std::string> outputs;
+    std::lock_guard<std::mutex> lock(mutex_);
+    outputs.reserve(output_inputs_.size());
+    for (const auto& pair : output_inputs_) outputs.push_back(pair.first);
+    return outputs;
+}
+
+bool BuildManifest::output_up_to_date(const std::string& output_path, const std::vector<std::string>& input_keys,
+                                      const BuildManifest& current) const {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = output_inputs_.find(output_path);
+        if (it == output_inputs_.end() || it->second != input_keys) return false;
+    }
+    for (const auto& input_key : input_keys) {
+        std::string previous_hash = input_hash(input_key);
+        if (previous_hash.empty() || previous_hash != current.input_hash(input_key)) return false;
+    }
+    return true;
+}
+
+std::vector<std::string> BuildManifest::stale_outputs(const BuildManifest& current) const {
+    std::vector<std::string> stale;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& pair : output_inputs_) {
+        if (!current.has_output(pair.first)) stale.push_back(pair.first);
+    }
+    return stale;
+}
@@ -0,0 +1,61 @@
+#ifndef BUILD_MANIFEST_H
+#define BUILD_MANIFEST_H
+
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// --- Build Manifest ---
+// Persisted record of the last build: the content hash of every input (posts,
+// templates, static assets, the builder version) and, for every file written
+// under public/, the inputs it was generated from. Comparing the previous
+// manifest with the hashes of the current inputs tells the incremental build
+// which outputs are still valid and which ones belong to inputs that no longer
+// exist.
+//
+// Input keys are short, stable names such as "post:2025-06-01-guix-packages.md",
+// "template:post.html.template.html", "static:css/shared.css.source" or the
+// synthetic "site:post-list" (hash of the whole post list, which index.html
+// depends on) and "archive:archive/2025/index.html" (what one archive page lists).
+// Output paths are relative to public/.
+//
+// All methods are thread-safe so build tasks can record into one manifest.
+class BuildManifest {
+public:
+    bool load(const fs::path& path);
+    bool save(const fs::path& path) const;
+
+    void set_tool_version(const std::string& version);
+    std::string tool_version() const;
+
+    void set_input_hash(const std::string& input_key, const std::string& hash);
+    std::string input_hash(const std::string& input_key) const; // "" if unknown
+
+    void add_output(const std::string& output_path, std::vector<std::string> input_keys);
+    bool has_output(const std::string& output_path) const;
+    // Every output recorded as generated from input_key (e.g. every file of a
+    // search segment, whose number varies from segment to segment).
+    std::vector<std::string> outputs_with_input(const std::string& input_key) const;
+    // Every recorded output, sorted.
+    std::vector<std::string> outputs() const;
+
+    // True if this (previous) manifest recorded output_path as generated from
+    // exactly input_keys and none of those inputs' hashes differ in `current`.
+    bool output_up_to_date(const std::string& output_path, const std::vector<std::string>& input_keys,
+                           const BuildManifest& current) const;
+
+    // Outputs recorded here that `current` no longer produces.
+    std::vector<std::string> stale_outputs(const BuildManifest& current) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::string tool_version_;
+    std::map<std::string, std::string> input_hashes_;
+    std::map<std::string, std::vector<std::string>> output_inputs_;
+};
+
+#endif // BUILD_MANIFEST_H
@@ -0,0 +1,468 @@
+#include "build_stages.h"
+#include "archive_pages.h"
+#include "asset_manifest.h"
+#include "css_minifier.h"
+#include "front_matter.h"
+#include "js_minifier.h"
+#include "precompress.h"
+#include "related_posts.h"
+#include "search_index.h"
+#include "search_segments.h"
+#include "syntax_highlight.h"
+#include "task_graph.h"
+#include "trace.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+const std::string SITE_TITLE = "dee-blogger";
+const std::string BASE_URL = "https://vdeemann.github.io/dee-blogger.github.io";
+
+const fs::path POSTS_SOURCE_DIR = "src/blog_content/posts";
+const fs::path TEMPLATES_DIR = "src/blog_content/templates";
+const fs::path STATIC_SOURCE_DIR = "src/blog_content/static";
+const fs::path PUBLIC_DIR = "public";
+const fs::path SEARCH_SHARD_DIR = "search";
+
+const fs::path BUILD_MANIFEST_PATH = ".build-cache/build-manifest.tsv";
+const fs::path SEARCH_SPILL_DIR = ".build-cache/spill";
+const std::string BUILDER_VERSION = "17";
+
+// The standalone tools precompress what their stage wrote (release settings,
+// every available codec); build_site runs precompression once, for the whole site.
+static bool precompress_stage_outputs(const std::vector<fs::path>& outputs) {
+    PrecompressOptions options;
+    PrecompressStats stats;
+    if (!precompress_files(outputs, options, default_job_count(), &stats)) return false;
+    print_precompress_summary(options, stats);
+    return true;
+}
+
+// --- Clean Stage ---
+
+bool clean_public_dir() {
+    std::cout << "🚀 Cleaning public directory..." << std::endl;
+    std::error_code ec;
+    // Remove all existing content in public/
+    fs::remove_all(PUBLIC_DIR, ec);
+    if (ec) {
+        std::cerr << "Error removing public directory: " << ec.message() << std::endl;
+        return false;
+    }
+    if (!ensure_public_dirs()) return false;
+    std::cout << "✅ Public directory cleaned and base structure created." << std::endl;
+    return true;
+}
+
+bool ensure_public_dirs() {
+    std::error_code ec;
+    // Recreate necessary base directories
+    for (const char* sub_dir : {"p", "archive", "images"}) {
+        fs::create_directories(PUBLIC_DIR / sub_dir, ec);
+        if (ec) {
+            std::cerr << "Error creating " << (PUBLIC_DIR / sub_dir) << " directory: " << ec.message() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// --- Static Assets Stage ---
+
+std::vector<fs::path> list_static_assets() {
+    std::vector<fs::path> assets;
+    if (!fs::exists(STATIC_SOURCE_DIR)) {
+        std::cerr << "Warning: Static assets source directory not found: " << STATIC_SOURCE_DIR << std::endl;
+        return assets; // Not an error if dir doesn't exist, just nothing to copy
+    }
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(STATIC_SOURCE_DIR, ec)) {
+        if (entry.is_regular_file()) assets.push_back(entry.path());
+    }
+    if (ec) {
+        std::cerr << "Error iterating static directory: " << ec.message() << std::endl;
+    }
+    std::sort(assets.begin(), assets.end());
+    return assets;
+}
+
+fs::path static_asset_output_path(const fs::path& source_path) {
+    std::error_code ec;
+    fs::path relative_path = fs::relative(source_path, STATIC_SOURCE_DIR, ec);
+    if (ec) relative_path = source_path.filename();
+    // Determine the final uncompressed filename
+    std::string uncompressed_filename = (PUBLIC_DIR / relative_path).string();
+    // If the source ends with .source, remove it for the output filename
+    if (uncompressed_filename.length() >= 7 && uncompressed_filename.substr(uncompressed_filename.length() - 7) == ".source") {
+        uncompressed_filename = uncompressed_filename.substr(0, uncompressed_filename.length() - 7);
+    }
+    return uncompressed_filename;
+}
+
+AssetKind static_asset_kind(const fs::path& source_path) {
+    fs::path type_path = source_path.extension() == ".source" ? source_path.stem() : source_path;
+    const std::string extension = type_path.extension().string();
+    if (extension == ".css" || extension == ".js") return AssetKind::Minified;
+    for (const char* text_extension : {".svg", ".json", ".txt", ".xml", ".html", ".map", ".webmanifest"}) {
+        if (extension == text_extension) return AssetKind::Text;
+    }
+    return AssetKind::Binary;
+}
+
+static std::string minify_static_content(const fs::path& source_path, std::string_view content) {
+    fs::path type_path = source_path.extension() == ".source" ? source_path.stem() : source_path;
+    if (type_path.extension() == ".css") {
+        CssMinifyStats stats;
+        return minify_css_with_stats(content, stats);
+    }
+    JsMinifyStats stats;
+    return minify_js_with(content, true, stats);
+}
+
+// "css/shared.css" -> "css/shared.1a2b3c4d.css"
+static fs::path fingerprinted_path(const fs::path& output_path, const std::string& content_hash) {
+    fs::path path = output_path;
+    path.replace_filename(output_path.stem().string() + "." + content_hash.substr(0, 8) + output_path.extension().string());
+    return path;
+}
+
+bool load_static_asset(const fs::path& source_path, bool fingerprint, StaticAsset& asset) {
+    asset.source_path = source_path;
+    asset.kind = static_asset_kind(source_path);
+    asset.output_path = static_asset_output_path(source_path);
+    asset.minified.clear();
+    asset.source.reset();
+    if (asset.kind == AssetKind::Binary) {
+        // Size and modification time stand in for the content, which stays in the kernel.
+        struct stat info;
+        if (::stat(source_path.c_str(), &info) != 0) {
+            std::cerr << "Error: Could not stat file " << source_path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        asset.input_hash = hash_content(std::to_string(info.st_size) + ":" + std::to_string(info.st_mtim.tv_sec) + "." +
+                                        std::to_string(info.st_mtim.tv_nsec));
+        return true;
+    }
+    if (!asset.source.open(source_path)) return false;
+    asset.input_hash = hash_content(asset.source.view());
+    if (fingerprint && asset.kind == AssetKind::Minified) {
+        asset.minified = minify_static_content(source_path, asset.source.view());
+        asset.output_path = fingerprinted_path(asset.output_path, hash_content(asset.minified));
+    }
+    return true;
+}
+
+std::string minified_content(const StaticAsset& asset) {
+    return asset.minified.empty() ? minify_static_content(asset.source_path, asset.source.view()) : asset.minified;
+}
+
+bool write_static_asset(const StaticAsset& asset, std::vector<fs::path>& outputs) {
+    std::error_code ec;
+    fs::create_directories(asset.output_path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "Error creating directory for " << asset.output_path << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    TraceSpan span("static asset");
+    if (asset.kind == AssetKind::Binary) {
+        if (!clone_file(asset.source_path, asset.output_path)) return false;
+        outputs.push_back(asset.output_path);
+        return true;
+    }
+    // Text assets are written straight from the input mapping.
+    std::string minified;
+    std::string_view processed_content = asset.source.view();
+    if (asset.kind == AssetKind::Minified) {
+        if (asset.minified.empty()) minified = minified_content(asset);
+        processed_content = asset.minified.empty() ? std::string_view(minified) : std::string_view(asset.minified);
+    }
+
+    span.set_bytes(asset.source.view().size(), processed_content.size());
+    if (!write_output_file(asset.output_path, processed_content)) return false;
+    outputs.push_back(asset.output_path);
+    return true;
+}
+
+bool copy_static_assets() {
+    std::cout << "📦 Copying and compressing static assets..." << std::endl;
+    std::vector<fs::path> outputs;
+    for (const auto& source_path : list_static_assets()) {
+        StaticAsset asset;
+        if (!load_static_asset(source_path, false, asset) || !write_static_asset(asset, outputs)) return false;
+    }
+    if (!flush_output_files() || !precompress_stage_outputs(outputs)) return false;
+    std::cout << "✅ Static assets copied, minified, and compressed." << std::endl;
+    return true;
+}
+
+// --- Markdown Stage ---
+
+std::vector<fs::path> list_markdown_files(const fs::path& posts_dir) {
+    std::vector<fs::path> markdown_files;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(posts_dir, ec)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".md") {
+            markdown_files.push_back(entry.path());
+        }
+    }
+    if (ec) {
+        std::cerr << "Error listing posts directory " << posts_dir << ": " << ec.message() << std::endl;
+    }
+    std::sort(markdown_files.begin(), markdown_files.end());
+    return markdown_files;
+}
+
+bool read_post_source(const fs::path& md_file_path, PostMetadata& post, MappedFile& markdown_source) {
+    TraceSpan span("read");
+    if (!markdown_source.open(md_file_path)) return false;
+    std::string_view markdown_content = markdown_source.view();
+    if (markdown_content.empty()) return false;
+
+    post.id = md_file_path.stem().string(); // filename without extension
+    span.set_item(post.id);
+    span.set_bytes(markdown_content.size(), 0);
+    post.permalink = "p/" + post.id + ".html"; // This is relative to public/
+
+    return scan_post_source(md_file_path, markdown_content, post);
+}
+
+void render_post_body(PostMetadata& post, std::string_view markdown_content) {
+    // Markdown to HTML conversion using cmark
+    TraceSpan span("parse");
+    span.set_item(post.id);
+    post.html_body = convert_markdown_to_html(post_body(markdown_content));
+    span.set_bytes(markdown_content.size(), post.html_body.size());
+}
+
+bool process_markdown_file(const fs::path& md_file_path, PostMetadata& post) {
+    MappedFile markdown_source;
+    if (!read_post_source(md_file_path, post, markdown_source)) return false;
+    render_post_body(post, markdown_source.view());
+    return true;
+}
+
+static bool newer_first(const PostMetadata& a, const PostMetadata& b) {
+    if (a.date != b.date) return a.date > b.date; // Sort descending by date (YYYY-MM-DD string comparison works)
+    return a.id < b.id;
+}
+
+void sort_by_date(std::vector<const PostMetadata*>& posts) {
+    std::sort(posts.begin(), posts.end(),
+              [](const PostMetadata* a, const PostMetadata* b) { return newer_first(*a, *b); });
+}
+
+std::vector<const PostMetadata*> sorted_by_date(const std::vector<PostMetadata>& posts) {
+    std::vector<const PostMetadata*> sorted_posts;
+    sorted_posts.reserve(posts.size());
+    for (const auto& post : posts) sorted_posts.push_back(&post);
+    sort_by_date(sorted_posts);
+    return sorted_posts;
+}
+
+// --- Pages Stage ---
+
+bool load_page_templates(PageTemplates& templates, const AssetManifest* assets, const Stylesheets* critical_css) {
+    // Read and compile template contents once
+    struct TemplateSpec {
+        const char* file_name;
+        CompiledTemplate* compiled;
+        std::shared_ptr<const CriticalCss>* css;
+        std::vector<std::string> slot_names;
+    };
+    const TemplateSpec specs[] = {
+        {"index.html.template.html", &templates.index, &templates.index_css, {"SITE_TITLE", "BASE_URL", "RECENT_POSTS_LIST", "TOTAL_POSTS_COUNT"}},
+        {"post.html.template.html", &templates.post, &templates.post_css, {"SITE_TITLE", "BASE_URL", "POST_TITLE", "POST_DATE", "POST_BODY_HTML", "PERMALINK", "RELATED_POSTS"}},
+        {"archive.html.template.html", &templates.archive, &templates.archive_css, {"SITE_TITLE", "BASE_URL", "ALL_POSTS_LIST", "ARCHIVE_TITLE", "ARCHIVE_NAV", "ARCHIVE_PATH", "ROOT"}},
+    };
+
+    bool ok = true;
+    for (const auto& spec : specs) {
+        fs::path template_path = TEMPLATES_DIR / spec.file_name;
+        std::string template_text = read_file(template_path);
+        if (template_text.empty()) {
+            std::cerr << "Error: Could not read HTML template " << template_path << std::endl;
+            ok = false;
+            continue;
+        }
+        if (assets) template_text = assets->rewrite_references(template_text);
+        spec.css->reset();
+        if (critical_css) *spec.css = CriticalCss::for_template(template_path.string(), template_text, *critical_css);
+        if (!spec.compiled->compile(template_path.string(), template_text, spec.slot_names)) ok = false;
+    }
+    return ok;
+}
+
+std::string render_post_page(const PageTemplates& templates, const PostMetadata& post, const std::string& related_html) {
+    TraceSpan span("render");
+    span.set_item(post.id);
+    std::string page = templates.post.render({SITE_TITLE, BASE_URL, post.title, post.date, post.html_body, post.permalink,
+                                              related_html});
+    if (templates.post_css) templates.post_css->inline_into(page);
+    span.set_bytes(post.html_body.size(), page.size());
+    return page;
+}
+
+std::string render_index_page(const PageTemplates& templates, const std::vector<const PostMetadata*>& sorted_posts) {
+    // Main page with recent posts
+    std::string index_posts_html_list;
+    size_t post_display_count = std::min<size_t>(sorted_posts.size(), 10); // Limit to 10 most recent posts
+    for (size_t i = 0; i < post_display_count; ++i) {
+        const PostMetadata& post = *sorted_posts[i];
+        index_posts_html_list += "<li><h2><a href=\"" + post.permalink + "\">" + post.title + "</a></h2><p class=\"post-meta\">" + post.date + "</p>";
+        if (!post.excerpt.empty()) {
+            index_posts_html_list += "<p class=\"excerpt\">";
+            append_code_escaped(index_posts_html_list, post.excerpt);
+            index_posts_html_list += "</p>";
+        }
+        index_posts_html_list += "</li>";
+    }
+    std::string total_posts_count = std::to_string(sorted_posts.size());
+    std::string page = templates.index.render({SITE_TITLE, BASE_URL, index_posts_html_list, total_posts_count});
+    if (templates.index_css) templates.index_css->inline_into(page);
+    return page;
+}
+
+fs::path post_output_path(const PostMetadata& post) {
+    return PUBLIC_DIR / "p" / (post.id + ".html");
+}
+
+bool write_page(const fs::path& output_path, const std::string& rendered_html) {
+    // Minified chunks go to a FileSink, which holds at most FILE_SINK_BUFFER_SIZE
+    // bytes of the minified page before writing them out.
+    FileSink html_file;
+    if (!html_file.open(output_path)) return false;
+    bool minified;
+    {
+        TraceSpan span("minify");
+        minified = minify_html_to(rendered_html, html_file);
+        span.set_bytes(rendered_html.size(), html_file.bytes_written());
+    }
+    if (!minified) {
+        html_file.discard();
+        return false;
+    }
+    TraceSpan span("write");
+    span.set_bytes(html_file.bytes_written(), html_file.bytes_written());
+    return html_file.close();
+}
+
+bool generate_pages(const std::vector<PostMetadata>& posts, size_t archive_page_size) {
+    std::cout << "Building HTML pages..." << std::endl;
+
+    PageTemplates templates;
+    if (!load_page_templates(templates)) return false;
+
+    // Related posts from every post's terms, then the individual post HTML pages
+    std::vector<const PostMetadata*> sorted_posts = sorted_by_date(posts);
+    RelatedPosts related;
+    for (const PostMetadata* post : sorted_posts) {
+        related.set_terms(post->id, "", search_index.count_terms(post->title, post->html_body));
+    }
+    related.compute(sorted_posts, default_job_count());
+    std::vector<fs::path> outputs;
+    for (size_t i = 0; i < sorted_posts.size(); ++i) {
+        outputs.push_back(post_output_path(*sorted_posts[i]));
+        if (!write_page(outputs.back(), render_post_page(templates, *sorted_posts[i], related.html(i)))) return false;
+    }
+    std::cout << "✅ Individual post pages generated (related posts: " << related.summary() << ")." << std::endl;
+
+    outputs.push_back(PUBLIC_DIR / "index.html");
+    if (!write_page(outputs.back(), render_index_page(templates, sorted_posts))) return false;
+    std::cout << "✅ index.html generated." << std::endl;
+
+    std::vector<ArchivePage> archive_pages = plan_archive_pages(sorted_posts, archive_page_size);
+    for (const auto& page : archive_pages) {
+        outputs.push_back(page.output_path);
+        if (!write_archive_page(page, render_archive_page(templates, page))) return false;
+    }
+    std::cout << "✅ " << archive_pages.size() << " archive pages generated." << std::endl;
+
+    return flush_output_files() && precompress_stage_outputs(outputs);
+}
+
+// --- Search Stage ---
+
+void index_post_for_search(const PostMetadata& post, SearchTermCounts* term_counts) {
+    // Add content (title and full HTML body as separate fields) to the search index
+    TraceSpan span("index");
+    span.set_item(post.id);
+    span.set_bytes(post.title.size() + post.html_body.size(), 0);
+    search_index.add_document(post.id, post.title, post.html_body, term_counts);
+}
+
+bool write_search_index(const std::vector<const PostMetadata*>& posts, SearchSegments& segments,
+                        std::vector<fs::path>& outputs, std::vector<fs::path>* written) {
+    TraceSpan emit_span("search emit");
+    // Segment files never change once written: only the new segment's are,
+    // each as soon as it is encoded.
+    const fs::path search_dir = PUBLIC_DIR / SEARCH_SHARD_DIR;
+    size_t shard_count = 0;
+    size_t shard_bytes = 0;
+    std::set<fs::path> created_dirs;
+    {
+        TraceSpan span("search encode");
+        bool ok = segments.commit(search_index, posts, [&](const std::string& name, std::string&& content) {
+            fs::path shard_path = search_dir / name;
+            if (created_dirs.insert(shard_path.parent_path()).second) {
+                std::error_code ec;
+                fs::create_directories(shard_path.parent_path(), ec);
+                if (ec) {
+                    std::cerr << "Error creating " << shard_path.parent_path() << " directory: " << ec.message() << std::endl;
+                    return false;
+                }
+            }
+            ++shard_count;
+            shard_bytes += content.size();
+            if (written) written->push_back(shard_path);
+            return write_output_file(shard_path, content);
+        });
+        span.set_bytes(0, shard_bytes);
+        if (!ok) return false;
+    }
+    for (const auto& name : segments.file_names()) outputs.push_back(search_dir / name);
+
+    // The manifest, then post metadata for client-side use (excluding html_body
+    // to save JS file size). Segment doc IDs map to postMetadata positions.
+    std::string search_index_data_js = "const searchManifest={\"format\":" + std::to_string(SEARCH_INDEX_FORMAT_VERSION) +
+        ",\"segments\":" + segments.manifest_json(posts) +
+        ",\"termBlockSize\":" + std::to_string(SEARCH_TERM_BLOCK_SIZE) +
+        ",\"minTermLength\":" + std::to_string(SEARCH_MIN_TERM_LENGTH) +
+        ",\"stopwords\":\"" + (search_index.tokenizer_options().remove_stopwords ? SEARCH_STOPWORDS : "") +
+        "\",\"stem\":" + (search_index.tokenizer_options().stem ? "true" : "false") + "};";
+    search_index_data_js += "const postMetadata=[";
+    for (size_t i = 0; i < posts.size(); ++i) {
+        if (i > 0) search_index_data_js += ",";
+        search_index_data_js += "{\"title\":\"";
+        append_json_escaped(search_index_data_js, posts[i]->title);
+        search_index_data_js += "\",\"date\":\"" + posts[i]->date + "\",\"permalink\":\"" + posts[i]->permalink + "\"}";
+    }
+    search_index_data_js += "];";
+
+    // Generated already minified (minify_js would also trip over escaped quotes in titles)
+    fs::path manifest_path = PUBLIC_DIR / "search-index.js";
+    emit_span.set_bytes(0, shard_bytes + search_index_data_js.size());
+    if (!write_output_file(manifest_path, search_index_data_js)) return false;
+    outputs.push_back(manifest_path);
+    if (written) written->push_back(manifest_path);
+
+    std::cout << "✅ search-index.js generated (" << shard_count << " new search shards; "
+              << segments.summary() << ")." << std::endl;
+    return true;
+}
+
+bool generate_search_index(const std::vector<PostMetadata>& posts) {
+    std::cout << "Generating search-index.js..." << std::endl;
+    for (const auto& post : posts) index_post_for_search(post);
+    const std::vector<const PostMetadata*> sorted_posts = sorted_by_date(posts);
+    SearchSegments segments;
+    std::vector<SearchSegments::Post> plan_posts;
+    for (const PostMetadata* post : sorted_posts) plan_posts.push_back({post->id, hash_content(post->title + "\n" + post->html_body)});
+    segments.plan(plan_posts);
+    std::vector<fs::path> outputs;
+    return write_search_index(sorted_posts, segments, outputs) && flush_output_files() && precompress_stage_outputs(outputs);
+}
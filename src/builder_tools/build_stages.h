@@ -0,0 +1,149 @@
+#ifndef BUILD_STAGES_H
+#define BUILD_STAGES_H
+
+#include "common_utils.h"
+#include "critical_css.h"
+#include "template_engine.h"
+#include "stream_writer.h"
+#include "file_io.h"
+#include "search_index.h"
+
+class AssetManifest;
+class SearchSegments;
+
+// --- Site Configuration ---
+// (External configuration. In a larger project, these might be passed as
+// command-line arguments or read from a config file.)
+extern const std::string SITE_TITLE;
+extern const std::string BASE_URL;
+
+extern const fs::path POSTS_SOURCE_DIR;
+extern const fs::path TEMPLATES_DIR;
+extern const fs::path STATIC_SOURCE_DIR;
+extern const fs::path PUBLIC_DIR;
+// Search index shards, relative to PUBLIC_DIR.
+extern const fs::path SEARCH_SHARD_DIR;
+
+// Incremental build state lives outside public/ so it is never deployed.
+extern const fs::path BUILD_MANIFEST_PATH;
+// Spill runs of a build with a memory budget (pipeline.h), removed once encoded.
+extern const fs::path SEARCH_SPILL_DIR;
+// Bump whenever a change to the builder alters its output, so the next
+// incremental build regenerates everything instead of trusting old outputs.
+extern const std::string BUILDER_VERSION;
+
+// --- Build Stages ---
+// Each stage is a plain library call so the single-process blog_builder driver
+// can pass PostMetadata objects between them in memory. The standalone tools
+// (clean_public, copy_static, process_markdown, generate_pages, generate_search)
+// are thin wrappers around these functions.
+
+bool clean_public_dir();
+// Creates public/ and its base subdirectories without removing anything.
+bool ensure_public_dirs();
+
+// --- Static Assets ---
+enum class AssetKind {
+    Minified, // CSS/JS: minified, fingerprinted with --fingerprint-assets
+    Text,     // Other text formats (SVG, JSON, ...): written as they are
+    Binary,   // Images, fonts, ...: cloned as they are, never read (clone_file)
+};
+
+struct StaticAsset {
+    fs::path source_path;
+    AssetKind kind = AssetKind::Binary;
+    fs::path output_path;   // In public/; name.<hash>.ext for fingerprinted assets
+    std::string input_hash; // Of the content; for Binary, of the size and mtime
+    MappedFile source;      // Minified and Text only
+    std::string minified;   // Minified only, when loaded with fingerprint
+};
+
+// Every regular file under STATIC_SOURCE_DIR, sorted.
+std::vector<fs::path> list_static_assets();
+AssetKind static_asset_kind(const fs::path& source_path);
+// Output location in public/ (the ".source" suffix is dropped).
+fs::path static_asset_output_path(const fs::path& source_path);
+// Fills asset for source_path. With fingerprint, CSS/JS is minified now and
+// its output name carries the first 8 hex digits of the minified content's
+// hash ("css/shared.css" -> "css/shared.1a2b3c4d.css").
+bool load_static_asset(const fs::path& source_path, bool fingerprint, StaticAsset& asset);
+// The minified content of a loaded Minified asset (what write_static_asset writes).
+std::string minified_content(const StaticAsset& asset);
+// Writes a loaded asset (minifying it if that has not happened yet); Binary
+// assets are cloned. Every path written is appended to outputs. Compressed
+// siblings are precompress.h's business.
+bool write_static_asset(const StaticAsset& asset, std::vector<fs::path>& outputs);
+bool copy_static_assets();
+
+// Sorted list of all *.md files in posts_dir (sorted so builds are reproducible).
+std::vector<fs::path> list_markdown_files(const fs::path& posts_dir);
+
+// Reads one markdown file and fills the post's metadata (front_matter.h; no
+// body yet). Drafts read successfully: callers skip them by post.draft.
+// The raw markdown stays mapped in markdown_source for render_post_body.
+// Returns false for a file that cannot be read or is empty (markdown_source
+// is then empty), and for invalid metadata, reported per file and line.
+bool read_post_source(const fs::path& md_file_path, PostMetadata& post, MappedFile& markdown_source);
+// Renders markdown_content (front matter skipped) into post.html_body.
+void render_post_body(PostMetadata& post, std::string_view markdown_content);
+// read_post_source + render_post_body.
+bool process_markdown_file(const fs::path& md_file_path, PostMetadata& post);
+
+// Newest first; ties broken by id so the order never depends on input order.
+void sort_by_date(std::vector<const PostMetadata*>& posts);
+std::vector<const PostMetadata*> sorted_by_date(const std::vector<PostMetadata>& posts);
+
+// --- Page Rendering ---
+// The three templates in TEMPLATES_DIR, compiled once per build. Slot order
+// (what render() expects) is fixed by load_page_templates.
+struct PageTemplates {
+    CompiledTemplate index;   // SITE_TITLE, BASE_URL, RECENT_POSTS_LIST, TOTAL_POSTS_COUNT
+    CompiledTemplate post;    // SITE_TITLE, BASE_URL, POST_TITLE, POST_DATE, POST_BODY_HTML, PERMALINK, RELATED_POSTS
+    CompiledTemplate archive; // SITE_TITLE, BASE_URL, ALL_POSTS_LIST, ARCHIVE_TITLE, ARCHIVE_NAV, ARCHIVE_PATH, ROOT
+    // With --critical-css, per template (null if it links none of the stylesheets).
+    std::shared_ptr<const CriticalCss> index_css;
+    std::shared_ptr<const CriticalCss> post_css;
+    std::shared_ptr<const CriticalCss> archive_css;
+};
+// Fails on unreadable templates or unknown placeholders. With assets, asset
+// references in the templates are rewritten to the published names first
+// (AssetManifest::rewrite_references), so rendering pays nothing for them.
+// With critical_css, links to those stylesheets are made non-blocking and
+// each page gets its critical rules inlined (critical_css.h).
+bool load_page_templates(PageTemplates& templates, const AssetManifest* assets = nullptr,
+                         const Stylesheets* critical_css = nullptr);
+
+// Each render_* returns the filled-in template (critical CSS inlined, if the
+// template has any); write_page minifies it.
+// (Archive pages: see archive_pages.h.)
+// related_html fills {{RELATED_POSTS}} (RelatedPosts::html, related_posts.h).
+std::string render_post_page(const PageTemplates& templates, const PostMetadata& post, const std::string& related_html);
+std::string render_index_page(const PageTemplates& templates, const std::vector<const PostMetadata*>& sorted_posts);
+
+fs::path post_output_path(const PostMetadata& post);
+// Minifies rendered_html into output_path (compressed siblings: precompress.h).
+bool write_page(const fs::path& output_path, const std::string& rendered_html);
+
+// Serial page generation: every post page (with its related posts), then
+// index.html and the archive pages. Like copy_static_assets and
+// generate_search_index, it precompresses what it wrote before returning.
+bool generate_pages(const std::vector<PostMetadata>& posts, size_t archive_page_size);
+
+// --- Search Index ---
+// Adds one post (title + body) to the global search index. Thread-safe.
+// Its term counts go to term_counts if given (for related_posts.h).
+void index_post_for_search(const PostMetadata& post, SearchTermCounts* term_counts = nullptr);
+// Brings the search index segments (search_segments.h) up to date after
+// segments.plan(): encodes the planned posts, which must be in the global
+// search index, into a new segment under SEARCH_SHARD_DIR and writes
+// search-index.js for the given posts (postMetadata follows their order).
+// Every file of the index is appended to outputs, the ones actually written
+// to written (if given); the files of merged segments are left for the caller
+// to remove (segments.dropped_files()).
+bool write_search_index(const std::vector<const PostMetadata*>& posts, SearchSegments& segments,
+                        std::vector<fs::path>& outputs, std::vector<fs::path>* written = nullptr);
+// index_post_for_search for every post, then write_search_index into a
+// single new segment.
+bool generate_search_index(const std::vector<PostMetadata>& posts);
+
+#endif // BUILD_STAGES_H
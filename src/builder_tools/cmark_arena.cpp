@@ -0,0 +1,137 @@
+#include "cmark_arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+// Every allocation is preceded by its requested size, so a realloc that has to
+// move knows how much to copy.
+constexpr size_t HEADER_SIZE = ALIGNMENT;
+constexpr size_t FIRST_BLOCK_SIZE = 64 * 1024;
+// Blocks double up to this size. reset() drops bigger ones: one huge post
+// must not pin its memory for the rest of the build.
+constexpr size_t MAX_RETAINED_BLOCK_SIZE = 4 * 1024 * 1024;
+
+size_t footprint(size_t size) {
+    return HEADER_SIZE + ((std::max<size_t>(size, 1) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+}
+
+size_t& requested_size(void* pointer) {
+    return *reinterpret_cast<size_t*>(static_cast<char*>(pointer) - HEADER_SIZE);
+}
+
+[[noreturn]] void out_of_memory() {
+    // What cmark's own allocator does: it has no way to report a failed allocation.
+    std::fputs("[cmark arena] out of memory, aborting\n", stderr);
+    std::abort();
+}
+
+void* arena_calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) out_of_memory();
+    return CmarkArena::for_this_thread().allocate(count * size, true);
+}
+
+void* arena_realloc(void* pointer, size_t size) {
+    return CmarkArena::for_this_thread().reallocate(pointer, size);
+}
+
+void arena_free(void* pointer) {
+    CmarkArena::for_this_thread().release(pointer);
+}
+
+cmark_mem ARENA_MEM = {arena_calloc, arena_realloc, arena_free};
+
+} // namespace
+
+CmarkArena& CmarkArena::for_this_thread() {
+    thread_local CmarkArena arena;
+    return arena;
+}
+
+cmark_mem* CmarkArena::mem() {
+    return &ARENA_MEM;
+}
+
+CmarkArena::~CmarkArena() {
+    for (const auto& block : blocks_) std::free(block.data);
+}
+
+void CmarkArena::reset() {
+    // Keep the largest block that is not oversized; it is reused from the start.
+    Block kept{nullptr, 0};
+    for (const auto& block : blocks_) {
+        if (block.size <= MAX_RETAINED_BLOCK_SIZE && block.size > kept.size) {
+            std::free(kept.data);
+            kept = block;
+        } else {
+            std::free(block.data);
+        }
+    }
+    blocks_.clear();
+    if (kept.data) blocks_.push_back(kept);
+    used_ = 0;
+    last_allocation_ = nullptr;
+    stats_.bytes_in_use = 0;
+}
+
+void* CmarkArena::allocate(size_t size, bool zeroed) {
+    ++stats_.requests;
+    const size_t needed = footprint(size);
+    void* pointer;
+    if (!blocks_.empty() && blocks_.back().size - used_ >= needed) {
+        pointer = blocks_.back().data + used_ + HEADER_SIZE;
+        used_ += needed;
+    } else {
+        pointer = allocate_in_new_block(needed);
+    }
+    requested_size(pointer) = size;
+    last_allocation_ = static_cast<char*>(pointer);
+    stats_.bytes_in_use += needed;
+    if (zeroed) std::memset(pointer, 0, size);
+    return pointer;
+}
+
+void* CmarkArena::allocate_in_new_block(size_t needed) {
+    size_t block_size = blocks_.empty() ? FIRST_BLOCK_SIZE : std::min(blocks_.back().size * 2, MAX_RETAINED_BLOCK_SIZE);
+    block_size = std::max(block_size, needed);
+    char* data = static_cast<char*>(std::malloc(block_size));
+    if (!data) out_of_memory();
+    ++stats_.blocks;
+    blocks_.push_back({data, block_size});
+    used_ = needed;
+    return data + HEADER_SIZE;
+}
+
+void* CmarkArena::reallocate(void* pointer, size_t size) {
+    if (!pointer) return allocate(size, false);
+    if (pointer == last_allocation_) {
+        // The newest allocation (typically the HTML buffer being grown) is
+        // resized in place while its block has room.
+        const size_t offset = static_cast<size_t>(last_allocation_ - HEADER_SIZE - blocks_.back().data);
+        const size_t needed = footprint(size);
+        if (offset + needed <= blocks_.back().size) {
+            ++stats_.requests;
+            stats_.bytes_in_use = stats_.bytes_in_use - (used_ - offset) + needed;
+            used_ = offset + needed;
+            requested_size(pointer) = size;
+            return pointer;
+        }
+    }
+    const size_t old_size = requested_size(pointer);
+    void* moved = allocate(size, false);
+    std::memcpy(moved, pointer, std::min(old_size, size));
+    return moved;
+}
+
+void CmarkArena::release(void* pointer) {
+    // Only the newest allocation can be given back; the rest waits for reset().
+    if (!pointer || pointer != last_allocation_) return;
+    const size_t offset = static_cast<size_t>(last_allocation_ - HEADER_SIZE - blocks_.back().data);
+    stats_.bytes_in_use -= used_ - offset;
+    used_ = offset;
+    last_allocation_ = nullptr;
+}
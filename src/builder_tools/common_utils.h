@@ -2,15 +2,15 @@
 #define COMMON_UTILS_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 #include <map>
 #include <set>
 #include <mutex>
 
-// For cmark-gfm and brotli
+// For cmark-gfm (Brotli output lives in stream_writer.h)
 #include <cmark-gfm.h> // <--- THIS MUST BE cmark-gfm.h
-#include <brotli/encode.h>
 
 namespace fs = std::filesystem;
 
@@ -20,29 +20,53 @@ struct PostMetadata {
     std::string title;
     std::string date; // Format: YYYY-MM-DD for sorting
     std::string permalink;
+    std::vector<std::string> tags;
+    bool draft = false;    // Drafts are read but never published
+    std::string excerpt;   // Plain text (front_matter.h); HTML-escape before use
     std::string html_body; // For internal use by process_markdown, passed via JSON
 };
 
-// --- Global Data (only for generate_search.cpp and common_utils.cpp internal use) ---
-extern std::map<std::string, std::set<std::string>> inverted_index;
-extern std::map<std::string, PostMetadata> post_id_to_metadata;
-extern std::mutex global_data_mutex; // Protects inverted_index and post_id_to_metadata
+// Destination for streamed output (files, Brotli streams, in-memory strings).
+// write() returns false once the sink has failed; callers stop feeding it.
+class ByteSink {
+public:
+    virtual ~ByteSink() = default;
+    virtual bool write(const char* data, size_t size) = 0;
+};
+
+// ByteSink that appends to a std::string.
+class StringSink : public ByteSink {
+public:
+    explicit StringSink(std::string& out) : out_(out) {}
+    bool write(const char* data, size_t size) override { out_.append(data, size); return true; }
+private:
+    std::string& out_;
+};
 
 // --- Utility Functions ---
 std::string read_file(const fs::path& path);
 bool write_file(const fs::path& path, const std::string& content);
 bool copy_file(const fs::path& source, const std::string& destination);
 
-std::string convert_markdown_to_html(const std::string& markdown_content);
+// 64-bit FNV-1a content hash as 16 hex digits. Used for change detection, not security.
+std::string hash_content(std::string_view data);
+
+// Parses and renders with the calling thread's CmarkArena (cmark_arena.h),
+// which is reset before returning.
+std::string convert_markdown_to_html(std::string_view markdown_content);
+// HTML minification is implemented in html_minifier.cpp (see html_minifier.h).
 std::string minify_html(const std::string& html);
+// Streaming form of minify_html: output is produced in small chunks, so a page
+// can be minified straight into a file and a Brotli stream without ever holding
+// the minified copy in memory.
+bool minify_html_to(std::string_view html, ByteSink& out);
+// CSS and JS minification: css_minifier.h and js_minifier.h.
 std::string minify_css(const std::string& css);
 std::string minify_js(const std::string& js);
-std::string compress_brotli(const std::string& data);
-
-std::vector<std::string> tokenize(const std::string& text);
-void add_to_inverted_index(const std::string& post_id, const std::string& content_to_index);
 
 // JSON utility for PostMetadata
+// Appends value with JSON string escaping (no surrounding quotes).
+void append_json_escaped(std::string& out, const std::string& value);
 std::string post_metadata_to_json(const PostMetadata& post, const std::string& html_body_content = "");
 PostMetadata post_metadata_from_json(const std::string& json_str);
 
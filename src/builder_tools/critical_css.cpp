@@ -0,0 +1,1197 @@
+#include "critical_css.h"
+#include "asset_manifest.h"
+#include "trace.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <mutex>
+
+const size_t CRITICAL_FOLD_TEXT_BYTES = 2000;
+
+// Bounds the per-template shape cache; shapes past it are matched every time.
+static const size_t SHAPE_CACHE_LIMIT = 50000;
+
+// Where inline_into() puts the <style> block (placed by for_template).
+static const char CRITICAL_CSS_MARKER[] = "<!--critical-css-->";
+
+// --- Parsed Representation ---
+
+namespace {
+
+enum class PseudoKind {
+    Never,   // User-action states (:hover, :focus, ...): false at first paint
+    Always,  // Unknown or unsupported (:has, :lang, ...): assumed true, so the rule is kept
+    Root, Empty, Link, Checked, Disabled, Enabled,
+    FirstChild, LastChild, OnlyChild, FirstOfType, LastOfType, OnlyOfType,
+    NthChild, NthLastChild, NthOfType, NthLastOfType,
+    Not, Is,  // :is, :where, :matches, :-webkit-any
+};
+
+struct Attribute {
+    std::string name;  // Lowercase
+    char op = 0;       // 0 (present), '=', '~', '|', '^', '$', '*'
+    std::string value;
+    bool ignore_case = false;
+};
+
+} // namespace
+
+struct CriticalCss::Compound {
+    struct Pseudo {
+        PseudoKind kind = PseudoKind::Always;
+        int a = 0, b = 0;                      // Nth*: an+b
+        std::vector<CriticalCss::Selector> arguments; // Not, Is
+    };
+    std::string tag;  // Lowercase; empty for any
+    std::vector<std::string> ids;
+    std::vector<std::string> classes;
+    std::vector<Attribute> attributes;
+    std::vector<Pseudo> pseudos;
+    char combinator = 0; // To the compound on the left: ' ', '>', '+', '~' (0 for the leftmost)
+};
+
+struct CriticalCss::Selector {
+    std::vector<Compound> compounds; // Left to right
+    size_t item = 0;                 // Style rule it belongs to (top-level selectors)
+    bool cacheable = true;           // Depends only on the element's shape (see critical_css.h)
+    bool uncertain = false;          // Contains a PseudoKind::Always somewhere
+};
+
+struct CriticalCss::Item {
+    enum Kind { StyleRule, Group, Keyframes, FontFace, Other } kind = Other;
+    size_t begin = 0, end = 0;       // The whole item in css_
+    size_t body_begin = 0;           // Group: after its '{'
+    std::vector<size_t> children;    // Group
+    std::string name;                // Keyframes
+    std::vector<std::string> animations; // StyleRule: identifiers of its animation(-name) values
+};
+
+namespace {
+
+struct Element {
+    std::string tag;
+    std::vector<std::pair<std::string, std::string>> attributes; // Names lowercase
+    std::string id;
+    std::vector<std::string> classes;
+    int parent = -1;
+    int previous = -1;            // Previous element sibling
+    uint32_t child_index = 0;     // 1-based among element siblings
+    uint32_t child_from_end = 0;
+    uint32_t type_index = 0;      // Same, among siblings with the same tag
+    uint32_t type_from_end = 0;
+    bool empty = true;            // No child elements or text
+    bool above_fold = false;
+};
+
+} // namespace
+
+struct CriticalCss::Dom {
+    std::vector<Element> elements;
+};
+
+// --- CSS Scanning ---
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static char ascii_lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static std::string ascii_lower(std::string_view text) {
+    std::string lower(text);
+    for (char& c : lower) c = ascii_lower(c);
+    return lower;
+}
+
+static std::string_view trim(std::string_view text) {
+    while (!text.empty() && is_space(text.front())) text.remove_prefix(1);
+    while (!text.empty() && is_space(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+// Skips a string or comment starting at pos; returns pos unchanged if there is none.
+static size_t skip_string_or_comment(std::string_view css, size_t pos) {
+    if (css[pos] == '"' || css[pos] == '\'') {
+        const char quote = css[pos];
+        for (++pos; pos < css.size() && css[pos] != quote; ++pos) {
+            if (css[pos] == '\\') ++pos;
+        }
+        return std::min(pos + 1, css.size());
+    }
+    if (css.compare(pos, 2, "/*") == 0) {
+        size_t close = css.find("*/", pos + 2);
+        return close == std::string_view::npos ? css.size() : close + 2;
+    }
+    return pos;
+}
+
+// First of stops at nesting depth 0 from pos (strings, comments and
+// (), [] groups skipped), or css.size().
+static size_t find_at_depth0(std::string_view css, size_t pos, std::string_view stops) {
+    int depth = 0;
+    while (pos < css.size()) {
+        size_t skipped = skip_string_or_comment(css, pos);
+        if (skipped != pos) {
+            pos = skipped;
+            continue;
+        }
+        const char c = css[pos];
+        if (depth == 0 && stops.find(c) != std::string_view::npos) return pos;
+        if (c == '(' || c == '[') ++depth;
+        else if ((c == ')' || c == ']') && depth > 0) --depth;
+        else if (c == '\\') ++pos;
+        ++pos;
+    }
+    return css.size();
+}
+
+// Position just past the '}' closing the block whose '{' is at open.
+static size_t block_end(std::string_view css, size_t open) {
+    int depth = 0;
+    size_t pos = open;
+    while (pos < css.size()) {
+        size_t skipped = skip_string_or_comment(css, pos);
+        if (skipped != pos) {
+            pos = skipped;
+            continue;
+        }
+        if (css[pos] == '{') ++depth;
+        else if (css[pos] == '}' && --depth == 0) return pos + 1;
+        else if (css[pos] == '\\') ++pos;
+        ++pos;
+    }
+    return css.size();
+}
+
+static std::string strip_comments(std::string_view text) {
+    std::string out;
+    out.reserve(text.size());
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t skipped = skip_string_or_comment(text, pos);
+        if (skipped == pos) {
+            out += text[pos++];
+        } else {
+            if (text[pos] != '/') out.append(text, pos, skipped - pos);
+            pos = skipped;
+        }
+    }
+    return out;
+}
+
+// The identifiers of the animation / animation-name declarations in a rule body.
+static std::vector<std::string> animation_names(std::string_view body) {
+    std::vector<std::string> names;
+    size_t pos = 0;
+    while (pos < body.size()) {
+        size_t end = find_at_depth0(body, pos, ";");
+        std::string_view declaration = body.substr(pos, end - pos);
+        pos = end + 1;
+        size_t colon = declaration.find(':');
+        if (colon == std::string_view::npos) continue;
+        std::string property = ascii_lower(trim(declaration.substr(0, colon)));
+        if (property.compare(0, 8, "-webkit-") == 0) property.erase(0, 8);
+        if (property != "animation" && property != "animation-name") continue;
+        std::string_view value = declaration.substr(colon + 1);
+        size_t start = std::string_view::npos;
+        for (size_t i = 0; i <= value.size(); ++i) {
+            const bool ident = i < value.size() &&
+                (std::isalnum(static_cast<unsigned char>(value[i])) || value[i] == '-' || value[i] == '_' ||
+                 static_cast<unsigned char>(value[i]) >= 0x80);
+            if (ident && start == std::string_view::npos) start = i;
+            if (!ident && start != std::string_view::npos) {
+                names.emplace_back(value.substr(start, i - start));
+                start = std::string_view::npos;
+            }
+        }
+    }
+    return names;
+}
+
+// --- Selector Parsing ---
+
+namespace {
+
+bool is_ident_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' ||
+           static_cast<unsigned char>(c) >= 0x80;
+}
+
+void append_utf8(std::string& out, unsigned long code_point) {
+    if (code_point == 0 || code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) code_point = 0xFFFD;
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+// Recursive-descent parser over one selector list. Every parse_* returns false
+// on anything it does not understand; the whole list is then invalid.
+class SelectorParser {
+public:
+    explicit SelectorParser(std::string_view text) : text_(text) {}
+
+    bool parse_list(std::vector<CriticalCss::Selector>& selectors, bool nested) {
+        while (true) {
+            CriticalCss::Selector selector;
+            if (!parse_selector(selector)) return false;
+            selectors.push_back(std::move(selector));
+            skip_spaces();
+            if (at_end() || (nested && peek() == ')')) return true;
+            if (peek() != ',') return false;
+            ++pos_;
+        }
+    }
+
+    bool at_end() const { return pos_ >= text_.size(); }
+    char peek() const { return at_end() ? '\0' : text_[pos_]; }
+    size_t position() const { return pos_; }
+
+private:
+    void skip_spaces() {
+        while (!at_end() && is_space(peek())) ++pos_;
+    }
+
+    bool parse_identifier(std::string& out) {
+        out.clear();
+        size_t start = pos_;
+        if (peek() == '-') ++pos_;
+        while (!at_end()) {
+            char c = peek();
+            if (c == '\\' && pos_ + 1 < text_.size()) {
+                ++pos_;
+                size_t hex_start = pos_;
+                while (pos_ < text_.size() && pos_ - hex_start < 6 && std::isxdigit(static_cast<unsigned char>(text_[pos_]))) ++pos_;
+                if (pos_ > hex_start) {
+                    append_utf8(out, std::stoul(std::string(text_.substr(hex_start, pos_ - hex_start)), nullptr, 16));
+                    if (!at_end() && is_space(peek())) ++pos_;
+                } else {
+                    out += text_[pos_++];
+                }
+            } else if (is_ident_char(c)) {
+                out += c;
+                ++pos_;
+            } else {
+                break;
+            }
+        }
+        if (pos_ > start && text_[start] == '-') out.insert(out.begin(), '-');
+        // Like the browser: no identifier starts with a digit (or "-" and a digit).
+        const size_t first = out.size() > 1 && out[0] == '-' ? 1 : 0;
+        return !out.empty() && out != "-" && !(out[first] >= '0' && out[first] <= '9' && text_[start + first] != '\\');
+    }
+
+    bool parse_selector(CriticalCss::Selector& selector) {
+        skip_spaces();
+        char combinator = 0;
+        while (true) {
+            CriticalCss::Compound compound;
+            if (!parse_compound(compound, selector)) return false;
+            compound.combinator = selector.compounds.empty() ? 0 : combinator;
+            if (compound.combinator == '+' || compound.combinator == '~') selector.cacheable = false;
+            selector.compounds.push_back(std::move(compound));
+
+            const size_t before = pos_;
+            skip_spaces();
+            if (at_end() || peek() == ',' || peek() == ')') return true;
+            if (peek() == '>' || peek() == '+' || peek() == '~') {
+                combinator = peek();
+                ++pos_;
+                skip_spaces();
+            } else if (pos_ > before) {
+                combinator = ' ';
+            } else {
+                return false;
+            }
+        }
+    }
+
+    bool parse_compound(CriticalCss::Compound& compound, CriticalCss::Selector& selector) {
+        const size_t start = pos_;
+        if (peek() == '*') {
+            ++pos_;
+        } else if (is_ident_char(peek()) || peek() == '\\') {
+            if (!parse_identifier(compound.tag)) return false;
+            compound.tag = ascii_lower(compound.tag);
+        }
+        if (peek() == '|') return false; // Namespaces
+        while (!at_end()) {
+            const char c = peek();
+            std::string name;
+            if (c == '#') {
+                ++pos_;
+                if (!parse_identifier(name)) return false;
+                compound.ids.push_back(name);
+            } else if (c == '.') {
+                ++pos_;
+                if (!parse_identifier(name)) return false;
+                compound.classes.push_back(name);
+            } else if (c == '[') {
+                ++pos_;
+                Attribute attribute;
+                if (!parse_attribute(attribute)) return false;
+                compound.attributes.push_back(std::move(attribute));
+            } else if (c == ':') {
+                if (!parse_pseudo(compound, selector)) return false;
+            } else {
+                break;
+            }
+        }
+        return pos_ > start;
+    }
+
+    bool parse_attribute(Attribute& attribute) {
+        skip_spaces();
+        if (!parse_identifier(attribute.name)) return false;
+        attribute.name = ascii_lower(attribute.name);
+        skip_spaces();
+        if (peek() == ']') {
+            ++pos_;
+            return true;
+        }
+        if (peek() == '=') {
+            attribute.op = '=';
+            ++pos_;
+        } else if (std::string_view("~|^$*").find(peek()) != std::string_view::npos && pos_ + 1 < text_.size() &&
+                   text_[pos_ + 1] == '=') {
+            attribute.op = peek();
+            pos_ += 2;
+        } else {
+            return false;
+        }
+        skip_spaces();
+        if (peek() == '"' || peek() == '\'') {
+            const char quote = peek();
+            for (++pos_; !at_end() && peek() != quote; ++pos_) {
+                if (peek() == '\\' && pos_ + 1 < text_.size()) ++pos_;
+                attribute.value += peek();
+            }
+            if (at_end()) return false;
+            ++pos_;
+        } else if (!parse_identifier(attribute.value)) {
+            return false;
+        }
+        skip_spaces();
+        if (peek() == 'i' || peek() == 'I' || peek() == 's' || peek() == 'S') {
+            attribute.ignore_case = ascii_lower(peek()) == 'i';
+            ++pos_;
+            skip_spaces();
+        }
+        if (peek() != ']') return false;
+        ++pos_;
+        if (attribute.ignore_case) attribute.value = ascii_lower(attribute.value);
+        return true;
+    }
+
+    // Text up to the ')' closing a function whose '(' was just consumed.
+    bool function_arguments(std::string_view& arguments) {
+        size_t close = find_at_depth0(text_, pos_, ")");
+        if (close >= text_.size()) return false;
+        arguments = text_.substr(pos_, close - pos_);
+        pos_ = close + 1;
+        return true;
+    }
+
+    static bool parse_nth(std::string_view text, int& a, int& b) {
+        std::string nth;
+        for (char c : text) {
+            if (!is_space(c)) nth += ascii_lower(c);
+        }
+        if (nth == "odd") {
+            a = 2, b = 1;
+            return true;
+        }
+        if (nth == "even") {
+            a = 2, b = 0;
+            return true;
+        }
+        auto parse_int = [](const std::string& digits, int& value) {
+            if (digits.empty() || digits.size() > 9) return false;
+            size_t i = digits[0] == '+' || digits[0] == '-' ? 1 : 0;
+            if (i == digits.size()) return false;
+            for (size_t j = i; j < digits.size(); ++j) {
+                if (digits[j] < '0' || digits[j] > '9') return false;
+            }
+            value = std::stoi(digits);
+            return true;
+        };
+        size_t n = nth.find('n');
+        if (n == std::string::npos) {
+            a = 0;
+            return parse_int(nth, b);
+        }
+        std::string coefficient = nth.substr(0, n);
+        if (coefficient.empty() || coefficient == "+") a = 1;
+        else if (coefficient == "-") a = -1;
+        else if (!parse_int(coefficient, a)) return false;
+        std::string offset = nth.substr(n + 1);
+        b = 0;
+        return offset.empty() || ((offset[0] == '+' || offset[0] == '-') && parse_int(offset, b));
+    }
+
+    bool parse_pseudo(CriticalCss::Compound& compound, CriticalCss::Selector& selector) {
+        ++pos_;
+        bool element = false;
+        if (peek() == ':') {
+            element = true;
+            ++pos_;
+        }
+        std::string name;
+        if (!parse_identifier(name)) return false;
+        name = ascii_lower(name);
+        std::string_view arguments;
+        const bool function = peek() == '(';
+        if (function) {
+            ++pos_;
+            if (!function_arguments(arguments)) return false;
+        }
+        // Pseudo-elements style (part of) the element they follow: match that.
+        if (element || name == "before" || name == "after" || name == "first-line" || name == "first-letter") return true;
+
+        CriticalCss::Compound::Pseudo pseudo;
+        static const std::pair<const char*, PseudoKind> simple[] = {
+            {"hover", PseudoKind::Never}, {"active", PseudoKind::Never}, {"focus", PseudoKind::Never},
+            {"focus-within", PseudoKind::Never}, {"focus-visible", PseudoKind::Never},
+            {"visited", PseudoKind::Never}, {"target", PseudoKind::Never}, {"target-within", PseudoKind::Never},
+            {"root", PseudoKind::Root}, {"empty", PseudoKind::Empty},
+            {"link", PseudoKind::Link}, {"any-link", PseudoKind::Link},
+            {"checked", PseudoKind::Checked}, {"disabled", PseudoKind::Disabled}, {"enabled", PseudoKind::Enabled},
+            {"first-child", PseudoKind::FirstChild}, {"last-child", PseudoKind::LastChild},
+            {"only-child", PseudoKind::OnlyChild}, {"first-of-type", PseudoKind::FirstOfType},
+            {"last-of-type", PseudoKind::LastOfType}, {"only-of-type", PseudoKind::OnlyOfType},
+        };
+        static const std::pair<const char*, PseudoKind> nth[] = {
+            {"nth-child", PseudoKind::NthChild}, {"nth-last-child", PseudoKind::NthLastChild},
+            {"nth-of-type", PseudoKind::NthOfType}, {"nth-last-of-type", PseudoKind::NthLastOfType},
+        };
+        bool known = false;
+        if (!function) {
+            for (const auto& entry : simple) {
+                if (name == entry.first) {
+                    pseudo.kind = entry.second;
+                    known = true;
+                }
+            }
+        } else if (name == "not" || name == "is" || name == "where" || name == "matches" || name == "-webkit-any") {
+            SelectorParser nested(arguments);
+            if (!nested.parse_list(pseudo.arguments, true) || !nested.at_end()) return false;
+            pseudo.kind = name == "not" ? PseudoKind::Not : PseudoKind::Is;
+            known = true;
+            for (const auto& argument : pseudo.arguments) {
+                if (!argument.cacheable) selector.cacheable = false;
+                // :not(<unknown>) could be false where we would assume true: keep the rule instead.
+                if (argument.uncertain && pseudo.kind == PseudoKind::Not) known = false;
+                if (argument.uncertain) selector.uncertain = true;
+            }
+            if (!known) pseudo.arguments.clear();
+        } else {
+            for (const auto& entry : nth) {
+                // "An+B of S" is left to the browser.
+                if (name == entry.first && arguments.find(" of ") == std::string_view::npos) {
+                    if (!parse_nth(arguments, pseudo.a, pseudo.b)) return false;
+                    pseudo.kind = entry.second;
+                    known = true;
+                }
+            }
+        }
+        if (!known) {
+            pseudo.kind = PseudoKind::Always;
+            selector.uncertain = true;
+        }
+        if (pseudo.kind >= PseudoKind::Root && pseudo.kind <= PseudoKind::NthLastOfType &&
+            pseudo.kind != PseudoKind::Link && pseudo.kind != PseudoKind::Checked &&
+            pseudo.kind != PseudoKind::Disabled && pseudo.kind != PseudoKind::Enabled) {
+            selector.cacheable = false; // Depends on siblings or children
+        }
+        compound.pseudos.push_back(std::move(pseudo));
+        return true;
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+// --- Stylesheet Parsing ---
+
+// Rightmost-compound key selectors_by_key_ files a selector under.
+static std::string selector_key(const CriticalCss::Compound& compound) {
+    if (!compound.ids.empty()) return "#" + compound.ids.front();
+    if (!compound.classes.empty()) return "." + compound.classes.front();
+    if (!compound.tag.empty()) return compound.tag;
+    return "*";
+}
+
+// Attribute names a selector's matching looks at (beyond id and class).
+static void collect_attribute_names(const CriticalCss::Selector& selector, std::vector<std::string>& names) {
+    for (const auto& compound : selector.compounds) {
+        for (const auto& attribute : compound.attributes) names.push_back(attribute.name);
+        for (const auto& pseudo : compound.pseudos) {
+            if (pseudo.kind == PseudoKind::Link) names.push_back("href");
+            if (pseudo.kind == PseudoKind::Checked) names.push_back("checked");
+            if (pseudo.kind == PseudoKind::Disabled || pseudo.kind == PseudoKind::Enabled) names.push_back("disabled");
+            for (const auto& argument : pseudo.arguments) collect_attribute_names(argument, names);
+        }
+    }
+}
+
+bool CriticalCss::parse_stylesheets() {
+    const std::string_view css = css_;
+    // Parses the items in [pos, end) into items_, appending their indices to siblings.
+    auto parse_block = [&](auto& self, size_t pos, size_t end, std::vector<size_t>& siblings) -> void {
+        while (pos < end) {
+            while (pos < end && is_space(css[pos])) ++pos;
+            size_t skipped = skip_string_or_comment(css, pos);
+            if (skipped != pos) {
+                pos = skipped;
+                continue;
+            }
+            if (pos >= end) return;
+            if (css[pos] == '}' || css[pos] == ';') {
+                ++pos;
+                continue;
+            }
+            Item item;
+            item.begin = pos;
+            size_t stop = std::min(find_at_depth0(css, pos, "{;}"), end);
+            if (stop >= end || css[stop] == '}') {
+                // Trailing junk without a block: nothing the browser would apply either.
+                return;
+            }
+            if (css[stop] == ';') {
+                item.end = stop + 1; // @import, @charset, @layer a, b; ...
+                item.kind = Item::Other;
+            } else {
+                item.end = std::min(block_end(css, stop), end);
+                item.body_begin = stop + 1;
+            }
+            std::string_view prelude = css.substr(pos, stop - pos);
+            pos = item.end;
+            const size_t index = items_.size();
+            siblings.push_back(index);
+
+            if (css.substr(item.begin, item.end - item.begin).find("</") != std::string_view::npos) {
+                items_.push_back(std::move(item)); // Could end the <style> block early
+                continue;
+            }
+            if (css[stop] == ';') {
+                items_.push_back(std::move(item));
+                continue;
+            }
+            const std::string_view body = css.substr(item.body_begin, item.end - 1 - item.body_begin);
+            if (!prelude.empty() && prelude[0] == '@') {
+                size_t name_end = 1;
+                while (name_end < prelude.size() && is_ident_char(prelude[name_end])) ++name_end;
+                const std::string at_name = ascii_lower(prelude.substr(1, name_end - 1));
+                if (at_name == "media" || at_name == "supports" || at_name == "layer" || at_name == "container") {
+                    item.kind = Item::Group;
+                    items_.push_back(std::move(item));
+                    std::vector<size_t> children;
+                    self(self, items_[index].body_begin, items_[index].end - 1, children);
+                    items_[index].children = std::move(children);
+                    continue;
+                }
+                if (at_name.size() >= 9 && at_name.compare(at_name.size() - 9, 9, "keyframes") == 0) {
+                    item.kind = Item::Keyframes;
+                    std::string_view name = trim(prelude.substr(name_end));
+                    if (name.size() >= 2 && (name.front() == '"' || name.front() == '\'')) name = name.substr(1, name.size() - 2);
+                    item.name = std::string(name);
+                } else if (at_name == "font-face") {
+                    item.kind = Item::FontFace;
+                }
+                items_.push_back(std::move(item));
+                continue;
+            }
+
+            std::vector<Selector> selectors;
+            const std::string selector_text = strip_comments(prelude);
+            SelectorParser parser(selector_text);
+            if (parser.parse_list(selectors, false) && parser.at_end()) {
+                item.kind = Item::StyleRule;
+                item.animations = animation_names(body);
+                for (auto& selector : selectors) {
+                    selector.item = index;
+                    selectors_by_key_[selector_key(selector.compounds.back())].push_back(selectors_.size());
+                    if (selector.cacheable) collect_attribute_names(selector, shape_attributes_);
+                    selectors_.push_back(std::move(selector));
+                }
+            }
+            items_.push_back(std::move(item));
+        }
+    };
+    parse_block(parse_block, 0, css.size(), top_items_);
+    std::sort(shape_attributes_.begin(), shape_attributes_.end());
+    shape_attributes_.erase(std::unique(shape_attributes_.begin(), shape_attributes_.end()), shape_attributes_.end());
+    return !selectors_.empty();
+}
+
+// --- DOM ---
+
+static bool is_void_element(std::string_view tag) {
+    static const char* const void_elements[] = {"area", "base", "br", "col", "embed", "hr", "img", "input",
+                                                "link", "meta", "param", "source", "track", "wbr"};
+    for (const char* void_element : void_elements) {
+        if (tag == void_element) return true;
+    }
+    return false;
+}
+
+static bool is_raw_text_element(std::string_view tag) {
+    return tag == "script" || tag == "style" || tag == "textarea" || tag == "title";
+}
+
+// Whether starting new_tag implicitly closes an open open_tag (the common HTML cases).
+static bool closes_implicitly(std::string_view open_tag, std::string_view new_tag) {
+    if (open_tag == "p") {
+        static const char* const closers[] = {"address", "article", "aside", "blockquote", "div", "dl", "fieldset",
+                                              "footer", "form", "h1", "h2", "h3", "h4", "h5", "h6", "header", "hr",
+                                              "main", "nav", "ol", "p", "pre", "section", "table", "ul"};
+        for (const char* closer : closers) {
+            if (new_tag == closer) return true;
+        }
+        return false;
+    }
+    if (open_tag == "li") return new_tag == "li";
+    if (open_tag == "dt" || open_tag == "dd") return new_tag == "dt" || new_tag == "dd";
+    if (open_tag == "td" || open_tag == "th") return new_tag == "td" || new_tag == "th" || new_tag == "tr";
+    if (open_tag == "tr") return new_tag == "tr";
+    if (open_tag == "option") return new_tag == "option";
+    return false;
+}
+
+// A tolerant HTML scan: enough structure for selector matching, nothing more.
+static void parse_dom(std::string_view html, CriticalCss::Dom& dom) {
+    std::vector<Element>& elements = dom.elements;
+    std::vector<int> open; // Stack of open elements
+    size_t text_bytes = 0; // Visible (body) text so far
+    bool in_head = false;
+    size_t pos = 0;
+
+    auto count_text = [&](size_t begin, size_t end) {
+        if (end > begin && !open.empty()) elements[open.back()].empty = false;
+        if (in_head) return;
+        for (size_t i = begin; i < end; ++i) {
+            if (!is_space(html[i])) ++text_bytes;
+        }
+    };
+
+    while (pos < html.size()) {
+        size_t lt = html.find('<', pos);
+        if (lt == std::string_view::npos) lt = html.size();
+        count_text(pos, lt);
+        pos = lt;
+        if (pos >= html.size()) break;
+
+        if (html.compare(pos, 4, "<!--") == 0) {
+            size_t close = html.find("-->", pos + 4);
+            pos = close == std::string_view::npos ? html.size() : close + 3;
+            continue;
+        }
+        if (pos + 1 < html.size() && (html[pos + 1] == '!' || html[pos + 1] == '?')) {
+            size_t close = html.find('>', pos);
+            pos = close == std::string_view::npos ? html.size() : close + 1;
+            continue;
+        }
+        const bool end_tag = pos + 1 < html.size() && html[pos + 1] == '/';
+        size_t name_start = pos + (end_tag ? 2 : 1);
+        if (name_start >= html.size() || !std::isalpha(static_cast<unsigned char>(html[name_start]))) {
+            count_text(pos, pos + 1); // A stray '<' is text
+            ++pos;
+            continue;
+        }
+        size_t name_end = name_start;
+        while (name_end < html.size() && !is_space(html[name_end]) && html[name_end] != '>' && html[name_end] != '/') ++name_end;
+        const std::string tag = ascii_lower(html.substr(name_start, name_end - name_start));
+
+        if (end_tag) {
+            size_t close = html.find('>', name_end);
+            pos = close == std::string_view::npos ? html.size() : close + 1;
+            for (size_t depth = open.size(); depth-- > 0;) {
+                if (elements[open[depth]].tag == tag) {
+                    open.resize(depth);
+                    break;
+                }
+            }
+            if (tag == "head") in_head = false;
+            continue;
+        }
+
+        while (!open.empty() && closes_implicitly(elements[open.back()].tag, tag)) open.pop_back();
+        Element element;
+        element.tag = tag;
+        element.parent = open.empty() ? -1 : open.back();
+        element.above_fold = text_bytes < CRITICAL_FOLD_TEXT_BYTES;
+        if (element.parent >= 0) elements[element.parent].empty = false;
+
+        // Attributes, up to the tag's '>'.
+        size_t at = name_end;
+        bool self_closing = false;
+        while (at < html.size() && html[at] != '>') {
+            if (is_space(html[at])) {
+                ++at;
+                continue;
+            }
+            if (html[at] == '/') {
+                self_closing = at + 1 < html.size() && html[at + 1] == '>';
+                ++at;
+                continue;
+            }
+            size_t attribute_start = at;
+            while (at < html.size() && !is_space(html[at]) && html[at] != '=' && html[at] != '>' &&
+                   !(html[at] == '/' && at + 1 < html.size() && html[at + 1] == '>')) {
+                ++at;
+            }
+            std::string name = ascii_lower(html.substr(attribute_start, at - attribute_start));
+            size_t after_name = at;
+            while (at < html.size() && is_space(html[at])) ++at;
+            std::string value;
+            if (at < html.size() && html[at] == '=') {
+                ++at;
+                while (at < html.size() && is_space(html[at])) ++at;
+                if (at < html.size() && (html[at] == '"' || html[at] == '\'')) {
+                    size_t close = html.find(html[at], at + 1);
+                    if (close == std::string_view::npos) close = html.size();
+                    value = std::string(html.substr(at + 1, close - at - 1));
+                    at = std::min(close + 1, html.size());
+                } else {
+                    size_t value_start = at;
+                    while (at < html.size() && !is_space(html[at]) && html[at] != '>') ++at;
+                    value = std::string(html.substr(value_start, at - value_start));
+                }
+            } else {
+                at = after_name;
+            }
+            if (name == "id") element.id = value;
+            if (name == "class") {
+                size_t start = 0;
+                while (start < value.size()) {
+                    while (start < value.size() && is_space(value[start])) ++start;
+                    size_t end = start;
+                    while (end < value.size() && !is_space(value[end])) ++end;
+                    if (end > start) element.classes.push_back(value.substr(start, end - start));
+                    start = end;
+                }
+            }
+            element.attributes.emplace_back(std::move(name), std::move(value));
+        }
+        pos = std::min(at + 1, html.size());
+
+        const int index = static_cast<int>(elements.size());
+        elements.push_back(std::move(element));
+        if (tag == "head") in_head = true;
+        if (is_raw_text_element(tag)) {
+            // Contents are text up to the matching end tag.
+            size_t close = pos;
+            while ((close = html.find("</", close)) != std::string_view::npos &&
+                   ascii_lower(html.substr(close + 2, tag.size())) != tag) {
+                close += 2;
+            }
+            if (close == std::string_view::npos) close = html.size();
+            if (close > pos) elements[index].empty = false;
+            if (tag == "textarea" && !in_head) text_bytes += close - pos;
+            size_t end = close == html.size() ? close : html.find('>', close);
+            pos = end == std::string_view::npos ? html.size() : end + 1;
+            continue;
+        }
+        if (!self_closing && !is_void_element(tag)) open.push_back(index);
+    }
+
+    // Sibling positions, from the front and from the back.
+    std::map<std::pair<int, std::string>, uint32_t> type_counts;
+    std::map<int, uint32_t> child_counts;
+    std::map<int, int> last_child;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        Element& element = elements[i];
+        element.child_index = ++child_counts[element.parent];
+        element.type_index = ++type_counts[{element.parent, element.tag}];
+        auto last = last_child.find(element.parent);
+        element.previous = last == last_child.end() ? -1 : last->second;
+        last_child[element.parent] = static_cast<int>(i);
+    }
+    for (Element& element : elements) {
+        element.child_from_end = child_counts[element.parent] - element.child_index + 1;
+        element.type_from_end = type_counts[{element.parent, element.tag}] - element.type_index + 1;
+    }
+}
+
+// --- Matching ---
+
+namespace {
+
+const std::string* find_attribute(const Element& element, std::string_view name) {
+    for (const auto& attribute : element.attributes) {
+        if (attribute.first == name) return &attribute.second;
+    }
+    return nullptr;
+}
+
+bool attribute_matches(const Element& element, const Attribute& test) {
+    const std::string* found = find_attribute(element, test.name);
+    if (!found) return false;
+    if (test.op == 0) return true;
+    const std::string value = test.ignore_case ? ascii_lower(*found) : *found;
+    const std::string& expected = test.value;
+    switch (test.op) {
+        case '=': return value == expected;
+        case '~': {
+            size_t start = 0;
+            while (start < value.size()) {
+                while (start < value.size() && is_space(value[start])) ++start;
+                size_t end = start;
+                while (end < value.size() && !is_space(value[end])) ++end;
+                if (end > start && value.compare(start, end - start, expected) == 0) return true;
+                start = end;
+            }
+            return false;
+        }
+        case '|': return value == expected || value.compare(0, expected.size() + 1, expected + "-") == 0;
+        case '^': return !expected.empty() && value.compare(0, expected.size(), expected) == 0;
+        case '$':
+            return !expected.empty() && value.size() >= expected.size() &&
+                   value.compare(value.size() - expected.size(), expected.size(), expected) == 0;
+        case '*': return !expected.empty() && value.find(expected) != std::string::npos;
+    }
+    return false;
+}
+
+bool nth_matches(int a, int b, uint32_t position) {
+    const int offset = static_cast<int>(position) - b;
+    if (a == 0) return offset == 0;
+    return offset % a == 0 && offset / a >= 0;
+}
+
+bool is_form_control(const std::string& tag) {
+    return tag == "input" || tag == "button" || tag == "select" || tag == "textarea" || tag == "option" ||
+           tag == "optgroup" || tag == "fieldset";
+}
+
+bool matches_from(const CriticalCss::Selector& selector, size_t k, int index, const CriticalCss::Dom& dom);
+
+bool matches_any(const std::vector<CriticalCss::Selector>& selectors, int index, const CriticalCss::Dom& dom) {
+    for (const auto& selector : selectors) {
+        if (matches_from(selector, selector.compounds.size() - 1, index, dom)) return true;
+    }
+    return false;
+}
+
+bool compound_matches(const CriticalCss::Compound& compound, int index, const CriticalCss::Dom& dom) {
+    const Element& element = dom.elements[index];
+    if (!compound.tag.empty() && compound.tag != element.tag) return false;
+    for (const auto& id : compound.ids) {
+        if (element.id != id) return false;
+    }
+    for (const auto& class_name : compound.classes) {
+        if (std::find(element.classes.begin(), element.classes.end(), class_name) == element.classes.end()) return false;
+    }
+    for (const auto& attribute : compound.attributes) {
+        if (!attribute_matches(element, attribute)) return false;
+    }
+    for (const auto& pseudo : compound.pseudos) {
+        bool ok = true;
+        switch (pseudo.kind) {
+            case PseudoKind::Never: ok = false; break;
+            case PseudoKind::Always: ok = true; break;
+            case PseudoKind::Root: ok = element.parent < 0 && element.tag == "html"; break;
+            case PseudoKind::Empty: ok = element.empty; break;
+            case PseudoKind::Link:
+                ok = (element.tag == "a" || element.tag == "area") && find_attribute(element, "href");
+                break;
+            case PseudoKind::Checked:
+                ok = find_attribute(element, "checked") || (element.tag == "option" && find_attribute(element, "selected"));
+                break;
+            case PseudoKind::Disabled: ok = is_form_control(element.tag) && find_attribute(element, "disabled"); break;
+            case PseudoKind::Enabled: ok = is_form_control(element.tag) && !find_attribute(element, "disabled"); break;
+            case PseudoKind::FirstChild: ok = element.child_index == 1; break;
+            case PseudoKind::LastChild: ok = element.child_from_end == 1; break;
+            case PseudoKind::OnlyChild: ok = element.child_index == 1 && element.child_from_end == 1; break;
+            case PseudoKind::FirstOfType: ok = element.type_index == 1; break;
+            case PseudoKind::LastOfType: ok = element.type_from_end == 1; break;
+            case PseudoKind::OnlyOfType: ok = element.type_index == 1 && element.type_from_end == 1; break;
+            case PseudoKind::NthChild: ok = nth_matches(pseudo.a, pseudo.b, element.child_index); break;
+            case PseudoKind::NthLastChild: ok = nth_matches(pseudo.a, pseudo.b, element.child_from_end); break;
+            case PseudoKind::NthOfType: ok = nth_matches(pseudo.a, pseudo.b, element.type_index); break;
+            case PseudoKind::NthLastOfType: ok = nth_matches(pseudo.a, pseudo.b, element.type_from_end); break;
+            case PseudoKind::Not: ok = !matches_any(pseudo.arguments, index, dom); break;
+            case PseudoKind::Is: ok = matches_any(pseudo.arguments, index, dom); break;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// Whether compounds [0, k] of selector match with compound k on element index.
+bool matches_from(const CriticalCss::Selector& selector, size_t k, int index, const CriticalCss::Dom& dom) {
+    const auto& compound = selector.compounds[k];
+    if (!compound_matches(compound, index, dom)) return false;
+    if (k == 0) return true;
+    const auto& elements = dom.elements;
+    switch (compound.combinator) {
+        case '>': {
+            int parent = elements[index].parent;
+            return parent >= 0 && matches_from(selector, k - 1, parent, dom);
+        }
+        case '+': {
+            int previous = elements[index].previous;
+            return previous >= 0 && matches_from(selector, k - 1, previous, dom);
+        }
+        case '~':
+            for (int previous = elements[index].previous; previous >= 0; previous = elements[previous].previous) {
+                if (matches_from(selector, k - 1, previous, dom)) return true;
+            }
+            return false;
+        default:
+            for (int parent = elements[index].parent; parent >= 0; parent = elements[parent].parent) {
+                if (matches_from(selector, k - 1, parent, dom)) return true;
+            }
+            return false;
+    }
+}
+
+} // namespace
+
+void CriticalCss::match_page(const Dom& dom, std::vector<char>& selected) const {
+    const auto& elements = dom.elements;
+    std::vector<std::string> shapes(elements.size());
+    std::vector<const std::vector<size_t>*> candidates;
+    std::vector<uint32_t> matched;
+
+    for (size_t i = 0; i < elements.size(); ++i) {
+        const Element& element = elements[i];
+        // The shape: the parent's, then this element's tag, id, classes and tested attributes.
+        std::string& shape = shapes[i];
+        if (element.parent >= 0) shape = shapes[element.parent] + '\n';
+        shape += element.tag + '#' + element.id;
+        std::vector<std::string> classes = element.classes;
+        std::sort(classes.begin(), classes.end());
+        for (const auto& class_name : classes) shape += '.' + class_name;
+        for (const auto& name : shape_attributes_) {
+            if (const std::string* value = find_attribute(element, name)) shape += '[' + name + '=' + *value + ']';
+        }
+        if (!element.above_fold) continue;
+
+        candidates.clear();
+        auto add_candidates = [&](const std::string& key) {
+            auto it = selectors_by_key_.find(key);
+            if (it != selectors_by_key_.end()) candidates.push_back(&it->second);
+        };
+        if (!element.id.empty()) add_candidates('#' + element.id);
+        for (const auto& class_name : element.classes) add_candidates('.' + class_name);
+        add_candidates(element.tag);
+        add_candidates("*");
+
+        // Cacheable selectors: once per shape.
+        ++shape_lookups_;
+        bool cached = false;
+        {
+            std::shared_lock<std::shared_mutex> lock(shape_mutex_);
+            auto it = shape_matches_.find(shape);
+            if (it != shape_matches_.end()) {
+                for (uint32_t item : it->second) selected[item] = 1;
+                cached = true;
+            }
+        }
+        if (cached) {
+            ++shape_hits_;
+        } else {
+            matched.clear();
+            for (const auto* list : candidates) {
+                for (size_t s : *list) {
+                    const Selector& selector = selectors_[s];
+                    if (selector.cacheable && matches_from(selector, selector.compounds.size() - 1, static_cast<int>(i), dom)) {
+                        matched.push_back(static_cast<uint32_t>(selector.item));
+                    }
+                }
+            }
+            std::sort(matched.begin(), matched.end());
+            matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+            for (uint32_t item : matched) selected[item] = 1;
+            std::unique_lock<std::shared_mutex> lock(shape_mutex_);
+            if (shape_matches_.size() < SHAPE_CACHE_LIMIT) shape_matches_.emplace(shape, matched);
+        }
+
+        // The rest: on this element, unless their rule is already in.
+        for (const auto* list : candidates) {
+            for (size_t s : *list) {
+                const Selector& selector = selectors_[s];
+                if (selector.cacheable || selected[selector.item]) continue;
+                if (matches_from(selector, selector.compounds.size() - 1, static_cast<int>(i), dom)) selected[selector.item] = 1;
+            }
+        }
+    }
+}
+
+std::string CriticalCss::css_for(const std::vector<char>& selected) const {
+    std::vector<std::string> animations;
+    for (size_t i = 0; i < items_.size(); ++i) {
+        if (selected[i]) animations.insert(animations.end(), items_[i].animations.begin(), items_[i].animations.end());
+    }
+    std::string css;
+    auto emit = [&](auto& self, const std::vector<size_t>& indices) -> void {
+        for (size_t index : indices) {
+            const Item& item = items_[index];
+            switch (item.kind) {
+                case Item::StyleRule:
+                    if (selected[index]) css.append(css_, item.begin, item.end - item.begin);
+                    break;
+                case Item::Group: {
+                    const size_t prelude_end = css.size();
+                    css.append(css_, item.begin, item.body_begin - item.begin);
+                    const size_t body_start = css.size();
+                    self(self, item.children);
+                    if (css.size() == body_start) css.resize(prelude_end);
+                    else css += '}';
+                    break;
+                }
+                case Item::Keyframes:
+                    if (std::find(animations.begin(), animations.end(), item.name) != animations.end()) {
+                        css.append(css_, item.begin, item.end - item.begin);
+                    }
+                    break;
+                case Item::FontFace: css.append(css_, item.begin, item.end - item.begin); break;
+                case Item::Other: break;
+            }
+        }
+    };
+    emit(emit, top_items_);
+    return css;
+}
+
+// --- Templates ---
+
+std::shared_ptr<const CriticalCss> CriticalCss::for_template(const std::string& template_name, std::string& template_text,
+                                                             const Stylesheets& stylesheets) {
+    std::map<std::string, const std::string*> by_file_name; // null if ambiguous
+    for (const auto& entry : stylesheets) {
+        auto inserted = by_file_name.emplace(fs::path(entry.first).filename().string(), &entry.first);
+        if (!inserted.second) inserted.first->second = nullptr;
+    }
+
+    std::shared_ptr<CriticalCss> critical(new CriticalCss());
+    std::vector<const std::string*> linked;
+    std::string out;
+    size_t copied = 0;
+    size_t marker_at = std::string::npos;
+    const std::string lower = ascii_lower(template_text);
+    size_t at = 0;
+    while ((at = lower.find("<link", at)) != std::string::npos) {
+        const size_t tag_end = lower.find('>', at);
+        if (tag_end == std::string::npos) break;
+        const size_t tag_start = at;
+        at = tag_end + 1;
+        // rel and href (and media: a print-only sheet is not critical).
+        std::string rel, href, media;
+        size_t media_start = 0, media_end = 0;
+        size_t pos = tag_start + 5;
+        while (pos < tag_end) {
+            while (pos < tag_end && (is_space(lower[pos]) || lower[pos] == '/')) ++pos;
+            size_t name_start = pos;
+            while (pos < tag_end && !is_space(lower[pos]) && lower[pos] != '=' && lower[pos] != '/') ++pos;
+            std::string name = lower.substr(name_start, pos - name_start);
+            std::string value;
+            if (pos < tag_end && lower[pos] == '=') {
+                ++pos;
+                if (pos < tag_end && (lower[pos] == '"' || lower[pos] == '\'')) {
+                    size_t close = lower.find(lower[pos], pos + 1);
+                    if (close == std::string::npos || close > tag_end) close = tag_end;
+                    value = template_text.substr(pos + 1, close - pos - 1);
+                    pos = close + 1;
+                } else {
+                    size_t value_start = pos;
+                    while (pos < tag_end && !is_space(lower[pos])) ++pos;
+                    value = template_text.substr(value_start, pos - value_start);
+                }
+            }
+            if (name == "rel") rel = ascii_lower(value);
+            else if (name == "href") href = value;
+            else if (name == "media") {
+                media = ascii_lower(trim(value));
+                media_start = name_start - tag_start;
+                while (media_start > 0 && is_space(template_text[tag_start + media_start - 1])) --media_start;
+                media_end = pos - tag_start;
+            }
+        }
+        if ((" " + rel + " ").find(" stylesheet ") == std::string::npos || (!media.empty() && media != "all" && media != "screen")) continue;
+
+        std::string_view reference = asset_reference_path(href);
+        const std::string* path = nullptr;
+        if (reference.find('/') != std::string_view::npos) {
+            auto it = stylesheets.find(std::string(reference));
+            if (it != stylesheets.end()) path = &it->first;
+        } else {
+            auto it = by_file_name.find(std::string(reference));
+            if (it != by_file_name.end()) path = it->second;
+        }
+        if (!path) continue;
+
+        // <link ...> -> <link ... media="print" onload="this.media='all'"><noscript><link ...></noscript>
+        const std::string tag = template_text.substr(tag_start, tag_end + 1 - tag_start);
+        size_t close = tag.size() - 1;
+        while (close > 0 && (tag[close - 1] == '/' || is_space(tag[close - 1]))) --close;
+        if (marker_at == std::string::npos) marker_at = tag_start;
+        out.append(template_text, copied, tag_start - copied);
+        if (tag_start == marker_at) out += CRITICAL_CSS_MARKER;
+        std::string deferred = tag.substr(0, close);
+        if (media_end > media_start) deferred.erase(media_start, media_end - media_start); // media="all" is replaced
+        out += deferred + " media=\"print\" onload=\"this.media='all'\">";
+        out += "<noscript>" + tag + "</noscript>";
+        copied = tag_end + 1;
+        if (std::find(linked.begin(), linked.end(), path) == linked.end()) linked.push_back(path);
+    }
+    if (linked.empty()) return nullptr;
+    out.append(template_text, copied, std::string::npos);
+    template_text = std::move(out);
+
+    size_t stylesheet_bytes = 0;
+    for (const std::string* path : linked) stylesheet_bytes += stylesheets.at(*path).size() + 1;
+    critical->css_.reserve(stylesheet_bytes);
+    for (const std::string* path : linked) {
+        critical->css_ += stylesheets.at(*path);
+        critical->css_ += '\n';
+    }
+    critical->stylesheets_hash_ = hash_content(critical->css_);
+    if (!critical->parse_stylesheets()) {
+        std::cerr << "Warning: No usable CSS rules for the critical CSS of " << template_name << std::endl;
+    }
+    return critical;
+}
+
+CriticalCss::~CriticalCss() = default;
+
+void CriticalCss::inline_into(std::string& page) const {
+    const size_t marker = page.find(CRITICAL_CSS_MARKER);
+    if (marker == std::string::npos) return;
+    TraceSpan span("critical css");
+    Dom dom;
+    parse_dom(page, dom);
+    std::vector<char> selected(items_.size(), 0);
+    match_page(dom, selected);
+    std::string css = css_for(selected);
+    ++pages_;
+    inlined_bytes_ += css.size();
+    span.set_bytes(page.size(), css.size());
+    page.replace(marker, sizeof(CRITICAL_CSS_MARKER) - 1, css.empty() ? std::string() : "<style>" + css + "</style>");
+}
+
+CriticalCss::Stats CriticalCss::stats() const {
+    Stats stats;
+    stats.pages = pages_;
+    stats.inlined_bytes = inlined_bytes_;
+    stats.stylesheet_bytes = css_.size();
+    stats.shape_lookups = shape_lookups_;
+    stats.shape_hits = shape_hits_;
+    return stats;
+}
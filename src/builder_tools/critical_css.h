@@ -0,0 +1,102 @@
+#ifndef CRITICAL_CSS_H
+#define CRITICAL_CSS_H
+
+#include "common_utils.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <unordered_map>
+
+// --- Critical CSS ---
+// build --critical-css stops local stylesheets from blocking first paint. For
+// each page template, the <link rel="stylesheet"> tags naming static CSS
+// assets are loaded without blocking (media="print", switched to "all" once
+// loaded, with a <noscript> fallback), and every rendered page gets a <style>
+// block, in their place, with only the rules that style its content above the
+// fold:
+//   - the stylesheets are parsed once per template into rules (style rules,
+//     @media/@supports groups, @keyframes, @font-face) and selectors
+//   - each page is parsed into a DOM; elements before the fold (the first
+//     CRITICAL_FOLD_TEXT_BYTES of visible text) are matched against the
+//     selectors whose rightmost part (id, class or tag) they could match
+//   - a rule is inlined if one of its selectors matches such an element in its
+//     first-paint state: :hover, :focus and other user-action states never do.
+//     @keyframes follow the inlined rules that animate with them, and
+//     @font-face is always inlined. Rules with an invalid selector (which the
+//     browser drops too) and other at-rules are only in the deferred sheet.
+// The full stylesheets still load right after, so the page ends up styled
+// exactly as before; only the first paint no longer waits for them.
+//
+// Matching results are cached per template: pages of one kind share most of
+// their element shapes (the same header, the same <p> under <article>), so a
+// selector list is evaluated once per distinct shape (the element's and its
+// ancestors' tag, id, classes and matched-on attributes) rather than once per
+// element. Selectors that look at siblings or children (+, ~, :nth-child, ...)
+// depend on more than that shape and are matched on every page.
+
+extern const size_t CRITICAL_FOLD_TEXT_BYTES;
+
+// Minified content of the site's stylesheets, by their path under PUBLIC_DIR
+// (as published: css/shared.1a2b3c4d.css with --fingerprint-assets).
+using Stylesheets = std::map<std::string, std::string>;
+
+class CriticalCss {
+public:
+    // Rewrites the stylesheet links in template_text that name one of
+    // stylesheets (AssetManifest-style references: "../shared.css" finds
+    // css/shared.css) into non-blocking ones, preceded by a marker where
+    // inline_into() puts the <style> block. Returns null if there is none.
+    static std::shared_ptr<const CriticalCss> for_template(const std::string& template_name, std::string& template_text,
+                                                           const Stylesheets& stylesheets);
+    ~CriticalCss();
+
+    // Replaces the marker in a page rendered from the template with the page's
+    // critical rules. Thread-safe.
+    void inline_into(std::string& page) const;
+
+    // hash_content() of the stylesheets this template inlines from: part of
+    // the template's input hash for incremental builds.
+    const std::string& stylesheets_hash() const { return stylesheets_hash_; }
+
+    struct Stats {
+        size_t pages = 0;
+        size_t inlined_bytes = 0;    // Summed over pages
+        size_t stylesheet_bytes = 0; // Of this template's stylesheets
+        size_t shape_lookups = 0;
+        size_t shape_hits = 0;       // Lookups answered from the cache
+    };
+    Stats stats() const;
+
+    // Parsed stylesheet and selector representation (critical_css.cpp).
+    struct Compound;
+    struct Selector;
+    struct Item;
+    struct Dom;
+
+private:
+    CriticalCss() = default;
+    bool parse_stylesheets();
+    void match_page(const Dom& dom, std::vector<char>& selected) const;
+    std::string css_for(const std::vector<char>& selected) const;
+
+    std::string css_;   // The stylesheets, concatenated in link order
+    std::string stylesheets_hash_;
+    std::vector<Item> items_;           // Rules and at-rules, in source order
+    std::vector<size_t> top_items_;     // Indices of the top-level items
+    std::vector<Selector> selectors_;
+    // Selectors by the key of their rightmost compound ("#id", ".class", tag or "*").
+    std::unordered_map<std::string, std::vector<size_t>> selectors_by_key_;
+    std::vector<std::string> shape_attributes_; // Attributes some cacheable selector tests
+
+    // Shape (see above) -> items whose cacheable selectors match an element of that shape.
+    mutable std::shared_mutex shape_mutex_;
+    mutable std::unordered_map<std::string, std::vector<uint32_t>> shape_matches_;
+
+    mutable std::atomic<size_t> pages_{0};
+    mutable std::atomic<size_t> inlined_bytes_{0};
+    mutable std::atomic<size_t> shape_lookups_{0};
+    mutable std::atomic<size_t> shape_hits_{0};
+};
+
+#endif // CRITICAL_CSS_H
@@ -0,0 +1,827 @@
+#include "css_minifier.h"
+#include <algorithm>
+#include <array>
+#include <unordered_set>
+
+namespace {
+
+// --- Character Classes ---
+
+enum : uint8_t {
+    CSS_NAME_START = 1, // Letters, '_', non-ASCII
+    CSS_NAME = 2,       // Name starts, digits, '-'
+    CSS_DIGIT = 4,
+    CSS_HEX = 8,
+    CSS_SPACE = 16, // ' ', \t, \n, \r, \f
+};
+
+constexpr std::array<uint8_t, 256> make_class_table() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        uint8_t bits = 0;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80) bits |= CSS_NAME_START | CSS_NAME;
+        if (c >= '0' && c <= '9') bits |= CSS_DIGIT | CSS_NAME | CSS_HEX;
+        if ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F')) bits |= CSS_HEX;
+        if (c == '-') bits |= CSS_NAME;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') bits |= CSS_SPACE;
+        table[c] = bits;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_CLASS = make_class_table();
+
+inline bool has_class(char c, uint8_t bits) {
+    return (CHAR_CLASS[static_cast<unsigned char>(c)] & bits) != 0;
+}
+
+inline char lower(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (lower(a[i]) != b[i]) return false;
+    }
+    return true;
+}
+
+// --- Tokens ---
+
+enum class TokenType : uint8_t {
+    Whitespace,
+    Comment,
+    Ident,
+    Function, // "name("
+    AtKeyword,
+    Hash,
+    String,
+    Url, // Unquoted url(...), parentheses included
+    Number,
+    Percentage,
+    Dimension,
+    Delim, // Any other single character, and <!-- / -->
+    Colon,
+    Semicolon,
+    Comma,
+    OpenParen,
+    CloseParen,
+    OpenBracket,
+    CloseBracket,
+    OpenBrace,
+    CloseBrace,
+};
+
+struct Token {
+    TokenType type = TokenType::Whitespace;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t unit = 0; // Dimension: where the unit starts
+};
+
+// One token per next(), following the CSS Syntax tokenizer closely enough
+// that every token boundary the browser sees is a boundary here.
+class Lexer {
+public:
+    explicit Lexer(std::string_view css) : css_(css) {}
+
+    bool next(Token& token) {
+        if (pos_ >= css_.size()) return false;
+        token.begin = pos_;
+        token.unit = 0;
+        const char c = css_[pos_];
+        if (has_class(c, CSS_SPACE)) {
+            while (pos_ < css_.size() && has_class(css_[pos_], CSS_SPACE)) ++pos_;
+            token.type = TokenType::Whitespace;
+        } else if (c == '/' && at(pos_ + 1) == '*') {
+            size_t close = css_.find("*/", pos_ + 2);
+            pos_ = close == std::string_view::npos ? css_.size() : close + 2;
+            token.type = TokenType::Comment;
+        } else if (c == '"' || c == '\'') {
+            consume_string(c);
+            token.type = TokenType::String;
+        } else if (starts_number(pos_)) {
+            consume_numeric(token);
+        } else if (starts_name(pos_)) {
+            consume_ident_like(token);
+        } else if (c == '#' && (has_class(at(pos_ + 1), CSS_NAME) || starts_escape(pos_ + 1))) {
+            pos_ = consume_name(pos_ + 1);
+            token.type = TokenType::Hash;
+        } else if (c == '@' && starts_name(pos_ + 1)) {
+            pos_ = consume_name(pos_ + 1);
+            token.type = TokenType::AtKeyword;
+        } else if ((c == '<' && css_.compare(pos_, 4, "<!--") == 0) || (c == '-' && css_.compare(pos_, 3, "-->") == 0)) {
+            pos_ += c == '<' ? 4 : 3;
+            token.type = TokenType::Delim;
+        } else {
+            ++pos_;
+            switch (c) {
+            case ':': token.type = TokenType::Colon; break;
+            case ';': token.type = TokenType::Semicolon; break;
+            case ',': token.type = TokenType::Comma; break;
+            case '(': token.type = TokenType::OpenParen; break;
+            case ')': token.type = TokenType::CloseParen; break;
+            case '[': token.type = TokenType::OpenBracket; break;
+            case ']': token.type = TokenType::CloseBracket; break;
+            case '{': token.type = TokenType::OpenBrace; break;
+            case '}': token.type = TokenType::CloseBrace; break;
+            default: token.type = TokenType::Delim; break;
+            }
+        }
+        token.end = pos_;
+        return true;
+    }
+
+private:
+    char at(size_t i) const { return i < css_.size() ? css_[i] : '\0'; }
+
+    bool starts_escape(size_t i) const { return at(i) == '\\' && i + 1 < css_.size() && css_[i + 1] != '\n'; }
+
+    bool starts_name(size_t i) const {
+        const char c = at(i);
+        if (has_class(c, CSS_NAME_START)) return true;
+        if (c == '\\') return starts_escape(i);
+        if (c != '-') return false;
+        const char next = at(i + 1);
+        return has_class(next, CSS_NAME_START) || next == '-' || starts_escape(i + 1);
+    }
+
+    bool starts_number(size_t i) const {
+        const char c = at(i);
+        if (has_class(c, CSS_DIGIT)) return true;
+        if (c == '.') return has_class(at(i + 1), CSS_DIGIT);
+        if (c != '+' && c != '-') return false;
+        return has_class(at(i + 1), CSS_DIGIT) || (at(i + 1) == '.' && has_class(at(i + 2), CSS_DIGIT));
+    }
+
+    size_t consume_escape(size_t i) const {
+        ++i; // The backslash
+        if (!has_class(at(i), CSS_HEX)) return std::min(i + 1, css_.size());
+        size_t end = i;
+        while (end < css_.size() && end - i < 6 && has_class(css_[end], CSS_HEX)) ++end;
+        if (at(end) == '\r' && at(end + 1) == '\n') return end + 2;
+        return has_class(at(end), CSS_SPACE) ? end + 1 : end;
+    }
+
+    size_t consume_name(size_t i) const {
+        while (i < css_.size()) {
+            if (has_class(css_[i], CSS_NAME)) {
+                ++i;
+            } else if (starts_escape(i)) {
+                i = consume_escape(i);
+            } else {
+                break;
+            }
+        }
+        return i;
+    }
+
+    void consume_digits() {
+        while (pos_ < css_.size() && has_class(css_[pos_], CSS_DIGIT)) ++pos_;
+    }
+
+    void consume_numeric(Token& token) {
+        if (css_[pos_] == '+' || css_[pos_] == '-') ++pos_;
+        consume_digits();
+        if (at(pos_) == '.' && has_class(at(pos_ + 1), CSS_DIGIT)) {
+            ++pos_;
+            consume_digits();
+        }
+        if (lower(at(pos_)) == 'e') {
+            const size_t digits = at(pos_ + 1) == '+' || at(pos_ + 1) == '-' ? pos_ + 2 : pos_ + 1;
+            if (has_class(at(digits), CSS_DIGIT)) {
+                pos_ = digits;
+                consume_digits();
+            }
+        }
+        if (starts_name(pos_)) {
+            token.unit = pos_;
+            pos_ = consume_name(pos_);
+            token.type = TokenType::Dimension;
+        } else if (at(pos_) == '%') {
+            ++pos_;
+            token.type = TokenType::Percentage;
+        } else {
+            token.type = TokenType::Number;
+        }
+    }
+
+    void consume_ident_like(Token& token) {
+        const size_t start = pos_;
+        pos_ = consume_name(pos_);
+        if (at(pos_) != '(') {
+            token.type = TokenType::Ident;
+            return;
+        }
+        token.type = TokenType::Function;
+        const bool url = iequals(css_.substr(start, pos_ - start), "url");
+        ++pos_;
+        if (!url) return;
+        size_t argument = pos_;
+        while (has_class(at(argument), CSS_SPACE)) ++argument;
+        if (at(argument) == '"' || at(argument) == '\'') return; // url("..."): a function like any other
+        pos_ = argument;
+        while (pos_ < css_.size() && css_[pos_] != ')') pos_ += starts_escape(pos_) ? 2 : 1;
+        pos_ = std::min(pos_ + 1, css_.size());
+        token.type = TokenType::Url;
+    }
+
+    void consume_string(char quote) {
+        ++pos_;
+        while (pos_ < css_.size()) {
+            const char c = css_[pos_];
+            if (c == quote) {
+                ++pos_;
+                return;
+            }
+            if (c == '\n') return; // Unterminated: ends before the newline
+            pos_ += c == '\\' ? 2 : 1;
+        }
+        pos_ = css_.size();
+    }
+
+    std::string_view css_;
+    size_t pos_ = 0;
+};
+
+// --- Separators ---
+// The last token written, for deciding whether the next one needs a space.
+struct Written {
+    TokenType type = TokenType::Whitespace;
+    char first = 0; // First character (the character of a Delim)
+};
+
+inline bool is_delim(TokenType type, char first, char c) {
+    return type == TokenType::Delim && first == c;
+}
+
+// Whether a written next to b would read as other tokens (the CSS Syntax
+// serialization table), so a space has to stay between them.
+bool needs_separator(const Written& a, TokenType b, char b_first) {
+    const bool b_name = b == TokenType::Ident || b == TokenType::Function || b == TokenType::Url;
+    const bool b_numeric = b == TokenType::Number || b == TokenType::Percentage || b == TokenType::Dimension;
+    const bool b_minus = is_delim(b, b_first, '-');
+    switch (a.type) {
+    case TokenType::Ident:
+        return b_name || b_numeric || b_minus || b == TokenType::OpenParen;
+    case TokenType::AtKeyword:
+    case TokenType::Hash:
+    case TokenType::Dimension:
+        return b_name || b_numeric || b_minus;
+    case TokenType::Number:
+        return b_name || b_numeric || is_delim(b, b_first, '%');
+    case TokenType::Delim:
+        if (a.first == '#' || a.first == '-') return b_name || b_numeric || b_minus;
+        if (a.first == '@') return b_name || b_minus;
+        if (a.first == '.' || a.first == '+') return b_numeric;
+        if (a.first == '/') return is_delim(b, b_first, '*');
+        if (a.first == '\\') return true;
+        return false;
+    default:
+        return false;
+    }
+}
+
+enum class Mode {
+    Selector,
+    KeyframeSelector,
+    AtPrelude,
+    Value,
+};
+
+// Whether whitespace between a and b means anything (beyond keeping them apart).
+bool space_is_significant(Mode mode, const Written& a, TokenType b, char b_first, int bracket_depth) {
+    if (a.type == TokenType::Comma || b == TokenType::Comma) return false;
+    if (a.type == TokenType::OpenParen || a.type == TokenType::Function || b == TokenType::CloseParen) return false;
+    switch (mode) {
+    case Mode::Selector:
+        if (bracket_depth > 0 || a.type == TokenType::OpenBracket || b == TokenType::CloseBracket) return false;
+        for (char combinator : {'>', '+', '~'}) {
+            if (is_delim(a.type, a.first, combinator) || is_delim(b, b_first, combinator)) return false;
+        }
+        return true;
+    case Mode::KeyframeSelector:
+        return false;
+    case Mode::AtPrelude:
+        return a.type != TokenType::Colon && b != TokenType::Colon;
+    case Mode::Value:
+        return !(is_delim(a.type, a.first, '/') || is_delim(b, b_first, '/') || is_delim(a.type, a.first, '!') ||
+                 is_delim(b, b_first, '!'));
+    }
+    return true;
+}
+
+// --- Value Compaction ---
+
+// Appends number ("+1.50", "-0.5", "007") without redundant zeros and
+// returns true, or returns false if it has an exponent (left as it is).
+bool append_compact_number(std::string& out, std::string_view number) {
+    size_t i = 0;
+    const char sign = number[0] == '+' || number[0] == '-' ? number[0] : 0;
+    if (sign) ++i;
+    size_t int_begin = i;
+    while (i < number.size() && has_class(number[i], CSS_DIGIT)) ++i;
+    size_t int_end = i;
+    size_t frac_begin = i, frac_end = i;
+    if (i < number.size() && number[i] == '.') {
+        frac_begin = ++i;
+        while (i < number.size() && has_class(number[i], CSS_DIGIT)) ++i;
+        frac_end = i;
+    }
+    if (i != number.size()) return false;
+    while (int_begin < int_end && number[int_begin] == '0') ++int_begin;
+    while (frac_end > frac_begin && number[frac_end - 1] == '0') --frac_end;
+    if (int_begin == int_end && frac_begin == frac_end) {
+        out += '0'; // Zero has no sign
+        return true;
+    }
+    if (sign) out += sign;
+    out.append(number.substr(int_begin, int_end - int_begin));
+    if (frac_end > frac_begin) {
+        out += '.';
+        out.append(number.substr(frac_begin, frac_end - frac_begin));
+    }
+    return true;
+}
+
+bool is_length_unit(std::string_view unit) {
+    for (const char* length : {"px", "em", "rem", "ex", "ch", "vw", "vh", "vmin", "vmax", "cm", "mm", "q", "in", "pt", "pc"}) {
+        if (iequals(unit, length)) return true;
+    }
+    return false;
+}
+
+// Named colors shorter than their shortest hex form, by six-digit hex.
+constexpr std::pair<std::string_view, std::string_view> COLOR_NAMES[] = {
+    {"000080", "navy"},   {"008000", "green"},  {"008080", "teal"},   {"4b0082", "indigo"}, {"800000", "maroon"},
+    {"800080", "purple"}, {"808000", "olive"},  {"808080", "gray"},   {"a0522d", "sienna"}, {"a52a2a", "brown"},
+    {"c0c0c0", "silver"}, {"cd853f", "peru"},   {"d2b48c", "tan"},    {"da70d6", "orchid"}, {"dda0dd", "plum"},
+    {"ee82ee", "violet"}, {"f0e68c", "khaki"},  {"f0ffff", "azure"},  {"f5deb3", "wheat"},  {"f5f5dc", "beige"},
+    {"fa8072", "salmon"}, {"faf0e6", "linen"},  {"ff0000", "red"},    {"ff6347", "tomato"}, {"ff7f50", "coral"},
+    {"ffa500", "orange"}, {"ffc0cb", "pink"},   {"ffd700", "gold"},   {"ffe4c4", "bisque"}, {"fffafa", "snow"},
+    {"fffff0", "ivory"},
+};
+
+// Appends the shortest form of the color with these hex digits ("AABBCC"),
+// or returns false if they are not 3, 4, 6 or 8 hex digits.
+bool append_compact_color(std::string& out, std::string_view digits) {
+    const size_t size = digits.size();
+    if (size != 3 && size != 4 && size != 6 && size != 8) return false;
+    char hex[8];
+    for (size_t i = 0; i < size; ++i) {
+        if (!has_class(digits[i], CSS_HEX)) return false;
+        hex[i] = lower(digits[i]);
+    }
+    size_t length = size;
+    if ((size == 6 || size == 8) && hex[0] == hex[1] && hex[2] == hex[3] && hex[4] == hex[5] &&
+        (size == 6 || hex[6] == hex[7])) {
+        for (size_t i = 0; i < size / 2; ++i) hex[i] = hex[2 * i];
+        length = size / 2;
+    }
+    if (length == 3 || length == 6) {
+        char full[6];
+        for (size_t i = 0; i < 6; ++i) full[i] = length == 3 ? hex[i / 2] : hex[i];
+        const std::string_view key(full, 6);
+        for (const auto& [color, name] : COLOR_NAMES) {
+            if (color == key) {
+                if (name.size() < length + 1) {
+                    out.append(name);
+                    return true;
+                }
+                break;
+            }
+        }
+    }
+    out += '#';
+    out.append(hex, length);
+    return true;
+}
+
+// --- Blocks ---
+
+enum class EntryKind : uint8_t {
+    Declaration, // "name:value"
+    StyleRule,   // "selector{body}"
+    AtBlock,     // "@name prelude{body}"
+    Statement,   // "@name prelude;"
+    Other,       // Anything unrecognized, as written (with its ';', if any)
+};
+
+struct Entry {
+    EntryKind kind = EntryKind::Other;
+    std::string text;
+    size_t prelude_size = 0;        // Rules: where '{' is in text
+    bool declarations_only = false; // StyleRule: no nested rules in the body
+    bool dedupable = false;         // Only its last copy among its siblings matters
+    std::vector<std::string> declarations; // declarations_only: the body's, for merging
+};
+
+struct Block {
+    EntryKind kind = EntryKind::Other; // What it becomes in its parent
+    std::string prelude;
+    bool declarations = false; // Holds declarations (style rules, @font-face, ...) rather than rules
+    bool keyframes = false;    // Holds keyframe rules
+    bool drop_if_empty = false;
+    bool dedupable = false;
+    bool clean = true; // Holds nothing unrecognized
+    std::vector<Entry> entries;
+};
+
+enum class Terminator {
+    Semicolon,
+    CloseBrace,
+    End,
+};
+
+class CssMinifier {
+public:
+    CssMinifier(std::string_view css, CssMinifyStats& stats) : css_(css), stats_(stats) {}
+
+    std::string run() {
+        blocks_.emplace_back();
+        Lexer lexer(css_);
+        Token token;
+        int depth = 0; // Parentheses and brackets within the item
+        while (lexer.next(token)) {
+            switch (token.type) {
+            case TokenType::OpenBrace:
+                open_block();
+                depth = 0;
+                break;
+            case TokenType::CloseBrace:
+                finish_item(Terminator::CloseBrace);
+                close_block();
+                depth = 0;
+                break;
+            case TokenType::Semicolon:
+                if (depth == 0) {
+                    finish_item(Terminator::Semicolon);
+                } else {
+                    item_.push_back(token);
+                }
+                break;
+            case TokenType::Function:
+            case TokenType::OpenParen:
+            case TokenType::OpenBracket:
+                ++depth;
+                item_.push_back(token);
+                break;
+            case TokenType::CloseParen:
+            case TokenType::CloseBracket:
+                if (depth > 0) --depth;
+                item_.push_back(token);
+                break;
+            default:
+                item_.push_back(token);
+                break;
+            }
+        }
+        finish_item(Terminator::End);
+        while (blocks_.size() > 1) close_block(); // The browser closes them at the end too
+        std::string out;
+        join(blocks_.front(), out);
+        return out;
+    }
+
+private:
+    std::string_view text(const Token& token) const { return css_.substr(token.begin, token.end - token.begin); }
+
+    static bool significant(const Token& token) {
+        return token.type != TokenType::Whitespace && token.type != TokenType::Comment;
+    }
+
+    // [begin, end) of item_ without leading and trailing whitespace and comments.
+    std::pair<size_t, size_t> trimmed_item() const {
+        size_t begin = 0, end = item_.size();
+        while (begin < end && !significant(item_[begin])) ++begin;
+        while (end > begin && !significant(item_[end - 1])) --end;
+        return {begin, end};
+    }
+
+    void finish_item(Terminator terminator) {
+        const auto [begin, end] = trimmed_item();
+        Block& block = blocks_.back();
+        if (begin == end) {
+            item_.clear();
+            return;
+        }
+        Entry entry;
+        size_t colon = begin;
+        while (colon < end && item_[colon].type != TokenType::Colon) ++colon;
+        if (item_[begin].type == TokenType::AtKeyword) {
+            entry.kind = EntryKind::Statement;
+            append_tokens(entry.text, begin, end, Mode::AtPrelude);
+            entry.text += ';';
+        } else if (block.declarations && colon < end) {
+            entry.kind = EntryKind::Declaration;
+            entry.dedupable = true;
+            for (size_t i = begin; i < colon; ++i) {
+                if (significant(item_[i])) entry.text.append(text(item_[i]));
+            }
+            const std::string_view property = entry.text;
+            const bool custom_property = property.size() > 2 && property[0] == '-' && property[1] == '-';
+            // "flex: 0" is a flex factor, not a zero basis: keep its units
+            const bool drop_zero_units = property.find("flex") == std::string_view::npos;
+            entry.text += ':';
+            size_t value = colon + 1;
+            while (value < end && !significant(item_[value])) ++value;
+            if (custom_property) {
+                if (value < end) entry.text.append(css_.substr(item_[value].begin, item_[end - 1].end - item_[value].begin));
+            } else {
+                append_tokens(entry.text, value, end, Mode::Value, drop_zero_units);
+            }
+        } else if (!block.declarations && terminator == Terminator::End) {
+            item_.clear(); // A trailing prelude without a block: the browser drops it too
+            return;
+        } else {
+            append_tokens(entry.text, begin, end, Mode::Selector);
+            if (terminator == Terminator::Semicolon) entry.text += ';';
+            block.clean = false;
+        }
+        block.entries.push_back(std::move(entry));
+        item_.clear();
+    }
+
+    void open_block() {
+        const auto [begin, end] = trimmed_item();
+        const bool in_keyframes = blocks_.back().keyframes;
+        Block block;
+        if (begin < end && item_[begin].type == TokenType::AtKeyword) {
+            std::string name;
+            for (char c : text(item_[begin]).substr(1)) name += lower(c);
+            if (name.size() > 1 && name[0] == '-') { // -webkit-keyframes
+                const size_t prefix_end = name.find('-', 1);
+                if (prefix_end != std::string::npos) name.erase(0, prefix_end + 1);
+            }
+            block.kind = EntryKind::AtBlock;
+            append_tokens(block.prelude, begin, end, Mode::AtPrelude);
+            block.keyframes = name == "keyframes";
+            const bool conditional = name == "media" || name == "supports" || name == "container";
+            block.declarations = !(block.keyframes || conditional || name == "layer" || name == "document" ||
+                                   name == "scope" || name == "starting-style");
+            block.drop_if_empty = conditional || name == "font-face" || name == "page";
+            // Repeating @layer blocks would not repeat their place in the layer order
+            block.dedupable = name != "layer";
+        } else {
+            block.kind = EntryKind::StyleRule;
+            append_tokens(block.prelude, begin, end, in_keyframes ? Mode::KeyframeSelector : Mode::Selector);
+            block.declarations = true;
+            block.drop_if_empty = !in_keyframes;
+            block.dedupable = !in_keyframes;
+        }
+        item_.clear();
+        blocks_.push_back(std::move(block));
+    }
+
+    void close_block() {
+        if (blocks_.size() == 1) { // A stray '}' at the top level
+            Entry entry;
+            entry.text = "}";
+            blocks_.back().entries.push_back(std::move(entry));
+            blocks_.back().clean = false;
+            return;
+        }
+        Block block = std::move(blocks_.back());
+        blocks_.pop_back();
+        const bool declarations_only = std::all_of(block.entries.begin(), block.entries.end(),
+                                                   [](const Entry& entry) { return entry.kind == EntryKind::Declaration; });
+        Entry entry;
+        entry.kind = block.kind;
+        entry.prelude_size = block.prelude.size();
+        entry.declarations_only = declarations_only;
+        entry.dedupable = block.dedupable;
+        entry.text = std::move(block.prelude);
+        entry.text += '{';
+        join(block, entry.text);
+        if (entry.text.size() == entry.prelude_size + 1 && block.drop_if_empty) {
+            ++stats_.empty_rules;
+            return;
+        }
+        entry.text += '}';
+        if (declarations_only) {
+            entry.declarations.reserve(block.entries.size());
+            for (Entry& declaration : block.entries) entry.declarations.push_back(std::move(declaration.text));
+        }
+        blocks_.back().entries.push_back(std::move(entry));
+    }
+
+    static bool can_merge(const Entry& a, const Entry& b) {
+        return a.kind == EntryKind::StyleRule && b.kind == EntryKind::StyleRule && a.declarations_only &&
+               b.declarations_only && a.dedupable && b.dedupable && a.prelude_size == b.prelude_size &&
+               a.text.compare(0, a.prelude_size, b.text, 0, b.prelude_size) == 0;
+    }
+
+    // Drops the dedupable items of which a later copy follows. Most blocks
+    // hold a handful of declarations: those are compared pairwise, without
+    // building a hash set.
+    template <typename Item, typename Text>
+    void drop_earlier_duplicates(std::vector<Item>& items, Text text_of) {
+        if (items.size() < 2) return;
+        std::vector<char> keep(items.size(), 1);
+        bool dropped = false;
+        if (items.size() <= 16) {
+            for (size_t i = 0; i + 1 < items.size(); ++i) {
+                const std::string* text = text_of(items[i]);
+                if (!text) continue;
+                for (size_t j = i + 1; j < items.size() && keep[i]; ++j) {
+                    const std::string* later = text_of(items[j]);
+                    if (later && *later == *text) keep[i] = 0;
+                }
+                dropped = dropped || !keep[i];
+            }
+        } else {
+            std::unordered_set<std::string_view> seen;
+            seen.reserve(items.size());
+            for (size_t i = items.size(); i-- > 0;) {
+                const std::string* text = text_of(items[i]);
+                if (text && !seen.insert(*text).second) {
+                    keep[i] = 0;
+                    dropped = true;
+                }
+            }
+        }
+        if (!dropped) return;
+        size_t kept = 0;
+        for (size_t i = 0; i < items.size(); ++i) {
+            if (!keep[i]) {
+                ++stats_.duplicates;
+                continue;
+            }
+            if (kept != i) items[kept] = std::move(items[i]);
+            ++kept;
+        }
+        items.resize(kept);
+    }
+
+    // Appends b's declarations to a's (a and b adjacent, with one selector).
+    void merge_rules(Entry& a, Entry& b) {
+        for (std::string& declaration : b.declarations) a.declarations.push_back(std::move(declaration));
+        drop_earlier_duplicates(a.declarations, [](const std::string& declaration) { return &declaration; });
+        a.text.resize(a.prelude_size + 1);
+        for (size_t i = 0; i < a.declarations.size(); ++i) {
+            if (i > 0) a.text += ';';
+            a.text.append(a.declarations[i]);
+        }
+        a.text += '}';
+        ++stats_.merged_rules;
+    }
+
+    // Appends the block's body: its entries without earlier duplicates, adjacent
+    // rules with one selector merged (until neither changes anything more,
+    // since a merge can make new duplicates and dropping them new neighbours).
+    void join(Block& block, std::string& out) {
+        std::vector<Entry>& entries = block.entries;
+        for (bool merged = block.clean; merged;) {
+            drop_earlier_duplicates(entries, [](const Entry& entry) { return entry.dedupable ? &entry.text : nullptr; });
+            merged = false;
+            size_t kept = 0;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                if (kept > 0 && can_merge(entries[kept - 1], entries[i])) {
+                    merge_rules(entries[kept - 1], entries[i]);
+                    merged = true;
+                    continue;
+                }
+                if (kept != i) entries[kept] = std::move(entries[i]);
+                ++kept;
+            }
+            entries.resize(kept);
+        }
+        size_t size = out.size();
+        for (const Entry& entry : entries) size += entry.text.size() + 1;
+        out.reserve(size + 1);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0 && entries[i - 1].kind == EntryKind::Declaration) out += ';';
+            out.append(entries[i].text);
+        }
+    }
+
+    // rgb(r,g,b) or rgba(r,g,b,1) with integer channels, from item_[function]:
+    // appends its shortest form and returns the index after ')', or 0.
+    size_t append_rgb(std::string& out, size_t function, size_t end) const {
+        const std::string_view name = text(item_[function]);
+        if (!iequals(name, "rgb(") && !iequals(name, "rgba(")) return 0;
+        int channels[3];
+        size_t count = 0;
+        size_t i = function + 1;
+        while (true) {
+            while (i < end && !significant(item_[i])) ++i;
+            if (i >= end || item_[i].type != TokenType::Number || count == 4) return 0;
+            const std::string_view number = text(item_[i]);
+            if (count == 3) {
+                if (number != "1") return 0; // Opaque only
+            } else {
+                if (number.empty() || number.size() > 3 ||
+                    !std::all_of(number.begin(), number.end(), [](char c) { return has_class(c, CSS_DIGIT); })) {
+                    return 0;
+                }
+                channels[count] = std::stoi(std::string(number));
+                if (channels[count] > 255) return 0;
+            }
+            ++count;
+            ++i;
+            while (i < end && !significant(item_[i])) ++i;
+            if (i < end && item_[i].type == TokenType::CloseParen) break;
+            if (i >= end || item_[i].type != TokenType::Comma) return 0;
+            ++i;
+        }
+        if (count < 3) return 0;
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        char digits[6];
+        for (size_t c = 0; c < 3; ++c) {
+            digits[2 * c] = HEX_DIGITS[channels[c] >> 4];
+            digits[2 * c + 1] = HEX_DIGITS[channels[c] & 15];
+        }
+        append_compact_color(out, std::string_view(digits, 6));
+        return i + 1;
+    }
+
+    // Appends item_[begin, end) as mode has it: see space_is_significant and
+    // needs_separator for the whitespace, and the file comment for values.
+    void append_tokens(std::string& out, size_t begin, size_t end, Mode mode, bool drop_zero_units = true) {
+        Written last;
+        bool first = true;
+        bool space = false;
+        int function_depth = 0;
+        int bracket_depth = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const Token& token = item_[i];
+            if (!significant(token)) {
+                space = space || token.type == TokenType::Whitespace;
+                continue;
+            }
+            std::string_view written = text(token);
+            TokenType type = token.type;
+            scratch_.clear();
+            if (mode == Mode::Value || mode == Mode::KeyframeSelector) {
+                const bool numeric = type == TokenType::Number || type == TokenType::Percentage || type == TokenType::Dimension;
+                const size_t number_end = type == TokenType::Dimension ? token.unit
+                                        : type == TokenType::Percentage ? token.end - 1 : token.end;
+                if (numeric && append_compact_number(scratch_, css_.substr(token.begin, number_end - token.begin))) {
+                    if (type == TokenType::Dimension) {
+                        const std::string_view unit = css_.substr(token.unit, token.end - token.unit);
+                        if (mode == Mode::Value && scratch_ == "0" && drop_zero_units && function_depth == 0 &&
+                            is_length_unit(unit)) {
+                            type = TokenType::Number;
+                        } else {
+                            scratch_.append(unit);
+                        }
+                    } else if (type == TokenType::Percentage) {
+                        if (mode == Mode::KeyframeSelector && scratch_ == "100") {
+                            scratch_ = "to";
+                            type = TokenType::Ident;
+                        } else {
+                            scratch_ += '%';
+                        }
+                    }
+                    if (scratch_.size() < written.size()) ++stats_.numbers;
+                    written = scratch_;
+                } else if (mode == Mode::KeyframeSelector && type == TokenType::Ident && iequals(written, "from")) {
+                    written = "0%";
+                    type = TokenType::Percentage;
+                } else if (mode == Mode::Value && type == TokenType::Hash && append_compact_color(scratch_, written.substr(1))) {
+                    if (scratch_.size() < written.size()) ++stats_.colors;
+                    written = scratch_;
+                    type = scratch_[0] == '#' ? TokenType::Hash : TokenType::Ident;
+                } else if (mode == Mode::Value && type == TokenType::Function) {
+                    if (size_t after = append_rgb(scratch_, i, end)) {
+                        ++stats_.colors;
+                        written = scratch_;
+                        type = scratch_[0] == '#' ? TokenType::Hash : TokenType::Ident;
+                        i = after - 1;
+                    }
+                }
+            }
+            if (!first && ((space && space_is_significant(mode, last, type, written[0], bracket_depth)) ||
+                           needs_separator(last, type, written[0]))) {
+                out += ' ';
+            }
+            out.append(written);
+            if (type == TokenType::Function || type == TokenType::OpenParen) ++function_depth;
+            if (type == TokenType::CloseParen && function_depth > 0) --function_depth;
+            if (type == TokenType::OpenBracket) ++bracket_depth;
+            if (type == TokenType::CloseBracket && bracket_depth > 0) --bracket_depth;
+            last.type = type;
+            last.first = written[0];
+            first = false;
+            space = false;
+        }
+    }
+
+    std::string_view css_;
+    CssMinifyStats& stats_;
+    std::vector<Token> item_; // Tokens of the item being read
+    std::vector<Block> blocks_;
+    std::string scratch_; // Compacted token text
+};
+
+} // namespace
+
+std::string minify_css_with_stats(std::string_view css, CssMinifyStats& stats) {
+    return CssMinifier(css, stats).run();
+}
+
+std::string minify_css(const std::string& css) {
+    CssMinifyStats stats;
+    return minify_css_with_stats(css, stats);
+}
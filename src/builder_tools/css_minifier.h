@@ -0,0 +1,38 @@
+#ifndef CSS_MINIFIER_H
+#define CSS_MINIFIER_H
+
+#include "common_utils.h"
+
+// --- CSS Minifier ---
+// minify_css (declared in common_utils.h) tokenizes the stylesheet in one pass
+// (the CSS Syntax tokens: names, numbers, strings, url(), comments, ...) and
+// writes each item (a rule prelude, a declaration, an at-rule) from its tokens
+// as soon as it ends:
+//   whitespace   dropped, except one space where two tokens would otherwise
+//                run together or where it means something (the descendant
+//                combinator, between the parts of a value); comments go
+//   values       numbers lose redundant zeros (0.50 -> .5, 0px -> 0 outside
+//                functions), colors their redundant digits (#AABBCC -> #abc)
+//                or take a shorter name (#ff0000 -> red, rgb(0,0,128) -> navy);
+//                custom properties (--name) keep their value as written
+//   keyframes    from -> 0%, 100% -> to
+//   blocks       the last ';' and empty rules go; of a declaration repeated in
+//                a block, or a rule repeated among its siblings, only the last
+//                one stays (the earlier ones can never win the cascade), and
+//                adjacent rules with the same selector are merged
+// A block holding anything the minifier does not recognize (stray tokens,
+// a declaration without a colon) is copied without dropping or merging
+// anything, so it breaks the same way in the browser as the original.
+
+// Counts of what minify_css_with_stats compacted, for benchmarking.
+struct CssMinifyStats {
+    size_t numbers = 0;          // Numbers written shorter
+    size_t colors = 0;           // Colors written shorter
+    size_t duplicates = 0;       // Declarations and rules dropped as repeated
+    size_t merged_rules = 0;
+    size_t empty_rules = 0;
+};
+
+std::string minify_css_with_stats(std::string_view css, CssMinifyStats& stats);
+
+#endif // CSS_MINIFIER_H
@@ -0,0 +1,587 @@
+#include "dev_server.h"
+#include "dev_site.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char LIVE_RELOAD_PATH[] = "/__livereload";
+// Reloads the page if it, or a stylesheet/script it uses, is among the changed
+// URL paths ("*" = every page).
+const char LIVE_RELOAD_SCRIPT[] =
+    "<script>(function(){var s=new EventSource('/__livereload');s.onmessage=function(e){"
+    "var c=e.data.split(' '),p=location.pathname;if(p.slice(-1)=='/')p+='index.html';var u=[p];"
+    "document.querySelectorAll('link[href],script[src]').forEach(function(n){u.push(new URL(n.href||n.src,location.href).pathname)});"
+    "for(var i=0;i<c.length;i++)if(c[i]=='*'||u.indexOf(c[i])>=0){location.reload();return}}})();</script>";
+
+// Quiet time after the last inotify event before a batch is applied: editors
+// write a file in several steps (truncate, write, rename) within a few ms.
+constexpr auto WATCH_DEBOUNCE = std::chrono::milliseconds(8);
+constexpr int KEEPALIVE_INTERVAL_MS = 15000; // SSE comment so proxies keep the stream open
+constexpr size_t MAX_REQUEST_HEADER_BYTES = 16 * 1024;
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void request_stop(int) { stop_requested = 1; }
+
+double milliseconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool send_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+// --- Source Watcher ---
+
+class SourceWatcher {
+public:
+    ~SourceWatcher() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool start(const fs::path& root) {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ < 0) {
+            std::cerr << "Error: inotify_init1 failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        std::set<fs::path> ignored;
+        return add_tree(root, ignored);
+    }
+
+    int fd() const { return fd_; }
+
+    // Drains pending events into changed (paths relative to the site root).
+    void read_events(std::set<fs::path>& changed) {
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;) {
+            ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+            if (length <= 0) return; // EAGAIN: drained
+            for (char* cursor = buffer; cursor < buffer + length;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(cursor);
+                cursor += sizeof(struct inotify_event) + event->len;
+                auto dir = watched_dirs_.find(event->wd);
+                if (dir == watched_dirs_.end()) continue;
+                if (event->mask & IN_IGNORED) {
+                    watched_dirs_.erase(dir);
+                    continue;
+                }
+                if (event->len == 0) continue;
+                std::string name = event->name;
+                fs::path path = dir->second / name;
+                if (event->mask & IN_ISDIR) {
+                    // A directory that appears may already hold files (mkdir -p + cp, or a move).
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) add_tree(path, changed);
+                } else if (!is_editor_scratch_file(name)) {
+                    changed.insert(path);
+                }
+            }
+        }
+    }
+
+private:
+    static bool is_editor_scratch_file(const std::string& name) {
+        return name.empty() || name[0] == '.' || name.back() == '~' || name == "4913" ||
+               (name.size() > 4 && (name.compare(name.size() - 4, 4, ".swp") == 0 || name.compare(name.size() - 4, 4, ".swx") == 0));
+    }
+
+    // Watches dir and every directory below it; files already there count as changed.
+    bool add_tree(const fs::path& dir, std::set<fs::path>& changed) {
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+        int wd = inotify_add_watch(fd_, dir.c_str(), mask);
+        if (wd < 0) {
+            std::cerr << "Error: Cannot watch " << dir << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        watched_dirs_[wd] = dir;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            if (entry.is_directory(ec)) add_tree(entry.path(), changed);
+            else changed.insert(entry.path());
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+    std::map<int, fs::path> watched_dirs_;
+};
+
+// --- HTTP ---
+
+struct Client {
+    int fd = -1;
+    std::string request;
+    bool event_stream = false; // Subscribed to live reload; kept open
+};
+
+const char* content_type_for(const fs::path& path) {
+    static const std::map<std::string, const char*> types = {
+        {".html", "text/html; charset=utf-8"}, {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"}, {".json", "application/json"},
+        {".svg", "image/svg+xml"}, {".png", "image/png"}, {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"}, {".webp", "image/webp"}, {".ico", "image/x-icon"},
+        {".woff2", "font/woff2"}, {".txt", "text/plain; charset=utf-8"}, {".xml", "application/xml"},
+    };
+    auto it = types.find(path.extension().string());
+    return it != types.end() ? it->second : "application/octet-stream";
+}
+
+std::string lowercase(std::string text) {
+    for (char& c : text) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return text;
+}
+
+// Whether the Accept-Encoding header lists encoding (without q=0).
+bool accepts_encoding(const std::string& lowercase_headers, const std::string& encoding) {
+    size_t header = lowercase_headers.find("\naccept-encoding:");
+    if (header == std::string::npos) return false;
+    size_t end = lowercase_headers.find('\n', header + 1);
+    std::string value = lowercase_headers.substr(header + 17, end == std::string::npos ? std::string::npos : end - header - 17);
+    size_t start = 0;
+    while (start < value.size()) {
+        size_t comma = value.find(',', start);
+        std::string token = value.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma == std::string::npos ? value.size() : comma + 1;
+        token.erase(0, token.find_first_not_of(" \t"));
+        const size_t length = encoding.size();
+        if (token.compare(0, length, encoding) != 0 ||
+            (token.size() > length && token[length] != ';' && token[length] != ' ' && token[length] != '\r')) {
+            continue;
+        }
+        return token.find("q=0") == std::string::npos || token.find("q=0.") != std::string::npos;
+    }
+    return false;
+}
+
+std::string response_head(const char* status, const char* content_type, size_t content_length, const char* extra_headers = "") {
+    return std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + content_type +
+           "\r\nContent-Length: " + std::to_string(content_length) +
+           "\r\nCache-Control: no-cache\r\nConnection: close\r\n" + extra_headers + "\r\n";
+}
+
+void send_error(int fd, const char* status, bool head_only) {
+    std::string body = std::string(status) + "\n";
+    std::string response = response_head(status, "text/plain; charset=utf-8", body.size());
+    if (!head_only) response += body;
+    send_all(fd, response.data(), response.size());
+}
+
+std::string compress_for_response(const std::string& content) {
+    CompressionSettings settings{5, BROTLI_DEFAULT_WINDOW}; // Per request: favor speed
+    std::string compressed(BrotliEncoderMaxCompressedSize(content.size()), '\0');
+    size_t compressed_size = compressed.size();
+    if (!BrotliEncoderCompress(settings.quality, settings.lgwin, BROTLI_MODE_TEXT, content.size(),
+                               reinterpret_cast<const uint8_t*>(content.data()), &compressed_size,
+                               reinterpret_cast<uint8_t*>(&compressed[0]))) {
+        return {};
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+// Answers one complete request. Returns true if the connection became an event stream.
+bool handle_request(Client& client) {
+    size_t line_end = client.request.find("\r\n");
+    std::string request_line = client.request.substr(0, line_end);
+    size_t first_space = request_line.find(' ');
+    size_t second_space = request_line.find(' ', first_space + 1);
+    if (first_space == std::string::npos || second_space == std::string::npos) {
+        send_error(client.fd, "400 Bad Request", false);
+        return false;
+    }
+    std::string method = request_line.substr(0, first_space);
+    std::string target = request_line.substr(first_space + 1, second_space - first_space - 1);
+    bool head_only = method == "HEAD";
+    if (method != "GET" && !head_only) {
+        send_error(client.fd, "405 Method Not Allowed", false);
+        return false;
+    }
+    target = target.substr(0, target.find_first_of("?#"));
+
+    if (target == LIVE_RELOAD_PATH && !head_only) {
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                           "Connection: keep-alive\r\n\r\nretry: 500\n\n";
+        return send_all(client.fd, head.data(), head.size());
+    }
+
+    std::string decoded;
+    if (!percent_decode(target, decoded) || decoded.empty() || decoded[0] != '/') {
+        send_error(client.fd, "400 Bad Request", head_only);
+        return false;
+    }
+    fs::path file_path;
+    if (!public_file_path(decoded, file_path)) {
+        send_error(client.fd, "403 Forbidden", head_only);
+        return false;
+    }
+    std::error_code ec;
+    if (fs::is_directory(file_path, ec)) {
+        if (decoded.back() != '/') {
+            // Relative links in the page only resolve correctly below the directory.
+            std::string location = "Location: " + target + "/\r\n";
+            std::string response = response_head("301 Moved Permanently", "text/plain", 0, location.c_str());
+            send_all(client.fd, response.data(), response.size());
+            return false;
+        }
+        file_path /= "index.html";
+    }
+    if (!fs::is_regular_file(file_path, ec)) {
+        send_error(client.fd, "404 Not Found", head_only);
+        return false;
+    }
+
+    const std::string headers = lowercase(client.request.substr(line_end));
+    std::string body;
+    std::string extra_headers = "Vary: Accept-Encoding\r\n";
+    if (file_path.extension() == ".html") {
+        body = read_file(file_path);
+        size_t body_end = body.rfind("</body>");
+        body.insert(body_end == std::string::npos ? body.size() : body_end, LIVE_RELOAD_SCRIPT);
+        if (accepts_encoding(headers, "br")) {
+            std::string compressed = compress_for_response(body);
+            if (!compressed.empty()) {
+                body = std::move(compressed);
+                extra_headers += "Content-Encoding: br\r\n";
+            }
+        }
+    } else {
+        // The first precompressed sibling the client accepts, in available_codecs() order.
+        bool compressed = false;
+        for (Codec codec : available_codecs()) {
+            fs::path compressed_path = file_path.string() + codec_extension(codec);
+            if (accepts_encoding(headers, codec_name(codec)) && fs::is_regular_file(compressed_path, ec)) {
+                body = read_file(compressed_path);
+                extra_headers += std::string("Content-Encoding: ") + codec_name(codec) + "\r\n";
+                compressed = true;
+                break;
+            }
+        }
+        if (!compressed) body = read_file(file_path);
+    }
+    std::string response = response_head("200 OK", content_type_for(file_path), body.size(), extra_headers.c_str());
+    if (!head_only) response += body;
+    send_all(client.fd, response.data(), response.size());
+    return false;
+}
+
+int open_listen_socket(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // Local previews only
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, 64) < 0) {
+        std::cerr << "Error: Cannot listen on 127.0.0.1:" << port << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+std::string join_urls(const std::vector<std::string>& urls) {
+    std::set<std::string> unique(urls.begin(), urls.end());
+    std::string joined;
+    for (const auto& url : unique) {
+        if (!joined.empty()) joined += ' ';
+        joined += url;
+    }
+    return joined;
+}
+
+// --- Deferred Work ---
+// Runs DevSite::finish_pending_work on its own thread and hands the changed
+// URLs back to the event loop through an eventfd.
+class PendingWorker {
+public:
+    explicit PendingWorker(DevSite& site) : site_(site) {
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        thread_ = std::thread([this] { run(); });
+    }
+    ~PendingWorker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+        if (wake_fd_ >= 0) ::close(wake_fd_);
+    }
+
+    void notify() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            requested_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    int fd() const { return wake_fd_; }
+
+    std::vector<std::string> take_changed_urls() {
+        uint64_t count;
+        [[maybe_unused]] ssize_t ignored = ::read(wake_fd_, &count, sizeof(count));
+        std::lock_guard<std::mutex> lock(mutex_);
+        return std::exchange(changed_urls_, {});
+    }
+
+private:
+    void run() {
+        // Idle priority: an edit arriving meanwhile must not wait for CPU
+        // behind a search index update (notably on a single core).
+        sched_param idle{};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &idle);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            cv_.wait(lock, [this] { return requested_ || stopping_; });
+            if (stopping_) return;
+            requested_ = false;
+            lock.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::string> urls;
+            bool ok = site_.finish_pending_work(urls);
+            std::cout << (ok ? "✅" : "❌") << " Site pages and search index updated in "
+                      << static_cast<long>(milliseconds_since(start)) << " ms." << std::endl;
+
+            lock.lock();
+            changed_urls_.insert(changed_urls_.end(), urls.begin(), urls.end());
+            uint64_t one = 1;
+            [[maybe_unused]] ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+        }
+    }
+
+    DevSite& site_;
+    int wake_fd_ = -1;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool requested_ = false;
+    bool stopping_ = false;
+    std::vector<std::string> changed_urls_;
+};
+
+} // namespace
+
+// --- Request Paths ---
+
+bool percent_decode(const std::string& in, std::string& out) {
+    out.clear();
+    for (size_t i = 0; i < in.size(); ++i) {
+        if (in[i] != '%') {
+            out += in[i];
+            continue;
+        }
+        if (i + 2 >= in.size() || !std::isxdigit(static_cast<unsigned char>(in[i + 1])) ||
+            !std::isxdigit(static_cast<unsigned char>(in[i + 2]))) {
+            return false;
+        }
+        char decoded = static_cast<char>(std::stoi(in.substr(i + 1, 2), nullptr, 16));
+        if (decoded == '\0') return false;
+        out += decoded;
+        i += 2;
+    }
+    return true;
+}
+
+bool public_file_path(const std::string& decoded, fs::path& file_path) {
+    if (decoded.empty() || decoded[0] != '/') return false;
+    // "//etc/passwd" (or "/%2Fetc/passwd") leaves an absolute path, which
+    // operator/ would put in place of PUBLIC_DIR.
+    fs::path relative = fs::path(decoded.substr(1)).lexically_normal();
+    if (relative.has_root_path() || (!relative.empty() && *relative.begin() == "..")) return false;
+    file_path = PUBLIC_DIR / relative;
+    return true;
+}
+
+// --- Event Loop ---
+
+bool serve_site(const ServeOptions& options) {
+    if (!build_site(options.build)) return false;
+
+    int listen_fd = open_listen_socket(options.port);
+    if (listen_fd < 0) return false;
+
+    DevSite site(options.build.archive_page_size, options.build.precompress);
+    SourceWatcher watcher;
+    std::unique_ptr<PendingWorker> worker;
+    if (options.watch) {
+        auto start = std::chrono::steady_clock::now();
+        if (!site.load() || !watcher.start(POSTS_SOURCE_DIR.parent_path())) {
+            ::close(listen_fd);
+            return false;
+        }
+        worker = std::make_unique<PendingWorker>(site);
+        std::cout << "👀 Watching " << POSTS_SOURCE_DIR.parent_path().string() << " (" << site.post_count()
+                  << " posts resident, loaded in " << static_cast<long>(milliseconds_since(start)) << " ms)" << std::endl;
+    }
+    std::cout << "🌐 Serving " << PUBLIC_DIR.string() << "/ at http://127.0.0.1:" << options.port
+              << "/ (Ctrl-C to stop)" << std::endl;
+
+    struct sigaction action {};
+    action.sa_handler = request_stop; // No SA_RESTART: poll() returns EINTR
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    std::vector<Client> clients;
+    std::set<fs::path> changed_batch;
+    std::chrono::steady_clock::time_point batch_deadline;
+    std::chrono::steady_clock::time_point batch_first_event;
+
+    auto broadcast = [&](const std::vector<std::string>& urls) {
+        if (urls.empty()) return;
+        std::string message = "data: " + join_urls(urls) + "\n\n";
+        for (auto& client : clients) {
+            if (client.event_stream && !send_all(client.fd, message.data(), message.size())) {
+                ::close(client.fd);
+                client.fd = -1;
+            }
+        }
+    };
+
+    bool ok = true;
+    while (!stop_requested) {
+        std::vector<pollfd> fds;
+        fds.push_back({listen_fd, POLLIN, 0});
+        if (options.watch) {
+            fds.push_back({watcher.fd(), POLLIN, 0});
+            fds.push_back({worker->fd(), POLLIN, 0});
+        }
+        const size_t first_client = fds.size();
+        for (const auto& client : clients) fds.push_back({client.fd, POLLIN, 0});
+
+        int timeout_ms = KEEPALIVE_INTERVAL_MS;
+        if (!changed_batch.empty()) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(batch_deadline - std::chrono::steady_clock::now());
+            timeout_ms = static_cast<int>(std::max<long long>(0, remaining.count() + 1));
+        }
+        int ready = ::poll(fds.data(), fds.size(), timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: poll failed: " << std::strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        if (ready == 0 && changed_batch.empty()) {
+            static const char keepalive[] = ": ping\n\n";
+            for (auto& client : clients) {
+                if (client.event_stream && !send_all(client.fd, keepalive, sizeof(keepalive) - 1)) {
+                    ::close(client.fd);
+                    client.fd = -1;
+                }
+            }
+        }
+
+        // Source changes: collect, then apply once the burst is over.
+        if (options.watch && (fds[1].revents & POLLIN)) {
+            if (changed_batch.empty()) batch_first_event = std::chrono::steady_clock::now();
+            watcher.read_events(changed_batch);
+            batch_deadline = std::chrono::steady_clock::now() + WATCH_DEBOUNCE;
+        }
+        if (!changed_batch.empty() && std::chrono::steady_clock::now() >= batch_deadline) {
+            std::vector<fs::path> changed(changed_batch.begin(), changed_batch.end());
+            changed_batch.clear();
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::string> urls;
+            bool applied = site.apply_changes(changed, urls);
+            broadcast(urls);
+            if (!urls.empty() || !applied) {
+                std::cout << (applied ? "🔁 " : "❌ ") << join_urls(urls) << std::fixed << std::setprecision(1)
+                          << " rebuilt in " << milliseconds_since(start) << " ms (" << milliseconds_since(batch_first_event)
+                          << " ms after the first change), reload sent." << std::endl;
+                std::cout.unsetf(std::ios::floatfield);
+            }
+            if (site.has_pending_work()) worker->notify();
+        }
+        if (options.watch && (fds[2].revents & POLLIN)) broadcast(worker->take_changed_urls());
+
+        // Requests on existing connections.
+        for (size_t i = first_client; i < fds.size(); ++i) {
+            if (!fds[i].revents) continue;
+            Client& client = clients[i - first_client];
+            if (client.fd < 0) continue;
+            char buffer[4096];
+            ssize_t received = ::recv(client.fd, buffer, sizeof(buffer), 0);
+            if (received <= 0 || client.event_stream) {
+                // Closed (an event stream sends nothing, so any input there ends it too).
+                if (received < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                ::close(client.fd);
+                client.fd = -1;
+                continue;
+            }
+            client.request.append(buffer, static_cast<size_t>(received));
+            if (client.request.find("\r\n\r\n") == std::string::npos) {
+                if (client.request.size() > MAX_REQUEST_HEADER_BYTES) {
+                    send_error(client.fd, "431 Request Header Fields Too Large", false);
+                    ::close(client.fd);
+                    client.fd = -1;
+                }
+                continue;
+            }
+            int flags = fcntl(client.fd, F_GETFL);
+            fcntl(client.fd, F_SETFL, flags & ~O_NONBLOCK); // Responses are sent in one go
+            client.event_stream = handle_request(client);
+            if (!client.event_stream) {
+                ::close(client.fd);
+                client.fd = -1;
+            } else {
+                fcntl(client.fd, F_SETFL, flags);
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.fd < 0; }),
+                      clients.end());
+
+        // New connections.
+        if (fds[0].revents & POLLIN) {
+            for (;;) {
+                int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0) break;
+                timeval send_timeout{2, 0}; // A stalled browser must not hang the loop
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+                Client client;
+                client.fd = fd;
+                clients.push_back(std::move(client));
+            }
+        }
+    }
+
+    for (auto& client : clients) ::close(client.fd);
+    ::close(listen_fd);
+    worker.reset(); // Finishes an update in progress
+    std::cout << "👋 Server stopped." << std::endl;
+    return flush_output_files() && ok;
+}
@@ -0,0 +1,41 @@
+#ifndef DEV_SERVER_H
+#define DEV_SERVER_H
+
+#include "pipeline.h"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// --- Dev Server ---
+// `blog_builder serve [--watch]`: builds the site (dev compression unless
+// --release), then serves public/ over HTTP on localhost. Responses use a
+// precompressed sibling (.br, else .zst, else .gz) when the request's
+// Accept-Encoding allows it.
+// HTML pages get a small live-reload script injected, so they are compressed
+// on the fly instead: the script opens an EventSource on /__livereload.
+//
+// With --watch, src/blog_content is watched with inotify. Edits are applied to
+// a resident DevSite (see dev_site.h) after a short debounce. The edited
+// post's page is rewritten, then every connected browser is told which URLs
+// changed and reloads if it shows (or uses) one of them. Index and archive
+// pages and the search index follow on a background thread.
+struct ServeOptions {
+    BuildOptions build;
+    bool watch = false;
+    uint16_t port = 8000;
+};
+
+// --- Request Paths ---
+
+// Decodes %XX escapes; returns false on malformed input or a NUL byte.
+bool percent_decode(const std::string& in, std::string& out);
+
+// Maps a decoded request path ("/posts/a.html") to the file it names below
+// PUBLIC_DIR; false if the path is not absolute or would leave PUBLIC_DIR
+// ("/../x", "//etc/passwd").
+bool public_file_path(const std::string& decoded, std::filesystem::path& file_path);
+
+// Returns when interrupted (SIGINT/SIGTERM); false if the server could not start.
+bool serve_site(const ServeOptions& options);
+
+#endif // DEV_SERVER_H
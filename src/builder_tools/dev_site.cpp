@@ -0,0 +1,290 @@
+#include "dev_site.h"
+#include "search_index.h"
+#include "task_graph.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+static std::string url_of(const fs::path& output_path) {
+    return "/" + output_path.lexically_relative(PUBLIC_DIR).generic_string();
+}
+
+// Whether path is dir itself or below it (both relative to the site root).
+static bool is_under(const fs::path& path, const fs::path& dir) {
+    auto mismatch = std::mismatch(dir.begin(), dir.end(), path.begin(), path.end());
+    return mismatch.first == dir.end();
+}
+
+static bool same_listing(const PostMetadata& a, const PostMetadata& b) {
+    return a.id == b.id && a.title == b.title && a.date == b.date && a.permalink == b.permalink && a.excerpt == b.excerpt;
+}
+
+// The file and whichever precompressed siblings it had.
+static void remove_output(const fs::path& output_path) {
+    std::error_code ec;
+    fs::remove(output_path, ec);
+    for (Codec codec : {Codec::Brotli, Codec::Zstd, Codec::Gzip}) fs::remove(output_path.string() + codec_extension(codec), ec);
+}
+
+// --- Loading ---
+
+bool DevSite::load() {
+    auto templates = std::make_shared<PageTemplates>();
+    if (!load_page_templates(*templates)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    templates_ = std::move(templates);
+    posts_.clear();
+    search_index.clear();
+    for (const auto& md_file_path : list_markdown_files(POSTS_SOURCE_DIR)) {
+        ResidentPost resident;
+        MappedFile markdown_source;
+        if (!read_post_source(md_file_path, resident.post, markdown_source) || resident.post.draft) continue;
+        resident.content_hash = hash_content(markdown_source.view());
+        render_post_body(resident.post, markdown_source.view());
+        SearchTermCounts counts;
+        index_post_for_search(resident.post, &counts);
+        related_.set_terms(resident.post.id, resident.content_hash, counts);
+        posts_.emplace(md_file_path.filename().string(), std::move(resident));
+    }
+    update_related_posts(); // The lists build_site put on the pages
+
+    // The segments the last full build wrote, which edits add to.
+    search_segments_.load(SEARCH_SEGMENTS_PATH, search_index.tokenizer_options());
+    // The archive pages build_site just wrote, so the first update only
+    // rewrites the ones that change.
+    archive_pages_.clear();
+    std::vector<PostMetadata> listing;
+    for (const auto& entry : posts_) {
+        PostMetadata post = entry.second.post;
+        post.html_body.clear();
+        listing.push_back(std::move(post));
+    }
+    for (const auto& page : plan_archive_pages(sorted_by_date(listing), archive_page_size_)) {
+        archive_pages_[page.output_path] = hash_content(render_archive_page(*templates_, page));
+    }
+    site_pages_pending_ = false;
+    search_pending_ = false;
+    return true;
+}
+
+size_t DevSite::post_count() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return posts_.size();
+}
+
+// --- Immediate Updates ---
+
+bool DevSite::apply_changes(const std::vector<fs::path>& changed, std::vector<std::string>& changed_urls) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool ok = true;
+    bool templates_changed = false;
+    for (const auto& path : changed) {
+        if (is_under(path, POSTS_SOURCE_DIR)) {
+            if (path.extension() == ".md") ok = apply_post_change(path, changed_urls) && ok;
+        } else if (is_under(path, TEMPLATES_DIR)) {
+            templates_changed = true; // Once per batch, after every post is current
+        } else if (is_under(path, STATIC_SOURCE_DIR)) {
+            ok = apply_static_change(path, changed_urls) && ok;
+        }
+    }
+    if (templates_changed) ok = apply_template_change(changed_urls) && ok;
+    ok = flush_output_files() && ok;
+    // One job: the next edit, not this one, is what the other cores are for.
+    ok = precompress_files(written_, precompress_, 1) && ok;
+    written_.clear();
+    return ok;
+}
+
+bool DevSite::write_post_page(const ResidentPost& resident, std::vector<std::string>& changed_urls,
+                              std::vector<fs::path>& outputs) {
+    fs::path output_path = post_output_path(resident.post);
+    changed_urls.push_back(url_of(output_path));
+    outputs.push_back(output_path);
+    return write_page(output_path, render_post_page(*templates_, resident.post, resident.related_html));
+}
+
+bool DevSite::apply_post_change(const fs::path& path, std::vector<std::string>& changed_urls) {
+    const std::string file_name = path.filename().string();
+    auto existing = posts_.find(file_name);
+
+    ResidentPost resident;
+    MappedFile markdown_source;
+    std::error_code ec;
+    bool published = fs::is_regular_file(path, ec) && read_post_source(path, resident.post, markdown_source) &&
+                     !resident.post.draft;
+    if (!published) {
+        // Deleted, renamed away or turned into a draft: drop the post and its page.
+        if (existing == posts_.end()) return true;
+        const PostMetadata& post = existing->second.post;
+        remove_output(post_output_path(post));
+        changed_urls.push_back(url_of(post_output_path(post)));
+        search_index.remove_document(post.id);
+        posts_.erase(existing);
+        site_pages_pending_ = search_pending_ = true;
+        return true;
+    }
+
+    resident.content_hash = hash_content(markdown_source.view());
+    if (existing != posts_.end() && existing->second.content_hash == resident.content_hash) return true; // Touched, not changed
+    render_post_body(resident.post, markdown_source.view());
+    if (existing != posts_.end()) resident.related_html = existing->second.related_html; // Until finish_pending_work
+    if (!write_post_page(resident, changed_urls, written_)) return false;
+
+    if (existing == posts_.end() || !same_listing(existing->second.post, resident.post)) site_pages_pending_ = true;
+    if (existing != posts_.end()) search_index.remove_document(existing->second.post.id);
+    SearchTermCounts counts;
+    index_post_for_search(resident.post, &counts);
+    related_.set_terms(resident.post.id, resident.content_hash, counts);
+    search_pending_ = true;
+    posts_[file_name] = std::move(resident);
+    return true;
+}
+
+bool DevSite::apply_template_change(std::vector<std::string>& changed_urls) {
+    auto templates = std::make_shared<PageTemplates>();
+    if (!load_page_templates(*templates)) return false; // Keep serving the last good templates
+    bool post_template_changed = templates->post.source_hash() != templates_->post.source_hash();
+    if (templates->index.source_hash() != templates_->index.source_hash() ||
+        templates->archive.source_hash() != templates_->archive.source_hash()) {
+        site_pages_pending_ = true;
+    }
+    templates_ = std::move(templates);
+    if (!post_template_changed) return true;
+
+    std::vector<std::string> post_urls;
+    for (const auto& entry : posts_) {
+        if (!write_post_page(entry.second, post_urls, written_)) return false;
+    }
+    changed_urls.push_back("*");
+    return true;
+}
+
+bool DevSite::apply_static_change(const fs::path& path, std::vector<std::string>& changed_urls) {
+    // The dev server never fingerprints: pages keep pointing at the same names.
+    fs::path output_path = static_asset_output_path(path);
+    changed_urls.push_back(url_of(output_path));
+    StaticAsset asset;
+    std::error_code ec;
+    if (!fs::is_regular_file(path, ec) || !load_static_asset(path, false, asset)) {
+        remove_output(output_path);
+        return true;
+    }
+    return write_static_asset(asset, written_);
+}
+
+// --- Deferred Updates ---
+
+bool DevSite::has_pending_work() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return site_pages_pending_ || search_pending_;
+}
+
+bool DevSite::finish_pending_work(std::vector<std::string>& changed_urls) {
+    // Snapshot under the lock (metadata only, no bodies), then work without it.
+    std::vector<PostMetadata> listing;
+    std::vector<SearchSegments::Post> search_posts;
+    std::shared_ptr<const PageTemplates> templates;
+    bool site_pages_needed;
+    bool search_needed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        site_pages_needed = std::exchange(site_pages_pending_, false);
+        search_needed = std::exchange(search_pending_, false);
+        templates = templates_;
+        listing.reserve(posts_.size());
+        for (const auto& entry : posts_) {
+            PostMetadata post = entry.second.post;
+            post.html_body.clear();
+            listing.push_back(std::move(post));
+            if (search_needed) search_posts.push_back({entry.second.post.id, entry.second.content_hash});
+        }
+    }
+    std::vector<const PostMetadata*> sorted_posts = sorted_by_date(listing);
+
+    bool ok = true;
+    std::vector<fs::path> written;
+    if (search_needed) {
+        // Every content change can change any post's list (document frequencies
+        // move with it); usually only a few pages actually do. Rewritten under
+        // the lock, like apply_changes, so an edit never races its own page.
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const ResidentPost* resident : update_related_posts()) {
+            ok = write_post_page(*resident, changed_urls, written) && ok;
+        }
+    }
+    if (site_pages_needed) {
+        fs::path index_path = PUBLIC_DIR / "index.html";
+        ok = write_page(index_path, render_index_page(*templates, sorted_posts)) && ok;
+        changed_urls.push_back(url_of(index_path));
+        written.push_back(index_path);
+        ok = write_archive_pages(*templates, sorted_posts, changed_urls, written) && ok;
+    }
+    if (search_needed) {
+        // Not reported: every page loads search-index.js, and reloading them all
+        // for a search update would be noise. The next navigation picks it up.
+        // A post edited again meanwhile may be encoded in its newer version (or
+        // not at all, if deleted): the next update tombstones and re-indexes it.
+        std::vector<fs::path> outputs;
+        search_segments_.plan(search_posts);
+        ok = write_search_index(sorted_posts, search_segments_, outputs, &written) && ok;
+        for (const auto& name : search_segments_.dropped_files()) {
+            fs::path dropped = PUBLIC_DIR / SEARCH_SHARD_DIR / name;
+            remove_output(dropped);
+            std::error_code ec;
+            fs::remove(dropped.parent_path(), ec); // Once empty
+        }
+        ok = search_segments_.save(SEARCH_SEGMENTS_PATH, search_index.tokenizer_options()) && ok;
+    }
+    ok = flush_output_files() && ok;
+    return precompress_files(written, precompress_, 1) && ok;
+}
+
+std::vector<const DevSite::ResidentPost*> DevSite::update_related_posts() {
+    std::vector<const PostMetadata*> sorted_posts;
+    std::map<const PostMetadata*, ResidentPost*> residents;
+    for (auto& entry : posts_) {
+        sorted_posts.push_back(&entry.second.post);
+        residents[&entry.second.post] = &entry.second;
+    }
+    sort_by_date(sorted_posts);
+    related_.compute(sorted_posts, default_job_count());
+
+    std::vector<const ResidentPost*> changed;
+    for (size_t position = 0; position < sorted_posts.size(); ++position) {
+        ResidentPost& resident = *residents[sorted_posts[position]];
+        std::string html = related_.html(position);
+        if (html == resident.related_html) continue;
+        resident.related_html = std::move(html);
+        changed.push_back(&resident);
+    }
+    return changed;
+}
+
+bool DevSite::write_archive_pages(const PageTemplates& templates, const std::vector<const PostMetadata*>& sorted_posts,
+                                  std::vector<std::string>& changed_urls, std::vector<fs::path>& outputs) {
+    // One new post shifts every "all posts" page, but a year or month page
+    // only changes with its own posts.
+    bool ok = true;
+    std::map<fs::path, std::string> written;
+    for (const auto& page : plan_archive_pages(sorted_posts, archive_page_size_)) {
+        std::string rendered = render_archive_page(templates, page);
+        std::string rendered_hash = hash_content(rendered);
+        auto previous = archive_pages_.find(page.output_path);
+        if (previous == archive_pages_.end() || previous->second != rendered_hash) {
+            ok = write_archive_page(page, rendered) && ok;
+            changed_urls.push_back(url_of(page.output_path));
+            outputs.push_back(page.output_path);
+        }
+        written[page.output_path] = std::move(rendered_hash);
+    }
+    for (const auto& previous : archive_pages_) {
+        if (written.count(previous.first)) continue;
+        remove_output(previous.first);
+        changed_urls.push_back(url_of(previous.first));
+    }
+    archive_pages_ = std::move(written);
+    return ok;
+}
@@ -0,0 +1,80 @@
+#ifndef DEV_SITE_H
+#define DEV_SITE_H
+
+#include "archive_pages.h"
+#include "precompress.h"
+#include "related_posts.h"
+#include "search_segments.h"
+#include <memory>
+
+// --- Resident Dev Site ---
+// What `blog_builder serve --watch` keeps in memory between edits: every
+// parsed post (metadata + HTML body), the compiled templates and the search
+// index. A change is applied in two steps:
+//   apply_changes()        rewrites what the edited file itself produces (its
+//                          post page or static asset) and updates the resident
+//                          state. Milliseconds; the browser is told right after.
+//   finish_pending_work()  regenerates what depends on every post (index and
+//                          archive pages, search index) from a snapshot of that
+//                          state, so the server can run it on another thread
+//                          while the next edit is applied. Archive pages whose
+//                          content did not change are not rewritten; the search
+//                          index gets a small segment for the edited posts
+//                          (search_segments.h). Related posts are found again
+//                          and the post pages whose list changed rewritten; an
+//                          edited post keeps its old list until then.
+// Each step precompresses what it wrote (precompress.h) before returning.
+// Both report the URL paths they rewrote ("/p/x.html", "/index.html"; "*" for
+// every page) so the live-reload client can decide whether to refresh.
+class DevSite {
+public:
+    explicit DevSite(size_t archive_page_size = DEFAULT_ARCHIVE_PAGE_SIZE, PrecompressOptions precompress = {})
+        : archive_page_size_(archive_page_size), precompress_(std::move(precompress)) {}
+
+    // Loads the resident state from the sources. public/ is expected to be up
+    // to date already (build_site first).
+    bool load();
+
+    // changed: paths (as given to the watcher) of files under
+    // src/blog_content that were created, modified or deleted.
+    bool apply_changes(const std::vector<fs::path>& changed, std::vector<std::string>& changed_urls);
+
+    bool has_pending_work();
+    bool finish_pending_work(std::vector<std::string>& changed_urls);
+
+    size_t post_count();
+
+private:
+    struct ResidentPost {
+        PostMetadata post;
+        std::string content_hash;
+        std::string related_html; // On its page (RelatedPosts::html)
+    };
+
+    bool apply_post_change(const fs::path& path, std::vector<std::string>& changed_urls);
+    bool apply_template_change(std::vector<std::string>& changed_urls);
+    bool apply_static_change(const fs::path& path, std::vector<std::string>& changed_urls);
+    bool write_post_page(const ResidentPost& resident, std::vector<std::string>& changed_urls,
+                         std::vector<fs::path>& outputs);
+    // Finds the related posts of every post again (under the lock); returns
+    // the posts whose list changed, their related_html already updated.
+    std::vector<const ResidentPost*> update_related_posts();
+    bool write_archive_pages(const PageTemplates& templates, const std::vector<const PostMetadata*>& sorted_posts,
+                             std::vector<std::string>& changed_urls, std::vector<fs::path>& outputs);
+
+    const size_t archive_page_size_;
+    const PrecompressOptions precompress_;
+
+    std::mutex mutex_; // Guards everything below but the pending work state (last two)
+    std::map<std::string, ResidentPost> posts_; // By file name
+    std::shared_ptr<const PageTemplates> templates_;
+    bool site_pages_pending_ = false;
+    bool search_pending_ = false;
+    std::vector<fs::path> written_; // By the apply_changes in progress
+
+    RelatedPosts related_; // Term counts of every post; neighbours from the last update
+    SearchSegments search_segments_; // Shared with build_site through SEARCH_SEGMENTS_PATH
+    std::map<fs::path, std::string> archive_pages_; // Output path -> hash of the rendered page on disk
+};
+
+#endif // DEV_SITE_H
@@ -0,0 +1,645 @@
+#include "file_io.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/fs.h> // FICLONE
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+// Raw syscalls (no liburing dependency). Opcodes are enums, so headers are
+// assumed to be 5.11+ (IORING_OP_RENAMEAT) when IORING_FEAT_NATIVE_WORKERS
+// (added in 5.12) is defined; the kernel itself is probed at run time.
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register) && \
+    defined(IORING_FEAT_NATIVE_WORKERS)
+#define FILE_IO_IO_URING 1
+#else
+#define FILE_IO_IO_URING 0
+#endif
+
+// --- MappedFile ---
+
+MappedFile::~MappedFile() {
+    reset();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mapping_(std::exchange(other.mapping_, nullptr)),
+      mapping_size_(std::exchange(other.mapping_size_, 0)),
+      buffer_(std::move(other.buffer_)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+        buffer_ = std::move(other.buffer_);
+    }
+    return *this;
+}
+
+void MappedFile::reset() {
+    if (mapping_) ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    std::string().swap(buffer_);
+}
+
+bool MappedFile::open(const fs::path& path) {
+    reset();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open file " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        std::cerr << "Error: Could not stat file " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+    const bool regular = S_ISREG(info.st_mode);
+    const size_t file_size = regular ? static_cast<size_t>(info.st_size) : 0;
+
+    if (file_size >= MAPPED_FILE_MIN_SIZE) {
+        void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            ::close(fd);
+            mapping_ = mapping;
+            mapping_size_ = file_size;
+            return true;
+        }
+        // Filesystems without mmap support fall through to read().
+    }
+
+    // One byte of slack: a regular file that returns less than asked for is at
+    // its end, so a single read() suffices. Other files are read until EOF.
+    buffer_.resize(file_size + 1);
+    size_t length = 0;
+    bool ok = true;
+    while (true) {
+        if (length == buffer_.size()) buffer_.resize(buffer_.size() * 2 + 4096);
+        ssize_t count = ::read(fd, &buffer_[length], buffer_.size() - length);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: Could not read file " << path << ": " << std::strerror(errno) << std::endl;
+            ok = false;
+            break;
+        }
+        if (count == 0) break;
+        length += static_cast<size_t>(count);
+        if (regular && length < buffer_.size()) break;
+    }
+    ::close(fd);
+    buffer_.resize(ok ? length : 0);
+    return ok;
+}
+
+// --- File Copies ---
+
+const char* copy_method_name(CopyMethod method) {
+    switch (method) {
+        case CopyMethod::Reflink: return "reflink";
+        case CopyMethod::CopyFileRange: return "copy_file_range";
+        case CopyMethod::ReadWrite: return "read/write";
+    }
+    return "?";
+}
+
+// Errors meaning "this way of copying is not available here", after which the
+// next one is tried (rather than the copy failing).
+static bool copy_unsupported(int error) {
+    return error == EOPNOTSUPP || error == ENOTTY || error == ENOSYS || error == EXDEV || error == EINVAL ||
+           error == EBADF || error == EPERM;
+}
+
+static bool copy_with_read_write(int source_fd, int destination_fd) {
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t count = ::read(source_fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) return count == 0;
+        for (ssize_t written = 0; written < count;) {
+            ssize_t result = ::write(destination_fd, buffer + written, static_cast<size_t>(count - written));
+            if (result < 0 && errno == EINTR) continue;
+            if (result < 0) return false;
+            written += result;
+        }
+    }
+}
+
+// Copies size bytes from the current offsets. Sets unsupported (with nothing
+// copied) if the kernel or filesystem cannot do it.
+static bool copy_in_kernel(int source_fd, int destination_fd, size_t size, bool& unsupported) {
+    unsupported = false;
+#if defined(__linux__) && defined(__NR_copy_file_range)
+    size_t copied = 0;
+    while (copied < size) {
+        long result = ::syscall(__NR_copy_file_range, source_fd, nullptr, destination_fd, nullptr, size - copied, 0u);
+        if (result < 0 && errno == EINTR) continue;
+        if (result < 0) {
+            unsupported = copied == 0 && copy_unsupported(errno);
+            return false;
+        }
+        if (result == 0) break; // Source shrank underneath us
+        copied += static_cast<size_t>(result);
+    }
+    return true;
+#else
+    (void)source_fd;
+    (void)destination_fd;
+    (void)size;
+    unsupported = true;
+    return false;
+#endif
+}
+
+bool clone_file(const fs::path& source, const fs::path& destination, CopyMethod* method) {
+    int source_fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0) {
+        std::cerr << "Error: Could not open file " << source << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (::fstat(source_fd, &info) != 0) {
+        std::cerr << "Error: Could not stat file " << source << ": " << std::strerror(errno) << std::endl;
+        ::close(source_fd);
+        return false;
+    }
+    fs::path temp_path = destination;
+    temp_path += ".tmp-" + std::to_string(::getpid());
+    int destination_fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (destination_fd < 0) {
+        std::cerr << "Error: Could not create file " << destination << ": " << std::strerror(errno) << std::endl;
+        ::close(source_fd);
+        return false;
+    }
+
+    CopyMethod used = CopyMethod::Reflink;
+    bool ok = false;
+#if defined(__linux__) && defined(FICLONE)
+    ok = ::ioctl(destination_fd, FICLONE, source_fd) == 0;
+#endif
+    if (!ok) {
+        used = CopyMethod::CopyFileRange;
+        bool unsupported;
+        ok = copy_in_kernel(source_fd, destination_fd, static_cast<size_t>(info.st_size), unsupported);
+        if (!ok && unsupported) {
+            used = CopyMethod::ReadWrite;
+            ok = copy_with_read_write(source_fd, destination_fd);
+        }
+    }
+    int error = ok ? 0 : errno;
+    ::close(source_fd);
+    if (::close(destination_fd) != 0 && ok) {
+        ok = false;
+        error = errno;
+    }
+    if (ok && ::rename(temp_path.c_str(), destination.c_str()) != 0) {
+        ok = false;
+        error = errno;
+    }
+    if (!ok) {
+        std::cerr << "Error: Could not copy " << source << " to " << destination << ": " << std::strerror(error) << std::endl;
+        ::unlink(temp_path.c_str());
+        return false;
+    }
+    if (method) *method = used;
+    return true;
+}
+
+// --- Output Queue ---
+
+namespace {
+
+// Finishes a file with plain syscalls: writes content (which belongs at file
+// offset `offset`) from its byte `written` on, closes fd (if still open) and
+// renames the temporary file into place.
+bool complete_synchronously(int fd, bool fd_open, const std::string& content, size_t offset, size_t written,
+                            const std::string& temp_path, const std::string& final_path) {
+    int error = 0;
+    while (written < content.size() && error == 0) {
+        ssize_t count = ::pwrite(fd, content.data() + written, content.size() - written,
+                                 static_cast<off_t>(offset + written));
+        if (count < 0) {
+            if (errno != EINTR) error = errno;
+        } else {
+            written += static_cast<size_t>(count);
+        }
+    }
+    if (fd_open && ::close(fd) != 0 && error == 0) error = errno;
+    if (error == 0 && ::rename(temp_path.c_str(), final_path.c_str()) != 0) error = errno;
+    if (error != 0) {
+        std::cerr << "Error: Could not write " << final_path << ": " << std::strerror(error) << std::endl;
+        ::unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+#if FILE_IO_IO_URING
+
+// Minimal io_uring wrapper over the raw syscalls: one submission queue filled
+// by get_sqe(), published and entered by submit(), drained by reap().
+class IoUring {
+public:
+    IoUring() = default;
+    ~IoUring() {
+        if (sqes_) ::munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_) ::munmap(sq_ring_, sq_ring_size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // False if io_uring is unavailable or lacks one of the opcodes.
+    bool init(unsigned entries, std::initializer_list<uint8_t> required_opcodes) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) return false;
+        if (!(params.features & IORING_FEAT_SINGLE_MMAP)) return false; // Pre-5.4 kernels: not worth a second path
+
+        sq_ring_size_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                         params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+        sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            sq_ring_ = nullptr;
+            return false;
+        }
+        cq_ring_ = sq_ring_;
+        cq_ring_size_ = sq_ring_size_;
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return false;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sq_ring_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+        char* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        cq_entries_ = params.cq_entries;
+        sqe_tail_ = submitted_tail_ = *sq_tail_;
+
+        // Ask the kernel which opcodes it implements.
+        constexpr unsigned PROBE_OPS = 256;
+        std::unique_ptr<char[]> probe_buffer(new char[sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op)]());
+        auto* probe = reinterpret_cast<io_uring_probe*>(probe_buffer.get());
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0) return false;
+        for (uint8_t opcode : required_opcodes) {
+            if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    unsigned cq_entries() const { return cq_entries_; }
+    unsigned sq_space_left() const { return sq_entries_ - (sqe_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)); }
+
+    // A zeroed entry, or nullptr if the submission queue is full.
+    io_uring_sqe* get_sqe() {
+        if (sq_space_left() == 0) return nullptr;
+        unsigned index = sqe_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++sqe_tail_;
+        return sqe;
+    }
+
+    // Submits everything queued and waits for at least wait_count completions.
+    bool submit(unsigned wait_count) {
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+        unsigned to_submit = sqe_tail_ - submitted_tail_;
+        while (true) {
+            long submitted = ::syscall(__NR_io_uring_enter, fd_, to_submit, wait_count,
+                                       wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (submitted >= 0) {
+                submitted_tail_ += static_cast<unsigned>(submitted);
+                return true;
+            }
+            if (errno != EINTR) {
+                std::cerr << "Error: io_uring_enter failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Calls handle(user_data, result) for every available completion.
+    template <typename Handler>
+    void reap(Handler&& handle) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            handle(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    int fd_ = -1;
+    void* sq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void* cq_ring_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sqe_tail_ = 0;       // Entries filled in by get_sqe()
+    unsigned submitted_tail_ = 0; // Entries consumed by the kernel
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    unsigned cq_entries_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+constexpr unsigned OUTPUT_RING_ENTRIES = 256;
+constexpr unsigned OUTPUT_BATCH_FILES = 32;                 // Files per io_uring_enter
+constexpr size_t OUTPUT_MAX_IN_FLIGHT_BYTES = 64u << 20;    // Buffered content waiting for the kernel
+constexpr size_t OUTPUT_MAX_RING_WRITE = 1u << 30;          // Larger files are written with pwrite
+
+// One output in flight: write -> close -> rename, linked so each step only
+// runs if the previous one fully succeeded.
+struct QueuedFile {
+    enum Step : uint64_t { WRITE = 0, CLOSE = 1, RENAME = 2, STEP_COUNT = 3 };
+
+    int fd;
+    std::string content; // The file's tail, from byte `offset` on
+    size_t offset;
+    std::string temp_path;
+    std::string final_path;
+    int results[STEP_COUNT] = {0, 0, 0}; // -ECANCELED if an earlier step failed
+    unsigned outstanding = STEP_COUNT;
+};
+
+// A chain stops at a short write (the kernel cancels the rest), which is
+// finished by hand; any real error fails the file.
+bool finish_chain(const QueuedFile& file) {
+    const int write_result = file.results[QueuedFile::WRITE];
+    const int close_result = file.results[QueuedFile::CLOSE];
+    if (write_result == static_cast<int>(file.content.size()) && close_result == 0 &&
+        file.results[QueuedFile::RENAME] == 0) {
+        return true;
+    }
+    for (int result : file.results) {
+        if (result < 0 && result != -ECANCELED) {
+            std::cerr << "Error: Could not write " << file.final_path << ": " << std::strerror(-result) << std::endl;
+            if (close_result == -ECANCELED) ::close(file.fd);
+            ::unlink(file.temp_path.c_str());
+            return false;
+        }
+    }
+    return complete_synchronously(file.fd, close_result == -ECANCELED, file.content, file.offset,
+                                  static_cast<size_t>(std::max(write_result, 0)), file.temp_path, file.final_path);
+}
+
+#endif // FILE_IO_IO_URING
+
+class OutputQueue {
+public:
+    ~OutputQueue() {
+        flush(); // Nothing queued may be lost, even on an early exit
+    }
+
+    // content is written at file offset `offset` (what precedes it is already written).
+    bool enqueue(int fd, std::string content, size_t offset, std::string temp_path, std::string final_path) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start();
+#if FILE_IO_IO_URING
+        if (use_ring_ && content.size() <= OUTPUT_MAX_RING_WRITE) {
+            // Room for three entries in both rings, and a bound on buffered bytes.
+            while (ring_.sq_space_left() < QueuedFile::STEP_COUNT ||
+                   in_flight_requests_ + QueuedFile::STEP_COUNT > ring_.cq_entries() ||
+                   (in_flight_requests_ > 0 && in_flight_bytes_ + content.size() > OUTPUT_MAX_IN_FLIGHT_BYTES)) {
+                if (!submit_and_reap(1)) break;
+            }
+            if (ring_usable_) {
+                auto file = std::make_unique<QueuedFile>();
+                file->fd = fd;
+                file->content = std::move(content);
+                file->offset = offset;
+                file->temp_path = std::move(temp_path);
+                file->final_path = std::move(final_path);
+                queue_chain(std::move(file));
+                if (++unsubmitted_files_ >= OUTPUT_BATCH_FILES) submit_and_reap(0);
+                return true;
+            }
+        }
+#endif
+        lock.unlock();
+        return complete_synchronously(fd, true, content, offset, 0, temp_path, final_path);
+    }
+
+    bool flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+#if FILE_IO_IO_URING
+        while (in_flight_requests_ > 0 && submit_and_reap(1)) {}
+#endif
+        return !std::exchange(failed_, false);
+    }
+
+    const char* backend() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        start();
+        return use_ring_ ? "io_uring" : "pwrite";
+    }
+
+private:
+    void start() {
+        if (started_) return;
+        started_ = true;
+#if FILE_IO_IO_URING
+        if (std::getenv("BLOG_BUILDER_NO_IO_URING")) return;
+        use_ring_ = ring_.init(OUTPUT_RING_ENTRIES, {IORING_OP_WRITE, IORING_OP_CLOSE, IORING_OP_RENAMEAT});
+        ring_usable_ = use_ring_;
+#endif
+    }
+
+#if FILE_IO_IO_URING
+    void queue_chain(std::unique_ptr<QueuedFile> file) {
+        QueuedFile* raw = file.release(); // Owned by the ring until its last completion
+        const uint64_t tag = reinterpret_cast<uintptr_t>(raw);
+
+        io_uring_sqe* write = ring_.get_sqe();
+        write->opcode = IORING_OP_WRITE;
+        write->fd = raw->fd;
+        write->addr = reinterpret_cast<uintptr_t>(raw->content.data());
+        write->len = static_cast<uint32_t>(raw->content.size());
+        write->off = raw->offset;
+        write->flags = IOSQE_IO_LINK;
+        write->user_data = tag | QueuedFile::WRITE;
+
+        io_uring_sqe* close = ring_.get_sqe();
+        close->opcode = IORING_OP_CLOSE;
+        close->fd = raw->fd;
+        close->flags = IOSQE_IO_LINK;
+        close->user_data = tag | QueuedFile::CLOSE;
+
+        io_uring_sqe* rename = ring_.get_sqe();
+        rename->opcode = IORING_OP_RENAMEAT;
+        rename->fd = AT_FDCWD;
+        rename->addr = reinterpret_cast<uintptr_t>(raw->temp_path.c_str());
+        rename->len = static_cast<uint32_t>(AT_FDCWD);
+        rename->addr2 = reinterpret_cast<uintptr_t>(raw->final_path.c_str());
+        rename->user_data = tag | QueuedFile::RENAME;
+
+        in_flight_requests_ += QueuedFile::STEP_COUNT;
+        in_flight_bytes_ += raw->content.size();
+    }
+
+    bool submit_and_reap(unsigned wait_count) {
+        unsubmitted_files_ = 0;
+        if (!ring_.submit(wait_count)) {
+            // The ring is unusable; new files take the pwrite path. Requests
+            // already handed to the kernel may never complete, so give up on them.
+            ring_usable_ = false;
+            in_flight_requests_ = 0;
+            failed_ = true;
+            return false;
+        }
+        ring_.reap([this](uint64_t user_data, int32_t result) {
+            auto* file = reinterpret_cast<QueuedFile*>(user_data & ~uint64_t{3});
+            file->results[user_data & 3] = result;
+            --in_flight_requests_;
+            if (--file->outstanding > 0) return;
+            std::unique_ptr<QueuedFile> finished(file);
+            in_flight_bytes_ -= finished->content.size();
+            if (!finish_chain(*finished)) failed_ = true;
+        });
+        return true;
+    }
+
+    IoUring ring_;
+    bool ring_usable_ = false;
+    unsigned in_flight_requests_ = 0; // Queued or submitted, not yet completed
+    size_t in_flight_bytes_ = 0;
+    unsigned unsubmitted_files_ = 0;
+#endif
+
+    std::mutex mutex_;
+    bool started_ = false;
+    bool use_ring_ = false;
+    bool failed_ = false;
+};
+
+OutputQueue& output_queue() {
+    static OutputQueue queue;
+    return queue;
+}
+
+} // namespace
+
+bool write_output_file(const fs::path& path, std::string_view content) {
+    FileSink file;
+    return file.open(path) && file.write(content.data(), content.size()) && file.close();
+}
+
+bool flush_output_files() {
+    TraceSpan span("flush outputs");
+    return output_queue().flush();
+}
+
+const char* output_queue_backend() {
+    return output_queue().backend();
+}
+
+// --- FileSink ---
+
+FileSink::~FileSink() {
+    if (fd_ >= 0) discard(); // Never finished: do not leave a truncated file behind
+}
+
+bool FileSink::open(const fs::path& path) {
+    path_ = path;
+    temp_path_ = path;
+    temp_path_ += ".tmp-" + std::to_string(::getpid());
+    failed_ = false;
+    bytes_written_ = 0;
+    flushed_ = 0;
+    buffer_.clear();
+    fd_ = ::open(temp_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Error: Could not create file " << path << ": " << std::strerror(errno) << std::endl;
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool FileSink::write(const char* data, size_t size) {
+    if (fd_ < 0 || failed_) return false;
+    if (buffer_.size() + size > FILE_SINK_BUFFER_SIZE) {
+        if (!write_through(buffer_.data(), buffer_.size())) return false;
+        buffer_.clear();
+    }
+    if (size >= FILE_SINK_BUFFER_SIZE) {
+        if (!write_through(data, size)) return false;
+    } else {
+        buffer_.append(data, size);
+    }
+    bytes_written_ += size;
+    return true;
+}
+
+bool FileSink::write_through(const char* data, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        ssize_t count = ::pwrite(fd_, data + written, size - written, static_cast<off_t>(flushed_ + written));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: Could not write " << path_ << ": " << std::strerror(errno) << std::endl;
+            failed_ = true;
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    flushed_ += size;
+    return true;
+}
+
+bool FileSink::close() {
+    if (fd_ < 0) return !failed_;
+    int fd = std::exchange(fd_, -1);
+    if (failed_) {
+        ::close(fd);
+        ::unlink(temp_path_.c_str());
+        return false;
+    }
+    return output_queue().enqueue(fd, std::move(buffer_), flushed_, temp_path_.string(), path_.string());
+}
+
+void FileSink::discard() {
+    failed_ = true;
+    close();
+}
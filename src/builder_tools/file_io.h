@@ -0,0 +1,108 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include "common_utils.h"
+
+// --- Input Files ---
+// Whole-file read access as a string_view. Files of MAPPED_FILE_MIN_SIZE bytes
+// and up are memory-mapped (MAP_POPULATE, so a cold file is read in one go
+// rather than a page fault at a time). Smaller ones, which is most markdown
+// posts, are read with a single read(): for them a mapping costs more
+// syscalls (mmap + munmap) and page faults than it saves copying.
+constexpr size_t MAPPED_FILE_MIN_SIZE = 16 * 1024;
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Prints an error and returns false (leaving the view empty) if the file cannot be read.
+    bool open(const fs::path& path);
+    // Unmaps or frees the content.
+    void reset();
+
+    std::string_view view() const {
+        return mapping_ ? std::string_view(static_cast<const char*>(mapping_), mapping_size_) : std::string_view(buffer_);
+    }
+    bool mapped() const { return mapping_ != nullptr; }
+
+private:
+    void* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    std::string buffer_; // Content of small files
+};
+
+// --- File Copies ---
+// Copies a file that needs no processing (images, fonts) without its content
+// passing through user space: a reflink (FICLONE: the copy shares extents
+// with the source, btrfs/XFS) where the filesystem supports one, else
+// copy_file_range (copied inside the kernel), else a read/write loop. Like
+// FileSink, the copy is made under a temporary name and renamed into place.
+enum class CopyMethod { Reflink, CopyFileRange, ReadWrite };
+
+bool clone_file(const fs::path& source, const fs::path& destination, CopyMethod* method = nullptr);
+const char* copy_method_name(CopyMethod method);
+
+// --- Output Files ---
+// FileSink buffers up to FILE_SINK_BUFFER_SIZE bytes of a file's content;
+// whenever more arrives, the buffer is written out with pwrite, so a large
+// output is never held whole. close() hands the remaining tail (for most
+// pages, the whole file) to the process-wide output queue, which writes it to
+// the temporary file next to the destination and renames that into place, so
+// neither a reader nor an interrupted build ever sees a partially written
+// output. With io_uring, the write, close and rename of a file are one linked
+// chain of requests, and chains are submitted in batches (one io_uring_enter
+// for many files). Without io_uring (old kernel, seccomp,
+// BLOG_BUILDER_NO_IO_URING set) the same steps run synchronously with pwrite.
+//
+// Queued files are only guaranteed to be in place after flush_output_files(),
+// which also reports write errors that happened after close() returned. Every
+// stage function that writes outputs calls it before returning; build_site
+// calls it once, after the task graph.
+constexpr size_t FILE_SINK_BUFFER_SIZE = 256 * 1024;
+
+class FileSink : public ByteSink {
+public:
+    FileSink() = default;
+    ~FileSink() override;
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    // Creates the temporary file (errors are reported here, not at close()).
+    bool open(const fs::path& path);
+    bool write(const char* data, size_t size) override;
+    // Queues the buffered tail for writing and renaming into place. If anything
+    // failed, the temporary file is removed instead.
+    bool close();
+    // Closes and removes the temporary file regardless (the producer gave up).
+    void discard();
+
+    size_t bytes_written() const { return bytes_written_; }
+
+private:
+    // pwrites data at the end of what is already in the file.
+    bool write_through(const char* data, size_t size);
+
+    int fd_ = -1;
+    bool failed_ = false;
+    size_t bytes_written_ = 0;
+    size_t flushed_ = 0; // Bytes already in the file, ahead of buffer_
+    std::string buffer_;
+    fs::path path_;
+    fs::path temp_path_;
+};
+
+// open + write + close of a FileSink, for content already in memory.
+bool write_output_file(const fs::path& path, std::string_view content);
+
+// Waits for every queued output to be written and renamed into place. Returns
+// false if any of them failed since the last flush.
+bool flush_output_files();
+// "io_uring" or "pwrite".
+const char* output_queue_backend();
+
+#endif // FILE_IO_H
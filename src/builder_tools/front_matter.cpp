@@ -0,0 +1,418 @@
+#include "front_matter.h"
+#include <algorithm>
+#include <iostream>
+
+const size_t DEFAULT_EXCERPT_LENGTH = 200;
+
+namespace {
+
+// --- Lines ---
+
+bool is_blank(char c) { return c == ' ' || c == '\t'; }
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && is_blank(text.front())) text.remove_prefix(1);
+    while (!text.empty() && (is_blank(text.back()) || text.back() == '\r')) text.remove_suffix(1);
+    return text;
+}
+
+bool starts_with(std::string_view text, std::string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+// Walks source one line at a time (without the newline), counting lines from 1.
+class LineReader {
+public:
+    explicit LineReader(std::string_view source) : source_(source) {}
+
+    bool next(std::string_view& line) {
+        if (position_ >= source_.size()) return false;
+        size_t newline = source_.find('\n', position_);
+        size_t end = newline == std::string_view::npos ? source_.size() : newline;
+        line = source_.substr(position_, end - position_);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        position_ = newline == std::string_view::npos ? source_.size() : newline + 1;
+        ++line_number_;
+        return true;
+    }
+
+    size_t line_number() const { return line_number_; }
+    size_t position() const { return position_; }
+
+private:
+    std::string_view source_;
+    size_t position_ = 0;
+    size_t line_number_ = 0;
+};
+
+bool is_front_matter_fence(std::string_view line) {
+    return line == "---";
+}
+
+bool is_front_matter_end(std::string_view line) {
+    return line == "---" || line == "...";
+}
+
+// --- Values ---
+
+// Strips matching quotes: "..." (with \" and \\ escapes) or '...' (with '').
+// Unquoted values are taken as they are.
+bool unquote(std::string_view value, std::string& out) {
+    out.clear();
+    if (value.empty() || (value.front() != '"' && value.front() != '\'')) {
+        out.assign(value);
+        return true;
+    }
+    const char quote = value.front();
+    for (size_t i = 1; i < value.size(); ++i) {
+        char c = value[i];
+        if (c == quote) {
+            if (quote == '\'' && i + 1 < value.size() && value[i + 1] == '\'') {
+                out += '\'';
+                ++i;
+                continue;
+            }
+            return trim(value.substr(i + 1)).empty(); // Nothing may follow the closing quote
+        }
+        if (c == '\\' && quote == '"' && i + 1 < value.size()) c = value[++i];
+        out += c;
+    }
+    return false; // Unterminated
+}
+
+bool is_leap_year(int year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+// Accepts YYYY-MM-DD, optionally followed by a time ("2025-05-25 10:00",
+// "2025-05-25T10:00:00Z"), which is dropped.
+bool parse_date(std::string_view value, std::string& date) {
+    if (value.size() > 10 && value[10] != ' ' && value[10] != 'T') return false;
+    std::string_view day_part = value.substr(0, 10);
+    if (!is_valid_date(day_part)) return false;
+    date.assign(day_part);
+    return true;
+}
+
+// Tags: "[a, b]", "a, b" or a single tag. Quotes around a tag are stripped.
+bool parse_tag_list(std::string_view value, std::vector<std::string>& tags) {
+    if (!value.empty() && value.front() == '[') {
+        if (value.back() != ']') return false;
+        value = value.substr(1, value.size() - 2);
+    }
+    std::string tag;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = trim(value.substr(0, comma));
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        if (item.empty()) continue;
+        if (!unquote(item, tag)) return false;
+        tags.push_back(tag);
+    }
+    return true;
+}
+
+bool parse_flag(std::string_view value, bool& flag) {
+    if (value == "true" || value == "yes") flag = true;
+    else if (value == "false" || value == "no") flag = false;
+    else return false;
+    return true;
+}
+
+// --- Excerpt ---
+
+// Collects plain text up to limit bytes, then cuts it at a word boundary.
+class ExcerptBuilder {
+public:
+    explicit ExcerptBuilder(size_t limit) : limit_(limit) {}
+
+    bool full() const { return full_; }
+
+    // Appends one line of markdown prose without its inline markup.
+    void add_line(std::string_view line) {
+        for (size_t i = 0; i < line.size() && !full_; ++i) {
+            char c = line[i];
+            switch (c) {
+                case '*': case '`': continue;
+                case '_':
+                    // Emphasis only: snake_case keeps its underscores.
+                    if (i == 0 || i + 1 == line.size() || !is_word_byte(line[i - 1]) || !is_word_byte(line[i + 1])) continue;
+                    break;
+                case '!':
+                    if (i + 1 < line.size() && line[i + 1] == '[') continue; // Image: keep the alt text
+                    break;
+                case '[': continue;
+                case ']':
+                    // "[text](target)": the target is not prose.
+                    if (i + 1 < line.size() && line[i + 1] == '(') {
+                        size_t close = line.find(')', i + 2);
+                        if (close != std::string_view::npos) i = close;
+                    }
+                    continue;
+                case '<': {
+                    size_t close = line.find('>', i + 1);
+                    if (close != std::string_view::npos) {
+                        i = close;
+                        continue;
+                    }
+                    break;
+                }
+                case '\\':
+                    if (i + 1 < line.size()) c = line[++i];
+                    break;
+                default: break;
+            }
+            append(c);
+        }
+        append(' ');
+    }
+
+    std::string finish() {
+        while (!text_.empty() && text_.back() == ' ') text_.pop_back();
+        if (!full_) return std::move(text_);
+        // Cut at the last space that keeps the text within the limit, or at a
+        // UTF-8 boundary if a single word is that long.
+        size_t cut = text_.rfind(' ', limit_);
+        if (cut == std::string::npos || cut == 0) {
+            cut = std::min(limit_, text_.size());
+            while (cut > 0 && (static_cast<unsigned char>(text_[cut]) & 0xC0) == 0x80) --cut;
+        }
+        text_.resize(cut);
+        while (!text_.empty() && (text_.back() == ' ' || text_.back() == ',' || text_.back() == ';' ||
+                                  text_.back() == ':' || text_.back() == '.')) {
+            text_.pop_back();
+        }
+        text_ += "…";
+        return std::move(text_);
+    }
+
+private:
+    static bool is_word_byte(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    void append(char c) {
+        if (c == '\t') c = ' ';
+        if (c == ' ' && (text_.empty() || text_.back() == ' ')) return;
+        text_ += c;
+        // One byte past the limit tells finish() whether the text was cut.
+        if (text_.size() > limit_) full_ = true;
+    }
+
+    size_t limit_;
+    std::string text_;
+    bool full_ = false;
+};
+
+// Body lines that are not part of the excerpt.
+bool is_skipped_block(std::string_view line) {
+    char first = line.front();
+    if (first == '>' || first == '|' || first == '<') return true;
+    if ((first == '-' || first == '*' || first == '+') && (line.size() == 1 || line[1] == ' ' || line[1] == first)) {
+        return true; // List item or thematic break
+    }
+    if (first == '_' && starts_with(line, "___")) return true;
+    size_t digits = 0;
+    while (digits < line.size() && line[digits] >= '0' && line[digits] <= '9') ++digits;
+    return digits > 0 && digits + 1 < line.size() && (line[digits] == '.' || line[digits] == ')') && line[digits + 1] == ' ';
+}
+
+// --- Scanner ---
+
+class PostScanner {
+public:
+    PostScanner(const fs::path& source_path, std::string_view source, PostMetadata& post, size_t excerpt_length)
+        : path_(source_path), lines_(source), post_(post), excerpt_(excerpt_length), excerpt_length_(excerpt_length) {}
+
+    bool run() {
+        post_.title.clear();
+        post_.date.clear();
+        post_.tags.clear();
+        post_.draft = false;
+        post_.excerpt.clear();
+
+        if (!scan_front_matter()) return false;
+        if (!scan_body()) return false;
+
+        if (post_.title.empty()) post_.title = "Untitled Post " + post_.id;
+        if (post_.date.empty()) {
+            std::string_view id = post_.id;
+            if (id.size() < 10 || (id.size() > 10 && id[10] != '-') || !is_valid_date(id.substr(0, 10))) {
+                // A checkout's modification dates differ between machines: no fallback.
+                std::cerr << "Error: " << path_.string() << ":1: no date (front matter, \"Date:\" line or "
+                          << "YYYY-MM-DD file name prefix)" << std::endl;
+                return false;
+            }
+            post_.date.assign(id.substr(0, 10));
+        }
+        if (!have_summary_) post_.excerpt = excerpt_.finish();
+        return true;
+    }
+
+private:
+    void report(const char* severity, const std::string& message) const {
+        std::cerr << severity << ": " << path_.string() << ":" << lines_.line_number() << ": " << message << std::endl;
+    }
+
+    bool scan_front_matter() {
+        LineReader probe = lines_;
+        std::string_view line;
+        if (!probe.next(line) || !is_front_matter_fence(line)) return true;
+        lines_ = probe;
+        const size_t first_line = lines_.line_number();
+
+        bool in_tag_list = false;
+        std::string value;
+        while (lines_.next(line)) {
+            if (is_front_matter_end(line)) return true;
+            std::string_view content = trim(line);
+            if (content.empty() || content.front() == '#') continue;
+
+            if (content.front() == '-' && (content.size() == 1 || content[1] == ' ')) {
+                if (!in_tag_list) {
+                    report("Error", "list item outside of \"tags:\"");
+                    return false;
+                }
+                if (!unquote(trim(content.substr(1)), value)) {
+                    report("Error", "unterminated quoted tag");
+                    return false;
+                }
+                if (!value.empty()) post_.tags.push_back(value);
+                continue;
+            }
+            in_tag_list = false;
+
+            size_t colon = content.find(':');
+            if (colon == std::string_view::npos || colon == 0 || is_blank(line.front())) {
+                report("Error", "expected \"key: value\", got \"" + std::string(content) + "\"");
+                return false;
+            }
+            std::string_view key = trim(content.substr(0, colon));
+            std::string_view raw_value = trim(content.substr(colon + 1));
+            if (!set_field(key, raw_value, value, in_tag_list)) return false;
+        }
+        std::cerr << "Error: " << path_.string() << ":" << first_line << ": front matter is never closed (no \"---\" line)"
+                  << std::endl;
+        return false;
+    }
+
+    bool set_field(std::string_view key, std::string_view raw_value, std::string& value, bool& in_tag_list) {
+        if (key == "tags") {
+            if (raw_value.empty()) {
+                in_tag_list = true; // "- tag" lines follow
+            } else if (!parse_tag_list(raw_value, post_.tags)) {
+                report("Error", "malformed tag list \"" + std::string(raw_value) + "\"");
+                return false;
+            }
+            return true;
+        }
+        if (!unquote(raw_value, value)) {
+            report("Error", "unterminated quoted value for \"" + std::string(key) + "\"");
+            return false;
+        }
+        if (key == "title") {
+            post_.title = value;
+        } else if (key == "date") {
+            if (!parse_date(value, post_.date)) {
+                report("Error", "date \"" + value + "\" is not a valid YYYY-MM-DD date");
+                return false;
+            }
+        } else if (key == "draft") {
+            if (!parse_flag(value, post_.draft)) {
+                report("Error", "draft must be true or false, got \"" + value + "\"");
+                return false;
+            }
+        } else if (key == "summary") {
+            ExcerptBuilder summary(excerpt_length_);
+            summary.add_line(value);
+            post_.excerpt = summary.finish();
+            have_summary_ = !post_.excerpt.empty();
+        } else {
+            report("Warning", "unknown front matter key \"" + std::string(key) + "\" ignored");
+        }
+        return true;
+    }
+
+    bool scan_body() {
+        bool in_header = true; // Before the opening paragraph: title and Date: lines count
+        std::string fence;     // Marker of the open fenced code block
+        std::string_view line;
+        while (!done(in_header) && lines_.next(line)) {
+            std::string_view content = trim(line);
+            if (!fence.empty()) {
+                if (starts_with(content, fence)) fence.clear();
+                continue;
+            }
+            if (content.empty()) continue;
+            if (starts_with(content, "```") || starts_with(content, "~~~")) {
+                fence.assign(content.substr(0, 3));
+                continue;
+            }
+            if (content.front() == '#') {
+                if (in_header && post_.title.empty() && starts_with(content, "# ")) {
+                    post_.title.assign(trim(content.substr(2)));
+                }
+                continue;
+            }
+            if (in_header && starts_with(content, "Date:")) {
+                std::string_view date_value = trim(content.substr(5));
+                if (!post_.date.empty()) continue; // Front matter wins
+                if (!parse_date(date_value, post_.date)) {
+                    report("Warning", "\"Date: " + std::string(date_value) + "\" is not a valid YYYY-MM-DD date, ignored");
+                }
+                continue;
+            }
+            if (is_skipped_block(content)) continue;
+            in_header = false;
+            if (!have_summary_) excerpt_.add_line(content);
+        }
+        return true;
+    }
+
+    // Nothing later in the body can change the metadata.
+    bool done(bool in_header) const {
+        return !in_header && (have_summary_ || excerpt_.full());
+    }
+
+    const fs::path& path_;
+    LineReader lines_;
+    PostMetadata& post_;
+    ExcerptBuilder excerpt_;
+    size_t excerpt_length_;
+    bool have_summary_ = false;
+};
+
+} // namespace
+
+bool is_valid_date(std::string_view date) {
+    if (date.size() != 10 || date[4] != '-' || date[7] != '-') return false;
+    for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+        if (date[i] < '0' || date[i] > '9') return false;
+    }
+    auto number = [&](size_t at, size_t digits) {
+        int value = 0;
+        for (size_t i = at; i < at + digits; ++i) value = value * 10 + (date[i] - '0');
+        return value;
+    };
+    const int year = number(0, 4);
+    const int month = number(5, 2);
+    const int day = number(8, 2);
+    static const int DAYS_IN_MONTH[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month < 1 || month > 12 || day < 1) return false;
+    return day <= DAYS_IN_MONTH[month - 1] + (month == 2 && is_leap_year(year) ? 1 : 0);
+}
+
+std::string_view post_body(std::string_view source) {
+    LineReader lines(source);
+    std::string_view line;
+    if (!lines.next(line) || !is_front_matter_fence(line)) return source;
+    while (lines.next(line)) {
+        if (is_front_matter_end(line)) return source.substr(lines.position());
+    }
+    return source; // Unclosed: scan_post_source rejects the post
+}
+
+bool scan_post_source(const fs::path& source_path, std::string_view source, PostMetadata& post, size_t excerpt_length) {
+    return PostScanner(source_path, source, post, excerpt_length).run();
+}
@@ -0,0 +1,43 @@
+#ifndef FRONT_MATTER_H
+#define FRONT_MATTER_H
+
+#include "common_utils.h"
+
+// --- Post Front Matter ---
+// One forward pass over a post's markdown fills the metadata of PostMetadata.
+// A post may start with a YAML-style block:
+//
+//   ---
+//   title: "Static Sites vs Surveillance"
+//   date: 2025-05-25
+//   tags: [web, privacy]        (or "tags: web, privacy", or one "- tag" per line)
+//   draft: false                (true/false, yes/no)
+//   summary: One line for listings.
+//   ---
+//
+// Each field falls back to what the post body says:
+//   title    the first "# " heading before the opening paragraph
+//   date     a "Date: YYYY-MM-DD" line before the opening paragraph, then a
+//            YYYY-MM-DD prefix of the file name; a post with neither is an
+//            error
+//   excerpt  summary, else the opening prose of the body (headings, code,
+//            quotes, lists and tables skipped; inline markup and link targets
+//            dropped), cut at a word boundary to at most excerpt_length bytes
+//            plus an ellipsis
+// The scan stops as soon as every field is known, so long posts cost no more
+// than their first paragraphs.
+//
+// Problems are reported on std::cerr as "Error: path:line: ..." (the post is
+// not loaded) or "Warning: path:line: ..." (the field is ignored).
+
+extern const size_t DEFAULT_EXCERPT_LENGTH;
+
+// post.id must already be set (the file name date comes from it).
+bool scan_post_source(const fs::path& source_path, std::string_view source, PostMetadata& post,
+                      size_t excerpt_length = DEFAULT_EXCERPT_LENGTH);
+// The markdown after the front matter block: what gets rendered.
+std::string_view post_body(std::string_view source);
+// Whether date is a valid YYYY-MM-DD calendar date.
+bool is_valid_date(std::string_view date);
+
+#endif // FRONT_MATTER_H
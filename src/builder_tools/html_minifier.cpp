@@ -0,0 +1,321 @@
+#include "html_minifier.h"
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HTML_MINIFIER_X86 1
+#include <immintrin.h>
+#else
+#define HTML_MINIFIER_X86 0
+#endif
+
+namespace {
+
+// --- Character Classes ---
+
+enum : uint8_t {
+    CLASS_PLAIN = 0,
+    CLASS_SPACE = 1, // ' ', \t, \n, \v, \f, \r
+    CLASS_LT = 2,
+    CLASS_GT = 4,
+};
+
+constexpr std::array<uint8_t, 256> make_class_table() {
+    std::array<uint8_t, 256> table{};
+    for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) table[c] = CLASS_SPACE;
+    table['<'] = CLASS_LT;
+    table['>'] = CLASS_GT;
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_CLASS = make_class_table();
+
+inline uint8_t char_class(char c) {
+    return CHAR_CLASS[static_cast<unsigned char>(c)];
+}
+
+// --- Scan Kernels ---
+// Each returns the offset of the first byte that is not CLASS_PLAIN, or size.
+
+using ScanFunction = size_t (*)(const char* data, size_t size);
+
+size_t scan_scalar(const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (char_class(data[i]) != CLASS_PLAIN) return i;
+    }
+    return size;
+}
+
+#if HTML_MINIFIER_X86
+// Whitespace is ' ' or 0x09..0x0D; the latter is tested as (c - 9) <= 4 unsigned.
+__attribute__((target("sse2"))) size_t scan_sse2(const char* data, size_t size) {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i control = _mm_sub_epi8(bytes, tab);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, lt), _mm_cmpeq_epi8(bytes, gt)),
+            _mm_or_si128(_mm_cmpeq_epi8(bytes, space), _mm_cmpeq_epi8(_mm_min_epu8(control, four), control)));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+    }
+    return i + scan_scalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) size_t scan_avx2(const char* data, size_t size) {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i control = _mm256_sub_epi8(bytes, tab);
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, lt), _mm256_cmpeq_epi8(bytes, gt)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(bytes, space), _mm256_cmpeq_epi8(_mm256_min_epu8(control, four), control)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i + scan_sse2(data + i, size - i);
+}
+#endif
+
+ScanFunction scan_function_for(HtmlScanKernel kernel) {
+#if HTML_MINIFIER_X86
+    if (kernel == HtmlScanKernel::AVX2) return scan_avx2;
+    if (kernel == HtmlScanKernel::SSE2) return scan_sse2;
+#endif
+    (void)kernel;
+    return scan_scalar;
+}
+
+// --- Element Handling ---
+
+enum class Mode {
+    Text,
+    Tag,
+    Comment,
+    RawText,  // <script>, <style>
+    Verbatim, // <pre>, <textarea>, <code>
+};
+
+struct SpecialElement {
+    std::string_view open;  // "<name" (lowercase)
+    std::string_view close; // "</name"
+    Mode body_mode;
+};
+
+constexpr SpecialElement SPECIAL_ELEMENTS[] = {
+    {"<script", "</script", Mode::RawText},
+    {"<style", "</style", Mode::RawText},
+    {"<pre", "</pre", Mode::Verbatim},
+    {"<textarea", "</textarea", Mode::Verbatim},
+    {"<code", "</code", Mode::Verbatim},
+};
+
+// Case-insensitive match of a lowercase tag prefix at html[i], followed by the
+// end of the tag name (so "<pre" does not match "<preview").
+bool tag_starts_at(std::string_view html, size_t i, std::string_view tag) {
+    if (html.size() - i < tag.size()) return false;
+    for (size_t k = 0; k < tag.size(); ++k) {
+        char c = html[i + k];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != tag[k]) return false;
+    }
+    if (i + tag.size() == html.size()) return true;
+    char next = html[i + tag.size()];
+    return (char_class(next) & (CLASS_SPACE | CLASS_GT)) != 0 || next == '/';
+}
+
+// --- Output ---
+
+class MinifierOutput {
+public:
+    explicit MinifierOutput(ByteSink& out) : out_(out) {}
+
+    // Text that may be preceded by a held-back space.
+    void text(const char* data, size_t size) {
+        if (pending_space_ != 0 && emitted_any_) raw(&pending_space_, 1);
+        pending_space_ = 0;
+        raw(data, size);
+        emitted_any_ = true;
+    }
+    // Whitespace is held back until non-space output follows, which trims
+    // leading/trailing whitespace and collapses runs to their first character.
+    void space(char c) {
+        if (pending_space_ == 0) pending_space_ = c;
+    }
+    bool finish() {
+        flush();
+        return sink_ok_;
+    }
+
+private:
+    void raw(const char* data, size_t size) {
+        if (size >= sizeof(chunk_)) {
+            // Large runs skip the staging buffer.
+            flush();
+            if (sink_ok_) sink_ok_ = out_.write(data, size);
+            return;
+        }
+        if (chunk_length_ + size > sizeof(chunk_)) flush();
+        std::memcpy(chunk_ + chunk_length_, data, size);
+        chunk_length_ += size;
+    }
+    void flush() {
+        if (chunk_length_ > 0 && sink_ok_) sink_ok_ = out_.write(chunk_, chunk_length_);
+        chunk_length_ = 0;
+    }
+
+    ByteSink& out_;
+    char chunk_[16 * 1024];
+    size_t chunk_length_ = 0;
+    bool sink_ok_ = true;
+    char pending_space_ = 0;
+    bool emitted_any_ = false;
+};
+
+bool minify(std::string_view html, ByteSink& sink, ScanFunction scan) {
+    MinifierOutput out(sink);
+    const char* data = html.data();
+    const size_t size = html.size();
+
+    Mode mode = Mode::Text;
+    Mode mode_after_tag = Mode::Text;
+    std::string_view close_tag; // Ends the current RawText/Verbatim body
+
+    size_t i = 0;
+    while (i < size) {
+        if (mode == Mode::Comment) {
+            size_t end = html.find("-->", i);
+            i = end == std::string_view::npos ? size : end + 3;
+            mode = Mode::Text;
+            continue;
+        }
+
+        if (mode == Mode::Verbatim) {
+            // Copy everything up to the closing tag unchanged.
+            size_t end = i;
+            while (true) {
+                const void* lt = std::memchr(data + end, '<', size - end);
+                end = lt ? static_cast<size_t>(static_cast<const char*>(lt) - data) : size;
+                if (end == size || tag_starts_at(html, end, close_tag)) break;
+                ++end;
+            }
+            if (end > i) out.text(data + i, end - i);
+            i = end;
+            mode = Mode::Text;
+            continue;
+        }
+
+        // Text, Tag and RawText: copy the plain run, then handle one special byte.
+        // In text, a single ' ' between plain characters is already minified,
+        // so the run continues across it (sentences become one copy, not one per word).
+        size_t run_start = i;
+        while (true) {
+            i += scan(data + i, size - i);
+            if (mode == Mode::Text && i > run_start && i + 1 < size && data[i] == ' ' &&
+                char_class(data[i + 1]) == CLASS_PLAIN) {
+                ++i;
+                continue;
+            }
+            break;
+        }
+        if (i > run_start) {
+            out.text(data + run_start, i - run_start);
+            if (i == size) break;
+        }
+
+        char c = data[i];
+        uint8_t cls = char_class(c);
+        if (cls == CLASS_SPACE) {
+            out.space(mode == Mode::Text ? ' ' : c);
+            ++i;
+        } else if (cls == CLASS_LT) {
+            if (mode == Mode::RawText) {
+                // Only the matching end tag leaves a script/style body.
+                if (tag_starts_at(html, i, close_tag)) {
+                    mode = Mode::Text;
+                    continue;
+                }
+            } else if (mode == Mode::Text && html.compare(i, 4, "<!--") == 0) {
+                mode = Mode::Comment;
+                i += 4;
+                continue;
+            } else {
+                mode = Mode::Tag;
+                mode_after_tag = Mode::Text;
+                for (const SpecialElement& element : SPECIAL_ELEMENTS) {
+                    if (tag_starts_at(html, i, element.open)) {
+                        mode_after_tag = element.body_mode;
+                        close_tag = element.close;
+                        break;
+                    }
+                }
+            }
+            out.text(&c, 1);
+            ++i;
+        } else { // CLASS_GT
+            out.text(&c, 1);
+            ++i;
+            if (mode == Mode::Tag) mode = mode_after_tag;
+        }
+    }
+    return out.finish();
+}
+
+bool cpu_supports(HtmlScanKernel kernel) {
+#if HTML_MINIFIER_X86
+    __builtin_cpu_init();
+    if (kernel == HtmlScanKernel::AVX2) return __builtin_cpu_supports("avx2");
+    if (kernel == HtmlScanKernel::SSE2) return __builtin_cpu_supports("sse2");
+#endif
+    return kernel == HtmlScanKernel::Scalar;
+}
+
+} // namespace
+
+HtmlScanKernel best_html_scan_kernel() {
+    // SSE2 over AVX2: runs between tags and spaces are mostly shorter than 32
+    // bytes, and html_minify_bench measures the 16-byte kernel ahead on real pages.
+    static const HtmlScanKernel best =
+        cpu_supports(HtmlScanKernel::SSE2) ? HtmlScanKernel::SSE2 : HtmlScanKernel::Scalar;
+    return best;
+}
+
+bool html_scan_kernel_supported(HtmlScanKernel kernel) {
+    return cpu_supports(kernel);
+}
+
+const char* html_scan_kernel_name(HtmlScanKernel kernel) {
+    switch (kernel) {
+        case HtmlScanKernel::Scalar: return "scalar";
+        case HtmlScanKernel::SSE2: return "sse2";
+        case HtmlScanKernel::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+bool minify_html_with(std::string_view html, ByteSink& out, HtmlScanKernel kernel) {
+    return minify(html, out, scan_function_for(kernel));
+}
+
+bool minify_html_to(std::string_view html, ByteSink& out) {
+    static const ScanFunction scan = scan_function_for(best_html_scan_kernel());
+    return minify(html, out, scan);
+}
+
+std::string minify_html(const std::string& html) {
+    std::string minified_html;
+    minified_html.reserve(html.length());
+    StringSink sink(minified_html);
+    minify_html_to(html, sink);
+    return minified_html;
+}
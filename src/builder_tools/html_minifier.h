@@ -0,0 +1,31 @@
+#ifndef HTML_MINIFIER_H
+#define HTML_MINIFIER_H
+
+#include "common_utils.h"
+
+// --- HTML Minifier ---
+// minify_html / minify_html_to (declared in common_utils.h) are a single-pass
+// state machine over a 256-entry character-class table:
+//   text      runs of whitespace collapse to one space, comments are dropped
+//   tag       <...>: whitespace runs keep their first character
+//   raw text  <script>/<style> bodies: like tag
+//   verbatim  <pre>, <textarea> and <code> bodies are copied unchanged
+// Leading and trailing whitespace of the document is trimmed.
+//
+// Plain runs between interesting bytes ('<', '>', whitespace) are found with a
+// SIMD scan and copied in one go. The kernel is picked once from what the CPU
+// supports; the others stay available for benchmarking (html_minify_bench).
+enum class HtmlScanKernel {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+HtmlScanKernel best_html_scan_kernel();
+bool html_scan_kernel_supported(HtmlScanKernel kernel);
+const char* html_scan_kernel_name(HtmlScanKernel kernel);
+
+// minify_html_to with an explicit kernel (which must be supported).
+bool minify_html_with(std::string_view html, ByteSink& out, HtmlScanKernel kernel);
+
+#endif // HTML_MINIFIER_H
@@ -0,0 +1,1247 @@
+#include "js_minifier.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+// --- Character Classes ---
+
+enum : uint8_t {
+    JS_NAME_START = 1, // Letters, '$', '_', '\' (escapes), non-ASCII
+    JS_NAME = 2,       // Name starts and digits
+    JS_DIGIT = 4,
+    JS_SPACE = 8, // ' ', \t, \v, \f, \r (line feeds are tracked apart)
+};
+
+constexpr std::array<uint8_t, 256> make_class_table() {
+    std::array<uint8_t, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        uint8_t bits = 0;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '$' || c == '_' || c == '\\' || c >= 0x80) {
+            bits |= JS_NAME_START | JS_NAME;
+        }
+        if (c >= '0' && c <= '9') bits |= JS_DIGIT | JS_NAME;
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r') bits |= JS_SPACE;
+        table[c] = bits;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> CHAR_CLASS = make_class_table();
+
+inline bool has_class(char c, uint8_t bits) {
+    return (CHAR_CLASS[static_cast<unsigned char>(c)] & bits) != 0;
+}
+
+// Length of the non-ASCII space or line terminator encoded at js[i] in
+// UTF-8 (U+00A0, U+FEFF, U+2028, ...), or 0.
+size_t unicode_space_length(std::string_view js, size_t i, bool& line_terminator) {
+    const auto byte = [&](size_t k) { return k < js.size() ? static_cast<unsigned char>(js[k]) : 0u; };
+    const unsigned b0 = byte(i), b1 = byte(i + 1), b2 = byte(i + 2);
+    line_terminator = false;
+    if (b0 == 0xC2 && b1 == 0xA0) return 2;
+    if ((b0 == 0xEF && b1 == 0xBB && b2 == 0xBF) || (b0 == 0xE1 && b1 == 0x9A && b2 == 0x80) ||
+        (b0 == 0xE3 && b1 == 0x80 && b2 == 0x80) || (b0 == 0xE2 && b1 == 0x81 && b2 == 0x9F)) {
+        return 3;
+    }
+    if (b0 == 0xE2 && b1 == 0x80) {
+        if (b2 == 0xA8 || b2 == 0xA9) {
+            line_terminator = true;
+            return 3;
+        }
+        if ((b2 >= 0x80 && b2 <= 0x8A) || b2 == 0xAF) return 3;
+    }
+    return 0;
+}
+
+// --- Words ---
+
+enum : uint8_t {
+    WORD_RESERVED = 1,   // Never the name of a variable
+    WORD_EXPRESSION = 2, // An expression starts after it: '/' begins a regular
+                         // expression and '{' an object literal (but after do/else: a block)
+    WORD_OPERATOR = 4,   // Cannot end an expression (return/break/continue can end a statement)
+};
+
+struct Word {
+    std::string_view name;
+    uint8_t flags;
+};
+
+// Sorted by name.
+constexpr Word WORDS[] = {
+    {"await", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"break", WORD_RESERVED},
+    {"case", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"catch", WORD_RESERVED | WORD_OPERATOR},
+    {"class", WORD_RESERVED | WORD_OPERATOR},
+    {"const", WORD_RESERVED | WORD_OPERATOR},
+    {"continue", WORD_RESERVED},
+    {"debugger", WORD_RESERVED},
+    {"default", WORD_RESERVED | WORD_OPERATOR},
+    {"delete", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"do", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"else", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"enum", WORD_RESERVED | WORD_OPERATOR},
+    {"export", WORD_RESERVED | WORD_OPERATOR},
+    {"extends", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"false", WORD_RESERVED},
+    {"finally", WORD_RESERVED | WORD_OPERATOR},
+    {"for", WORD_RESERVED | WORD_OPERATOR},
+    {"function", WORD_RESERVED | WORD_OPERATOR},
+    {"if", WORD_RESERVED | WORD_OPERATOR},
+    {"import", WORD_RESERVED | WORD_OPERATOR},
+    {"in", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"instanceof", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"new", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"null", WORD_RESERVED},
+    {"of", WORD_EXPRESSION}, // Also a plain name
+    {"return", WORD_RESERVED | WORD_EXPRESSION},
+    {"super", WORD_RESERVED},
+    {"switch", WORD_RESERVED | WORD_OPERATOR},
+    {"this", WORD_RESERVED},
+    {"throw", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"true", WORD_RESERVED},
+    {"try", WORD_RESERVED | WORD_OPERATOR},
+    {"typeof", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"var", WORD_RESERVED | WORD_OPERATOR},
+    {"void", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+    {"while", WORD_RESERVED | WORD_OPERATOR},
+    {"with", WORD_RESERVED | WORD_OPERATOR},
+    {"yield", WORD_RESERVED | WORD_EXPRESSION | WORD_OPERATOR},
+};
+
+uint8_t word_flags(std::string_view name) {
+    if (name.size() < 2 || name.size() > 10 || name[0] < 'a' || name[0] > 'y') return 0;
+    const Word* word = std::lower_bound(std::begin(WORDS), std::end(WORDS), name,
+                                        [](const Word& w, std::string_view n) { return w.name < n; });
+    return word != std::end(WORDS) && word->name == name ? word->flags : 0;
+}
+
+// Not given to renamed variables either (strict-mode words and globals a
+// script may rely on without mentioning them).
+bool is_unusable_name(std::string_view name) {
+    static const std::unordered_set<std::string_view> UNUSABLE = {
+        "let", "static", "implements", "interface", "package", "private", "protected", "public",
+        "arguments", "eval", "undefined", "NaN", "Infinity", "async", "of", "get", "set",
+    };
+    return (word_flags(name) & WORD_RESERVED) || UNUSABLE.count(name) != 0;
+}
+
+// --- Tokens ---
+
+enum class TokenType : uint8_t {
+    Name, // Identifiers, keywords, #private names
+    Number,
+    String,
+    Template,       // `...` without substitutions
+    TemplateHead,   // `...${
+    TemplateMiddle, // }...${
+    TemplateTail,   // }...`
+    Regex,
+    Punctuator,
+};
+
+struct Token {
+    std::string_view text;
+    TokenType type = TokenType::Punctuator;
+    bool newline_before = false;
+    bool object_brace = false; // '{' of an object literal or pattern (not a block)
+    bool shorthand = false;    // {name} in an object literal or pattern: written {name:renamed}
+    uint8_t word = 0;          // Names: WORD_* flags
+    bool reference = false;    // A name to look up from scope
+    bool head = false;         // '(' or ')' of an if/for/while/... head or a parameter list
+    int32_t match = -1;        // Openers: index of the closing token
+    int32_t scope = -1;
+    int32_t variable = -1; // Declared or referenced variable
+};
+
+// Literal lengths are known at compile time: no strlen per comparison.
+template <size_t N>
+inline bool is(const Token& token, const char (&punctuator)[N]) {
+    return token.type == TokenType::Punctuator && token.text.size() == N - 1 &&
+           std::memcmp(token.text.data(), punctuator, N - 1) == 0;
+}
+
+template <size_t N>
+inline bool is_name(const Token& token, const char (&name)[N]) {
+    return token.type == TokenType::Name && token.text.size() == N - 1 && std::memcmp(token.text.data(), name, N - 1) == 0;
+}
+
+// Whether a statement could end after token (so a line break after it may be a semicolon).
+bool ends_expression(const Token& token) {
+    switch (token.type) {
+    case TokenType::Number:
+    case TokenType::String:
+    case TokenType::Template:
+    case TokenType::TemplateTail:
+    case TokenType::Regex:
+        return true;
+    case TokenType::Name:
+        return !(token.word & WORD_OPERATOR);
+    case TokenType::Punctuator:
+        return token.text == ")" || token.text == "]" || token.text == "}" || token.text == "++" || token.text == "--";
+    default:
+        return false;
+    }
+}
+
+// Longest first.
+constexpr std::string_view PUNCTUATORS[] = {
+    ">>>=", "...", "===", "!==", "**=", "<<=", ">>=", ">>>", "&&=", "||=", "?\?=", "=>", "==", "!=", "<=", ">=", "&&",
+    "||", "??", "?.", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "<<", ">>", "**",
+};
+
+// --- Lexer ---
+// Besides the tokens, tracks the nesting of brackets: to match them up, and
+// to tell '/' and '{' apart by what encloses them.
+class Lexer {
+public:
+    Lexer(std::string_view js, std::vector<Token>& tokens) : js_(js), tokens_(tokens) {}
+
+    // False if the script cannot be tokenized (unterminated or unbalanced).
+    bool run() {
+        tokens_.clear();
+        tokens_.reserve(js_.size() / 4 + 16);
+        stack_.reserve(32);
+        stack_.assign(1, Nesting{'{', 0, 0}); // The script is a block
+        size_t pos = 0;
+        if (js_.compare(0, 2, "#!") == 0) pos = std::min(js_.find('\n'), js_.size());
+        bool newline = false;
+        while (pos < js_.size()) {
+            const char c = js_[pos];
+            if (has_class(c, JS_SPACE)) {
+                ++pos;
+                continue;
+            }
+            if (c == '\n') {
+                newline = true;
+                ++pos;
+                continue;
+            }
+            if (static_cast<unsigned char>(c) >= 0x80) {
+                bool line_terminator = false;
+                if (size_t length = unicode_space_length(js_, pos, line_terminator)) {
+                    newline = newline || line_terminator;
+                    pos += length;
+                    continue;
+                }
+            }
+            if (c == '/' || c == '<' || c == '-') {
+                if ((c == '/' && at(pos + 1) == '/') || js_.compare(pos, 4, "<!--") == 0 ||
+                    ((newline || tokens_.empty()) && js_.compare(pos, 3, "-->") == 0)) {
+                    pos = std::min(js_.find('\n', pos), js_.size()); // Line comments (HTML-like ones included)
+                    continue;
+                }
+                if (c == '/' && at(pos + 1) == '*') {
+                    const size_t close = js_.find("*/", pos + 2);
+                    if (close == std::string_view::npos) return false;
+                    if (std::memchr(js_.data() + pos, '\n', close - pos)) newline = true;
+                    pos = close + 2;
+                    continue;
+                }
+            }
+
+            Token token;
+            token.newline_before = newline;
+            newline = false;
+            const size_t start = pos;
+            if (has_class(c, JS_NAME_START) || (c == '#' && has_class(at(pos + 1), JS_NAME_START))) {
+                pos = consume_name(pos + 1);
+                token.type = TokenType::Name;
+                if (pos != std::string_view::npos) token.word = word_flags(js_.substr(start, pos - start));
+            } else if (has_class(c, JS_DIGIT) || (c == '.' && has_class(at(pos + 1), JS_DIGIT))) {
+                pos = consume_number(pos);
+                token.type = TokenType::Number;
+            } else if (c == '"' || c == '\'') {
+                pos = consume_string(pos);
+                token.type = TokenType::String;
+            } else if (c == '`' || (c == '}' && stack_.back().kind == '$')) {
+                pos = consume_template(pos, token);
+            } else if (c == '/' && regex_allowed()) {
+                pos = consume_regex(pos);
+                token.type = TokenType::Regex;
+            } else {
+                pos += punctuator_length(pos);
+                token.type = TokenType::Punctuator;
+            }
+            if (pos == std::string_view::npos) return false;
+            token.text = js_.substr(start, pos - start);
+            if (!track_nesting(token)) return false;
+            tokens_.push_back(token);
+        }
+        return stack_.size() == 1;
+    }
+
+private:
+    struct Nesting {
+        char kind;        // '{' block, 'o' object, '(' parentheses, 'c' statement head or parameters, '[', '$' substitution
+        int conditionals; // '?' waiting for their ':'
+        size_t opener;    // Token index
+    };
+
+    char at(size_t i) const { return i < js_.size() ? js_[i] : '\0'; }
+
+    size_t consume_name(size_t pos) const {
+        while (pos < js_.size()) {
+            const char c = js_[pos];
+            if (c == '\\') {
+                if (at(pos + 1) == 'u' && at(pos + 2) == '{') {
+                    const size_t close = js_.find('}', pos);
+                    if (close == std::string_view::npos) return close;
+                    pos = close + 1;
+                } else {
+                    pos += 2;
+                }
+                continue;
+            }
+            if (!has_class(c, JS_NAME)) break;
+            bool line_terminator = false;
+            if (static_cast<unsigned char>(c) >= 0x80 && unicode_space_length(js_, pos, line_terminator)) break;
+            ++pos;
+        }
+        return std::min(pos, js_.size());
+    }
+
+    size_t consume_number(size_t pos) const {
+        if (js_[pos] == '0' && std::strchr("xXoObB", at(pos + 1)) && at(pos + 1) != '\0') {
+            pos += 2;
+            while (has_class(at(pos), JS_NAME)) ++pos; // Digits, '_' and the BigInt 'n'
+            return pos;
+        }
+        auto digits = [&] {
+            while (has_class(at(pos), JS_DIGIT) || at(pos) == '_') ++pos;
+        };
+        digits();
+        if (at(pos) == '.') {
+            ++pos;
+            digits();
+        }
+        if (at(pos) == 'e' || at(pos) == 'E') {
+            const size_t exponent = at(pos + 1) == '+' || at(pos + 1) == '-' ? pos + 2 : pos + 1;
+            if (has_class(at(exponent), JS_DIGIT)) {
+                pos = exponent;
+                digits();
+            }
+        }
+        if (at(pos) == 'n') ++pos;
+        return pos;
+    }
+
+    size_t consume_string(size_t pos) const {
+        const char quote = js_[pos++];
+        while (pos < js_.size()) {
+            const char c = js_[pos];
+            if (c == quote) return pos + 1;
+            if (c == '\n' || c == '\r') return std::string_view::npos;
+            if (c == '\\') {
+                pos += at(pos + 1) == '\r' && at(pos + 2) == '\n' ? 3 : 2;
+                continue;
+            }
+            ++pos;
+        }
+        return std::string_view::npos;
+    }
+
+    // From '`' or the '}' ending a substitution, to '`' or "${".
+    size_t consume_template(size_t pos, Token& token) const {
+        const bool head = js_[pos] == '`';
+        ++pos;
+        while (pos < js_.size()) {
+            const char c = js_[pos];
+            if (c == '\\') {
+                pos += 2;
+            } else if (c == '`') {
+                token.type = head ? TokenType::Template : TokenType::TemplateTail;
+                return pos + 1;
+            } else if (c == '$' && at(pos + 1) == '{') {
+                token.type = head ? TokenType::TemplateHead : TokenType::TemplateMiddle;
+                return pos + 2;
+            } else {
+                ++pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    size_t consume_regex(size_t pos) const {
+        bool in_class = false;
+        for (++pos; pos < js_.size(); ++pos) {
+            const char c = js_[pos];
+            if (c == '\\') {
+                ++pos;
+                if (at(pos) == '\n' || at(pos) == '\r') return std::string_view::npos;
+            } else if (c == '\n' || c == '\r') {
+                return std::string_view::npos;
+            } else if (c == '[') {
+                in_class = true;
+            } else if (c == ']') {
+                in_class = false;
+            } else if (c == '/' && !in_class) {
+                ++pos;
+                while (has_class(at(pos), JS_NAME)) ++pos; // Flags
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    size_t punctuator_length(size_t pos) const {
+        const char c = js_[pos];
+        if (!std::strchr("<>=!*&|?.+-%^/", c)) return 1;
+        for (std::string_view punctuator : PUNCTUATORS) {
+            if (punctuator[0] != c) continue;
+            if (js_.compare(pos, punctuator.size(), punctuator) != 0) continue;
+            if (punctuator == "?." && has_class(at(pos + 2), JS_DIGIT)) continue; // a?.5:b
+            return punctuator.size();
+        }
+        return 1;
+    }
+
+    // Whether a '/' here starts a regular expression rather than dividing.
+    bool regex_allowed() const {
+        if (tokens_.empty()) return true;
+        const Token& last = tokens_.back();
+        switch (last.type) {
+        case TokenType::Name:
+            return last.word & WORD_EXPRESSION;
+        case TokenType::TemplateHead:
+        case TokenType::TemplateMiddle:
+            return true;
+        case TokenType::Punctuator:
+            if (last.text == ")") return last_paren_control_;
+            if (last.text == "}") return last_brace_block_;
+            return last.text != "]" && last.text != "++" && last.text != "--";
+        default:
+            return false;
+        }
+    }
+
+    // Whether a '{' here starts an object literal rather than a block.
+    bool object_brace() const {
+        if (tokens_.empty()) return false;
+        const Token& last = tokens_.back();
+        switch (last.type) {
+        case TokenType::Name:
+            return (last.word & WORD_EXPRESSION) && last.text != "do" && last.text != "else";
+        case TokenType::TemplateHead:
+        case TokenType::TemplateMiddle:
+            return true;
+        case TokenType::Punctuator:
+            if (last.text == ":") return last_colon_ternary_ || stack_.back().kind == 'o';
+            return last.text != ")" && last.text != "]" && last.text != "}" && last.text != "{" &&
+                   last.text != ";" && last.text != "=>" && last.text != "++" && last.text != "--";
+        default:
+            return false;
+        }
+    }
+
+    // Whether a '(' here opens the head of a statement (if, for, ...) or a
+    // parameter list, rather than a call or a parenthesized expression.
+    bool opens_head() const {
+        const size_t count = tokens_.size();
+        if (count == 0) return false;
+        const Token& last = tokens_.back();
+        if (count >= 2 && (is(tokens_[count - 2], ".") || is(tokens_[count - 2], "?."))) return false; // promise.catch(
+        if (last.type == TokenType::Name) {
+            for (const char* keyword : {"if", "while", "for", "with", "switch", "catch", "function"}) {
+                if (last.text == keyword) return true;
+            }
+        }
+        if (count >= 2 && (last.type == TokenType::Name || is(last, "*"))) {
+            const Token& before = tokens_[count - 2];
+            if (is_name(before, "function") || (is(before, "*") && count >= 3 && is_name(tokens_[count - 3], "function"))) {
+                return true;
+            }
+        }
+        // A method in an object literal: {name() {...}}
+        if (stack_.back().kind != 'o' || count < 2 ||
+            (last.type != TokenType::Name && last.type != TokenType::String && last.type != TokenType::Number)) {
+            return false;
+        }
+        const Token& before = tokens_[count - 2];
+        return is(before, "{") || is(before, ",") || is(before, "*") || is_name(before, "get") ||
+               is_name(before, "set") || is_name(before, "async");
+    }
+
+    bool close(size_t index, const char* kinds) {
+        if (stack_.size() < 2 || !std::strchr(kinds, stack_.back().kind)) return false;
+        tokens_[stack_.back().opener].match = static_cast<int32_t>(index);
+        stack_.pop_back();
+        return true;
+    }
+
+    bool track_nesting(Token& token) {
+        const size_t index = tokens_.size();
+        switch (token.type) {
+        case TokenType::TemplateHead:
+            stack_.push_back({'$', 0, index});
+            return true;
+        case TokenType::TemplateMiddle:
+            if (!close(index, "$")) return false;
+            stack_.push_back({'$', 0, index});
+            return true;
+        case TokenType::TemplateTail:
+            return close(index, "$");
+        case TokenType::Punctuator:
+            break;
+        default:
+            return true;
+        }
+        if (token.text.size() != 1) return true;
+        switch (token.text[0]) {
+        case '{':
+            token.object_brace = object_brace();
+            stack_.push_back({token.object_brace ? 'o' : '{', 0, index});
+            return true;
+        case '(':
+            token.head = opens_head();
+            stack_.push_back({token.head ? 'c' : '(', 0, index});
+            return true;
+        case '[':
+            stack_.push_back({'[', 0, index});
+            return true;
+        case '}':
+            last_brace_block_ = !stack_.empty() && stack_.back().kind == '{';
+            return close(index, "{o");
+        case ')':
+            last_paren_control_ = !stack_.empty() && stack_.back().kind == 'c';
+            token.head = last_paren_control_;
+            return close(index, "(c");
+        case ']':
+            return close(index, "[");
+        case '?':
+            ++stack_.back().conditionals;
+            return true;
+        case ':':
+            last_colon_ternary_ = stack_.back().conditionals > 0;
+            if (last_colon_ternary_) --stack_.back().conditionals;
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    std::string_view js_;
+    std::vector<Token>& tokens_;
+    std::vector<Nesting> stack_;
+    bool last_paren_control_ = false;
+    bool last_brace_block_ = false;
+    bool last_colon_ternary_ = false;
+};
+
+// --- Scope Analysis ---
+// One walk over the tokens with a stack of frames (blocks, object literals,
+// parameter lists, patterns, ...) declares every binding in its scope and
+// records the scope of every name read; the reads are looked up once all
+// declarations (hoisted ones included) are known.
+
+enum class FrameKind : uint8_t {
+    Block, // The script, blocks, function bodies
+    Object,
+    Class,
+    Paren,
+    Params, // Parameters of a function, or a catch binding
+    Bracket,
+    Template,
+    ArrowBody, // Expression body of an arrow function: ends without a token of its own
+    ForBody,   // Body of for (let ...) without braces: likewise
+};
+
+enum class Binding : uint8_t {
+    None,
+    Var,     // In the enclosing function's scope
+    Lexical, // In the frame's scope (let, const, class, parameters)
+};
+
+struct Frame {
+    FrameKind kind = FrameKind::Block;
+    int scope = 0;
+    Binding pattern = Binding::None;   // Object, Bracket, Params: a pattern declaring its names
+    bool slot = false;                 // Pattern: the next name (or pattern) is a binding
+    bool in_default = false;           // Pattern: in a default value, whose names are read
+    bool key = false;                  // Object, Class: the next name is a property key
+    Binding statement = Binding::None; // In a var/let/const declaration list
+    bool expecting = false;            // ... whose next name (or pattern) is declared
+    int conditionals = 0;              // '?' waiting for their ':'
+    int after = -1;                    // Params: the scope of the body; Paren: a for head's scope
+    bool arrow = false;                // Params of an arrow function
+    bool for_head = false;
+};
+
+struct Scope {
+    int parent = -1;
+    bool function = false; // Where var declarations go
+    bool catch_clause = false; // Holds the binding of a catch clause
+    std::vector<int> children;
+    std::vector<int> variables;
+    std::vector<std::pair<std::string_view, int>> names; // Few per scope: searched in order
+};
+
+struct Variable {
+    std::string_view name;
+    int scope = 0;
+    size_t uses = 0;
+    int same_name_as = -1; // A catch parameter a var redeclares: renamed with that var
+};
+
+// "a".."_", then "aa", "ba", ...: short names by index.
+std::string short_name(size_t index) {
+    static constexpr std::string_view FIRST = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_";
+    static constexpr std::string_view REST = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_0123456789";
+    std::string name(1, FIRST[index % FIRST.size()]);
+    index /= FIRST.size();
+    while (index > 0) {
+        --index;
+        name += REST[index % REST.size()];
+        index /= REST.size();
+    }
+    return name;
+}
+
+class ScopeAnalysis {
+public:
+    explicit ScopeAnalysis(std::vector<Token>& tokens) : tokens_(tokens) {}
+
+    // Declares and looks up every name; false if the script does something
+    // the renaming could not follow (the tokens are then left for writing
+    // without new names).
+    bool run() {
+        scopes_.emplace_back();
+        scopes_[0].function = true;
+        frames_.reserve(64);
+        frames_.emplace_back();
+        for (i_ = 0; i_ < tokens_.size(); ++i_) {
+            if (!step()) return false;
+        }
+        if (pending_body_ >= 0 || pending_arrow_ >= 0 || pending_params_ >= 0) return false;
+        for (Token& token : tokens_) {
+            if (!token.reference) continue;
+            for (int scope = token.scope; scope >= 0 && token.variable < 0; scope = scopes_[scope].parent) {
+                token.variable = find_name(scope, token.text);
+            }
+            if (token.variable < 0) unrenamed_.insert(token.text);
+        }
+        for (const Token& token : tokens_) {
+            if (token.variable >= 0) ++variables_[token.variable].uses;
+        }
+        for (const auto& [name, variable] : scopes_[0].names) unrenamed_.insert(name);
+        return true;
+    }
+
+    // New names by variable ("" for globals).
+    std::vector<std::string> rename(size_t& renamed) {
+        std::vector<std::string> names(variables_.size());
+        assign_names(0, names, renamed);
+        return names;
+    }
+
+private:
+    // Candidate names are short_name(index); in_use_ marks the indices taken
+    // by the variables of the scopes enclosing the current one.
+    void assign_names(int scope, std::vector<std::string>& names, size_t& renamed) {
+        std::vector<int>& variables = scopes_[scope].variables;
+        std::vector<size_t> taken;
+        if (scope != 0) {
+            std::stable_sort(variables.begin(), variables.end(),
+                             [&](int a, int b) { return variables_[a].uses > variables_[b].uses; });
+            taken.reserve(variables.size());
+            size_t candidate = 0;
+            for (int variable : variables) {
+                if (variables_[variable].same_name_as >= 0) {
+                    names[variable] = names[variables_[variable].same_name_as]; // Named before its scope
+                    continue;
+                }
+                while (!usable_candidate(candidate)) ++candidate;
+                in_use_[candidate] = 1;
+                taken.push_back(candidate);
+                names[variable] = candidates_[candidate];
+                ++renamed;
+            }
+        }
+        for (int child : scopes_[scope].children) assign_names(child, names, renamed);
+        for (size_t candidate : taken) in_use_[candidate] = 0;
+    }
+
+    bool usable_candidate(size_t index) {
+        while (candidates_.size() <= index) {
+            std::string name = short_name(candidates_.size());
+            blocked_.push_back(is_unusable_name(name) || unrenamed_.count(name) != 0);
+            in_use_.push_back(0);
+            candidates_.push_back(std::move(name));
+        }
+        return !blocked_[index] && !in_use_[index];
+    }
+
+    int find_name(int scope, std::string_view name) const {
+        for (const auto& [declared, variable] : scopes_[scope].names) {
+            if (declared == name) return variable;
+        }
+        return -1;
+    }
+
+    const Token* token_at(size_t index) const { return index < tokens_.size() ? &tokens_[index] : nullptr; }
+
+    int new_scope(int parent, bool function) {
+        const int scope = static_cast<int>(scopes_.size());
+        scopes_.emplace_back();
+        scopes_[scope].parent = parent;
+        scopes_[scope].function = function;
+        scopes_[parent].children.push_back(scope);
+        return scope;
+    }
+
+    int function_scope(int scope) const {
+        while (!scopes_[scope].function) scope = scopes_[scope].parent;
+        return scope;
+    }
+
+    void declare_in(Token& token, int scope) {
+        int variable = find_name(scope, token.text);
+        if (variable < 0) {
+            variable = static_cast<int>(variables_.size());
+            variables_.push_back(Variable{token.text, scope, 0});
+            scopes_[scope].names.emplace_back(token.text, variable);
+            scopes_[scope].variables.push_back(variable);
+        }
+        token.variable = variable;
+    }
+
+    void declare(Token& token, Binding binding, int frame_scope) {
+        if (binding != Binding::Var) {
+            declare_in(token, frame_scope);
+            return;
+        }
+        const int function = function_scope(frame_scope);
+        declare_in(token, function);
+        // Annex B.3.5: "catch (e) { var e = 1; }" declares e in the function
+        // but assigns the catch parameter. Both keep one name, so the var
+        // still hoists past the parameter and its initializer still hits it.
+        for (int scope = frame_scope; scope != function; scope = scopes_[scope].parent) {
+            if (!scopes_[scope].catch_clause) continue;
+            if (const int parameter = find_name(scope, token.text); parameter >= 0) {
+                variables_[parameter].same_name_as = token.variable;
+                break;
+            }
+        }
+    }
+
+    void reference(Token& token, int scope) {
+        token.reference = true;
+        token.scope = scope;
+    }
+
+    // Takes the binding the next pattern would declare, if it is in one's place.
+    Binding take_binding_slot() {
+        Frame& frame = frames_.back();
+        if (frame.pattern != Binding::None && frame.slot && !frame.in_default) {
+            frame.slot = false;
+            return frame.pattern;
+        }
+        if (frame.statement != Binding::None && frame.expecting) {
+            frame.expecting = false;
+            return frame.statement;
+        }
+        return Binding::None;
+    }
+
+    void pop_bodies(bool for_bodies) {
+        while (frames_.size() > 1 && (frames_.back().kind == FrameKind::ArrowBody ||
+                                      (for_bodies && frames_.back().kind == FrameKind::ForBody))) {
+            frames_.pop_back();
+        }
+    }
+
+    // Whether a declaration at index would be a statement of its own (a
+    // function declaration rather than a function expression, a label).
+    bool statement_position(size_t index) const {
+        const Frame& top = frames_.back();
+        if (top.kind != FrameKind::Block && top.kind != FrameKind::ForBody) return false;
+        if (index > 0 && is_name(tokens_[index - 1], "async")) --index;
+        if (index == 0) return true;
+        const Token& previous = tokens_[index - 1];
+        if (previous.type == TokenType::Punctuator) {
+            const std::string_view p = previous.text;
+            if (p == ";" || p == "{" || p == "}" || p == ")") return true;
+            if (p == ":") return !last_colon_ternary_;
+        }
+        if (is_name(previous, "else") || is_name(previous, "do")) return true;
+        return tokens_[index].newline_before && ends_expression(previous);
+    }
+
+    bool step() {
+        Token& token = tokens_[i_];
+        const Token* previous = i_ > 0 ? &tokens_[i_ - 1] : nullptr;
+        // Automatic semicolon insertion ends arrow and for bodies and declaration lists
+        if (token.newline_before && previous && ends_expression(*previous) &&
+            !(is_name(*previous, "let") && frames_.back().expecting)) {
+            const bool starts_statement =
+                (token.type == TokenType::Name && token.text != "in" && token.text != "instanceof" && token.text != "of") ||
+                token.type == TokenType::Number || token.type == TokenType::String || token.type == TokenType::Regex ||
+                is(token, "{") || is(token, "++") || is(token, "--") || is(token, "!") || is(token, "~");
+            if (starts_statement) {
+                pop_bodies(true);
+                frames_.back().statement = Binding::None;
+            }
+        }
+        if (pending_for_ >= 0) {
+            const int scope = pending_for_;
+            pending_for_ = -1;
+            if (is(token, "{")) {
+                block_parent_ = scope;
+            } else {
+                // Where a braceless if/for/... body ends is beyond this walk
+                if ((token.word & WORD_RESERVED) && token.text != "this" &&
+                    token.text != "new" && token.text != "typeof" && token.text != "void" && token.text != "delete") {
+                    return false;
+                }
+                Frame body;
+                body.kind = FrameKind::ForBody;
+                body.scope = scope;
+                frames_.push_back(body);
+            }
+        }
+        if (pending_body_ >= 0 && !is(token, "{")) return false;
+        if (pending_arrow_ >= 0 && !is(token, "=>")) return false;
+
+        switch (token.type) {
+        case TokenType::Name:
+            return name(token);
+        case TokenType::TemplateHead:
+            push_inherited(FrameKind::Template);
+            return true;
+        case TokenType::TemplateMiddle:
+            if (!close(FrameKind::Template)) return false;
+            push_inherited(FrameKind::Template);
+            return true;
+        case TokenType::TemplateTail:
+            return close(FrameKind::Template);
+        case TokenType::Punctuator:
+            return punctuator(token);
+        default:
+            return true;
+        }
+    }
+
+    void push_inherited(FrameKind kind) {
+        Frame frame;
+        frame.kind = kind;
+        frame.scope = frames_.back().scope;
+        frames_.push_back(frame);
+    }
+
+    bool close(FrameKind kind, FrameKind other = FrameKind::Template, FrameKind third = FrameKind::Template) {
+        pop_bodies(true);
+        if (frames_.size() < 2) return false;
+        const Frame frame = frames_.back();
+        if (frame.kind != kind && frame.kind != other && frame.kind != third) return false;
+        frames_.pop_back();
+        Frame& top = frames_.back();
+        if (frame.kind == FrameKind::Params) {
+            (frame.arrow ? pending_arrow_ : pending_body_) = frame.after;
+        } else if (frame.kind == FrameKind::Paren && frame.for_head && frame.after >= 0) {
+            pending_for_ = frame.after;
+        } else if (frame.kind == FrameKind::Block && top.kind == FrameKind::Class) {
+            top.key = true; // After a method body or static block
+        }
+        return true;
+    }
+
+    bool name(Token& token) {
+        const std::string_view text = token.text;
+        const Token* previous = i_ > 0 ? &tokens_[i_ - 1] : nullptr;
+        const Token* next = token_at(i_ + 1);
+        if (text[0] == '#') return true; // Private names are properties
+        if (text.find('\\') != std::string_view::npos) return false;
+        if (previous && (is(*previous, ".") || is(*previous, "?."))) return true;
+        Frame& top = frames_.back();
+
+        if ((top.kind == FrameKind::Object || top.kind == FrameKind::Class) && top.key) {
+            const bool modifier = text == "get" || text == "set" || text == "async" || text == "static";
+            if (modifier && next && !next->newline_before &&
+                (next->type == TokenType::Name || next->type == TokenType::String || next->type == TokenType::Number ||
+                 is(*next, "[") || is(*next, "*") || (text == "static" && is(*next, "{")))) {
+                return true;
+            }
+            if (top.kind == FrameKind::Object && next && (is(*next, ",") || is(*next, "}") || is(*next, "="))) {
+                if (token.word & WORD_RESERVED) return false;
+                token.shorthand = true;
+                top.key = false;
+                if (top.pattern != Binding::None) {
+                    declare(token, top.pattern, top.scope);
+                } else {
+                    reference(token, top.scope);
+                }
+                return true;
+            }
+            return true; // A property key, followed by ':' or '('
+        }
+
+        if (token.word & WORD_RESERVED) return keyword(token);
+        if (text == "let" && next && (next->type == TokenType::Name || is(*next, "[") || is(*next, "{"))) {
+            top.statement = Binding::Lexical;
+            top.expecting = true;
+            return true;
+        }
+        if (text == "async" && next && !next->newline_before) {
+            const Token* after_next = token_at(i_ + 2);
+            if (is_name(*next, "function") || (next->type == TokenType::Name && after_next && is(*after_next, "=>")) ||
+                (is(*next, "(") && next->match >= 0 && token_at(next->match + 1) && is(tokens_[next->match + 1], "=>"))) {
+                return true;
+            }
+        }
+        if (text == "of" && top.for_head && previous && ends_expression(*previous)) {
+            top.statement = Binding::None;
+            return true;
+        }
+        if (text == "eval") return false; // Direct eval sees local names
+
+        if (top.pattern != Binding::None && top.slot && !top.in_default) {
+            top.slot = false;
+            declare(token, top.pattern, top.scope);
+            return true;
+        }
+        if (top.statement != Binding::None && top.expecting) {
+            top.expecting = false;
+            declare(token, top.statement, top.scope);
+            return true;
+        }
+        if (next && is(*next, "=>")) { // x => ...
+            const int scope = new_scope(top.scope, true);
+            declare_in(token, scope);
+            pending_arrow_ = scope;
+            return true;
+        }
+        // Labels (a separate namespace) keep their names
+        if (previous && (is_name(*previous, "break") || is_name(*previous, "continue")) && !token.newline_before) return true;
+        if (next && is(*next, ":") && top.conditionals == 0 && statement_position(i_)) return true;
+        reference(token, top.scope);
+        return true;
+    }
+
+    bool keyword(Token& token) {
+        const std::string_view text = token.text;
+        Frame& top = frames_.back();
+        if (text == "var" || text == "const") {
+            top.statement = text == "var" ? Binding::Var : Binding::Lexical;
+            top.expecting = true;
+            return true;
+        }
+        if (text == "function") {
+            const bool declaration = statement_position(i_);
+            const int scope = new_scope(top.scope, true);
+            size_t next = i_ + 1;
+            if (next < tokens_.size() && is(tokens_[next], "*")) ++next;
+            if (next < tokens_.size() && tokens_[next].type == TokenType::Name) {
+                Token& name_token = tokens_[next];
+                if ((name_token.word & WORD_RESERVED) || name_token.text.find('\\') != std::string_view::npos) return false;
+                if (declaration) {
+                    declare(name_token, Binding::Var, top.scope);
+                } else {
+                    declare_in(name_token, scope); // Only visible inside the function expression
+                }
+                ++next;
+            }
+            pending_params_ = scope;
+            i_ = next - 1;
+            return true;
+        }
+        if (text == "class") {
+            const bool declaration = statement_position(i_);
+            const int scope = new_scope(top.scope, false);
+            const Token* next = token_at(i_ + 1);
+            if (next && next->type == TokenType::Name && !(next->word & WORD_RESERVED)) {
+                Token& name_token = tokens_[i_ + 1];
+                if (name_token.text.find('\\') != std::string_view::npos) return false;
+                if (declaration) {
+                    declare(name_token, Binding::Lexical, top.scope);
+                } else {
+                    declare_in(name_token, scope);
+                }
+                ++i_;
+            }
+            pending_class_ = scope;
+            pending_class_depth_ = frames_.size();
+            return true;
+        }
+        if (text == "in" && top.for_head) {
+            top.statement = Binding::None;
+            return true;
+        }
+        return text != "with" && text != "import" && text != "export";
+    }
+
+    bool punctuator(Token& token) {
+        const std::string_view p = token.text;
+        if (p == "{") return open_brace(token);
+        if (p == "(") return open_paren(token);
+        if (p == "[") return open_bracket();
+        if (p == "}") return close(FrameKind::Block, FrameKind::Object, FrameKind::Class);
+        if (p == ")") return close(FrameKind::Paren, FrameKind::Params);
+        if (p == "]") return close(FrameKind::Bracket);
+        if (p == "=>") {
+            if (pending_arrow_ < 0) return false;
+            const int scope = pending_arrow_;
+            pending_arrow_ = -1;
+            const Token* next = token_at(i_ + 1);
+            if (next && is(*next, "{")) {
+                pending_body_ = scope;
+            } else {
+                Frame body;
+                body.kind = FrameKind::ArrowBody;
+                body.scope = scope;
+                frames_.push_back(body);
+            }
+            return true;
+        }
+        if (p == ",") {
+            pop_bodies(false);
+            Frame& top = frames_.back();
+            if (top.statement != Binding::None) top.expecting = true;
+            if (top.pattern != Binding::None) {
+                top.slot = top.kind != FrameKind::Object;
+                top.in_default = false;
+            }
+            if (top.kind == FrameKind::Object) top.key = true;
+            return true;
+        }
+        if (p == ";") {
+            pop_bodies(false);
+            Frame& top = frames_.back();
+            top.statement = Binding::None;
+            if (top.kind == FrameKind::ForBody) {
+                frames_.pop_back();
+            } else if (top.kind == FrameKind::Class) {
+                top.key = true;
+            }
+            return true;
+        }
+        Frame& top = frames_.back();
+        if (p == "=") {
+            if (top.pattern != Binding::None) {
+                top.in_default = true;
+                top.slot = false;
+            } else if (top.kind == FrameKind::Class && top.key) {
+                return false; // Class field initializers: where they end is beyond this walk
+            }
+            if (top.statement != Binding::None) top.expecting = false;
+            return true;
+        }
+        if (p == "?") {
+            ++top.conditionals;
+            return true;
+        }
+        if (p == ":") {
+            last_colon_ternary_ = top.conditionals > 0;
+            if (last_colon_ternary_) {
+                --top.conditionals;
+            } else if (top.kind == FrameKind::Object) {
+                top.key = false;
+                if (top.pattern != Binding::None) top.slot = true;
+            }
+            return true;
+        }
+        if (p == "...") {
+            if (top.pattern != Binding::None) top.slot = true;
+            if (top.kind == FrameKind::Object) top.key = false;
+            return true;
+        }
+        return true;
+    }
+
+    bool open_brace(const Token& token) {
+        Frame frame;
+        frame.scope = frames_.back().scope;
+        if (pending_body_ >= 0) {
+            frame.kind = FrameKind::Block; // A function body, in the scope of its parameters
+            frame.scope = pending_body_;
+            pending_body_ = -1;
+        } else if (pending_class_ >= 0 && pending_class_depth_ == frames_.size()) {
+            frame.kind = FrameKind::Class;
+            frame.scope = pending_class_;
+            frame.key = true;
+            pending_class_ = -1;
+        } else if (Binding binding = take_binding_slot(); binding != Binding::None) {
+            frame.kind = FrameKind::Object;
+            frame.pattern = binding;
+            frame.key = true;
+        } else if (token.object_brace) {
+            frame.kind = FrameKind::Object;
+            frame.key = true;
+        } else {
+            frame.kind = FrameKind::Block;
+            frame.scope = new_scope(block_parent_ >= 0 ? block_parent_ : frame.scope, false);
+        }
+        block_parent_ = -1;
+        frames_.push_back(frame);
+        return true;
+    }
+
+    bool open_paren(const Token& token) {
+        const Token* previous = i_ > 0 ? &tokens_[i_ - 1] : nullptr;
+        if (previous && i_ >= 2 && (is(tokens_[i_ - 2], ".") || is(tokens_[i_ - 2], "?."))) previous = nullptr; // promise.catch(
+        const Token* next = token_at(i_ + 1);
+        Frame& top = frames_.back();
+        Frame frame;
+        frame.kind = FrameKind::Paren;
+        frame.scope = top.scope;
+        auto parameters = [&](int scope, bool arrow) {
+            frame.kind = FrameKind::Params;
+            frame.pattern = Binding::Lexical;
+            frame.slot = true;
+            frame.scope = frame.after = scope;
+            frame.arrow = arrow;
+        };
+        if (pending_params_ >= 0) {
+            parameters(pending_params_, false);
+            pending_params_ = -1;
+        } else if ((top.kind == FrameKind::Object || top.kind == FrameKind::Class) && top.key) {
+            parameters(new_scope(top.scope, true), false); // A method
+        } else if (token.match >= 0 && token_at(token.match + 1) && is(tokens_[token.match + 1], "=>")) {
+            parameters(new_scope(top.scope, true), true);
+        } else if (previous && (is_name(*previous, "for") || (is_name(*previous, "await") && i_ >= 2 && is_name(tokens_[i_ - 2], "for")))) {
+            frame.for_head = true;
+            if (next && (is_name(*next, "let") || is_name(*next, "const"))) frame.scope = frame.after = new_scope(top.scope, false);
+        } else if (previous && is_name(*previous, "catch")) {
+            const int scope = new_scope(top.scope, false);
+            scopes_[scope].catch_clause = true;
+            parameters(scope, false);
+        }
+        frames_.push_back(frame);
+        return true;
+    }
+
+    bool open_bracket() {
+        Frame& top = frames_.back();
+        Frame frame;
+        frame.kind = FrameKind::Bracket;
+        frame.scope = top.scope;
+        const bool computed_key = (top.kind == FrameKind::Object || top.kind == FrameKind::Class) && top.key;
+        if (!computed_key) {
+            if (Binding binding = take_binding_slot(); binding != Binding::None) {
+                frame.pattern = binding;
+                frame.slot = true;
+            }
+        }
+        frames_.push_back(frame);
+        return true;
+    }
+
+    std::vector<Token>& tokens_;
+    size_t i_ = 0;
+    std::vector<Frame> frames_;
+    std::vector<Scope> scopes_;
+    std::vector<Variable> variables_;
+    std::unordered_set<std::string_view> unrenamed_; // Globals and undeclared names
+    std::vector<std::string> candidates_;
+    std::vector<char> blocked_; // By candidate: reserved, or the name of a global
+    std::vector<char> in_use_;
+    // What the next tokens open (scope indices, -1: nothing pending)
+    int pending_params_ = -1; // '(' of a function's parameters
+    int pending_body_ = -1;   // '{' of a function body
+    int pending_arrow_ = -1;  // "=>"
+    int pending_for_ = -1;    // Body of a for (let ...)
+    int block_parent_ = -1;   // Parent scope of the next block
+    int pending_class_ = -1;
+    size_t pending_class_depth_ = 0;
+    bool last_colon_ternary_ = false;
+};
+
+// --- Writing ---
+
+inline bool is_name_char(char c) {
+    return has_class(c, JS_NAME);
+}
+
+// Whether a space must separate a token ending in last from one starting
+// with first, so they still read as the same two tokens.
+bool needs_space(char last, const Token& previous, char first) {
+    if (is_name_char(last) && is_name_char(first)) return true;
+    if (previous.type == TokenType::Regex && is_name_char(first)) return true; // /a/ in b: not flags
+    if ((last == '+' || last == '-') && first == last) return true;
+    if (last == '/' && (first == '/' || first == '*')) return true;
+    if (last == '<' && first == '!') return true; // <!--
+    if (last == '-' && first == '>') return true; // -->
+    if (previous.type == TokenType::Number && first == '.') {
+        return std::all_of(previous.text.begin(), previous.text.end(), [](char c) { return has_class(c, JS_DIGIT); });
+    }
+    return false;
+}
+
+// Whether a line break between previous and token can stand for a semicolon.
+bool keeps_line_break(const Token& previous, const Token& token) {
+    if (!ends_expression(previous)) return false;
+    if ((previous.head && is(token, "{")) || (token.head && is(token, "("))) return false; // if\n(, ...)\n{
+    switch (token.type) {
+    case TokenType::Name:
+    case TokenType::Number:
+    case TokenType::String:
+    case TokenType::Template:
+    case TokenType::TemplateHead:
+    case TokenType::Regex:
+        return true;
+    case TokenType::Punctuator:
+        return token.text == "(" || token.text == "[" || token.text == "{" || token.text == "+" || token.text == "-" ||
+               token.text == "++" || token.text == "--" || token.text == "!" || token.text == "~";
+    default:
+        return false;
+    }
+}
+
+std::string write_tokens(const std::vector<Token>& tokens, const std::vector<std::string>& names, size_t size_hint) {
+    std::string out;
+    out.reserve(size_hint);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const Token& token = tokens[i];
+        std::string_view renamed;
+        if (token.variable >= 0 && static_cast<size_t>(token.variable) < names.size()) renamed = names[token.variable];
+        const std::string_view first_piece = renamed.empty() || token.shorthand ? token.text : renamed;
+        if (i > 0) {
+            if (token.newline_before && keeps_line_break(tokens[i - 1], token)) {
+                out += '\n';
+            } else if (needs_space(out.back(), tokens[i - 1], first_piece[0])) {
+                out += ' ';
+            }
+        }
+        out.append(first_piece);
+        if (!renamed.empty() && token.shorthand) {
+            out += ':';
+            out.append(renamed);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+std::string minify_js_with(std::string_view js, bool mangle, JsMinifyStats& stats) {
+    std::vector<Token> tokens;
+    if (!Lexer(js, tokens).run()) return std::string(js);
+    stats.tokenized = true;
+    stats.tokens = tokens.size();
+    std::vector<std::string> names;
+    if (mangle) {
+        ScopeAnalysis analysis(tokens);
+        if (analysis.run()) {
+            names = analysis.rename(stats.renamed);
+            stats.mangled = true;
+        }
+    }
+    return write_tokens(tokens, names, js.size());
+}
+
+std::string minify_js(const std::string& js) {
+    JsMinifyStats stats;
+    return minify_js_with(js, true, stats);
+}
+
+bool js_tokens(std::string_view js, std::vector<std::string_view>& tokens) {
+    std::vector<Token> lexed;
+    if (!Lexer(js, lexed).run()) return false;
+    tokens.clear();
+    tokens.reserve(lexed.size());
+    for (const Token& token : lexed) tokens.push_back(token.text);
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef JS_MINIFIER_H
+#define JS_MINIFIER_H
+
+#include "common_utils.h"
+
+// --- JavaScript Minifier ---
+// minify_js (declared in common_utils.h) lexes the script in one pass into
+// tokens (views into the input), renames its local variables, then writes the
+// tokens back out:
+//   comments     dropped
+//   whitespace   dropped, except a space between tokens that would otherwise
+//                run together (a b, a+ +b, 1 .x) and a line break where one
+//                separated two tokens that automatic semicolon insertion
+//                could act on (a\n++b, return\nx)
+//   / ... /      a regular expression or a division, told apart by the token
+//                before it the way the parser does (after ')' of an if/for/
+//                while head or '}' of a block: a regular expression)
+//   templates    `...${ and }...` are tokens of their own, so substitutions
+//                are minified like the code around them
+//   names        parameters, variables and functions local to a function or
+//                block get the shortest names that none of their uses can
+//                confuse with another variable (frequent ones first, reused
+//                across sibling scopes); {shorthand} properties are expanded
+//                to keep their key
+// Top-level declarations are globals that other scripts share (search-logic.js
+// reads search-index.js's), and property names are part of the data, so
+// neither is renamed. A script using what scope analysis cannot follow (eval,
+// with, modules, class fields, escaped names) keeps every name; one the lexer
+// cannot tokenize (an unterminated string, say) is copied as it is.
+
+struct JsMinifyStats {
+    bool tokenized = false; // False: copied as it is
+    bool mangled = false;   // Names were renamed
+    size_t tokens = 0;
+    size_t renamed = 0;     // Local variables renamed
+};
+
+// minify_js, optionally without renaming.
+std::string minify_js_with(std::string_view js, bool mangle, JsMinifyStats& stats);
+
+// The tokens of js (comments and whitespace dropped), for comparing scripts
+// token by token (asset_minify_bench). False if it cannot be tokenized.
+bool js_tokens(std::string_view js, std::vector<std::string_view>& tokens);
+
+#endif // JS_MINIFIER_H
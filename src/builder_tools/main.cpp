@@ -0,0 +1,164 @@
+#include "dev_server.h"
+#include "pipeline.h"
+#include "trace.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+
+static void print_usage(const char* program) {
+    std::cout << "Usage: " << program << " [--jobs N] [--clean] [--dev] [--archive-page-size N] [--fingerprint-assets] [--critical-css] [--codecs LIST] [--min-gain PCT] [--max-memory MB] [--trace FILE [--trace-top N]]" << std::endl;
+    std::cout << "  -j, --jobs N   Worker threads (default: one per hardware thread)" << std::endl;
+    std::cout << "  --clean        Ignore the build manifest and rebuild everything" << std::endl;
+    std::cout << "  --dev          Faster compression settings for pages (local previews, not deploys)" << std::endl;
+    std::cout << "  --archive-page-size N  Posts per archive page (default " << DEFAULT_ARCHIVE_PAGE_SIZE << ")" << std::endl;
+    std::cout << "  --fingerprint-assets   Content-hashed CSS/JS names (shared.<hash>.css) + public/asset-manifest.json" << std::endl;
+    std::cout << "  --critical-css Inline each page's above-the-fold CSS rules and load the stylesheets without blocking" << std::endl;
+    std::cout << "  --codecs LIST  Precompressed siblings to write: br,zst,gz or none (default: every one built in)" << std::endl;
+    std::cout << "  --min-gain PCT Keep a precompressed sibling only if it saves PCT% of the size (default "
+              << static_cast<int>(DEFAULT_PRECOMPRESS_MIN_GAIN * 100) << ")" << std::endl;
+    std::cout << "  --max-memory MB  Stream posts and spill the search index to disk to stay within MB (very large sites)" << std::endl;
+    std::cout << "  --trace FILE   Record per-stage/per-post spans as a Chrome trace (Perfetto, chrome://tracing)" << std::endl;
+    std::cout << "  --trace-top N  Rows in the slowest stages/posts summary printed with --trace (default 10)" << std::endl;
+    std::cout << "       " << program << " serve [--watch] [--port N] [--jobs N] [--clean] [--release] [--archive-page-size N]" << std::endl;
+    std::cout << "  Builds with --dev settings (unless --release), then serves public/ on 127.0.0.1." << std::endl;
+    std::cout << "  --watch        Rebuild on changes under src/blog_content and live-reload open pages" << std::endl;
+    std::cout << "  --port N       HTTP port (default 8000)" << std::endl;
+}
+
+static bool parse_archive_page_size(const char* value, BuildOptions& options) {
+    int page_size = std::atoi(value);
+    if (page_size <= 0) {
+        std::cerr << "Error: --archive-page-size expects a positive number." << std::endl;
+        return false;
+    }
+    options.archive_page_size = static_cast<size_t>(page_size);
+    return true;
+}
+
+static bool parse_min_gain(const char* value, BuildOptions& options) {
+    char* end = nullptr;
+    double percent = std::strtod(value, &end);
+    if (end == value || *end != '\0' || percent < 0 || percent >= 100) {
+        std::cerr << "Error: --min-gain expects a percentage from 0 to 99." << std::endl;
+        return false;
+    }
+    options.precompress.min_gain = percent / 100;
+    return true;
+}
+
+static bool parse_max_memory(const char* value, BuildOptions& options) {
+    char* end = nullptr;
+    unsigned long long megabytes = std::strtoull(value, &end, 10);
+    if (end == value || *end != '\0' || megabytes == 0) {
+        std::cerr << "Error: --max-memory expects a positive number of megabytes." << std::endl;
+        return false;
+    }
+    options.max_memory = static_cast<size_t>(megabytes) << 20;
+    return true;
+}
+
+static int run_serve(int argc, char* argv[]) {
+    ServeOptions options;
+    options.build.dev = true;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg == "--watch") {
+            options.watch = true;
+        } else if (arg == "--port" && i + 1 < argc) {
+            int port = std::atoi(argv[++i]);
+            if (port <= 0 || port > 65535) {
+                std::cerr << "Error: --port expects a port number." << std::endl;
+                return 1;
+            }
+            options.port = static_cast<uint16_t>(port);
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            int jobs = std::atoi(argv[++i]);
+            if (jobs <= 0) {
+                std::cerr << "Error: --jobs expects a positive number." << std::endl;
+                return 1;
+            }
+            options.build.jobs = static_cast<unsigned>(jobs);
+        } else if (arg == "--clean") {
+            options.build.clean = true;
+        } else if (arg == "--release") {
+            options.build.dev = false;
+        } else if (arg == "--archive-page-size" && i + 1 < argc) {
+            if (!parse_archive_page_size(argv[++i], options.build)) return 1;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    return serve_site(options) ? 0 : 1;
+}
+
+// Single-process driver: runs every stage as a library call and keeps posts in
+// memory, instead of piping JSON between process_markdown, generate_pages and
+// generate_search. Run from the repository root, like build.sh.
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "serve") return run_serve(argc, argv);
+
+    BuildOptions options;
+    fs::path trace_path;
+    size_t trace_top = 10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            int jobs = std::atoi(argv[++i]);
+            if (jobs <= 0) {
+                std::cerr << "Error: --jobs expects a positive number." << std::endl;
+                return 1;
+            }
+            options.jobs = static_cast<unsigned>(jobs);
+        } else if (arg == "--clean") {
+            options.clean = true;
+        } else if (arg == "--dev") {
+            options.dev = true;
+        } else if (arg == "--fingerprint-assets") {
+            options.fingerprint_assets = true;
+        } else if (arg == "--critical-css") {
+            options.critical_css = true;
+        } else if (arg == "--codecs" && i + 1 < argc) {
+            if (!parse_codec_list(argv[++i], options.precompress.codecs)) return 1;
+        } else if (arg == "--min-gain" && i + 1 < argc) {
+            if (!parse_min_gain(argv[++i], options)) return 1;
+        } else if (arg == "--archive-page-size" && i + 1 < argc) {
+            if (!parse_archive_page_size(argv[++i], options)) return 1;
+        } else if (arg == "--max-memory" && i + 1 < argc) {
+            if (!parse_max_memory(argv[++i], options)) return 1;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--trace-top" && i + 1 < argc) {
+            int top = std::atoi(argv[++i]);
+            if (top <= 0) {
+                std::cerr << "Error: --trace-top expects a positive number." << std::endl;
+                return 1;
+            }
+            trace_top = static_cast<size_t>(top);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    if (!trace_path.empty()) start_tracing();
+
+    bool ok = build_site(options);
+    // Written even for a failed build: that is when it is most wanted.
+    if (!trace_path.empty() && !finish_tracing(trace_path, trace_top)) ok = false;
+    if (!ok) return 1;
+
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+    std::cout << "🎉 Build finished in " << elapsed_ms << " ms." << std::endl;
+    return 0;
+}
@@ -0,0 +1,474 @@
+#include "pipeline.h"
+#include "asset_manifest.h"
+#include "build_manifest.h"
+#include "related_posts.h"
+#include "search_segments.h"
+#include "task_graph.h"
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+// Higher runs first among ready tasks: finishing posts already in flight beats
+// starting new ones, which is what keeps the per-post stages pipelined.
+enum TaskPriority {
+    PRIORITY_READ = 0,
+    PRIORITY_PARSE = 1,
+    PRIORITY_INDEX = 2,
+    PRIORITY_RENDER = 3,
+    PRIORITY_WRITE = 4,
+    PRIORITY_SITE_PAGES = 5,
+};
+
+// Manifest keys for the synthetic inputs shared by site-wide pages.
+static const char POST_LIST_INPUT[] = "site:post-list"; // id/title/date/permalink/excerpt of every post
+static const char SEARCH_INPUT[] = "site:search";       // search-index.js: content hash and listing of every post
+static const char SEARCH_SEGMENT_INPUT_PREFIX[] = "search-segment:"; // + segment name, also its hash
+static const char ARCHIVE_INPUT_PREFIX[] = "archive:";  // + page path: metadata of the posts it lists
+static const char ASSETS_INPUT[] = "site:assets";        // Published names of the fingerprinted assets
+static const char RELATED_INPUT_PREFIX[] = "related:";   // + post file: its related posts block
+
+static std::string relative_to_public(const fs::path& path) {
+    return path.lexically_relative(PUBLIC_DIR).generic_string();
+}
+
+bool build_site(const BuildOptions& options) {
+    unsigned jobs = options.jobs == 0 ? default_job_count() : options.jobs;
+    set_dev_compression(options.dev);
+    // Dev and release builds compress differently, so neither may reuse the other's outputs.
+    const std::string tool_version = options.dev ? BUILDER_VERSION + "-dev" : BUILDER_VERSION;
+
+    // --- Previous build state ---
+    BuildManifest previous_manifest;
+    bool incremental;
+    {
+        TraceSpan span("load manifest");
+        incremental = !options.clean
+            && previous_manifest.load(BUILD_MANIFEST_PATH)
+            && previous_manifest.tool_version() == tool_version
+            && fs::exists(PUBLIC_DIR);
+    }
+    BuildManifest manifest;
+    manifest.set_tool_version(tool_version);
+    const bool streaming = options.max_memory > 0;
+    search_index.set_memory_budget(options.max_memory / 4, SEARCH_SPILL_DIR);
+
+    if (incremental) {
+        std::cout << "♻️  Incremental build (manifest " << BUILD_MANIFEST_PATH << ")" << std::endl;
+        if (!ensure_public_dirs()) return false;
+    } else if (!clean_public_dir()) {
+        return false;
+    }
+
+    // An output can be kept if the previous build produced it from the same,
+    // unchanged inputs and it is still on disk.
+    auto output_fresh = [&](const fs::path& output_path, const std::vector<std::string>& input_keys) {
+        return incremental
+            && previous_manifest.output_up_to_date(relative_to_public(output_path), input_keys, manifest)
+            && fs::exists(output_path);
+    };
+    auto record_output = [&](const fs::path& output_path, const std::vector<std::string>& input_keys) {
+        manifest.add_output(relative_to_public(output_path), input_keys);
+    };
+
+    // --- Static assets (loaded up front: fingerprinted names go into the templates) ---
+    std::vector<StaticAsset> static_assets;
+    AssetManifest asset_manifest;
+    for (const auto& source_path : list_static_assets()) {
+        StaticAsset asset;
+        if (!load_static_asset(source_path, options.fingerprint_assets, asset)) return false;
+        if (options.fingerprint_assets) asset_manifest.add(static_asset_output_path(source_path), asset.output_path);
+        static_assets.push_back(std::move(asset));
+    }
+
+    // Stylesheets the critical CSS of each template is drawn from, by published path.
+    Stylesheets stylesheets;
+    if (options.critical_css) {
+        for (const auto& asset : static_assets) {
+            if (asset.kind != AssetKind::Minified || asset.output_path.extension() != ".css") continue;
+            stylesheets[relative_to_public(asset.output_path)] = minified_content(asset);
+        }
+    }
+
+    // --- Templates (compiled and hashed up front so every task can see them) ---
+    PageTemplates templates;
+    if (!load_page_templates(templates, options.fingerprint_assets ? &asset_manifest : nullptr,
+                             options.critical_css ? &stylesheets : nullptr)) {
+        return false;
+    }
+    const std::string post_template_input = "template:post.html.template.html";
+    const std::string index_template_input = "template:index.html.template.html";
+    const std::string archive_template_input = "template:archive.html.template.html";
+    // With critical CSS, a page also depends on the stylesheets inlined from.
+    auto template_hash = [](const CompiledTemplate& compiled, const std::shared_ptr<const CriticalCss>& css) {
+        return css ? hash_content(compiled.source_hash() + css->stylesheets_hash()) : compiled.source_hash();
+    };
+    manifest.set_input_hash(post_template_input, template_hash(templates.post, templates.post_css));
+    manifest.set_input_hash(index_template_input, template_hash(templates.index, templates.index_css));
+    manifest.set_input_hash(archive_template_input, template_hash(templates.archive, templates.archive_css));
+
+    std::vector<fs::path> markdown_files = list_markdown_files(POSTS_SOURCE_DIR);
+    const size_t post_count = markdown_files.size();
+    std::cout << "📝 Building " << post_count << " posts with " << jobs << " jobs (" << output_queue_backend()
+              << " output)..." << std::endl;
+
+    // Per-post state. Each slot is only touched by that post's own chain of tasks,
+    // except metadata (id/title/date/permalink), which is read-only after the read task.
+    std::vector<PostMetadata> posts(post_count);
+    std::vector<MappedFile> markdown_sources(post_count);
+    std::vector<std::string> content_hashes(post_count);
+    std::vector<std::string> rendered_pages(post_count);
+    std::vector<char> post_loaded(post_count, 0);
+    std::vector<char> page_needed(post_count, 0);
+    std::vector<char> index_needed(post_count, 0);
+    std::vector<char> terms_needed(post_count, 0);
+    std::vector<size_t> sorted_positions(post_count); // In sorted_posts, which RelatedPosts goes by
+
+    std::vector<const PostMetadata*> sorted_posts;
+    std::vector<ArchivePage> archive_pages;
+    bool search_needed = true;
+    SearchSegments search_segments;
+    if (incremental) search_segments.load(SEARCH_SEGMENTS_PATH, search_index.tokenizer_options());
+    RelatedPosts related;
+    if (incremental) related.load(RELATED_TERMS_PATH, search_index.tokenizer_options());
+    std::atomic<size_t> terms_counted{0};
+    std::atomic<size_t> pages_written{0};
+    std::atomic<size_t> archive_pages_written{0};
+    std::atomic<size_t> drafts_skipped{0};
+
+    auto post_input_key = [&](size_t i) { return "post:" + markdown_files[i].filename().string(); };
+
+    TaskGraph graph;
+    // read, parse, index, render, write per post, then the site-wide tasks
+    graph.reserve(5 * post_count + 2 * jobs + 6);
+
+    graph.add_task("static assets", [&] {
+        size_t assets_processed = 0;
+        for (auto& asset : static_assets) {
+            std::string input_key = "static:" + asset.source_path.lexically_relative(STATIC_SOURCE_DIR).generic_string();
+            manifest.set_input_hash(input_key, asset.input_hash);
+
+            if (output_fresh(asset.output_path, {input_key})) {
+                record_output(asset.output_path, {input_key});
+            } else {
+                std::vector<fs::path> outputs;
+                if (!write_static_asset(asset, outputs)) return false;
+                for (const auto& output : outputs) record_output(output, {input_key});
+                ++assets_processed;
+            }
+            asset.source.reset();
+            std::string().swap(asset.minified);
+        }
+        if (options.fingerprint_assets) {
+            const fs::path manifest_path = PUBLIC_DIR / ASSET_MANIFEST_PATH;
+            const std::string json = asset_manifest.to_json();
+            manifest.set_input_hash(ASSETS_INPUT, hash_content(json));
+            if (!output_fresh(manifest_path, {ASSETS_INPUT})) {
+                if (!write_output_file(manifest_path, json)) return false;
+            }
+            record_output(manifest_path, {ASSETS_INPUT});
+        }
+        std::cout << "✅ Static assets: " << assets_processed << " processed"
+                  << (options.fingerprint_assets ? ", fingerprinted (" + ASSET_MANIFEST_PATH.string() + ")." : ".") << std::endl;
+        return true;
+    });
+
+    std::vector<TaskGraph::TaskId> read_tasks;
+    std::vector<TaskGraph::TaskId> index_tasks;
+    read_tasks.reserve(post_count);
+    index_tasks.reserve(post_count);
+
+    for (size_t i = 0; i < post_count; ++i) {
+        read_tasks.push_back(graph.add_task("read " + markdown_files[i].filename().string(), [&, i] {
+            if (!read_post_source(markdown_files[i], posts[i], markdown_sources[i])) {
+                // Invalid metadata fails the build rather than dropping a published post.
+                if (!markdown_sources[i].view().empty()) return false;
+                std::cerr << "Warning: Skipping unreadable post " << markdown_files[i] << std::endl;
+                return true;
+            }
+            if (posts[i].draft) {
+                markdown_sources[i].reset();
+                ++drafts_skipped;
+                return true;
+            }
+            content_hashes[i] = hash_content(markdown_sources[i].view());
+            manifest.set_input_hash(post_input_key(i), content_hashes[i]);
+            terms_needed[i] = !related.has_terms(posts[i].id, content_hashes[i]);
+            post_loaded[i] = 1;
+            if (streaming) markdown_sources[i].reset(); // Read again if it is parsed
+            return true;
+        }, {}, PRIORITY_READ));
+    }
+
+    // Once every post is read: order them, hash the site-wide inputs and decide
+    // what actually has to be regenerated. Site-wide pages only need metadata,
+    // so they do not wait for any post body.
+    TaskGraph::TaskId plan_task = graph.add_task("plan", [&] {
+        TraceSpan span("plan");
+        for (size_t i = 0; i < post_count; ++i) {
+            if (post_loaded[i]) sorted_posts.push_back(&posts[i]);
+        }
+        sort_by_date(sorted_posts);
+
+        std::string post_list_state;
+        std::string search_state;
+        for (const PostMetadata* post : sorted_posts) {
+            size_t i = static_cast<size_t>(post - posts.data());
+            post_list_state += post->id + '\t' + post->title + '\t' + post->date + '\t' + post->permalink + '\t' + post->excerpt + '\n';
+            search_state += post->id + '\t' + content_hashes[i] + '\t' + post->permalink + '\n';
+        }
+        manifest.set_input_hash(POST_LIST_INPUT, hash_content(post_list_state));
+        manifest.set_input_hash(SEARCH_INPUT, hash_content(search_state));
+        archive_pages = plan_archive_pages(sorted_posts, options.archive_page_size);
+        for (const auto& page : archive_pages) {
+            manifest.set_input_hash(ARCHIVE_INPUT_PREFIX + relative_to_public(page.output_path),
+                                    hash_content(archive_page_state(page)));
+        }
+
+        // The search index only gets a segment for the posts that are new,
+        // edited or merged (search_segments.h); search-index.js maps them all.
+        std::vector<SearchSegments::Post> search_posts;
+        for (const PostMetadata* post : sorted_posts) {
+            search_posts.push_back({post->id, content_hashes[static_cast<size_t>(post - posts.data())]});
+        }
+        const std::set<std::string> to_index = search_segments.plan(search_posts);
+        for (const PostMetadata* post : sorted_posts) {
+            if (to_index.count(post->id)) index_needed[static_cast<size_t>(post - posts.data())] = 1;
+        }
+        search_needed = search_segments.changed() || !output_fresh(PUBLIC_DIR / "search-index.js", {SEARCH_INPUT});
+        std::cout << "✅ " << sorted_posts.size() << " posts read";
+        if (drafts_skipped > 0) std::cout << " (" << drafts_skipped << " drafts skipped)";
+        std::cout << (search_needed ? ", " + std::to_string(to_index.size()) + " posts to index for search." : ".")
+                  << std::endl;
+        return true;
+    }, read_tasks, PRIORITY_SITE_PAGES);
+
+    for (size_t i = 0; i < post_count; ++i) {
+        const std::string post_name = markdown_files[i].filename().string();
+
+        // Which pages need rendering is only known once the related posts are
+        // (below): bodies parsed for the index or the term counts are kept for
+        // rendering, except when streaming, where render parses them again.
+        TaskGraph::TaskId parse_task = graph.add_task("parse " + post_name, [&, i] {
+            if (post_loaded[i] && (index_needed[i] || terms_needed[i])) {
+                if (streaming && !markdown_sources[i].open(markdown_files[i])) return false;
+                render_post_body(posts[i], markdown_sources[i].view());
+            }
+            markdown_sources[i].reset(); // Markdown no longer needed
+            return true;
+        }, {read_tasks[i], plan_task}, PRIORITY_PARSE);
+
+        index_tasks.push_back(graph.add_task("index " + post_name, [&, i] {
+            if (!post_loaded[i]) return true;
+            SearchTermCounts counts;
+            if (index_needed[i]) {
+                index_post_for_search(posts[i], terms_needed[i] ? &counts : nullptr);
+            } else if (terms_needed[i]) {
+                counts = search_index.count_terms(posts[i].title, posts[i].html_body);
+            }
+            if (terms_needed[i]) {
+                related.set_terms(posts[i].id, content_hashes[i], counts);
+                ++terms_counted;
+            }
+            if (streaming) std::string().swap(posts[i].html_body);
+            return true;
+        }, {parse_task}, PRIORITY_INDEX));
+    }
+
+    // --- Related posts (once every post has its term counts) ---
+    std::vector<TaskGraph::TaskId> related_dependencies = index_tasks;
+    related_dependencies.push_back(plan_task);
+    std::chrono::steady_clock::time_point related_start;
+    TaskGraph::TaskId related_prepare_task = graph.add_task("related posts", [&] {
+        TraceSpan span("related posts");
+        related_start = std::chrono::steady_clock::now();
+        related.prepare(sorted_posts);
+        return true;
+    }, related_dependencies, PRIORITY_SITE_PAGES);
+    std::vector<TaskGraph::TaskId> related_slice_tasks;
+    for (unsigned slice = 0; slice < jobs; ++slice) {
+        related_slice_tasks.push_back(graph.add_task("related posts " + std::to_string(slice), [&, slice] {
+            TraceSpan span("related posts");
+            related.find_neighbours(slice, jobs);
+            return true;
+        }, {related_prepare_task}, PRIORITY_SITE_PAGES));
+    }
+    // A post page depends on its related posts block as much as on the post.
+    TaskGraph::TaskId related_finish_task = graph.add_task("plan post pages", [&] {
+        size_t pages_needed = 0;
+        related.release_vectors();
+        for (size_t position = 0; position < sorted_posts.size(); ++position) {
+            const size_t i = static_cast<size_t>(sorted_posts[position] - posts.data());
+            sorted_positions[i] = position;
+            const std::string related_input = RELATED_INPUT_PREFIX + markdown_files[i].filename().string();
+            manifest.set_input_hash(related_input, hash_content(related.html(position)));
+            std::vector<std::string> inputs = {post_input_key(i), post_template_input, related_input};
+            page_needed[i] = !output_fresh(post_output_path(posts[i]), inputs);
+            record_output(post_output_path(posts[i]), inputs);
+            if (page_needed[i]) ++pages_needed;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - related_start;
+        std::cout << "🔗 Related posts: " << related.summary() << ", " << terms_counted << " counted; "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms." << std::endl;
+        std::cout << "✅ " << pages_needed << " post pages to regenerate." << std::endl;
+        return true;
+    }, related_slice_tasks, PRIORITY_SITE_PAGES);
+
+    for (size_t i = 0; i < post_count; ++i) {
+        const std::string post_name = markdown_files[i].filename().string();
+
+        TaskGraph::TaskId render_task = graph.add_task("render " + post_name, [&, i] {
+            if (page_needed[i]) {
+                // Not parsed (or no longer): e.g. an unchanged post whose related posts changed.
+                if (posts[i].html_body.empty()) {
+                    if (!markdown_sources[i].open(markdown_files[i])) return false;
+                    render_post_body(posts[i], markdown_sources[i].view());
+                    markdown_sources[i].reset();
+                }
+                rendered_pages[i] = render_post_page(templates, posts[i], related.html(sorted_positions[i]));
+            }
+            return true;
+        }, {related_finish_task}, PRIORITY_RENDER);
+
+        // Once rendered, only the post's metadata is kept.
+        graph.add_task("write " + post_name, [&, i] {
+            std::string().swap(posts[i].html_body);
+            if (!page_needed[i]) return true;
+            TraceSpan span("page");
+            span.set_item(posts[i].id);
+            span.set_bytes(rendered_pages[i].size(), 0);
+            bool ok = write_page(post_output_path(posts[i]), rendered_pages[i]);
+            std::string().swap(rendered_pages[i]);
+            ++pages_written;
+            return ok;
+        }, {render_task}, PRIORITY_WRITE);
+    }
+
+    auto add_site_page_task = [&](const std::string& name, const fs::path& output_path, const std::string& template_input,
+                                  std::string (*render)(const PageTemplates&, const std::vector<const PostMetadata*>&)) {
+        graph.add_task(name, [&, name, output_path, template_input, render] {
+            std::vector<std::string> inputs = {POST_LIST_INPUT, template_input};
+            bool fresh = output_fresh(output_path, inputs);
+            record_output(output_path, inputs);
+            if (fresh) return true;
+            TraceSpan span("site page");
+            if (!write_page(output_path, render(templates, sorted_posts))) return false;
+            std::cout << "✅ " << relative_to_public(output_path) << " generated." << std::endl;
+            return true;
+        }, {plan_task}, PRIORITY_SITE_PAGES);
+    };
+    add_site_page_task("index page", PUBLIC_DIR / "index.html", index_template_input, render_index_page);
+
+    // Archive pages are only known once the post list is: spread them over one
+    // task per job instead of one task per page.
+    for (unsigned slice = 0; slice < jobs; ++slice) {
+        graph.add_task("archive pages " + std::to_string(slice), [&, slice] {
+            for (size_t i = slice; i < archive_pages.size(); i += jobs) {
+                const ArchivePage& page = archive_pages[i];
+                std::vector<std::string> inputs = {ARCHIVE_INPUT_PREFIX + relative_to_public(page.output_path), archive_template_input};
+                bool fresh = output_fresh(page.output_path, inputs);
+                record_output(page.output_path, inputs);
+                if (fresh) continue;
+                TraceSpan span("site page");
+                if (!write_archive_page(page, render_archive_page(templates, page))) return false;
+                ++archive_pages_written;
+            }
+            return true;
+        }, {plan_task}, PRIORITY_SITE_PAGES);
+    }
+
+    std::vector<TaskGraph::TaskId> search_dependencies = index_tasks;
+    search_dependencies.push_back(plan_task);
+    graph.add_task("search index", [&] {
+        std::vector<fs::path> outputs;
+        if (search_needed) {
+            std::cout << "Generating search-index.js..." << std::endl;
+            bool ok = write_search_index(sorted_posts, search_segments, outputs);
+            search_index.clear(); // Frees the term statistics and removes the spill runs
+            if (!ok) return false;
+        } else {
+            for (const auto& name : search_segments.file_names()) outputs.push_back(PUBLIC_DIR / SEARCH_SHARD_DIR / name);
+            outputs.push_back(PUBLIC_DIR / "search-index.js");
+        }
+        // Segment files never change: each depends on its segment's name only.
+        const fs::path search_dir = PUBLIC_DIR / SEARCH_SHARD_DIR;
+        for (const auto& output : outputs) {
+            if (output.parent_path().parent_path() != search_dir) {
+                record_output(output, {SEARCH_INPUT});
+                continue;
+            }
+            const std::string input_key = SEARCH_SEGMENT_INPUT_PREFIX + output.parent_path().filename().string();
+            manifest.set_input_hash(input_key, output.parent_path().filename().string());
+            record_output(output, {input_key});
+        }
+        return true;
+    }, search_dependencies, PRIORITY_SITE_PAGES);
+
+    // Every output is in place (or the build failed) before it is precompressed,
+    // stale outputs go and the manifest is saved.
+    bool graph_ok = graph.run(jobs);
+    bool outputs_ok = flush_output_files();
+    if (!graph_ok || !outputs_ok) return false;
+    if (search_needed && !search_segments.save(SEARCH_SEGMENTS_PATH, search_index.tokenizer_options())) return false;
+    if ((terms_counted > 0 || related.stored_post_count() != sorted_posts.size()) &&
+        !related.save(RELATED_TERMS_PATH, search_index.tokenizer_options())) {
+        return false;
+    }
+    std::cout << "✅ " << pages_written << " individual post pages generated." << std::endl;
+    std::cout << "✅ " << archive_pages_written << " of " << archive_pages.size() << " archive pages generated." << std::endl;
+    if (options.critical_css) {
+        const std::pair<const char*, const CriticalCss*> critical_templates[] = {
+            {"post", templates.post_css.get()}, {"index", templates.index_css.get()}, {"archive", templates.archive_css.get()}};
+        for (const auto& entry : critical_templates) {
+            if (!entry.second) continue;
+            CriticalCss::Stats stats = entry.second->stats();
+            if (stats.pages == 0) continue;
+            std::cout << "🎨 Critical CSS (" << entry.first << " pages): " << stats.inlined_bytes / stats.pages
+                      << " of " << stats.stylesheet_bytes << " bytes inlined on average over " << stats.pages
+                      << " pages, " << stats.shape_hits << " of " << stats.shape_lookups << " element shapes cached."
+                      << std::endl;
+        }
+    }
+
+    // Precompression runs a task graph of its own: free this one's tasks and
+    // per-post state first, they add up on large sites.
+    graph = TaskGraph();
+    std::vector<MappedFile>().swap(markdown_sources);
+    std::vector<std::string>().swap(content_hashes);
+    std::vector<std::string>().swap(rendered_pages);
+    std::vector<ArchivePage>().swap(archive_pages);
+    related.clear();
+
+    // --- Precompression ---
+    {
+        std::vector<fs::path> outputs;
+        for (const auto& output : manifest.outputs()) outputs.push_back(PUBLIC_DIR / output);
+        PrecompressStats stats;
+        if (!precompress_files(outputs, options.precompress, jobs, &stats, &manifest,
+                               incremental ? &previous_manifest : nullptr)) {
+            return false;
+        }
+        print_precompress_summary(options.precompress, stats);
+    }
+
+    // Outputs of deleted posts (or assets) that this build no longer produces.
+    if (incremental) {
+        size_t removed = 0;
+        for (const auto& stale_output : previous_manifest.stale_outputs(manifest)) {
+            std::error_code ec;
+            if (fs::remove(PUBLIC_DIR / stale_output, ec)) ++removed;
+            if (ec) std::cerr << "Warning: Could not remove stale output " << stale_output << ": " << ec.message() << std::endl;
+        }
+        if (removed > 0) std::cout << "🧹 Removed " << removed << " stale outputs." << std::endl;
+        // Directories of merged search segments, now empty.
+        for (const auto& name : search_segments.dropped_files()) {
+            std::error_code ec;
+            fs::remove((PUBLIC_DIR / SEARCH_SHARD_DIR / name).parent_path(), ec);
+        }
+    }
+
+    TraceSpan span("save manifest");
+    return manifest.save(BUILD_MANIFEST_PATH);
+}
@@ -0,0 +1,49 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "archive_pages.h"
+#include "precompress.h"
+
+// --- Build Options ---
+struct BuildOptions {
+    unsigned jobs = 0; // 0 = one per hardware thread
+    bool clean = false; // Ignore the build manifest and rebuild everything
+    bool dev = false;   // Faster, lower-ratio compression for pages (see compression_settings_for)
+    size_t archive_page_size = DEFAULT_ARCHIVE_PAGE_SIZE; // Posts per archive page (see archive_pages.h)
+    bool fingerprint_assets = false; // Content-hashed CSS/JS names + asset manifest (see asset_manifest.h)
+    bool critical_css = false;       // Inlined above-the-fold CSS, deferred stylesheets (see critical_css.h)
+    PrecompressOptions precompress;  // Codecs and gain threshold of the .br/.zst/.gz siblings
+    size_t max_memory = 0;           // Bytes; 0 = unbounded (see Memory below)
+};
+
+// --- Full Site Build ---
+// Runs every stage as a task graph on options.jobs threads:
+//   read(N) -> parse(N) -> render+minify(N) -> write(N)
+//                       -> index(N)
+// Per-post chains overlap across posts. index.html and the archive pages are
+// scheduled as soon as every post's metadata has been read (no bodies needed),
+// and search-index.js (+ a search/ segment) once every post has been indexed.
+// Once every output is in place, they are all precompressed (precompress.h).
+// The output is byte-identical for any job count.
+//
+// Builds are incremental: BUILD_MANIFEST_PATH records the hash of every input
+// and which outputs were generated from which inputs. A post edit regenerates
+// that post's page, a template edit every page using that template;
+// index.html follows the post list metadata, each archive page the metadata of
+// the posts it lists (and its links), and the search index gets a new segment
+// for new and edited posts only (search_segments.h). Untouched files in public/ are left
+// alone and outputs of deleted posts are removed. Without a usable manifest (or
+// with options.clean) public/ is wiped and rebuilt from scratch.
+//
+// Memory: only post metadata (id, title, date, permalink, excerpt) stays
+// resident for the whole build; a post's HTML body is dropped as soon as its
+// page is written and it is indexed. With options.max_memory, the build also
+// streams instead of keeping what grows with the corpus: markdown sources are
+// read again from disk when they are parsed instead of staying mapped, and the
+// search index spills sorted runs to SEARCH_SPILL_DIR beyond a quarter of the
+// budget and merges them when encoding (search_index.h), writing each shard
+// out as it goes. The rest of the budget covers the metadata, the posts in
+// flight and the output queue.
+bool build_site(const BuildOptions& options);
+
+#endif // PIPELINE_H
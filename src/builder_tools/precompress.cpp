@@ -0,0 +1,298 @@
+#include "precompress.h"
+#include "build_stages.h"
+#include "task_graph.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+// --- Codecs ---
+
+const char* codec_extension(Codec codec) {
+    switch (codec) {
+        case Codec::Brotli: return ".br";
+        case Codec::Zstd: return ".zst";
+        case Codec::Gzip: return ".gz";
+    }
+    return "";
+}
+
+const char* codec_name(Codec codec) {
+    switch (codec) {
+        case Codec::Brotli: return "br";
+        case Codec::Zstd: return "zstd";
+        case Codec::Gzip: return "gzip";
+    }
+    return "";
+}
+
+bool codec_available(Codec codec) {
+#ifdef BUILDER_HAVE_ZSTD
+    (void)codec;
+    return true;
+#else
+    return codec != Codec::Zstd;
+#endif
+}
+
+std::vector<Codec> available_codecs() {
+    std::vector<Codec> codecs;
+    for (Codec codec : {Codec::Brotli, Codec::Zstd, Codec::Gzip}) {
+        if (codec_available(codec)) codecs.push_back(codec);
+    }
+    return codecs;
+}
+
+bool parse_codec_list(const std::string& list, std::vector<Codec>& codecs) {
+    codecs.clear();
+    if (list == "none") return true;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, comma - start);
+        start = comma + 1;
+        Codec codec;
+        if (name == "br" || name == "brotli") codec = Codec::Brotli;
+        else if (name == "zst" || name == "zstd") codec = Codec::Zstd;
+        else if (name == "gz" || name == "gzip") codec = Codec::Gzip;
+        else {
+            std::cerr << "Error: Unknown codec \"" << name << "\" (expected br, zst, gz or none)." << std::endl;
+            return false;
+        }
+        if (!codec_available(codec)) {
+            std::cerr << "Error: This build of the builder has no " << codec_name(codec) << " support." << std::endl;
+            return false;
+        }
+        if (std::find(codecs.begin(), codecs.end(), codec) == codecs.end()) codecs.push_back(codec);
+    }
+    return true;
+}
+
+// --- File Selection ---
+
+bool is_precompressed_variant(const fs::path& path) {
+    const std::string extension = path.extension().string();
+    for (Codec codec : {Codec::Brotli, Codec::Zstd, Codec::Gzip}) {
+        if (extension == codec_extension(codec)) return true;
+    }
+    return false;
+}
+
+bool is_precompressible(const fs::path& output_path) {
+    if (is_precompressed_variant(output_path)) return false;
+    if (output_path.parent_path().parent_path() == PUBLIC_DIR / SEARCH_SHARD_DIR) return true; // Segment files
+    const std::string extension = output_path.extension().string();
+    for (const char* text_extension : {".html", ".css", ".js", ".json", ".svg", ".xml", ".txt", ".map", ".webmanifest"}) {
+        if (extension == text_extension) return true;
+    }
+    return false;
+}
+
+// Which compression_settings_for profile a file in public/ gets.
+static OutputClass output_class_of(const std::string& relative_path) {
+    const std::string shard_prefix = SEARCH_SHARD_DIR.generic_string() + "/";
+    if (relative_path == "search-index.js" || relative_path.compare(0, shard_prefix.size(), shard_prefix) == 0) {
+        return OutputClass::SearchIndex;
+    }
+    if (relative_path.compare(0, 2, "p/") == 0) return OutputClass::PostPage;
+    if (fs::path(relative_path).extension() == ".html") return OutputClass::SitePage;
+    return OutputClass::StaticAsset;
+}
+
+// What a variant depends on besides the file's content; part of its manifest hash.
+static std::string settings_signature(const PrecompressOptions& options, const CompressionSettings& settings) {
+    std::string signature = std::to_string(options.min_gain);
+    for (Codec codec : options.codecs) {
+        signature += ',';
+        signature += codec_name(codec);
+        switch (codec) {
+            case Codec::Brotli:
+                signature += std::to_string(settings.quality) + '/' + std::to_string(settings.lgwin);
+                break;
+            case Codec::Zstd: signature += std::to_string(settings.zstd_level); break;
+            case Codec::Gzip: signature += std::to_string(settings.gzip_level); break;
+        }
+    }
+    return signature;
+}
+
+// --- Compression ---
+
+namespace {
+
+// TaskGraph priorities: the slowest codec starts first, and every codec
+// outranks reading the next file, so few files are mapped at a time.
+enum PrecompressPriority {
+    PRIORITY_HASH = 0,
+    PRIORITY_GZIP = 1,
+    PRIORITY_ZSTD = 2,
+    PRIORITY_BROTLI = 3,
+};
+
+struct FileJob {
+    fs::path path;
+    std::string relative_path;
+    CompressionSettings settings;
+    MappedFile content;
+    std::vector<char> codec_needed; // Per options.codecs entry
+    std::atomic<size_t> codecs_left{0}; // The last codec task to finish unmaps the file
+};
+
+// Compresses content into variant_path; kept tells whether the variant beat
+// discard_at_size and was written.
+template <typename Writer>
+bool write_variant(const fs::path& variant_path, std::string_view content, CompressionSettings settings,
+                   size_t discard_at_size, bool& kept, size_t& compressed_bytes) {
+    Writer writer;
+    if (!writer.open(variant_path, settings, content.size()) || !writer.write(content.data(), content.size()) ||
+        !writer.finish(discard_at_size)) {
+        return false;
+    }
+    compressed_bytes = writer.compressed_bytes();
+    kept = compressed_bytes < discard_at_size;
+    return true;
+}
+
+bool compress_variant(Codec codec, const fs::path& variant_path, std::string_view content, CompressionSettings settings,
+                      size_t discard_at_size, bool& kept, size_t& compressed_bytes) {
+    switch (codec) {
+        case Codec::Brotli: {
+            TraceSpan span("brotli");
+            bool ok = write_variant<BrotliFileWriter>(variant_path, content, settings, discard_at_size, kept, compressed_bytes);
+            span.set_bytes(content.size(), compressed_bytes);
+            return ok;
+        }
+        case Codec::Zstd: {
+            TraceSpan span("zstd");
+            bool ok = write_variant<ZstdFileWriter>(variant_path, content, settings, discard_at_size, kept, compressed_bytes);
+            span.set_bytes(content.size(), compressed_bytes);
+            return ok;
+        }
+        case Codec::Gzip: {
+            TraceSpan span("gzip");
+            bool ok = write_variant<GzipFileWriter>(variant_path, content, settings, discard_at_size, kept, compressed_bytes);
+            span.set_bytes(content.size(), compressed_bytes);
+            return ok;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool precompress_files(const std::vector<fs::path>& paths, const PrecompressOptions& options, unsigned jobs,
+                       PrecompressStats* stats, BuildManifest* manifest, const BuildManifest* previous) {
+    std::vector<const fs::path*> selected;
+    for (const auto& path : paths) {
+        if (is_precompressible(path)) selected.push_back(&path);
+    }
+    if (selected.empty() || options.codecs.empty()) return true;
+
+    const size_t codec_count = options.codecs.size();
+    std::vector<FileJob> files(selected.size());
+    std::atomic<size_t> files_compressed{0};
+    std::atomic<size_t> files_unchanged{0};
+    std::atomic<size_t> variants_written{0};
+    std::atomic<size_t> variants_dropped{0};
+    std::atomic<size_t> input_bytes{0};
+    std::atomic<size_t> output_bytes{0};
+
+    TaskGraph graph;
+    graph.reserve(selected.size() * (1 + codec_count)); // A hash task and one task per codec per file
+    for (size_t i = 0; i < selected.size(); ++i) {
+        FileJob& file = files[i];
+        file.path = *selected[i];
+        file.relative_path = file.path.lexically_relative(PUBLIC_DIR).generic_string();
+        file.settings = compression_settings_for(output_class_of(file.relative_path));
+        file.codec_needed.assign(codec_count, 1);
+
+        TaskGraph::TaskId hash_task = graph.add_task("precompress " + file.relative_path, [&, i] {
+            FileJob& file = files[i];
+            if (!file.content.open(file.path)) return false;
+            if (manifest) {
+                const std::string input_key = "precompress:" + file.relative_path;
+                const std::string input_hash = hash_content(hash_content(file.content.view()) +
+                                                            settings_signature(options, file.settings));
+                manifest->set_input_hash(input_key, input_hash);
+                if (previous && previous->input_hash(input_key) == input_hash) {
+                    // Same content, same settings: a variant the previous build kept is
+                    // still good if it is on disk; one it dropped would be dropped again.
+                    for (size_t c = 0; c < codec_count; ++c) {
+                        const std::string variant = file.relative_path + codec_extension(options.codecs[c]);
+                        std::error_code ec;
+                        file.codec_needed[c] = previous->has_output(variant) && !fs::exists(PUBLIC_DIR / variant, ec);
+                        if (previous->has_output(variant) && !file.codec_needed[c]) manifest->add_output(variant, {input_key});
+                    }
+                }
+            }
+            size_t needed = 0;
+            for (char codec_needed : file.codec_needed) needed += codec_needed ? 1 : 0;
+            if (needed == 0) {
+                file.content.reset();
+                ++files_unchanged;
+                return true;
+            }
+            file.codecs_left = needed;
+            ++files_compressed;
+            input_bytes += file.content.view().size();
+            return true;
+        }, {}, PRIORITY_HASH);
+
+        for (size_t c = 0; c < codec_count; ++c) {
+            const Codec codec = options.codecs[c];
+            const int priority = codec == Codec::Brotli ? PRIORITY_BROTLI : codec == Codec::Zstd ? PRIORITY_ZSTD : PRIORITY_GZIP;
+            graph.add_task(std::string(codec_name(codec)) + " " + file.relative_path, [&, i, c, codec] {
+                FileJob& file = files[i];
+                if (!file.codec_needed[c]) return true;
+                std::string_view content = file.content.view();
+                const fs::path variant_path = file.path.string() + codec_extension(codec);
+                // Kept only if at least min_gain of the size is saved.
+                const size_t discard_at_size = static_cast<size_t>(std::ceil(content.size() * (1.0 - options.min_gain)));
+                bool kept = false;
+                size_t compressed_bytes = 0;
+                bool ok = compress_variant(codec, variant_path, content, file.settings, discard_at_size, kept, compressed_bytes);
+                if (--file.codecs_left == 0) file.content.reset();
+                if (!ok) return false;
+                if (kept) {
+                    ++variants_written;
+                    output_bytes += compressed_bytes;
+                    if (manifest) manifest->add_output(file.relative_path + codec_extension(codec), {"precompress:" + file.relative_path});
+                } else {
+                    // Not worth sending: a variant from an earlier build must not outlive it.
+                    ++variants_dropped;
+                    std::error_code ec;
+                    fs::remove(variant_path, ec);
+                }
+                return true;
+            }, {hash_task}, priority);
+        }
+    }
+
+    bool graph_ok = graph.run(jobs);
+    bool outputs_ok = flush_output_files();
+    if (stats) {
+        stats->files_compressed += files_compressed;
+        stats->files_unchanged += files_unchanged;
+        stats->variants_written += variants_written;
+        stats->variants_dropped += variants_dropped;
+        stats->input_bytes += input_bytes;
+        stats->output_bytes += output_bytes;
+    }
+    return graph_ok && outputs_ok;
+}
+
+void print_precompress_summary(const PrecompressOptions& options, const PrecompressStats& stats) {
+    std::string codecs;
+    for (Codec codec : options.codecs) codecs += (codecs.empty() ? "" : ", ") + std::string(codec_extension(codec));
+    if (codecs.empty()) {
+        std::cout << "🗜️  Precompression disabled." << std::endl;
+        return;
+    }
+    std::cout << "🗜️  Precompressed " << stats.files_compressed << " files (" << codecs << "): "
+              << stats.variants_written << " variants written, " << stats.variants_dropped << " saving less than "
+              << static_cast<int>(std::lround(options.min_gain * 100)) << "% dropped";
+    if (stats.files_unchanged > 0) std::cout << ", " << stats.files_unchanged << " files unchanged";
+    std::cout << "." << std::endl;
+}
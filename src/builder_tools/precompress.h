@@ -0,0 +1,69 @@
+#ifndef PRECOMPRESS_H
+#define PRECOMPRESS_H
+
+#include "build_manifest.h"
+#include "stream_writer.h"
+
+// --- Precompression ---
+// The last stage of a build: once every output is in place, each compressible
+// file (pages, CSS/JS, SVG/JSON/XML/text, the search index and its shards)
+// gets one sibling per codec (page.html.br, page.html.zst, page.html.gz) that
+// a server or CDN can send as is to clients whose Accept-Encoding allows it.
+// Every file and codec is a task of its own, so they compress in parallel.
+//
+// A variant is kept only if it saves at least min_gain of the file's size;
+// otherwise it is not written (and one left by an earlier build is removed),
+// so no server ever sends a "compressed" file that is barely smaller, or even
+// larger, than the original. Levels come from compression_settings_for:
+// Brotli 11 / zstd 19 / gzip 9 in release builds, faster ones for pages in
+// dev builds.
+
+enum class Codec { Brotli, Zstd, Gzip };
+
+const char* codec_extension(Codec codec); // ".br", ".zst", ".gz"
+const char* codec_name(Codec codec);      // Content-Encoding token: "br", "zstd", "gzip"
+// zstd needs libzstd when the builder is built (BUILDER_HAVE_ZSTD).
+bool codec_available(Codec codec);
+// Every available codec, in the order servers should prefer them.
+std::vector<Codec> available_codecs();
+// "br,zst,gz" ("zstd" and "gzip" work too; "none" for no precompression).
+// Prints an error and returns false on an unknown or unavailable codec.
+bool parse_codec_list(const std::string& list, std::vector<Codec>& codecs);
+
+constexpr double DEFAULT_PRECOMPRESS_MIN_GAIN = 0.05;
+
+struct PrecompressOptions {
+    std::vector<Codec> codecs = available_codecs();
+    double min_gain = DEFAULT_PRECOMPRESS_MIN_GAIN; // Fraction of the file size a variant must save
+};
+
+struct PrecompressStats {
+    size_t files_compressed = 0;
+    size_t files_unchanged = 0;  // Variants kept from the previous build
+    size_t variants_written = 0;
+    size_t variants_dropped = 0; // Below min_gain
+    size_t input_bytes = 0;      // Of the files compressed
+    size_t output_bytes = 0;     // Of the variants written
+};
+
+// By extension; search segment files (under SEARCH_SHARD_DIR) always are. Variants never are.
+bool is_precompressible(const fs::path& output_path);
+// Whether path is a .br/.zst/.gz sibling.
+bool is_precompressed_variant(const fs::path& path);
+
+// Precompresses every file in paths (under PUBLIC_DIR, already in place: see
+// flush_output_files) that is_precompressible; other paths are ignored.
+// Returns after the variants are in place. The stage is quiet: callers that
+// report progress print the stats (print_precompress_summary).
+//
+// With manifests (build_site), the hash of each file's content and of the
+// settings it is compressed with is recorded in `manifest` under the input
+// key "precompress:<path>", and the variants kept as outputs of that key. A
+// file whose hash is the same in `previous` is not compressed again: the
+// variants it had there are recorded as they are.
+bool precompress_files(const std::vector<fs::path>& paths, const PrecompressOptions& options, unsigned jobs,
+                       PrecompressStats* stats = nullptr, BuildManifest* manifest = nullptr,
+                       const BuildManifest* previous = nullptr);
+void print_precompress_summary(const PrecompressOptions& options, const PrecompressStats& stats);
+
+#endif // PRECOMPRESS_H
@@ -0,0 +1,462 @@
+#include "related_posts.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RELATED_POSTS_X86 1
+#include <immintrin.h>
+#else
+#define RELATED_POSTS_X86 0
+#endif
+
+const fs::path RELATED_TERMS_PATH = ".build-cache/related-terms.tsv";
+
+namespace {
+
+// --- Dot Product Kernels ---
+// Sum of dense[terms[i]] * weights[i]: a sparse vector against a dense one.
+// Both kernels add in the same order (eight lanes, then pairwise, then the
+// tail), so scores do not depend on which one the CPU gets.
+
+using DotFunction = float (*)(const float* dense, const uint32_t* terms, const float* weights, size_t count);
+
+float finish_dot(const float lanes[8], const float* dense, const uint32_t* terms, const float* weights, size_t i,
+                 size_t count) {
+    float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; i < count; ++i) sum += dense[terms[i]] * weights[i];
+    return sum;
+}
+
+float dot_scalar(const float* dense, const uint32_t* terms, const float* weights, size_t count) {
+    float lanes[8] = {};
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (size_t lane = 0; lane < 8; ++lane) lanes[lane] += dense[terms[i + lane]] * weights[i + lane];
+    }
+    return finish_dot(lanes, dense, terms, weights, i, count);
+}
+
+#if RELATED_POSTS_X86
+__attribute__((target("avx2"))) float dot_avx2(const float* dense, const uint32_t* terms, const float* weights, size_t count) {
+    __m256 sum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i indexes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(terms + i));
+        __m256 values = _mm256_i32gather_ps(dense, indexes, 4);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(values, _mm256_loadu_ps(weights + i)));
+    }
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sum);
+    return finish_dot(lanes, dense, terms, weights, i, count);
+}
+#endif
+
+bool has_avx2() {
+#if RELATED_POSTS_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+DotFunction dot_function() {
+#if RELATED_POSTS_X86
+    if (has_avx2()) return dot_avx2;
+#endif
+    return dot_scalar;
+}
+
+// Scores are compared at this resolution, so a last-bit difference never
+// decides between two posts: equal ones go to the newer post.
+int64_t rank_key(float score) {
+    return static_cast<int64_t>(std::lround(static_cast<double>(score) * (1 << 20)));
+}
+
+} // namespace
+
+// --- Term Counts ---
+
+size_t RelatedPosts::stored_post_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return terms_.size();
+}
+
+bool RelatedPosts::has_terms(const std::string& post_id, const std::string& content_hash) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = terms_.find(post_id);
+    return it != terms_.end() && it->second.content_hash == content_hash;
+}
+
+void RelatedPosts::set_terms(const std::string& post_id, const std::string& content_hash, const SearchTermCounts& counts) {
+    std::vector<const std::pair<std::string, float>*> kept;
+    kept.reserve(counts.size());
+    for (const auto& count : counts) kept.push_back(&count);
+    auto more_frequent = [](const std::pair<std::string, float>* a, const std::pair<std::string, float>* b) {
+        return a->second != b->second ? a->second > b->second : a->first < b->first;
+    };
+    if (kept.size() > RELATED_MAX_TERMS) {
+        std::partial_sort(kept.begin(), kept.begin() + RELATED_MAX_TERMS, kept.end(), more_frequent);
+        kept.resize(RELATED_MAX_TERMS);
+    }
+
+    PostTerms terms;
+    terms.content_hash = content_hash;
+    terms.counts.reserve(kept.size());
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto* count : kept) {
+        auto inserted = term_ids_.emplace(count->first, static_cast<uint32_t>(vocabulary_.size()));
+        if (inserted.second) vocabulary_.push_back(count->first);
+        terms.counts.emplace_back(inserted.first->second, count->second);
+    }
+    terms_[post_id] = std::move(terms);
+}
+
+// --- State File ---
+// One tab-separated record per line:
+//   format  <RELATED_TERMS_FORMAT>  <tokenizer options>
+//   post    <post id>  <content hash>  then <term>  <count> for each term kept
+static const char RELATED_TERMS_HEADER[] = "# dee-blogger related posts term counts";
+static const char RELATED_TERMS_FORMAT[] = "1";
+
+bool RelatedPosts::load(const fs::path& path, const TokenizerOptions& tokenizer_options) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        vocabulary_.clear();
+        term_ids_.clear();
+        terms_.clear();
+    }
+    std::ifstream file(path);
+    if (!file.is_open()) return false; // No previous build
+
+    bool format_ok = false;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        for (std::string field; std::getline(stream, field, '\t');) fields.push_back(std::move(field));
+
+        bool ok = true;
+        if (fields[0] == "format" && fields.size() == 3) {
+            format_ok = fields[1] == RELATED_TERMS_FORMAT && fields[2] == tokenizer_signature(tokenizer_options);
+            if (!format_ok) break; // Other tokenizer options: every post is counted again
+        } else if (fields[0] == "post" && fields.size() >= 3 && fields.size() % 2 == 1 && format_ok) {
+            SearchTermCounts counts;
+            for (size_t i = 3; i + 1 < fields.size() && ok; i += 2) {
+                char* end = nullptr;
+                float count = std::strtof(fields[i + 1].c_str(), &end);
+                ok = *end == '\0' && count > 0;
+                counts.emplace_back(fields[i], count);
+            }
+            if (ok) set_terms(fields[1], fields[2], counts);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Warning: Ignoring malformed related posts state " << path << " (line " << line_number << ")" << std::endl;
+            format_ok = false;
+            break;
+        }
+    }
+    if (!format_ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        vocabulary_.clear();
+        term_ids_.clear();
+        terms_.clear();
+    }
+    return format_ok;
+}
+
+bool RelatedPosts::save(const fs::path& path, const TokenizerOptions& tokenizer_options) const {
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "Error creating directory for " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    // Like the build manifest: never leave a truncated file behind. Written as
+    // it goes, the state runs to tens of megabytes on large sites.
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not write related posts state " << temp_path << std::endl;
+            return false;
+        }
+        file << RELATED_TERMS_HEADER << "\n";
+        file << "format\t" << RELATED_TERMS_FORMAT << "\t" << tokenizer_signature(tokenizer_options) << "\n";
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const PostMetadata* post : posts_) {
+            auto it = terms_.find(post->id);
+            if (it == terms_.end()) continue;
+            file << "post\t" << post->id << "\t" << it->second.content_hash;
+            for (const auto& count : it->second.counts) file << "\t" << vocabulary_[count.first] << "\t" << count.second;
+            file << "\n";
+        }
+        if (!file) {
+            std::cerr << "Error: Failed writing related posts state " << temp_path << std::endl;
+            return false;
+        }
+    }
+    fs::rename(temp_path, path, ec);
+    if (ec) {
+        std::cerr << "Error: Could not replace related posts state " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Vectors ---
+
+void RelatedPosts::prepare(const std::vector<const PostMetadata*>& posts) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    posts_ = posts;
+    const size_t post_count = posts_.size();
+    const size_t vocabulary_size = vocabulary_.size();
+
+    std::vector<const PostTerms*> post_terms(post_count, nullptr);
+    std::vector<uint32_t> document_frequencies(vocabulary_size, 0);
+    for (size_t i = 0; i < post_count; ++i) {
+        auto it = terms_.find(posts_[i]->id);
+        if (it == terms_.end()) continue;
+        post_terms[i] = &it->second;
+        for (const auto& count : it->second.counts) ++document_frequencies[count.first];
+    }
+
+    // TF-IDF vectors, by term ID
+    const double max_document_frequency = std::max(2.0, RELATED_MAX_DF_RATIO * static_cast<double>(post_count));
+    vector_offsets_.assign(1, 0);
+    vector_terms_.clear();
+    vector_weights_.clear();
+    std::vector<std::pair<uint32_t, float>> vector;
+    const std::vector<std::pair<uint32_t, float>> no_counts;
+    for (size_t i = 0; i < post_count; ++i) {
+        vector.clear();
+        double norm = 0;
+        for (const auto& count : post_terms[i] ? post_terms[i]->counts : no_counts) {
+            const uint32_t document_frequency = document_frequencies[count.first];
+            if (document_frequency > max_document_frequency) continue;
+            double weight = (1.0 + std::log(count.second)) *
+                            std::log(static_cast<double>(post_count) / static_cast<double>(document_frequency));
+            if (weight <= 0) continue;
+            vector.emplace_back(count.first, static_cast<float>(weight));
+            norm += weight * weight;
+        }
+        std::sort(vector.begin(), vector.end());
+        norm = std::sqrt(norm);
+        for (const auto& entry : vector) {
+            vector_terms_.push_back(entry.first);
+            vector_weights_.push_back(static_cast<float>(entry.second / norm));
+        }
+        vector_offsets_.push_back(vector_terms_.size());
+    }
+
+    // Inverted lists: only terms shared by two posts or more can relate them.
+    std::vector<uint32_t> list_sizes(vocabulary_size, 0);
+    for (uint32_t term : vector_terms_) ++list_sizes[term];
+    list_offsets_.assign(vocabulary_size + 1, 0);
+    for (size_t term = 0; term < vocabulary_size; ++term) {
+        list_offsets_[term + 1] = list_offsets_[term] + (list_sizes[term] >= 2 ? list_sizes[term] : 0);
+    }
+    list_postings_.resize(list_offsets_[vocabulary_size]);
+    std::vector<size_t> fill(list_offsets_.begin(), list_offsets_.end() - 1);
+    for (size_t i = 0; i < post_count; ++i) {
+        for (size_t v = vector_offsets_[i]; v < vector_offsets_[i + 1]; ++v) {
+            const uint32_t term = vector_terms_[v];
+            if (list_sizes[term] >= 2) list_postings_[fill[term]++] = {static_cast<uint32_t>(i), vector_weights_[v]};
+        }
+    }
+    for (size_t term = 0; term < vocabulary_size; ++term) {
+        std::sort(list_postings_.begin() + static_cast<std::ptrdiff_t>(list_offsets_[term]),
+                  list_postings_.begin() + static_cast<std::ptrdiff_t>(list_offsets_[term + 1]),
+                  [](const Posting& a, const Posting& b) { return a.weight != b.weight ? a.weight > b.weight : a.post < b.post; });
+    }
+
+    neighbours_.assign(post_count, {});
+    candidates_scored_ = 0;
+}
+
+// --- Neighbours ---
+
+namespace {
+
+// Bounds are sums of floats added in another order than the exact scores, so
+// pruning keeps this much margin: a post is only ruled out if it is clearly worse.
+constexpr float SCORE_EPSILON = 1e-5f;
+// Seeds: the first postings of the post's heaviest terms, scored up front.
+constexpr size_t SEED_TERMS = 8;
+constexpr size_t SEEDS_PER_TERM = 2;
+
+} // namespace
+
+void RelatedPosts::find_neighbours(size_t slice, size_t slice_count) {
+    static const DotFunction dot = dot_function();
+    const size_t post_count = posts_.size();
+    std::vector<float> dense(vocabulary_.size(), 0.0f); // The post's vector
+    std::vector<float> partial(post_count, 0.0f);      // Scores over the lists walked so far
+    std::vector<uint32_t> scored_for(post_count, UINT32_MAX); // Post a candidate was last scored for
+    std::vector<uint32_t> candidates;
+    std::vector<size_t> order;
+    std::vector<float> remaining; // remaining[j]: best score a post gets from terms order[j] and after
+    std::vector<std::pair<float, uint32_t>> bounds;
+    struct Scored {
+        int64_t rank;
+        uint32_t post;
+        bool operator<(const Scored& other) const { // Best first, then newest
+            return rank != other.rank ? rank > other.rank : post < other.post;
+        }
+    };
+    std::vector<Scored> best;
+    size_t candidates_scored = 0;
+
+    for (size_t post = slice; post < post_count; post += slice_count) {
+        const size_t begin = vector_offsets_[post];
+        const size_t end = vector_offsets_[post + 1];
+        if (begin == end) continue;
+
+        order.clear();
+        for (size_t v = begin; v < end; ++v) {
+            dense[vector_terms_[v]] = vector_weights_[v];
+            order.push_back(v);
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return vector_weights_[a] > vector_weights_[b]; });
+        remaining.assign(order.size() + 1, 0.0f);
+        for (size_t j = order.size(); j-- > 0;) {
+            const uint32_t term = vector_terms_[order[j]];
+            const float top = list_offsets_[term] == list_offsets_[term + 1] ? 0.0f : list_postings_[list_offsets_[term]].weight;
+            remaining[j] = remaining[j + 1] + vector_weights_[order[j]] * top;
+        }
+
+        // Exact scores, keeping the k best; threshold is the k-th best's score.
+        best.clear();
+        float threshold = 0;
+        auto score = [&](uint32_t candidate) {
+            if (scored_for[candidate] == post) return;
+            scored_for[candidate] = static_cast<uint32_t>(post);
+            const size_t offset = vector_offsets_[candidate];
+            const float exact = dot(dense.data(), vector_terms_.data() + offset, vector_weights_.data() + offset,
+                                    vector_offsets_[candidate + 1] - offset);
+            ++candidates_scored;
+            const Scored entry{rank_key(exact), candidate};
+            if (best.size() == RELATED_POST_COUNT && !(entry < best.back())) return;
+            best.insert(std::upper_bound(best.begin(), best.end(), entry), entry);
+            if (best.size() > RELATED_POST_COUNT) best.pop_back();
+            if (best.size() == RELATED_POST_COUNT) threshold = static_cast<float>(best.back().rank) / (1 << 20);
+        };
+        for (size_t j = 0; j < std::min(order.size(), SEED_TERMS); ++j) {
+            const uint32_t term = vector_terms_[order[j]];
+            size_t seeds = 0;
+            for (size_t p = list_offsets_[term]; p < list_offsets_[term + 1] && seeds < SEEDS_PER_TERM; ++p) {
+                if (list_postings_[p].post == post) continue;
+                score(list_postings_[p].post);
+                ++seeds;
+            }
+        }
+
+        // Candidates: walk each list while a post first seen there could still
+        // beat the threshold. What the cut tails could add to posts already
+        // seen is at most the first skipped contribution of each (slack).
+        candidates.clear();
+        float slack = 0;
+        size_t j = 0;
+        for (bool budget_left = true; j < order.size() && budget_left; ++j) {
+            if (remaining[j] + SCORE_EPSILON < threshold) break; // Not even a post in every list could
+            const uint32_t term = vector_terms_[order[j]];
+            const float weight = vector_weights_[order[j]];
+            for (size_t p = list_offsets_[term]; p < list_offsets_[term + 1]; ++p) {
+                const Posting& posting = list_postings_[p];
+                const float contribution = weight * posting.weight;
+                budget_left = candidates.size() < RELATED_MAX_CANDIDATES;
+                if (!budget_left || contribution + remaining[j + 1] + SCORE_EPSILON < threshold) {
+                    slack += contribution;
+                    break;
+                }
+                if (posting.post == post) continue;
+                if (partial[posting.post] == 0.0f) candidates.push_back(posting.post);
+                partial[posting.post] += contribution;
+            }
+        }
+
+        // Exact scores, most promising first, until no candidate left can make it.
+        bounds.clear();
+        for (uint32_t candidate : candidates) {
+            const float bound = partial[candidate] + slack + remaining[j];
+            if (bound + SCORE_EPSILON >= threshold) bounds.emplace_back(bound, candidate);
+            partial[candidate] = 0.0f;
+        }
+        std::sort(bounds.begin(), bounds.end(), [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) {
+            return a.first > b.first;
+        });
+        for (const auto& bound : bounds) {
+            if (bound.first + SCORE_EPSILON < threshold) break;
+            score(bound.second);
+        }
+        for (size_t v = begin; v < end; ++v) dense[vector_terms_[v]] = 0.0f;
+
+        std::vector<uint32_t>& neighbours = neighbours_[post];
+        for (const Scored& entry : best) neighbours.push_back(entry.post);
+    }
+    candidates_scored_ += candidates_scored;
+}
+
+void RelatedPosts::release_vectors() {
+    std::vector<size_t>().swap(vector_offsets_);
+    std::vector<uint32_t>().swap(vector_terms_);
+    std::vector<float>().swap(vector_weights_);
+    std::vector<size_t>().swap(list_offsets_);
+    std::vector<Posting>().swap(list_postings_);
+}
+
+void RelatedPosts::compute(const std::vector<const PostMetadata*>& posts, unsigned jobs) {
+    prepare(posts);
+    jobs = std::max(1u, jobs);
+    std::vector<std::thread> threads;
+    for (unsigned slice = 1; slice < jobs; ++slice) threads.emplace_back([this, slice, jobs] { find_neighbours(slice, jobs); });
+    find_neighbours(0, jobs);
+    for (auto& thread : threads) thread.join();
+    release_vectors();
+}
+
+void RelatedPosts::clear() {
+    release_vectors();
+    std::vector<std::vector<uint32_t>>().swap(neighbours_);
+    std::vector<const PostMetadata*>().swap(posts_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string>().swap(vocabulary_);
+    std::unordered_map<std::string, uint32_t>().swap(term_ids_);
+    std::unordered_map<std::string, PostTerms>().swap(terms_);
+}
+
+// --- Output ---
+
+std::string RelatedPosts::html(size_t i) const {
+    if (neighbours_[i].empty()) return "";
+    // Post pages live in p/, next to each other; permalinks are relative to public/.
+    std::string html = "<aside class=\"related-posts\"><h2>Related posts</h2><ul>";
+    for (uint32_t neighbour : neighbours_[i]) {
+        const PostMetadata& post = *posts_[neighbour];
+        html += "<li><a href=\"../" + post.permalink + "\">" + post.title + "</a> <span class=\"post-date\">" + post.date + "</span></li>";
+    }
+    return html + "</ul></aside>";
+}
+
+std::string RelatedPosts::summary() const {
+    const size_t post_count = posts_.size();
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    out << post_count << " posts, "
+        << (post_count ? static_cast<double>(candidates_scored_) / static_cast<double>(post_count) : 0.0)
+        << " candidates scored per post (" << (has_avx2() ? "AVX2" : "scalar") << ")";
+    return out.str();
+}
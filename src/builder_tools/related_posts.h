@@ -0,0 +1,113 @@
+#ifndef RELATED_POSTS_H
+#define RELATED_POSTS_H
+
+#include "search_index.h"
+#include <atomic>
+#include <unordered_map>
+
+// --- Related Posts ---
+// Every post page lists the RELATED_POST_COUNT posts most similar to it in a
+// {{RELATED_POSTS}} block. Similarity is the cosine of TF-IDF vectors built
+// from the term counts the search index already collects (SearchTermCounts,
+// titles weighted like in the index): weight = (1 + ln tf) * ln(N / df),
+// L2-normalized. Each post keeps its RELATED_MAX_TERMS most frequent terms,
+// and terms in more than RELATED_MAX_DF_RATIO of the posts are left out: they
+// say little about what a post is about and have the longest lists.
+//
+// Neighbours are found without comparing every pair of posts:
+//   prepare()          builds the vectors and an inverted list per term (its
+//                      posts by descending weight).
+//   find_neighbours()  for each post, scores a few seeds exactly (the top
+//                      posts of its heaviest terms) for a first k-th best
+//                      score, then walks the lists of its terms by descending
+//                      weight, collecting the posts sharing them as candidates
+//                      while one not seen yet could still beat that score (the
+//                      remaining terms' weights times their lists' best
+//                      weights bound it). Candidates are then scored exactly,
+//                      best bound first, until none left can make the top k:
+//                      a dot product of their sparse vector with the post's,
+//                      scattered into a dense array (AVX2 gathers where the
+//                      CPU has them).
+// The result is the exact top k, unless a post runs into RELATED_MAX_CANDIDATES:
+// on sites where no posts are much alike, the walk stops there, and a post
+// sharing only lighter terms may be missed. That bounds the work per post, so
+// the stage stays linear in the number of posts.
+// Posts are independent of each other in find_neighbours, so slices of them
+// run in parallel. Ties go to the newer post, so the result never depends on
+// the number of slices.
+//
+// Term counts are kept between builds in RELATED_TERMS_PATH (outside public/),
+// by post and content hash: only new and edited posts are tokenized again.
+
+extern const fs::path RELATED_TERMS_PATH;
+
+constexpr size_t RELATED_POST_COUNT = 5;
+constexpr size_t RELATED_MAX_TERMS = 64;
+constexpr double RELATED_MAX_DF_RATIO = 0.25;
+constexpr size_t RELATED_MAX_CANDIDATES = 1024;
+
+class RelatedPosts {
+public:
+    // False (and no term counts) if there is no saved state or it was written
+    // with other tokenizer options.
+    bool load(const fs::path& path, const TokenizerOptions& tokenizer_options);
+    // Saves the term counts of the posts given to the last prepare().
+    bool save(const fs::path& path, const TokenizerOptions& tokenizer_options) const;
+
+    // Posts with term counts, including ones no longer given to prepare().
+    size_t stored_post_count() const;
+    // Whether the term counts of post_id are those of this content hash.
+    bool has_terms(const std::string& post_id, const std::string& content_hash) const;
+    // Keeps the RELATED_MAX_TERMS most frequent of counts. Thread-safe.
+    void set_terms(const std::string& post_id, const std::string& content_hash, const SearchTermCounts& counts);
+
+    // Builds the vectors and inverted lists of posts (every one of which must
+    // have term counts; ones without are never related). Neighbours are by
+    // position in posts, which should be newest first.
+    void prepare(const std::vector<const PostMetadata*>& posts);
+    // Finds the neighbours of posts slice, slice + slice_count, ... Slices
+    // can run in parallel; every slice must run before neighbours() is used.
+    void find_neighbours(size_t slice, size_t slice_count);
+    // Frees the vectors and inverted lists once every slice has run; the
+    // neighbours stay.
+    void release_vectors();
+    // prepare(), find_neighbours() on `jobs` threads, then release_vectors().
+    void compute(const std::vector<const PostMetadata*>& posts, unsigned jobs);
+    // Frees everything, term counts included.
+    void clear();
+
+    // Positions (in prepare's posts) of the posts most related to posts[i], most similar first.
+    const std::vector<uint32_t>& neighbours(size_t i) const { return neighbours_[i]; }
+    // "<aside class="related-posts">...</aside>" for posts[i], linked from a
+    // post page; empty without neighbours.
+    std::string html(size_t i) const;
+    // "713 posts, 2.1 candidates scored per post, AVX2"
+    std::string summary() const;
+
+private:
+    struct PostTerms {
+        std::string content_hash;
+        std::vector<std::pair<uint32_t, float>> counts; // Vocabulary ID, weighted term frequency
+    };
+    struct Posting {
+        uint32_t post;
+        float weight;
+    };
+
+    mutable std::mutex mutex_; // Guards vocabulary_ and terms_ during set_terms
+    std::vector<std::string> vocabulary_;
+    std::unordered_map<std::string, uint32_t> term_ids_;
+    std::unordered_map<std::string, PostTerms> terms_; // By post id
+
+    // From prepare(): vectors (sorted by term ID) and inverted lists, both flat.
+    std::vector<const PostMetadata*> posts_;
+    std::vector<size_t> vector_offsets_; // posts_.size() + 1 entries
+    std::vector<uint32_t> vector_terms_;
+    std::vector<float> vector_weights_;
+    std::vector<size_t> list_offsets_; // vocabulary_.size() + 1 entries
+    std::vector<Posting> list_postings_;
+    std::vector<std::vector<uint32_t>> neighbours_;
+    std::atomic<size_t> candidates_scored_{0};
+};
+
+#endif // RELATED_POSTS_H
@@ -0,0 +1,590 @@
+#include "search_index.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+SearchIndexBuilder search_index;
+
+// --- Encoding Helpers ---
+
+void append_varint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+// --- SearchIndexBuilder ---
+
+// Heap footprint of an allocation of size bytes: malloc rounds up to 16 bytes
+// with an 8-byte header and never hands out less than 32.
+static size_t allocation_bytes(size_t size) {
+    return size == 0 ? 0 : std::max<size_t>(32, (size + 8 + 15) & ~size_t(15));
+}
+
+SearchIndexBuilder::~SearchIndexBuilder() {
+    remove_spill_runs_locked(); // Nothing else can hold the mutex any more
+}
+
+SearchIndexBuilder::Document SearchIndexBuilder::tokenize(const std::string& post_id, const std::string& title,
+                                                          const std::string& body) const {
+    Document document;
+    document.post_id = post_id;
+
+    // Keyed by the tokenizer's string_view: lookups of repeated terms don't allocate.
+    std::map<std::string, TermStats, std::less<>> stats_by_term;
+    auto add_field = [&](SearchTokenizer& tokenizer, bool is_title) {
+        std::string_view token;
+        uint32_t position = 0;
+        while (tokenizer.next(token, position)) {
+            auto it = stats_by_term.find(token);
+            if (it == stats_by_term.end()) it = stats_by_term.emplace(std::string(token), TermStats{}).first;
+            TermStats& stats = it->second;
+            (is_title ? stats.title_frequency : stats.body_frequency) += 1;
+            stats.positions.push_back(position);
+            (is_title ? document.title_length : document.body_length) += 1;
+        }
+    };
+    SearchTokenizer title_tokens(title, TextKind::PlainText, tokenizer_options_);
+    add_field(title_tokens, true);
+    // A phrase never spans the title/body boundary
+    SearchTokenizer body_tokens(body, TextKind::Html, tokenizer_options_, title_tokens.next_position() + 1);
+    add_field(body_tokens, false);
+
+    document.terms.reserve(stats_by_term.size());
+    document.term_bytes = allocation_bytes(stats_by_term.size() * sizeof(TermStats));
+    for (auto& pair : stats_by_term) { // Already sorted by term
+        pair.second.term = pair.first;
+        pair.second.positions.shrink_to_fit();
+        document.term_bytes += allocation_bytes(pair.second.positions.capacity() * sizeof(uint32_t)) +
+                               (pair.first.size() > 15 ? allocation_bytes(pair.first.capacity() + 1) : 0); // Beyond the short string buffer
+        document.terms.push_back(std::move(pair.second));
+    }
+
+    document.words_seen = title_tokens.words_seen() + body_tokens.words_seen();
+    document.stopwords_removed = title_tokens.stopwords_removed() + body_tokens.stopwords_removed();
+    document.markup_bytes_skipped = body_tokens.markup_bytes_skipped();
+    return document;
+}
+
+SearchTermCounts SearchIndexBuilder::term_counts_of(const Document& document) {
+    SearchTermCounts counts;
+    counts.reserve(document.terms.size());
+    for (const auto& stats : document.terms) {
+        counts.emplace_back(stats.term, static_cast<float>(stats.title_frequency * SEARCH_TITLE_WEIGHT +
+                                                           stats.body_frequency * SEARCH_BODY_WEIGHT));
+    }
+    return counts;
+}
+
+void SearchIndexBuilder::add_document(const std::string& post_id, const std::string& title, const std::string& body,
+                                      SearchTermCounts* term_counts) {
+    Document document = tokenize(post_id, title, body);
+    if (term_counts) *term_counts = term_counts_of(document);
+
+    std::lock_guard<std::mutex> lock(mutex_); // Only the append (and a spill) is serialized
+    words_seen_ += document.words_seen;
+    stopwords_removed_ += document.stopwords_removed;
+    markup_bytes_skipped_ += document.markup_bytes_skipped;
+    document.ordinal = next_ordinal_++;
+    term_bytes_ += document.term_bytes;
+    documents_.push_back(std::move(document));
+    if (memory_budget_ > 0 && term_bytes_ > memory_budget_) spill_locked();
+}
+
+SearchTermCounts SearchIndexBuilder::count_terms(const std::string& title, const std::string& body) const {
+    return term_counts_of(tokenize("", title, body));
+}
+
+void SearchIndexBuilder::remove_document(const std::string& post_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto removed = std::remove_if(documents_.begin(), documents_.end(),
+                                  [&](const Document& document) { return document.post_id == post_id; });
+    for (auto it = removed; it != documents_.end(); ++it) {
+        words_seen_ -= it->words_seen;
+        stopwords_removed_ -= it->stopwords_removed;
+        markup_bytes_skipped_ -= it->markup_bytes_skipped;
+        term_bytes_ -= it->term_bytes;
+    }
+    documents_.erase(removed, documents_.end()); // Spilled postings of its ordinal are skipped from now on
+}
+
+bool SearchIndexBuilder::has_document(const std::string& post_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::any_of(documents_.begin(), documents_.end(),
+                       [&](const Document& document) { return document.post_id == post_id; });
+}
+
+void SearchIndexBuilder::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    documents_.clear();
+    next_ordinal_ = 0;
+    term_bytes_ = 0;
+    remove_spill_runs_locked();
+    words_seen_ = 0;
+    stopwords_removed_ = 0;
+    markup_bytes_skipped_ = 0;
+}
+
+void SearchIndexBuilder::set_memory_budget(size_t budget_bytes, const fs::path& spill_dir) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_budget_ = budget_bytes;
+    spill_dir_ = spill_dir;
+}
+
+// --- Spill Runs ---
+// A run holds the postings of the documents that were in memory when it was
+// written, sorted by term, then ordinal:
+//   per term: varint length, term bytes, varint posting count, then per
+//   posting: varint ordinal, title frequency, body frequency, position count
+//   and the positions (first, then gaps).
+
+void SearchIndexBuilder::spill_locked() {
+    std::vector<std::pair<const TermStats*, const Document*>> postings;
+    for (const Document& document : documents_) {
+        for (const TermStats& stats : document.terms) postings.emplace_back(&stats, &document);
+    }
+    std::sort(postings.begin(), postings.end(), [](const auto& a, const auto& b) {
+        int order = a.first->term.compare(b.first->term);
+        return order != 0 ? order < 0 : a.second->ordinal < b.second->ordinal;
+    });
+
+    std::error_code ec;
+    fs::create_directories(spill_dir_, ec);
+    const fs::path run_path = spill_dir_ / ("search-run-" + std::to_string(spill_runs_.size()) + ".bin");
+    std::ofstream file(run_path, std::ios::binary | std::ios::trunc);
+    std::string buffer;
+    for (size_t begin = 0; begin < postings.size() && file;) {
+        const std::string& term = postings[begin].first->term;
+        size_t end = begin;
+        while (end < postings.size() && postings[end].first->term == term) ++end;
+        append_varint(buffer, term.size());
+        buffer += term;
+        append_varint(buffer, end - begin);
+        for (; begin < end; ++begin) {
+            const TermStats& stats = *postings[begin].first;
+            append_varint(buffer, postings[begin].second->ordinal);
+            append_varint(buffer, stats.title_frequency);
+            append_varint(buffer, stats.body_frequency);
+            append_varint(buffer, stats.positions.size());
+            for (size_t k = 0; k < stats.positions.size(); ++k) {
+                append_varint(buffer, k == 0 ? stats.positions[k] : stats.positions[k] - stats.positions[k - 1]);
+            }
+        }
+        if (buffer.size() >= (1u << 20)) {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.close();
+    if (ec || !file) {
+        // Not fatal: the index just stays in memory.
+        std::cerr << "Warning: Could not write search spill run " << run_path
+                  << "; keeping the search index in memory." << std::endl;
+        fs::remove(run_path, ec);
+        memory_budget_ = 0;
+        return;
+    }
+
+    spill_runs_.push_back(run_path);
+    for (Document& document : documents_) {
+        std::vector<TermStats>().swap(document.terms);
+        document.term_bytes = 0;
+    }
+    term_bytes_ = 0;
+#ifdef __GLIBC__
+    // The freed statistics are scattered between live allocations, where free()
+    // keeps them; hand their pages back or they count against the budget.
+    malloc_trim(0);
+#endif
+}
+
+void SearchIndexBuilder::remove_spill_runs_locked() {
+    std::error_code ec;
+    for (const auto& run_path : spill_runs_) fs::remove(run_path, ec);
+    if (!spill_runs_.empty()) fs::remove(spill_dir_, ec); // Only if nothing else is in it
+    spill_runs_.clear();
+}
+
+namespace {
+
+// Every run is read at once by the merge: keep their buffers small.
+constexpr size_t SPILL_READ_BUFFER_BYTES = 256 * 1024;
+
+// Sequential reader of a spill run.
+class SpillRunReader {
+public:
+    explicit SpillRunReader(const fs::path& path) : path_(path), file_(path, std::ios::binary) {
+        failed_ = !file_.is_open();
+    }
+
+    const fs::path& path() const { return path_; }
+    bool failed() const { return failed_; }
+    bool at_end() {
+        return position_ == buffer_.size() && !refill();
+    }
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = next_byte();
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        failed_ = true;
+        return 0;
+    }
+    void read(std::string& out, size_t size) {
+        out.clear();
+        while (out.size() < size && !failed_) {
+            if (position_ == buffer_.size() && !refill()) {
+                failed_ = true;
+                break;
+            }
+            size_t count = std::min(size - out.size(), buffer_.size() - position_);
+            out.append(buffer_, position_, count);
+            position_ += count;
+        }
+    }
+
+private:
+    bool refill() {
+        buffer_.resize(SPILL_READ_BUFFER_BYTES);
+        file_.read(&buffer_[0], static_cast<std::streamsize>(buffer_.size()));
+        buffer_.resize(static_cast<size_t>(file_.gcount()));
+        position_ = 0;
+        return !buffer_.empty();
+    }
+    uint8_t next_byte() {
+        if (position_ == buffer_.size() && !refill()) {
+            failed_ = true; // Truncated run
+            return 0;
+        }
+        return static_cast<uint8_t>(buffer_[position_++]);
+    }
+
+    fs::path path_;
+    std::ifstream file_;
+    std::string buffer_;
+    size_t position_ = 0;
+    bool failed_ = false;
+};
+
+} // namespace
+
+bool SearchIndexBuilder::for_each_term(const std::vector<uint32_t>& doc_ids, const TermVisitor& visit) const {
+    constexpr uint32_t NO_DOC = UINT32_MAX;
+    std::vector<const Document*> documents_by_ordinal(next_ordinal_, nullptr);
+    for (const Document& document : documents_) documents_by_ordinal[document.ordinal] = &document;
+
+    // Postings still in memory, sorted by term.
+    std::vector<std::pair<const TermStats*, const Document*>> resident;
+    for (const Document& document : documents_) {
+        if (doc_ids[document.ordinal] == NO_DOC) continue;
+        for (const TermStats& stats : document.terms) resident.emplace_back(&stats, &document);
+    }
+    std::sort(resident.begin(), resident.end(),
+              [](const auto& a, const auto& b) { return a.first->term < b.first->term; });
+    size_t next_resident = 0;
+
+    // Each run's next term (read ahead; its postings are read when it is merged).
+    struct RunCursor {
+        std::unique_ptr<SpillRunReader> reader;
+        std::string term;
+        size_t posting_count = 0;
+        bool done = false;
+        void advance() {
+            done = reader->at_end();
+            if (done) return;
+            size_t length = reader->varint();
+            reader->read(term, length);
+            posting_count = reader->varint();
+            done = reader->failed();
+        }
+    };
+    std::vector<RunCursor> runs(spill_runs_.size());
+    for (size_t r = 0; r < runs.size(); ++r) {
+        runs[r].reader = std::make_unique<SpillRunReader>(spill_runs_[r]);
+        runs[r].advance();
+    }
+
+    std::vector<MergedPosting> postings;
+    std::vector<uint32_t> run_positions; // Of the postings read from runs
+    std::vector<size_t> run_position_begin;
+    std::string term;
+    while (true) {
+        const std::string* smallest = next_resident < resident.size() ? &resident[next_resident].first->term : nullptr;
+        for (const RunCursor& run : runs) {
+            if (!run.done && (!smallest || run.term < *smallest)) smallest = &run.term;
+        }
+        if (!smallest) break;
+        term = *smallest;
+
+        postings.clear();
+        for (; next_resident < resident.size() && resident[next_resident].first->term == term; ++next_resident) {
+            const TermStats& stats = *resident[next_resident].first;
+            const Document& document = *resident[next_resident].second;
+            postings.push_back({doc_ids[document.ordinal], stats.title_frequency, stats.body_frequency,
+                                document.title_length, document.body_length, stats.positions.data(), stats.positions.size()});
+        }
+        const size_t resident_count = postings.size();
+        run_positions.clear();
+        run_position_begin.clear();
+        for (RunCursor& run : runs) {
+            if (run.done || run.term != term) continue;
+            SpillRunReader& reader = *run.reader;
+            for (size_t i = 0; i < run.posting_count && !reader.failed(); ++i) {
+                uint64_t ordinal = reader.varint();
+                uint32_t title_frequency = static_cast<uint32_t>(reader.varint());
+                uint32_t body_frequency = static_cast<uint32_t>(reader.varint());
+                size_t position_count = reader.varint();
+                size_t position_begin = run_positions.size();
+                uint32_t position = 0;
+                for (size_t k = 0; k < position_count; ++k) {
+                    position = static_cast<uint32_t>(k == 0 ? reader.varint() : position + reader.varint());
+                    run_positions.push_back(position);
+                }
+                // Removed since (or not in this segment): skipped
+                const Document* document = ordinal < documents_by_ordinal.size() ? documents_by_ordinal[ordinal] : nullptr;
+                if (!document || doc_ids[ordinal] == NO_DOC) {
+                    run_positions.resize(position_begin);
+                    continue;
+                }
+                postings.push_back({doc_ids[ordinal], title_frequency, body_frequency, document->title_length,
+                                    document->body_length, nullptr, position_count});
+                run_position_begin.push_back(position_begin);
+            }
+            if (reader.failed()) {
+                std::cerr << "Error: Could not read search spill run " << reader.path() << std::endl;
+                return false;
+            }
+            run.advance();
+        }
+        // Only now that run_positions is complete are pointers into it stable.
+        for (size_t i = resident_count; i < postings.size(); ++i) {
+            postings[i].positions = run_positions.data() + run_position_begin[i - resident_count];
+        }
+        if (postings.empty()) continue;
+        std::sort(postings.begin(), postings.end(),
+                  [](const MergedPosting& a, const MergedPosting& b) { return a.doc_id < b.doc_id; });
+        if (!visit(term, postings)) return false;
+    }
+    for (const RunCursor& run : runs) {
+        if (run.reader->failed()) {
+            std::cerr << "Error: Could not read search spill run " << run.reader->path() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchCollectionStats::add(const SearchCollectionStats& other) {
+    document_count += other.document_count;
+    title_length_total += other.title_length_total;
+    body_length_total += other.body_length_total;
+    for (const auto& entry : other.document_frequencies) document_frequencies[entry.first] += entry.second;
+}
+
+// Appends a sorted ID list as first ID + gaps, preceded by its byte length.
+static void append_id_list(std::string& out, const std::vector<uint32_t>& ids, std::string& scratch) {
+    scratch.clear();
+    for (size_t i = 0; i < ids.size(); ++i) append_varint(scratch, i == 0 ? ids[i] : ids[i] - ids[i - 1]);
+    append_varint(out, scratch.size());
+    out += scratch;
+}
+
+static std::string shard_header() {
+    return std::string(1, static_cast<char>(SEARCH_INDEX_FORMAT_VERSION));
+}
+
+bool SearchIndexBuilder::encode(const std::vector<const PostMetadata*>& sorted_posts, const SearchCollectionStats& others,
+                                SearchIndexFiles& files, const SearchShardWriter& write_shard) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files = SearchIndexFiles();
+
+    std::unordered_map<std::string_view, uint32_t> positions_by_id;
+    positions_by_id.reserve(sorted_posts.size());
+    for (size_t i = 0; i < sorted_posts.size(); ++i) {
+        positions_by_id.emplace(sorted_posts[i]->id, static_cast<uint32_t>(i));
+    }
+    std::vector<uint32_t> doc_ids(next_ordinal_, UINT32_MAX); // By ordinal
+    for (const Document& document : documents_) {
+        auto it = positions_by_id.find(document.post_id);
+        if (it == positions_by_id.end()) continue;
+        doc_ids[document.ordinal] = it->second;
+        files.stats.title_length_total += document.title_length;
+        files.stats.body_length_total += document.body_length;
+        ++files.stats.document_count;
+    }
+
+    // BM25F score of every posting against this segment and the others
+    // together, then quantized so the best one is 255.
+    const double document_count = static_cast<double>(files.stats.document_count + others.document_count);
+    const double total_title_length = static_cast<double>(files.stats.title_length_total + others.title_length_total);
+    const double total_body_length = static_cast<double>(files.stats.body_length_total + others.body_length_total);
+    const double average_title_length = document_count ? std::max(1.0, total_title_length / document_count) : 1.0;
+    const double average_body_length = document_count ? std::max(1.0, total_body_length / document_count) : 1.0;
+    auto idf_of = [&](const std::string& term, size_t posting_count) {
+        double document_frequency = static_cast<double>(posting_count);
+        auto other = others.document_frequencies.find(term);
+        if (other != others.document_frequencies.end()) document_frequency += other->second;
+        return std::log(1.0 + (document_count - document_frequency + 0.5) / (document_frequency + 0.5));
+    };
+    auto score_of = [&](const MergedPosting& posting, double idf) {
+        double title_norm = 1.0 - SEARCH_TITLE_B + SEARCH_TITLE_B * posting.title_length / average_title_length;
+        double body_norm = 1.0 - SEARCH_BODY_B + SEARCH_BODY_B * posting.body_length / average_body_length;
+        double weighted_frequency = SEARCH_TITLE_WEIGHT * posting.title_frequency / title_norm
+                                  + SEARCH_BODY_WEIGHT * posting.body_frequency / body_norm;
+        return idf * weighted_frequency * (SEARCH_BM25_K1 + 1.0) / (weighted_frequency + SEARCH_BM25_K1);
+    };
+
+    // First pass: the vocabulary (term ID = position), document frequencies and the best score.
+    std::vector<std::string> terms;
+    size_t posting_count = 0;
+    double max_score = 0;
+    bool ok = for_each_term(doc_ids, [&](const std::string& term, const std::vector<MergedPosting>& postings) {
+        files.stats.document_frequencies.emplace_hint(files.stats.document_frequencies.end(), term,
+                                                      static_cast<uint32_t>(postings.size()));
+        const double idf = idf_of(term, postings.size());
+        for (const MergedPosting& posting : postings) max_score = std::max(max_score, score_of(posting, idf));
+        terms.push_back(term);
+        posting_count += postings.size();
+        return true;
+    });
+    if (!ok) return false;
+    auto impact_of = [&](double score) {
+        long impact = max_score > 0 ? std::lround(score * 255.0 / max_score) : 1;
+        return static_cast<char>(static_cast<uint8_t>(std::clamp(impact, 1L, 255L)));
+    };
+
+    size_t total_bytes = 0;
+    size_t shard_count = 0;
+    auto emit = [&](std::string name, std::string content) {
+        total_bytes += content.size();
+        ++shard_count;
+        if (write_shard) return write_shard(name, std::move(content));
+        files.shards.emplace_back(std::move(name), std::move(content));
+        return true;
+    };
+
+    // One flat (gram, term ID) vector, sorted once. Grams are packed big-endian
+    // into an integer so they sort in byte order.
+    std::vector<std::pair<uint32_t, uint32_t>> grams;
+    for (uint32_t term_id = 0; term_id < terms.size(); ++term_id) {
+        std::string padded = terms[term_id] + SEARCH_TERM_END;
+        for (size_t i = 0; i + 3 <= padded.size(); ++i) {
+            uint32_t gram = (static_cast<uint8_t>(padded[i]) << 16) | (static_cast<uint8_t>(padded[i + 1]) << 8) |
+                            static_cast<uint8_t>(padded[i + 2]);
+            grams.emplace_back(gram, term_id);
+        }
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end()); // A term may repeat a gram
+
+    files.impact_scale = max_score / 255.0;
+    std::string scratch;
+
+    // Gram shards, one per first byte.
+    size_t gram_count = 0;
+    std::vector<uint32_t> term_ids;
+    for (size_t shard_begin = 0; shard_begin < grams.size();) {
+        char key = static_cast<char>(grams[shard_begin].first >> 16);
+        std::string grams_section;
+        size_t grams_in_shard = 0;
+        size_t begin = shard_begin;
+        while (begin < grams.size() && static_cast<char>(grams[begin].first >> 16) == key) {
+            uint32_t gram = grams[begin].first;
+            term_ids.clear();
+            for (; begin < grams.size() && grams[begin].first == gram; ++begin) term_ids.push_back(grams[begin].second);
+            grams_section += static_cast<char>(gram >> 16);
+            grams_section += static_cast<char>(gram >> 8);
+            grams_section += static_cast<char>(gram);
+            append_id_list(grams_section, term_ids, scratch);
+            ++grams_in_shard;
+        }
+        std::string shard = shard_header();
+        append_varint(shard, grams_in_shard);
+        shard += grams_section;
+        static const char HEX_DIGITS[] = "0123456789abcdef";
+        std::string hex_key{HEX_DIGITS[static_cast<uint8_t>(key) >> 4], HEX_DIGITS[static_cast<uint8_t>(key) & 0xf]};
+        if (!emit("g-" + hex_key + ".bin", std::move(shard))) return false;
+        files.gram_shard_keys += hex_key;
+        gram_count += grams_in_shard;
+        shard_begin = begin;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>>().swap(grams);
+
+    // Second pass: term blocks and their position blocks, each written out as
+    // soon as its last term is in.
+    std::string shard;
+    std::string positions_shard;
+    std::string postings_section;
+    std::string positions_section;
+    std::string previous_term;
+    size_t term_id = 0;
+    auto finish_block = [&] {
+        std::string block_number = std::to_string(files.term_block_count++);
+        return emit("t-" + block_number + ".bin", std::move(shard)) &&
+               emit("p-" + block_number + ".bin", std::move(positions_shard));
+    };
+    ok = for_each_term(doc_ids, [&](const std::string& term, const std::vector<MergedPosting>& postings) {
+        if (term_id == terms.size() || term != terms[term_id]) {
+            std::cerr << "Error: Search index terms changed while encoding." << std::endl;
+            return false;
+        }
+        if (term_id % SEARCH_TERM_BLOCK_SIZE == 0) {
+            if (term_id > 0 && !finish_block()) return false;
+            size_t block_terms = std::min(SEARCH_TERM_BLOCK_SIZE, terms.size() - term_id);
+            shard = shard_header();
+            positions_shard = shard_header();
+            append_varint(shard, block_terms);
+            append_varint(positions_shard, block_terms);
+            previous_term.clear();
+        }
+        size_t shared = 0;
+        size_t max_shared = std::min(term.size(), previous_term.size());
+        while (shared < max_shared && term[shared] == previous_term[shared]) ++shared;
+        append_varint(shard, shared);
+        append_varint(shard, term.size() - shared);
+        shard.append(term, shared, std::string::npos);
+
+        const double idf = idf_of(term, postings.size());
+        postings_section.clear();
+        positions_section.clear();
+        for (size_t i = 0; i < postings.size(); ++i) {
+            const MergedPosting& posting = postings[i];
+            append_varint(postings_section, i == 0 ? posting.doc_id : posting.doc_id - postings[i - 1].doc_id);
+            postings_section += impact_of(score_of(posting, idf));
+
+            append_varint(positions_section, posting.position_count);
+            for (size_t k = 0; k < posting.position_count; ++k) {
+                append_varint(positions_section, k == 0 ? posting.positions[k] : posting.positions[k] - posting.positions[k - 1]);
+            }
+        }
+        append_varint(shard, postings_section.size());
+        shard += postings_section;
+        append_varint(positions_shard, positions_section.size());
+        positions_shard += positions_section;
+        previous_term = term;
+        ++term_id;
+        return true;
+    });
+    if (!ok || (term_id > 0 && !finish_block())) return false;
+    files.term_count = terms.size();
+
+    std::cout << "🔎 Search segment: " << files.stats.document_count << " posts, " << terms.size() << " terms, " << posting_count << " postings, "
+              << gram_count << " grams in " << shard_count << " shards (" << total_bytes << " bytes";
+    if (!spill_runs_.empty()) std::cout << ", merged from " << spill_runs_.size() << " spill runs";
+    std::cout << ")." << std::endl;
+    std::cout << "🔎 Tokenizer: " << words_seen_ << " words, " << stopwords_removed_ << " stopwords dropped, "
+              << markup_bytes_skipped_ << " bytes of markup skipped." << std::endl;
+    return true;
+}
@@ -0,0 +1,211 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include "common_utils.h"
+#include "tokenizer.h"
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+// --- Sharded Search Index ---
+// search-index.js is only a manifest: searchManifest (format, the segments (see
+// search_segments.h), the tokenizer's stopwords and stemming) and postMetadata,
+// an array with one entry per post, newest first.
+//
+// The index itself is split into segments, each an independent index over some
+// of the posts in small binary files under public/search/<segment>/, fetched
+// on demand by search-logic.js.source. Within a segment, posts are numbered by
+// local doc ID (newest first when the segment was written); the manifest maps
+// them to postMetadata. A segment's files are:
+//
+//   g-<xx>.bin gram shard: every gram starting with byte xx (two hex digits).
+//              Terms are UTF-8 (see tokenizer.h) and grams are bytes: the grams
+//              of a term are the byte trigrams of term + "$", so a query of
+//              three or more bytes is looked up by intersecting the term lists
+//              of its trigrams, and a two-byte query by the union of all grams
+//              starting with it (one shard either way for short queries).
+//     u8      SEARCH_INDEX_FORMAT_VERSION
+//     varint  gram_count
+//     gram_count times, grams in ascending byte order:
+//       3 bytes gram
+//       varint  list_length   byte length of the term ID list that follows
+//       varints term IDs: first ID, then gaps
+//
+//   t-<n>.bin  term block n: terms n * SEARCH_TERM_BLOCK_SIZE and up (term IDs
+//              are positions in the sorted vocabulary). Matching candidates
+//              are verified against the real term here (trigrams only prove
+//              the pieces occur) and mapped to posts with their scores.
+//     u8      SEARCH_INDEX_FORMAT_VERSION
+//     varint  term_count
+//     term_count times:
+//       varint  shared_prefix   bytes shared with the previous term in the block
+//       varint  suffix_length
+//       bytes   suffix
+//       varint  postings_length byte length of the postings that follow
+//       postings, by ascending doc ID:
+//         varint  doc ID (first posting) or gap to the previous doc ID
+//         u8      impact          quantized BM25F score of the term in this post
+//
+//   p-<n>.bin  positions for term block n, only fetched for "phrase" queries:
+//     u8      SEARCH_INDEX_FORMAT_VERSION
+//     varint  term_count
+//     term_count times, same terms and posting order as t-<n>.bin:
+//       varint  positions_length byte length of this term's positions
+//       for every posting: varint count, then the token positions (first
+//       position, then gaps). Positions count every token of the title and
+//       then the body, including the short ones that are not indexed.
+//
+// Varints are little-endian base-128 (7 bits per byte, high bit = more bytes).
+//
+// Ranking is computed here, not in the browser: each posting stores an impact,
+// the BM25F score of the term in that post (title and body weighted
+// separately, IDF and length normalization included) scaled so the best
+// posting in the segment is 255. IDF and average lengths are those of every
+// segment together when the segment was written. The manifest gives each
+// segment's scale (score per impact unit); the client ranks by summing
+// impact * scale.
+constexpr uint8_t SEARCH_INDEX_FORMAT_VERSION = 4;
+constexpr size_t SEARCH_TERM_BLOCK_SIZE = 128;
+// Appended to each term before taking its trigrams; the tokenizer never emits it.
+constexpr char SEARCH_TERM_END = '$';
+
+// BM25F parameters.
+constexpr double SEARCH_BM25_K1 = 1.2;
+constexpr double SEARCH_TITLE_WEIGHT = 3.0;
+constexpr double SEARCH_TITLE_B = 0.5;  // Titles vary little in length
+constexpr double SEARCH_BODY_WEIGHT = 1.0;
+constexpr double SEARCH_BODY_B = 0.75;
+
+// What BM25F scores are computed against: document count, field lengths and
+// document frequencies, of one segment or of several added together.
+struct SearchCollectionStats {
+    uint64_t document_count = 0;
+    uint64_t title_length_total = 0; // Indexed tokens
+    uint64_t body_length_total = 0;
+    std::map<std::string, uint32_t> document_frequencies; // Term -> posts containing it
+
+    void add(const SearchCollectionStats& other);
+};
+
+// Receives each shard as soon as it is encoded: file name (relative to the
+// segment's directory) and binary content. Returning false stops encoding.
+using SearchShardWriter = std::function<bool(const std::string& name, std::string&& content)>;
+
+// Field-weighted frequency of every term of a document (a title occurrence
+// counts SEARCH_TITLE_WEIGHT, a body one SEARCH_BODY_WEIGHT), by term.
+using SearchTermCounts = std::vector<std::pair<std::string, float>>;
+
+struct SearchIndexFiles {
+    // File name and binary content of every shard (unless encode() was given a SearchShardWriter).
+    std::vector<std::pair<std::string, std::string>> shards;
+    std::string gram_shard_keys; // Hex first bytes that have a g-<xx>.bin, concatenated
+    size_t term_count = 0;
+    size_t term_block_count = 0; // Number of t-<n>.bin (and p-<n>.bin) files
+    double impact_scale = 0;     // BM25F score of one impact unit
+    SearchCollectionStats stats; // Of the documents encoded (for later segments' scores)
+};
+
+// Collects per-field term frequencies, field lengths and token positions of
+// every document while posts are indexed (possibly from several threads) and
+// encodes the index at the end, one term at a time in term order.
+//
+// With a memory budget, the term statistics of documents not encoded yet are
+// kept in memory up to the budget only: beyond it, they are written out to a
+// spill run (postings sorted by term) and dropped. encode() then merges the
+// runs and what is still in memory, term by term, twice: once for the
+// vocabulary and the best score (which impacts are scaled to), once to write
+// the shards out. Peak memory is the budget plus one term's postings, not the
+// size of the corpus.
+class SearchIndexBuilder {
+public:
+    SearchIndexBuilder() = default;
+    ~SearchIndexBuilder(); // Removes the spill runs
+    SearchIndexBuilder(const SearchIndexBuilder&) = delete;
+    SearchIndexBuilder& operator=(const SearchIndexBuilder&) = delete;
+
+    // Tokenizes the title (plain text) and body (HTML) and records the document's term statistics. Thread-safe.
+    // Its term counts go to term_counts if given (related_posts.h reuses them).
+    void add_document(const std::string& post_id, const std::string& title, const std::string& body,
+                      SearchTermCounts* term_counts = nullptr);
+    // The term counts add_document would give, without recording the document. Thread-safe.
+    SearchTermCounts count_terms(const std::string& title, const std::string& body) const;
+    // Drops the document of post_id (before re-adding an edited post). Thread-safe.
+    void remove_document(const std::string& post_id);
+    void clear();
+    // Spill runs go to spill_dir once the documents' term statistics take
+    // more than budget_bytes; 0 (the default) keeps everything in memory.
+    void set_memory_budget(size_t budget_bytes, const fs::path& spill_dir);
+
+    const TokenizerOptions& tokenizer_options() const { return tokenizer_options_; }
+
+    bool has_document(const std::string& post_id) const;
+
+    // Encodes the shards of one segment described above. Doc IDs are positions
+    // in sorted_posts; documents that are not in sorted_posts are left out.
+    // Scores count `others` (the segments kept beside this one) into the
+    // collection statistics. Shards go to write_shard if given, else into
+    // files.shards. False if a spill run could not be read or write_shard failed.
+    bool encode(const std::vector<const PostMetadata*>& sorted_posts, const SearchCollectionStats& others,
+                SearchIndexFiles& files, const SearchShardWriter& write_shard = {}) const;
+
+private:
+    struct TermStats {
+        std::string term;
+        uint32_t title_frequency = 0;
+        uint32_t body_frequency = 0;
+        std::vector<uint32_t> positions; // Ascending
+    };
+    struct Document {
+        std::string post_id;
+        uint32_t ordinal = 0;      // Order of addition: identifies the document in spill runs
+        uint32_t title_length = 0; // Indexed tokens per field
+        uint32_t body_length = 0;
+        std::vector<TermStats> terms; // Sorted by term, distinct; empty once spilled
+        size_t term_bytes = 0;        // Memory held by terms
+        // Tokenizer counters, subtracted again by remove_document
+        size_t words_seen = 0;
+        size_t stopwords_removed = 0;
+        size_t markup_bytes_skipped = 0;
+    };
+    // One posting of the term being encoded, from memory or a spill run.
+    struct MergedPosting {
+        uint32_t doc_id;
+        uint32_t title_frequency;
+        uint32_t body_frequency;
+        uint32_t title_length;
+        uint32_t body_length;
+        const uint32_t* positions;
+        size_t position_count;
+    };
+    using TermVisitor = std::function<bool(const std::string& term, const std::vector<MergedPosting>& postings)>;
+
+    // Calls visit for every term of the documents that have a doc ID
+    // (doc_ids, by ordinal), in term order, with its postings by doc ID.
+    bool for_each_term(const std::vector<uint32_t>& doc_ids, const TermVisitor& visit) const;
+    // Term statistics of one document (not recorded yet).
+    Document tokenize(const std::string& post_id, const std::string& title, const std::string& body) const;
+    static SearchTermCounts term_counts_of(const Document& document);
+    // Writes the term statistics of every document in memory to a new spill run. Mutex held.
+    void spill_locked();
+    void remove_spill_runs_locked();
+
+    const TokenizerOptions tokenizer_options_;
+    mutable std::mutex mutex_;
+    std::vector<Document> documents_;
+    uint32_t next_ordinal_ = 0;
+    size_t term_bytes_ = 0; // Of every document still in memory
+    size_t memory_budget_ = 0;
+    fs::path spill_dir_;
+    std::vector<fs::path> spill_runs_;
+    size_t words_seen_ = 0;
+    size_t stopwords_removed_ = 0;
+    size_t markup_bytes_skipped_ = 0;
+};
+
+// The index being built by index_post_for_search.
+extern SearchIndexBuilder search_index;
+
+void append_varint(std::string& out, uint64_t value);
+
+#endif // SEARCH_INDEX_H
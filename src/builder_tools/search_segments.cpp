@@ -0,0 +1,317 @@
+#include "search_segments.h"
+#include "build_stages.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+const fs::path SEARCH_SEGMENTS_PATH = ".build-cache/search-segments.tsv";
+
+// --- SearchSegment ---
+
+size_t SearchSegment::live_count() const {
+    return static_cast<size_t>(std::count_if(docs.begin(), docs.end(), [](const Doc& doc) { return !doc.deleted; }));
+}
+
+std::vector<std::string> SearchSegment::file_names() const {
+    std::vector<std::string> names;
+    for (size_t i = 0; i + 2 <= gram_shard_keys.size(); i += 2) {
+        names.push_back(name + "/g-" + gram_shard_keys.substr(i, 2) + ".bin");
+    }
+    for (size_t block = 0; block < term_block_count; ++block) {
+        names.push_back(name + "/t-" + std::to_string(block) + ".bin");
+        names.push_back(name + "/p-" + std::to_string(block) + ".bin");
+    }
+    return names;
+}
+
+// --- State File ---
+// One tab-separated record per line; doc and df records belong to the
+// segment record before them.
+//   format   <SEARCH_INDEX_FORMAT_VERSION>  <tokenizer options>
+//   segment  <name>  <gram shard keys>  <term blocks>  <impact scale>  <docs>  <title tokens>  <body tokens>
+//   doc      <post id>  <content hash>  live|deleted
+//   df       <term>  <document frequency>
+static const char SEGMENTS_HEADER[] = "# dee-blogger search segments";
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) break;
+        start = tab + 1;
+    }
+    return fields;
+}
+
+void SearchSegments::clear() {
+    segments_.clear();
+    reindex_.clear();
+    dropped_files_.clear();
+    changed_ = false;
+}
+
+bool SearchSegments::load(const fs::path& path, const TokenizerOptions& tokenizer_options) {
+    clear();
+    std::ifstream file(path);
+    if (!file.is_open()) return false; // No previous build
+
+    const std::string format = std::to_string(SEARCH_INDEX_FORMAT_VERSION);
+    bool format_ok = false;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        if (line.empty() || line[0] == '#') continue;
+        std::vector<std::string> fields = split_tabs(line);
+        bool ok = true;
+        try {
+            if (fields[0] == "format" && fields.size() == 3) {
+                format_ok = fields[1] == format && fields[2] == tokenizer_signature(tokenizer_options);
+                if (!format_ok) break; // Written by another index format: start over
+            } else if (fields[0] == "segment" && fields.size() == 8 && format_ok) {
+                SearchSegment segment;
+                segment.name = fields[1];
+                segment.gram_shard_keys = fields[2];
+                segment.term_block_count = std::stoul(fields[3]);
+                segment.impact_scale = std::stod(fields[4]);
+                segment.stats.document_count = std::stoull(fields[5]);
+                segment.stats.title_length_total = std::stoull(fields[6]);
+                segment.stats.body_length_total = std::stoull(fields[7]);
+                segments_.push_back(std::move(segment));
+            } else if (fields[0] == "doc" && fields.size() == 4 && !segments_.empty()) {
+                segments_.back().docs.push_back({fields[1], fields[2], fields[3] == "deleted"});
+            } else if (fields[0] == "df" && fields.size() == 3 && !segments_.empty()) {
+                segments_.back().stats.document_frequencies[fields[1]] = static_cast<uint32_t>(std::stoul(fields[2]));
+            } else {
+                ok = false;
+            }
+        } catch (const std::exception&) {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Warning: Ignoring malformed search segment state " << path << " (line " << line_number << ")" << std::endl;
+            clear(); // Forces a new base segment
+            return false;
+        }
+    }
+    if (!format_ok) clear();
+    return format_ok;
+}
+
+bool SearchSegments::save(const fs::path& path, const TokenizerOptions& tokenizer_options) const {
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "Error creating directory for " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    std::ostringstream out;
+    out << std::setprecision(17);
+    out << SEGMENTS_HEADER << "\n";
+    out << "format\t" << static_cast<int>(SEARCH_INDEX_FORMAT_VERSION) << "\t" << tokenizer_signature(tokenizer_options) << "\n";
+    for (const auto& segment : segments_) {
+        out << "segment\t" << segment.name << "\t" << segment.gram_shard_keys << "\t" << segment.term_block_count << "\t"
+            << segment.impact_scale << "\t" << segment.stats.document_count << "\t"
+            << segment.stats.title_length_total << "\t" << segment.stats.body_length_total << "\n";
+        for (const auto& doc : segment.docs) {
+            out << "doc\t" << doc.post_id << "\t" << doc.content_hash << "\t" << (doc.deleted ? "deleted" : "live") << "\n";
+        }
+        for (const auto& entry : segment.stats.document_frequencies) out << "df\t" << entry.first << "\t" << entry.second << "\n";
+    }
+
+    // Like the build manifest: never leave a truncated file behind.
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not write search segment state " << temp_path << std::endl;
+            return false;
+        }
+        file << out.str();
+        if (!file) {
+            std::cerr << "Error: Failed writing search segment state " << temp_path << std::endl;
+            return false;
+        }
+    }
+    fs::rename(temp_path, path, ec);
+    if (ec) {
+        std::cerr << "Error: Could not replace search segment state " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// --- Planning ---
+
+std::set<std::string> SearchSegments::plan(const std::vector<Post>& posts) {
+    reindex_.clear();
+    dropped_files_.clear();
+    changed_ = false;
+    auto drop_if = [&](auto predicate) {
+        auto kept = std::stable_partition(segments_.begin(), segments_.end(),
+                                          [&](const SearchSegment& segment) { return !predicate(segment); });
+        for (auto it = kept; it != segments_.end(); ++it) {
+            for (auto& name : it->file_names()) dropped_files_.push_back(std::move(name));
+            changed_ = true;
+        }
+        segments_.erase(kept, segments_.end());
+    };
+
+    // Segments with files missing (public/ cleaned by hand) are forgotten: their posts are indexed again.
+    drop_if([](const SearchSegment& segment) {
+        std::error_code ec;
+        for (const auto& name : segment.file_names()) {
+            if (!fs::exists(PUBLIC_DIR / SEARCH_SHARD_DIR / name, ec)) return true;
+        }
+        return false;
+    });
+
+    std::map<std::string, const std::string*> content_hashes;
+    for (const auto& post : posts) content_hashes[post.id] = &post.content_hash;
+    std::set<std::string> indexed;
+    for (auto& segment : segments_) {
+        for (auto& doc : segment.docs) {
+            if (doc.deleted) continue;
+            auto it = content_hashes.find(doc.post_id);
+            if (it == content_hashes.end() || *it->second != doc.content_hash || !indexed.insert(doc.post_id).second) {
+                doc.deleted = true; // Deleted, edited or (never expected) indexed twice
+                changed_ = true;
+            }
+        }
+    }
+    drop_if([](const SearchSegment& segment) { return segment.live_count() == 0; });
+    for (const auto& post : posts) {
+        if (!indexed.count(post.id)) reindex_.emplace(post.id, post.content_hash);
+    }
+
+    // Merge policy (search_segments.h).
+    if (!segments_.empty()) {
+        const SearchSegment& base = segments_.front();
+        const size_t base_live = base.live_count();
+        size_t recent_live = reindex_.size();
+        for (size_t i = 1; i < segments_.size(); ++i) recent_live += segments_[i].live_count();
+        const bool merge_all = base_live < (1.0 - SEARCH_TOMBSTONE_MERGE_RATIO) * base.docs.size() ||
+                               recent_live > SEARCH_BASE_MERGE_RATIO * base_live;
+        const size_t recent_segments = segments_.size() - 1 + (reindex_.empty() ? 0 : 1);
+        const size_t first_merged = merge_all ? 0 : recent_segments > SEARCH_MAX_RECENT_SEGMENTS ? 1 : segments_.size();
+        for (size_t i = first_merged; i < segments_.size(); ++i) {
+            segments_[i].merging = true;
+            for (const auto& doc : segments_[i].docs) {
+                if (!doc.deleted) reindex_.emplace(doc.post_id, doc.content_hash);
+            }
+        }
+    }
+    if (!reindex_.empty()) changed_ = true;
+
+    std::set<std::string> post_ids;
+    for (const auto& entry : reindex_) post_ids.insert(entry.first);
+    return post_ids;
+}
+
+bool SearchSegments::commit(const SearchIndexBuilder& builder, const std::vector<const PostMetadata*>& sorted_posts,
+                            const SearchShardWriter& write_file) {
+    std::vector<std::string> dropped;
+    auto remove_merged = [&] {
+        auto merged = std::stable_partition(segments_.begin(), segments_.end(),
+                                            [](const SearchSegment& segment) { return !segment.merging; });
+        segments_.erase(merged, segments_.end());
+    };
+    for (const auto& segment : segments_) {
+        if (!segment.merging) continue;
+        for (auto& name : segment.file_names()) dropped.push_back(std::move(name));
+    }
+    if (reindex_.empty()) {
+        remove_merged();
+        for (auto& name : dropped) dropped_files_.push_back(std::move(name));
+        return true;
+    }
+
+    // The name covers what the content follows from: the kept segments
+    // (collection statistics) and each post's source, in doc ID order.
+    SearchCollectionStats others;
+    std::string name_state = std::to_string(SEARCH_INDEX_FORMAT_VERSION) + '\n';
+    for (const auto& segment : segments_) {
+        if (segment.merging) continue;
+        others.add(segment.stats);
+        name_state += segment.name + '\n';
+    }
+    SearchSegment segment;
+    std::vector<const PostMetadata*> segment_posts;
+    for (const PostMetadata* post : sorted_posts) {
+        // A post missing from the builder (not indexed) stays out, to be picked up next time.
+        auto it = reindex_.find(post->id);
+        if (it == reindex_.end() || !builder.has_document(post->id)) continue;
+        segment_posts.push_back(post);
+        segment.docs.push_back({post->id, it->second, false});
+        name_state += post->id + '\t' + it->second + '\n';
+    }
+    segment.name = "s-" + hash_content(name_state);
+
+    SearchIndexFiles index_files;
+    std::set<std::string> written;
+    bool ok = builder.encode(segment_posts, others, index_files, [&](const std::string& file_name, std::string&& content) {
+        written.insert(segment.name + "/" + file_name);
+        return write_file(segment.name + "/" + file_name, std::move(content));
+    });
+    if (!ok) return false;
+    segment.gram_shard_keys = std::move(index_files.gram_shard_keys);
+    segment.term_block_count = index_files.term_block_count;
+    segment.impact_scale = index_files.impact_scale;
+    segment.stats = std::move(index_files.stats);
+    reindex_.clear();
+
+    // A merge that reproduces a dropped segment exactly keeps its files.
+    for (auto& name : dropped) {
+        if (!written.count(name)) dropped_files_.push_back(std::move(name));
+    }
+    remove_merged();
+    segments_.push_back(std::move(segment));
+    return true;
+}
+
+// --- Output ---
+
+std::vector<std::string> SearchSegments::file_names() const {
+    std::vector<std::string> names;
+    for (const auto& segment : segments_) {
+        for (auto& name : segment.file_names()) names.push_back(std::move(name));
+    }
+    return names;
+}
+
+std::string SearchSegments::manifest_json(const std::vector<const PostMetadata*>& sorted_posts) const {
+    std::map<std::string_view, size_t> positions;
+    for (size_t i = 0; i < sorted_posts.size(); ++i) positions.emplace(sorted_posts[i]->id, i);
+
+    std::ostringstream json;
+    json << std::setprecision(9) << "[";
+    for (size_t s = 0; s < segments_.size(); ++s) {
+        const SearchSegment& segment = segments_[s];
+        json << (s > 0 ? "," : "") << "{\"name\":\"" << segment.name << "\",\"gramShards\":\"" << segment.gram_shard_keys
+             << "\",\"termBlocks\":" << segment.term_block_count << ",\"scale\":" << segment.impact_scale << ",\"docs\":[";
+        for (size_t d = 0; d < segment.docs.size(); ++d) {
+            auto it = segment.docs[d].deleted ? positions.end() : positions.find(segment.docs[d].post_id);
+            json << (d > 0 ? "," : "");
+            if (it == positions.end()) json << "-1";
+            else json << it->second;
+        }
+        json << "]}";
+    }
+    json << "]";
+    return json.str();
+}
+
+std::string SearchSegments::summary() const {
+    size_t tombstones = 0;
+    for (const auto& segment : segments_) tombstones += segment.docs.size() - segment.live_count();
+    std::string summary = segments_.empty() ? "no segments" : "1 base";
+    if (segments_.size() > 1) summary += " + " + std::to_string(segments_.size() - 1) + " recent";
+    if (!segments_.empty()) summary += segments_.size() > 1 ? " segments" : " segment";
+    return summary + ", " + std::to_string(tombstones) + " tombstones";
+}
@@ -0,0 +1,112 @@
+#ifndef SEARCH_SEGMENTS_H
+#define SEARCH_SEGMENTS_H
+
+#include "search_index.h"
+#include <set>
+
+// --- Search Segments ---
+// The search index is a list of immutable segments (format in search_index.h):
+// a large base segment with most posts and a few small recent ones. Each lives
+// in its own directory, public/search/s-<hash>/, named after everything its
+// content follows from (its posts' sources and the segments it was scored
+// against): its files never change once written, can be cached for good and
+// are written out while the segment is still being encoded. A build only
+// encodes a segment for what changed: a new post ships a few KB of index, not
+// the whole of it again.
+//
+// A post that is deleted or edited gets a tombstone in the segment it was in:
+// search-index.js maps its local doc ID to -1 instead of a postMetadata
+// position, and the client skips it. An edited post is indexed again in the
+// new segment.
+//
+// Merge policy, applied by plan() before each update:
+//   - more than SEARCH_MAX_RECENT_SEGMENTS recent segments: they are merged
+//     into one (with the new posts)
+//   - recent segments (and new posts) holding more than
+//     SEARCH_BASE_MERGE_RATIO of the base's live posts, or a base with more
+//     than SEARCH_TOMBSTONE_MERGE_RATIO of its posts tombstoned: everything is
+//     merged into a new base, which also brings every score up to date with
+//     the current collection statistics
+//   - a segment whose posts are all tombstoned is dropped.
+// Merging means indexing the merged segments' live posts again: plan()
+// returns them with the new and edited posts, and build_site indexes them in
+// its task graph alongside the rest of the build.
+//
+// The segments of the last update are saved to SEARCH_SEGMENTS_PATH (outside
+// public/), with each one's posts and content hashes and the collection
+// statistics later segments are scored against.
+
+extern const fs::path SEARCH_SEGMENTS_PATH;
+
+constexpr size_t SEARCH_MAX_RECENT_SEGMENTS = 4;
+constexpr double SEARCH_BASE_MERGE_RATIO = 0.125;
+constexpr double SEARCH_TOMBSTONE_MERGE_RATIO = 0.5;
+
+struct SearchSegment {
+    struct Doc {
+        std::string post_id;
+        std::string content_hash; // Of the post's source when it was indexed
+        bool deleted = false;     // Tombstone
+    };
+
+    std::string name;            // Directory under SEARCH_SHARD_DIR: "s-" + hash
+    std::vector<Doc> docs;       // By local doc ID
+    std::string gram_shard_keys; // As in SearchIndexFiles
+    size_t term_block_count = 0;
+    double impact_scale = 0;
+    SearchCollectionStats stats; // Of its posts, tombstoned ones included
+    bool merging = false;        // Picked by plan(): replaced at the next commit()
+
+    size_t live_count() const;
+    // Every file, relative to SEARCH_SHARD_DIR ("s-<hash>/g-61.bin").
+    std::vector<std::string> file_names() const;
+};
+
+class SearchSegments {
+public:
+    // A post as plan() sees it: content_hash changes whenever its indexed text does.
+    struct Post {
+        std::string id;
+        std::string content_hash;
+    };
+
+    // False (and no segments) if there is no saved state or it was written
+    // with another index format or tokenizer options.
+    bool load(const fs::path& path, const TokenizerOptions& tokenizer_options);
+    bool save(const fs::path& path, const TokenizerOptions& tokenizer_options) const;
+    void clear();
+
+    // Tombstones the docs of posts that are gone or have changed, forgets
+    // segments whose files are missing from public/ and applies the merge
+    // policy. Returns the ids of the posts commit() needs in its index
+    // builder: new and edited posts and the live posts of merged segments.
+    std::set<std::string> plan(const std::vector<Post>& posts);
+    // Whether the last plan() changed anything (search-index.js is then out of date).
+    bool changed() const { return changed_; }
+
+    // Encodes the posts plan() returned (doc IDs follow sorted_posts) into a new
+    // segment, in place of the merged ones, handing each of its files to
+    // write_file as soon as it is encoded (path relative to SEARCH_SHARD_DIR).
+    // Writes nothing if plan() returned no posts. False if encoding or
+    // write_file failed; the segments are then left as they were.
+    bool commit(const SearchIndexBuilder& builder, const std::vector<const PostMetadata*>& sorted_posts,
+                const SearchShardWriter& write_file);
+    // Files of the segments the last plan() and commit() let go (relative to SEARCH_SHARD_DIR).
+    const std::vector<std::string>& dropped_files() const { return dropped_files_; }
+
+    // Files of every segment, relative to SEARCH_SHARD_DIR.
+    std::vector<std::string> file_names() const;
+    // searchManifest.segments: [{"name", "gramShards", "termBlocks", "scale",
+    // "docs": postMetadata position of each local doc ID, -1 for tombstones}].
+    std::string manifest_json(const std::vector<const PostMetadata*>& sorted_posts) const;
+    // "1 base + 2 recent segments, 3 tombstones"
+    std::string summary() const;
+
+private:
+    std::vector<SearchSegment> segments_; // Oldest (the base) first
+    std::map<std::string, std::string> reindex_; // The last plan()'s posts: id -> content hash
+    std::vector<std::string> dropped_files_;
+    bool changed_ = false;
+};
+
+#endif // SEARCH_SEGMENTS_H
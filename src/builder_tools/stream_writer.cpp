@@ -0,0 +1,381 @@
+#include "stream_writer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#ifdef BUILDER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// --- Compression Settings ---
+
+static bool dev_compression_enabled = false;
+
+void set_dev_compression(bool dev_build) {
+    dev_compression_enabled = dev_build;
+}
+
+bool dev_compression() {
+    return dev_compression_enabled;
+}
+
+CompressionSettings compression_settings_for(OutputClass output_class) {
+    CompressionSettings settings;
+    switch (output_class) {
+        case OutputClass::PostPage:
+        case OutputClass::SitePage:
+            // Regenerated on every edit while previewing; quality 5 is ~50x faster than 11.
+            if (dev_compression_enabled) {
+                settings.quality = 5;
+                settings.zstd_level = 3;
+                settings.gzip_level = 6; // zlib's default
+            }
+            break;
+        case OutputClass::SearchIndex:
+            // Downloaded by every visitor and grows with the corpus: always the best ratio.
+            settings.quality = BROTLI_MAX_QUALITY;
+            settings.lgwin = BROTLI_MAX_WINDOW_BITS;
+            break;
+        case OutputClass::StaticAsset:
+            break;
+    }
+    return settings;
+}
+
+// --- Per-thread Encoder Memory Pool ---
+// Brotli encoders (and zlib's deflate) allocate the same handful of large
+// buffers (ring buffer, hash tables) for every file. Freed blocks are kept per thread and handed back
+// to the next encoder instead of going through malloc/free each time.
+
+namespace {
+
+struct EncoderMemoryPool {
+    struct Block {
+        size_t size;
+        void* memory;
+    };
+    std::vector<Block> free_blocks;
+    size_t cached_bytes = 0;
+
+    ~EncoderMemoryPool() {
+        for (const Block& block : free_blocks) std::free(block.memory);
+    }
+};
+
+thread_local EncoderMemoryPool encoder_memory_pool;
+
+// Each allocation is prefixed with its size; 16 bytes keeps the payload aligned.
+constexpr size_t POOL_HEADER_SIZE = 16;
+constexpr size_t POOL_MAX_CACHED_BYTES = 256u << 20;
+
+void* pool_alloc(void* opaque, size_t size) {
+    auto* pool = static_cast<EncoderMemoryPool*>(opaque);
+    // Best fit among cached blocks that are not wastefully large.
+    size_t best = pool->free_blocks.size();
+    for (size_t i = 0; i < pool->free_blocks.size(); ++i) {
+        size_t block_size = pool->free_blocks[i].size;
+        if (block_size >= size && block_size <= size * 2 &&
+            (best == pool->free_blocks.size() || block_size < pool->free_blocks[best].size)) {
+            best = i;
+        }
+    }
+    if (best != pool->free_blocks.size()) {
+        EncoderMemoryPool::Block block = pool->free_blocks[best];
+        pool->free_blocks[best] = pool->free_blocks.back();
+        pool->free_blocks.pop_back();
+        pool->cached_bytes -= block.size;
+        return static_cast<char*>(block.memory) + POOL_HEADER_SIZE;
+    }
+
+    void* memory = std::malloc(size + POOL_HEADER_SIZE);
+    if (!memory) return nullptr;
+    std::memcpy(memory, &size, sizeof(size));
+    return static_cast<char*>(memory) + POOL_HEADER_SIZE;
+}
+
+void pool_free(void* opaque, void* address) {
+    if (!address) return;
+    auto* pool = static_cast<EncoderMemoryPool*>(opaque);
+    void* memory = static_cast<char*>(address) - POOL_HEADER_SIZE;
+    size_t size;
+    std::memcpy(&size, memory, sizeof(size));
+    if (pool->cached_bytes + size > POOL_MAX_CACHED_BYTES) {
+        std::free(memory);
+        return;
+    }
+    pool->free_blocks.push_back({size, memory});
+    pool->cached_bytes += size;
+}
+
+voidpf zlib_pool_alloc(voidpf opaque, uInt items, uInt size) {
+    return pool_alloc(opaque, static_cast<size_t>(items) * size);
+}
+
+void zlib_pool_free(voidpf opaque, voidpf address) {
+    pool_free(opaque, address);
+}
+
+// Where deflate and zstd put their output before it is appended to the FileSink.
+constexpr size_t COMPRESSED_CHUNK_SIZE = 64 << 10;
+thread_local char compressed_chunk[COMPRESSED_CHUNK_SIZE];
+
+} // namespace
+
+// --- BrotliFileWriter ---
+
+BrotliFileWriter::~BrotliFileWriter() {
+    destroy_encoder();
+}
+
+void BrotliFileWriter::destroy_encoder() {
+    if (encoder_) {
+        BrotliEncoderDestroyInstance(encoder_);
+        encoder_ = nullptr;
+    }
+}
+
+bool BrotliFileWriter::open(const fs::path& path, CompressionSettings settings, size_t size_hint) {
+    destroy_encoder();
+    input_bytes_ = 0;
+    failed_ = false;
+
+    encoder_ = BrotliEncoderCreateInstance(pool_alloc, pool_free, &encoder_memory_pool);
+    if (!encoder_) {
+        std::cerr << "Error: Could not create Brotli encoder for " << path << std::endl;
+        failed_ = true;
+        return false;
+    }
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(settings.quality));
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_LGWIN, static_cast<uint32_t>(settings.lgwin));
+    BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_MODE, BROTLI_MODE_TEXT); // Most of our content is text (HTML, CSS, JS)
+    if (size_hint > 0) {
+        BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_SIZE_HINT,
+                                  static_cast<uint32_t>(std::min<size_t>(size_hint, 1u << 30)));
+    }
+
+    if (!file_.open(path)) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool BrotliFileWriter::pump(BrotliEncoderOperation operation, const uint8_t* data, size_t size) {
+    size_t available_in = size;
+    const uint8_t* next_in = data;
+    while (true) {
+        // available_out == 0: the encoder keeps output in its own (pooled)
+        // buffer and BrotliEncoderTakeOutput hands it to us without a copy.
+        size_t available_out = 0;
+        if (!BrotliEncoderCompressStream(encoder_, operation, &available_in, &next_in,
+                                         &available_out, nullptr, nullptr)) {
+            std::cerr << "Error: Brotli compression failed." << std::endl;
+            return false;
+        }
+        size_t output_size = 0;
+        const uint8_t* output = BrotliEncoderTakeOutput(encoder_, &output_size);
+        if (output_size > 0 && !file_.write(reinterpret_cast<const char*>(output), output_size)) return false;
+
+        if (BrotliEncoderHasMoreOutput(encoder_)) continue;
+        if (operation == BROTLI_OPERATION_FINISH) {
+            if (BrotliEncoderIsFinished(encoder_)) return true;
+        } else if (available_in == 0) {
+            return true;
+        }
+    }
+}
+
+bool BrotliFileWriter::write(const char* data, size_t size) {
+    if (!encoder_ || failed_) return false;
+    input_bytes_ += size;
+    if (!pump(BROTLI_OPERATION_PROCESS, reinterpret_cast<const uint8_t*>(data), size)) failed_ = true;
+    return !failed_;
+}
+
+bool BrotliFileWriter::finish(size_t discard_at_size) {
+    if (encoder_ && !failed_ && !pump(BROTLI_OPERATION_FINISH, nullptr, 0)) failed_ = true;
+    destroy_encoder(); // Returns its buffers to this thread's pool
+    if (failed_) {
+        file_.discard();
+        return false;
+    }
+    if (file_.bytes_written() >= discard_at_size) {
+        file_.discard();
+        return true;
+    }
+    return file_.close();
+}
+
+// --- GzipFileWriter ---
+
+GzipFileWriter::~GzipFileWriter() {
+    destroy_stream();
+}
+
+void GzipFileWriter::destroy_stream() {
+    if (stream_open_) {
+        deflateEnd(&stream_);
+        stream_open_ = false;
+    }
+}
+
+bool GzipFileWriter::open(const fs::path& path, CompressionSettings settings, size_t /*size_hint*/) {
+    destroy_stream();
+    input_bytes_ = 0;
+    failed_ = false;
+
+    stream_ = z_stream{};
+    stream_.zalloc = zlib_pool_alloc;
+    stream_.zfree = zlib_pool_free;
+    stream_.opaque = &encoder_memory_pool;
+    // windowBits 15 + 16: the largest window, wrapped in a gzip header (with no
+    // name and mtime 0, so the output is reproducible).
+    if (deflateInit2(&stream_, settings.gzip_level, Z_DEFLATED, 15 + 16, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        std::cerr << "Error: Could not create gzip encoder for " << path << std::endl;
+        failed_ = true;
+        return false;
+    }
+    stream_open_ = true;
+
+    if (!file_.open(path)) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool GzipFileWriter::pump(int flush, const char* data, size_t size) {
+    while (true) {
+        // avail_in is 32 bits wide.
+        const size_t chunk = std::min<size_t>(size, 1u << 30);
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream_.avail_in = static_cast<uInt>(chunk);
+        data += chunk;
+        size -= chunk;
+        const int chunk_flush = size == 0 ? flush : Z_NO_FLUSH;
+        do {
+            stream_.next_out = reinterpret_cast<Bytef*>(compressed_chunk);
+            stream_.avail_out = static_cast<uInt>(COMPRESSED_CHUNK_SIZE);
+            if (deflate(&stream_, chunk_flush) == Z_STREAM_ERROR) {
+                std::cerr << "Error: gzip compression failed." << std::endl;
+                return false;
+            }
+            const size_t output_size = COMPRESSED_CHUNK_SIZE - stream_.avail_out;
+            if (output_size > 0 && !file_.write(compressed_chunk, output_size)) return false;
+        } while (stream_.avail_out == 0);
+        if (size == 0) return true;
+    }
+}
+
+bool GzipFileWriter::write(const char* data, size_t size) {
+    if (!stream_open_ || failed_) return false;
+    input_bytes_ += size;
+    if (!pump(Z_NO_FLUSH, data, size)) failed_ = true;
+    return !failed_;
+}
+
+bool GzipFileWriter::finish(size_t discard_at_size) {
+    if (stream_open_ && !failed_ && !pump(Z_FINISH, nullptr, 0)) failed_ = true;
+    destroy_stream();
+    if (failed_) {
+        file_.discard();
+        return false;
+    }
+    if (file_.bytes_written() >= discard_at_size) {
+        file_.discard();
+        return true;
+    }
+    return file_.close();
+}
+
+// --- ZstdFileWriter ---
+
+#ifdef BUILDER_HAVE_ZSTD
+namespace {
+
+struct ZstdContext {
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+    ~ZstdContext() { ZSTD_freeCCtx(context); }
+};
+
+thread_local ZstdContext zstd_context;
+
+} // namespace
+#endif
+
+ZstdFileWriter::~ZstdFileWriter() {
+#ifdef BUILDER_HAVE_ZSTD
+    if (context_) ZSTD_CCtx_reset(context_, ZSTD_reset_session_only);
+#endif
+}
+
+bool ZstdFileWriter::open(const fs::path& path, CompressionSettings settings, size_t size_hint) {
+    input_bytes_ = 0;
+    failed_ = false;
+#ifdef BUILDER_HAVE_ZSTD
+    context_ = zstd_context.context;
+    if (!context_) {
+        std::cerr << "Error: Could not create zstd encoder for " << path << std::endl;
+        failed_ = true;
+        return false;
+    }
+    ZSTD_CCtx_reset(context_, ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, settings.zstd_level);
+    // Stored in the frame header; also lets zstd size its tables to the input.
+    if (size_hint > 0) ZSTD_CCtx_setPledgedSrcSize(context_, size_hint);
+
+    if (!file_.open(path)) {
+        failed_ = true;
+        return false;
+    }
+    return true;
+#else
+    (void)settings;
+    (void)size_hint;
+    std::cerr << "Error: Built without zstd support, cannot write " << path << std::endl;
+    failed_ = true;
+    return false;
+#endif
+}
+
+bool ZstdFileWriter::pump(bool end, const char* data, size_t size) {
+#ifdef BUILDER_HAVE_ZSTD
+    ZSTD_inBuffer input{data, size, 0};
+    while (true) {
+        ZSTD_outBuffer output{compressed_chunk, COMPRESSED_CHUNK_SIZE, 0};
+        const size_t remaining = ZSTD_compressStream2(context_, &output, &input, end ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(remaining)) {
+            std::cerr << "Error: zstd compression failed: " << ZSTD_getErrorName(remaining) << std::endl;
+            return false;
+        }
+        if (output.pos > 0 && !file_.write(compressed_chunk, output.pos)) return false;
+        if (end ? remaining == 0 : input.pos == input.size) return true;
+    }
+#else
+    (void)end;
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+bool ZstdFileWriter::write(const char* data, size_t size) {
+    if (!context_ || failed_) return false;
+    input_bytes_ += size;
+    if (!pump(false, data, size)) failed_ = true;
+    return !failed_;
+}
+
+bool ZstdFileWriter::finish(size_t discard_at_size) {
+    if (context_ && !failed_ && !pump(true, nullptr, 0)) failed_ = true;
+    context_ = nullptr;
+    if (failed_) {
+        file_.discard();
+        return false;
+    }
+    if (file_.bytes_written() >= discard_at_size) {
+        file_.discard();
+        return true;
+    }
+    return file_.close();
+}
@@ -0,0 +1,125 @@
+#ifndef STREAM_WRITER_H
+#define STREAM_WRITER_H
+
+#include "common_utils.h"
+#include "file_io.h"
+#include <brotli/encode.h>
+#include <zlib.h>
+#include <cstdint>
+
+struct ZSTD_CCtx_s; // <zstd.h>
+
+// --- Compression Settings ---
+// Levels per kind of output for every codec (see precompress.h). Release
+// builds use maximum-ratio settings everywhere (the cost is paid once per
+// deploy); dev builds trade ratio for speed on the outputs that are
+// regenerated most often.
+enum class OutputClass {
+    PostPage,    // public/p/*.html
+    SitePage,    // index.html, archive pages
+    SearchIndex, // search-index.js and search/ shards (downloaded by every visitor)
+    StaticAsset, // CSS/JS/images under static/
+};
+
+struct CompressionSettings {
+    int quality = BROTLI_MAX_QUALITY; // Brotli
+    int lgwin = BROTLI_DEFAULT_WINDOW;
+    int zstd_level = 19; // Highest level before zstd's memory-hungry --ultra range
+    int gzip_level = Z_BEST_COMPRESSION;
+};
+
+// Selects the release (default) or dev profile. Call before the build starts.
+void set_dev_compression(bool dev_build);
+bool dev_compression();
+CompressionSettings compression_settings_for(OutputClass output_class);
+
+// Streams a Brotli-compressed copy of everything written to it into a file.
+// Built on BrotliEncoderCompressStream: input is compressed as it arrives and
+// output is taken from the encoder's own buffer into a FileSink (which writes
+// it out in FILE_SINK_BUFFER_SIZE pieces), so no worst-case-size staging
+// vector is ever allocated. Encoder allocations are served from a per-thread
+// pool, so after the first few files a thread compresses without touching
+// malloc.
+class BrotliFileWriter : public ByteSink {
+public:
+    BrotliFileWriter() = default;
+    ~BrotliFileWriter() override;
+    BrotliFileWriter(const BrotliFileWriter&) = delete;
+    BrotliFileWriter& operator=(const BrotliFileWriter&) = delete;
+
+    // size_hint (total input bytes, 0 if unknown) lets the encoder pick the same
+    // parameters the one-shot BrotliEncoderCompress would.
+    bool open(const fs::path& path, CompressionSettings settings, size_t size_hint = 0);
+    bool write(const char* data, size_t size) override;
+    // Flushes the stream and closes the file. On failure the file is removed.
+    // So is a stream that compressed to discard_at_size bytes or more: it is
+    // dropped before it ever replaces the destination.
+    bool finish(size_t discard_at_size = SIZE_MAX);
+
+    size_t input_bytes() const { return input_bytes_; }
+    size_t compressed_bytes() const { return file_.bytes_written(); }
+
+private:
+    bool pump(BrotliEncoderOperation operation, const uint8_t* data, size_t size);
+    void destroy_encoder();
+
+    BrotliEncoderState* encoder_ = nullptr;
+    FileSink file_;
+    size_t input_bytes_ = 0;
+    bool failed_ = false;
+};
+
+// The same interface over zlib's deflate, with a gzip header (the .gz
+// sibling). Its state is allocated from the same per-thread pool.
+class GzipFileWriter : public ByteSink {
+public:
+    GzipFileWriter() = default;
+    ~GzipFileWriter() override;
+    GzipFileWriter(const GzipFileWriter&) = delete;
+    GzipFileWriter& operator=(const GzipFileWriter&) = delete;
+
+    bool open(const fs::path& path, CompressionSettings settings, size_t size_hint = 0);
+    bool write(const char* data, size_t size) override;
+    bool finish(size_t discard_at_size = SIZE_MAX);
+
+    size_t input_bytes() const { return input_bytes_; }
+    size_t compressed_bytes() const { return file_.bytes_written(); }
+
+private:
+    bool pump(int flush, const char* data, size_t size);
+    void destroy_stream();
+
+    z_stream stream_{};
+    bool stream_open_ = false;
+    FileSink file_;
+    size_t input_bytes_ = 0;
+    bool failed_ = false;
+};
+
+// And over zstd's streaming API (the .zst sibling). Each thread keeps one
+// compression context and reuses it for every file. Without libzstd at build
+// time (BUILDER_HAVE_ZSTD unset), open() fails.
+class ZstdFileWriter : public ByteSink {
+public:
+    ZstdFileWriter() = default;
+    ~ZstdFileWriter() override;
+    ZstdFileWriter(const ZstdFileWriter&) = delete;
+    ZstdFileWriter& operator=(const ZstdFileWriter&) = delete;
+
+    bool open(const fs::path& path, CompressionSettings settings, size_t size_hint = 0);
+    bool write(const char* data, size_t size) override;
+    bool finish(size_t discard_at_size = SIZE_MAX);
+
+    size_t input_bytes() const { return input_bytes_; }
+    size_t compressed_bytes() const { return file_.bytes_written(); }
+
+private:
+    bool pump(bool end, const char* data, size_t size);
+
+    ZSTD_CCtx_s* context_ = nullptr; // The thread's context while open
+    FileSink file_;
+    size_t input_bytes_ = 0;
+    bool failed_ = false;
+};
+
+#endif // STREAM_WRITER_H
@@ -0,0 +1,635 @@
+#include "syntax_highlight.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SYNTAX_HIGHLIGHT_X86 1
+#include <emmintrin.h>
+#else
+#define SYNTAX_HIGHLIGHT_X86 0
+#endif
+
+namespace {
+
+// --- Compile-Time Tables ---
+
+enum CharFlags : uint8_t {
+    IDENT_START = 1 << 0, // Letters, '_', and UTF-8 bytes (identifiers may be non-ASCII)
+    IDENT_PART = 1 << 1,  // IDENT_START plus digits
+    DIGIT = 1 << 2,
+    ESCAPED = 1 << 3,     // Must be written as an entity
+};
+
+constexpr std::array<uint8_t, 256> make_char_flags() {
+    std::array<uint8_t, 256> flags{};
+    for (int c = 0; c < 256; ++c) {
+        bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+        bool digit = c >= '0' && c <= '9';
+        flags[c] = static_cast<uint8_t>((letter ? IDENT_START : 0) | ((letter || digit) ? IDENT_PART : 0) |
+                                        (digit ? DIGIT : 0));
+    }
+    for (char c : {'&', '<', '>', '"'}) flags[static_cast<unsigned char>(c)] |= ESCAPED;
+    return flags;
+}
+constexpr std::array<uint8_t, 256> CHAR_FLAGS = make_char_flags();
+
+inline bool has_flag(char c, uint8_t flag) {
+    return (CHAR_FLAGS[static_cast<unsigned char>(c)] & flag) != 0;
+}
+
+// --- Scan Kernels ---
+// 16 bytes at a time where there are 16 bytes left to read (SSE2 is part of
+// x86-64, so there is no runtime dispatch); the scalar loops finish the tail.
+
+#if SYNTAX_HIGHLIGHT_X86
+// Bit i set if data[i] is '&', '<', '>' or '"'.
+__attribute__((target("sse2"))) inline unsigned escaped_mask(__m128i bytes) {
+    __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('&')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('<'))),
+                                _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('>')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))));
+    return static_cast<unsigned>(_mm_movemask_epi8(hits));
+}
+
+// Bit i set if data[i] is IDENT_PART: a letter, digit, '_' or a byte >= 0x80.
+// "x <= k" is tested unsigned as min(x, k) == x.
+__attribute__((target("sse2"))) inline unsigned identifier_mask(__m128i bytes) {
+    const __m128i letter = _mm_sub_epi8(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    const __m128i digit = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+    __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(25)), letter),
+                                _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit));
+    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('_')));
+    return static_cast<unsigned>(_mm_movemask_epi8(hits) | _mm_movemask_epi8(bytes));
+}
+
+// Bit i set if data[i] is one of chars (each broadcast to all 16 bytes).
+template <size_t N>
+__attribute__((target("sse2"))) inline unsigned any_of_mask(__m128i bytes, const __m128i (&chars)[N]) {
+    __m128i hits = _mm_cmpeq_epi8(bytes, chars[0]);
+    for (size_t i = 1; i < N; ++i) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(bytes, chars[i]));
+    return static_cast<unsigned>(_mm_movemask_epi8(hits));
+}
+#endif
+
+// First byte in [at, end) that must be written as an entity.
+inline const char* next_escaped(const char* at, const char* end) {
+#if SYNTAX_HIGHLIGHT_X86
+    for (; end - at >= 16; at += 16) {
+        const unsigned escaped = escaped_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(at)));
+        if (escaped != 0) return at + __builtin_ctz(escaped);
+    }
+#endif
+    while (at < end && !has_flag(*at, ESCAPED)) ++at;
+    return at;
+}
+
+// First byte in [at, end) that is not IDENT_PART.
+inline const char* identifier_run_end(const char* at, const char* end) {
+#if SYNTAX_HIGHLIGHT_X86
+    for (; end - at >= 16; at += 16) {
+        const unsigned outside = ~identifier_mask(_mm_loadu_si128(reinterpret_cast<const __m128i*>(at))) & 0xFFFF;
+        if (outside != 0) return at + __builtin_ctz(outside);
+    }
+#endif
+    while (at < end && has_flag(*at, IDENT_PART)) ++at;
+    return at;
+}
+
+// Keywords are a perfect hash table built at compile time: the seed is the
+// first one that gives every keyword its own slot, so a lookup is one hash and
+// one comparison. Slots hold the keyword zero-padded to 16 bytes, which the
+// comparison reads as one block.
+constexpr unsigned KEYWORD_SLOT_BITS = 9;
+constexpr size_t KEYWORD_SLOTS = size_t{1} << KEYWORD_SLOT_BITS;
+constexpr size_t MAX_KEYWORD_LENGTH = 16;
+
+struct KeywordSet {
+    std::array<std::array<char, MAX_KEYWORD_LENGTH>, KEYWORD_SLOTS> padded{};
+    std::array<uint8_t, KEYWORD_SLOTS> lengths{}; // 0: empty slot
+    uint64_t seed = 0;                             // 0: no seed found
+    bool distinct = true;
+};
+
+constexpr size_t keyword_slot(const char* word, size_t length, uint64_t seed) {
+    const uint64_t key = static_cast<uint64_t>(static_cast<unsigned char>(word[0])) |
+                         static_cast<uint64_t>(static_cast<unsigned char>(word[length > 1 ? 1 : 0])) << 8 |
+                         static_cast<uint64_t>(static_cast<unsigned char>(word[length / 2])) << 16 |
+                         static_cast<uint64_t>(static_cast<unsigned char>(word[length - 1])) << 24 |
+                         static_cast<uint64_t>(length) << 32;
+    return static_cast<size_t>((key * seed) >> (64 - KEYWORD_SLOT_BITS));
+}
+
+template <size_t N>
+constexpr KeywordSet keyword_set(const std::string_view (&words)[N]) {
+    KeywordSet set;
+    for (size_t i = 0; i < N; ++i) {
+        if (words[i].empty() || words[i].size() > MAX_KEYWORD_LENGTH) set.distinct = false;
+        for (size_t j = 0; j < i; ++j) {
+            if (words[i] == words[j]) set.distinct = false;
+        }
+    }
+    if (!set.distinct) return set;
+    for (uint64_t attempt = 1; set.seed == 0 && attempt <= 4096; ++attempt) {
+        const uint64_t seed = (attempt * 0x9E3779B97F4A7C15ull) | 1; // Odd multipliers spread over 64 bits
+        std::array<bool, KEYWORD_SLOTS> used{};
+        bool collision = false;
+        for (size_t i = 0; i < N && !collision; ++i) {
+            const size_t slot = keyword_slot(words[i].data(), words[i].size(), seed);
+            collision = used[slot];
+            used[slot] = true;
+        }
+        if (!collision) set.seed = seed;
+    }
+    for (std::string_view word : words) {
+        const size_t slot = keyword_slot(word.data(), word.size(), set.seed);
+        for (size_t i = 0; i < word.size(); ++i) set.padded[slot][i] = word[i];
+        set.lengths[slot] = static_cast<uint8_t>(word.size());
+    }
+    return set;
+}
+
+// end: end of the text word is in (the block comparison reads 16 bytes when
+// they are there).
+inline bool is_keyword(const KeywordSet& set, const char* word, size_t length, const char* end) {
+    if (length > MAX_KEYWORD_LENGTH) return false;
+    const size_t slot = keyword_slot(word, length, set.seed);
+    if (set.lengths[slot] != length) return false;
+#if SYNTAX_HIGHLIGHT_X86
+    if (static_cast<size_t>(end - word) >= MAX_KEYWORD_LENGTH) {
+        const __m128i text = _mm_loadu_si128(reinterpret_cast<const __m128i*>(word));
+        const __m128i keyword = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.padded[slot].data()));
+        const unsigned differ = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(text, keyword)));
+        return (differ & ((1u << length) - 1)) == 0;
+    }
+#endif
+    (void)end;
+    return std::memcmp(set.padded[slot].data(), word, length) == 0;
+}
+
+constexpr KeywordSet C_KEYWORDS = keyword_set({
+    "alignas", "alignof", "auto", "bool", "break", "case", "catch", "char", "class", "const", "constexpr",
+    "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "extern", "false", "final", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override", "private", "protected",
+    "public", "register", "reinterpret_cast", "return", "short", "signed", "size_t", "sizeof", "static",
+    "static_assert", "static_cast", "struct", "switch", "template", "this", "throw", "true", "try", "typedef",
+    "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while",
+});
+constexpr KeywordSet JS_KEYWORDS = keyword_set({
+    "as", "async", "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default",
+    "delete", "do", "else", "enum", "export", "extends", "false", "finally", "for", "from", "function", "if",
+    "implements", "import", "in", "instanceof", "interface", "let", "new", "null", "of", "private", "protected",
+    "public", "readonly", "return", "static", "super", "switch", "this", "throw", "true", "try", "type",
+    "typeof", "undefined", "var", "void", "while", "with", "yield",
+});
+constexpr KeywordSet PYTHON_KEYWORDS = keyword_set({
+    "False", "None", "True", "and", "as", "assert", "async", "await", "break", "class", "continue", "def", "del",
+    "elif", "else", "except", "finally", "for", "from", "global", "if", "import", "in", "is", "lambda",
+    "nonlocal", "not", "or", "pass", "raise", "return", "self", "try", "while", "with", "yield",
+});
+constexpr KeywordSet SHELL_KEYWORDS = keyword_set({
+    "case", "declare", "do", "done", "elif", "else", "esac", "exit", "export", "fi", "for", "function", "if",
+    "in", "local", "readonly", "return", "select", "set", "shift", "source", "then", "unset", "until", "while",
+});
+constexpr KeywordSet JSON_KEYWORDS = keyword_set({"false", "null", "true"});
+constexpr KeywordSet ELIXIR_KEYWORDS = keyword_set({
+    "after", "alias", "and", "case", "catch", "cond", "def", "defimpl", "defmacro", "defmodule", "defp",
+    "defprotocol", "defstruct", "do", "else", "end", "false", "fn", "for", "if", "import", "in", "nil", "not",
+    "or", "quote", "raise", "receive", "require", "rescue", "true", "try", "unless", "unquote", "use", "when",
+    "with",
+});
+static_assert(C_KEYWORDS.distinct && JS_KEYWORDS.distinct && PYTHON_KEYWORDS.distinct && SHELL_KEYWORDS.distinct &&
+              JSON_KEYWORDS.distinct && ELIXIR_KEYWORDS.distinct, "duplicate or over-long keyword");
+static_assert(C_KEYWORDS.seed && JS_KEYWORDS.seed && PYTHON_KEYWORDS.seed && SHELL_KEYWORDS.seed && JSON_KEYWORDS.seed &&
+              ELIXIR_KEYWORDS.seed, "no collision-free keyword hash seed");
+
+struct LanguageSpec {
+    const KeywordSet* keywords;
+    std::string_view line_comment;        // "" if none
+    std::string_view block_comment_open;  // "" if none
+    std::string_view block_comment_close;
+    std::string_view quotes;              // Characters that open a string
+    std::string_view multiline_quotes;    // Of those, the ones whose strings may span lines
+    std::string_view raw_quotes;          // Of those, the ones without backslash escapes
+    std::string_view string_prefixes;     // Letters that may prefix a string (r"...", L"...")
+    std::string_view identifier_extras;   // Non-letters allowed inside identifiers
+    bool triple_quotes = false;           // """...""" / '''...'''
+    bool comment_at_word_start = false;   // Shell: '#' only starts a comment after whitespace
+    bool preprocessor = false;            // C: '#directive' at the start of a line
+    bool dollar_variables = false;        // Shell: $name, ${...}, $1, $?
+    bool decorators = false;              // Python: @name
+};
+
+// What the lexer does on seeing a character; PLAIN runs are copied as they are.
+enum Action : uint8_t { PLAIN, ESCAPE, IDENTIFIER, NUMBER, DOT, QUOTE, COMMENT, DIRECTIVE, DOLLAR, AT };
+
+enum CharRole : uint8_t {
+    ROLE_IDENT_PART = 1 << 0,
+    ROLE_MULTILINE_QUOTE = 1 << 1,
+    ROLE_RAW_QUOTE = 1 << 2,
+    ROLE_STRING_PREFIX = 1 << 3,
+    ROLE_QUOTE = 1 << 4,
+};
+
+constexpr size_t MAX_ACTION_CHARS = 8;
+
+struct Language {
+    LanguageSpec spec;
+    std::array<uint8_t, 256> actions;
+    std::array<uint8_t, 256> roles;
+    // The characters outside identifiers and numbers whose action is not
+    // PLAIN, padded with copies of the first: the vector scan compares each
+    // byte with all of them.
+    std::array<char, MAX_ACTION_CHARS> action_chars;
+    bool action_chars_fit;
+};
+
+constexpr Language make_language(const LanguageSpec& spec) {
+    Language language{spec, {}, {}, {}, true};
+    auto& actions = language.actions;
+    auto& roles = language.roles;
+    auto at = [](char c) { return static_cast<unsigned char>(c); };
+    for (int c = 0; c < 256; ++c) {
+        if (CHAR_FLAGS[c] & ESCAPED) actions[c] = ESCAPE;
+        if (CHAR_FLAGS[c] & IDENT_START) actions[c] = IDENTIFIER;
+        if (CHAR_FLAGS[c] & DIGIT) actions[c] = NUMBER;
+        if (CHAR_FLAGS[c] & IDENT_PART) roles[c] |= ROLE_IDENT_PART;
+    }
+    actions[at('.')] = DOT;
+    if (!spec.line_comment.empty()) actions[at(spec.line_comment[0])] = COMMENT;
+    if (!spec.block_comment_open.empty()) actions[at(spec.block_comment_open[0])] = COMMENT;
+    if (spec.preprocessor) actions[at('#')] = DIRECTIVE;
+    if (spec.dollar_variables) actions[at('$')] = DOLLAR;
+    if (spec.decorators) actions[at('@')] = AT;
+    for (char c : spec.quotes) {
+        actions[at(c)] = QUOTE;
+        roles[at(c)] |= ROLE_QUOTE;
+    }
+    for (char c : spec.multiline_quotes) roles[at(c)] |= ROLE_MULTILINE_QUOTE;
+    for (char c : spec.raw_quotes) roles[at(c)] |= ROLE_RAW_QUOTE;
+    for (char c : spec.string_prefixes) roles[at(c)] |= ROLE_STRING_PREFIX;
+    for (char c : spec.identifier_extras) roles[at(c)] |= ROLE_IDENT_PART;
+
+    size_t count = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (actions[c] == PLAIN || actions[c] == IDENTIFIER || actions[c] == NUMBER) continue;
+        if (count == MAX_ACTION_CHARS) language.action_chars_fit = false;
+        else language.action_chars[count++] = static_cast<char>(c);
+    }
+    for (size_t i = count; i < MAX_ACTION_CHARS; ++i) language.action_chars[i] = language.action_chars[0];
+    return language;
+}
+
+constexpr Language C_LANGUAGE = make_language(
+    {&C_KEYWORDS, "//", "/*", "*/", "\"'", "", "", "LuUR8", "", false, false, true, false, false});
+constexpr Language JS_LANGUAGE = make_language(
+    {&JS_KEYWORDS, "//", "/*", "*/", "\"'`", "`", "", "", "$", false, false, false, false, false});
+constexpr Language PYTHON_LANGUAGE = make_language(
+    {&PYTHON_KEYWORDS, "#", "", "", "\"'", "", "", "rRbBfFuU", "", true, false, false, false, true});
+constexpr Language SHELL_LANGUAGE = make_language(
+    {&SHELL_KEYWORDS, "#", "", "", "\"'", "\"'", "'", "", "", false, true, false, true, false});
+constexpr Language JSON_LANGUAGE = make_language(
+    {&JSON_KEYWORDS, "", "", "", "\"", "", "", "", "", false, false, false, false, false});
+constexpr Language ELIXIR_LANGUAGE = make_language(
+    {&ELIXIR_KEYWORDS, "#", "", "", "\"'", "", "", "", "?!", true, false, false, false, false});
+
+static_assert(C_LANGUAGE.action_chars_fit && JS_LANGUAGE.action_chars_fit && PYTHON_LANGUAGE.action_chars_fit &&
+              SHELL_LANGUAGE.action_chars_fit && JSON_LANGUAGE.action_chars_fit && ELIXIR_LANGUAGE.action_chars_fit,
+              "more than MAX_ACTION_CHARS token-starting characters");
+
+struct LanguageAlias {
+    std::string_view name;
+    const Language* language;
+};
+
+constexpr LanguageAlias LANGUAGE_ALIASES[] = {
+    {"c", &C_LANGUAGE}, {"cpp", &C_LANGUAGE}, {"c++", &C_LANGUAGE}, {"cc", &C_LANGUAGE},
+    {"cxx", &C_LANGUAGE}, {"h", &C_LANGUAGE}, {"hpp", &C_LANGUAGE},
+    {"js", &JS_LANGUAGE}, {"javascript", &JS_LANGUAGE}, {"jsx", &JS_LANGUAGE}, {"mjs", &JS_LANGUAGE},
+    {"ts", &JS_LANGUAGE}, {"typescript", &JS_LANGUAGE},
+    {"py", &PYTHON_LANGUAGE}, {"python", &PYTHON_LANGUAGE}, {"python3", &PYTHON_LANGUAGE},
+    {"sh", &SHELL_LANGUAGE}, {"bash", &SHELL_LANGUAGE}, {"shell", &SHELL_LANGUAGE}, {"zsh", &SHELL_LANGUAGE},
+    {"console", &SHELL_LANGUAGE},
+    {"json", &JSON_LANGUAGE},
+    {"ex", &ELIXIR_LANGUAGE}, {"exs", &ELIXIR_LANGUAGE}, {"elixir", &ELIXIR_LANGUAGE},
+};
+
+const Language* find_language(std::string_view fence_language) {
+    // Fence info is usually lower case, but ```Python or ```JSON happen.
+    char lowered[16];
+    if (fence_language.empty() || fence_language.size() > sizeof(lowered)) return nullptr;
+    for (size_t i = 0; i < fence_language.size(); ++i) {
+        char c = fence_language[i];
+        lowered[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    std::string_view name(lowered, fence_language.size());
+    for (const auto& alias : LANGUAGE_ALIASES) {
+        if (alias.name == name) return alias.language;
+    }
+    return nullptr;
+}
+
+// --- Lexer ---
+
+enum TokenClass { KEYWORD, FUNCTION, STRING, COMMENT_TEXT, NUMBER_TEXT, VARIABLE };
+constexpr std::string_view SPAN_OPEN[] = {
+    "<span class=\"kw\">", "<span class=\"fn\">", "<span class=\"str\">",
+    "<span class=\"com\">", "<span class=\"num\">", "<span class=\"var\">",
+};
+constexpr std::string_view SPAN_CLOSE = "</span>";
+
+void append_escaped(std::string& out, const char* begin, const char* end) {
+    for (const char* at = next_escaped(begin, end); at < end; at = next_escaped(begin, end)) {
+        out.append(begin, static_cast<size_t>(at - begin));
+        switch (*at) {
+            case '&': out.append("&amp;", 5); break;
+            case '<': out.append("&lt;", 4); break;
+            case '>': out.append("&gt;", 4); break;
+            default: out.append("&quot;", 6); break;
+        }
+        begin = at + 1;
+    }
+    out.append(begin, static_cast<size_t>(end - begin));
+}
+
+class Lexer {
+public:
+    Lexer(const Language& language, std::string_view code, std::string& out)
+        : language_(language), spec_(language.spec), begin_(code.data()), end_(code.data() + code.size()),
+          at_(begin_), plain_from_(begin_), out_(out) {
+#if SYNTAX_HIGHLIGHT_X86
+        for (size_t i = 0; i < MAX_ACTION_CHARS; ++i) action_chars_[i] = _mm_set1_epi8(language.action_chars[i]);
+#endif
+    }
+
+    void run() {
+        for (const char* window = begin_; window < end_; window = std::max(window + WINDOW, at_)) {
+            classify(window);
+            uint64_t tokens = token_bits_;
+            while (tokens != 0) {
+                at_ = window + __builtin_ctzll(tokens);
+                if (action(*at_) == IDENTIFIER && lex_word()) {
+                    tokens &= tokens - 1;
+                    continue;
+                }
+                switch (action(*at_)) {
+                    case PLAIN: break; // Not a token start
+                    case ESCAPE:
+                        flush_plain();
+                        append_escaped(out_, at_, at_ + 1);
+                        plain_from_ = ++at_;
+                        break;
+                    case IDENTIFIER: lex_identifier(); break;
+                    case NUMBER: emit(NUMBER_TEXT, number_end(), false); break;
+                    case DOT:
+                        if (at_ + 1 < end_ && has_flag(at_[1], DIGIT)) emit(NUMBER_TEXT, number_end(), false);
+                        else plain(at_ + 1);
+                        break;
+                    case QUOTE: emit(STRING, string_end(at_), true); break;
+                    case COMMENT: if (!lex_comment()) plain(at_ + 1); break;
+                    case DIRECTIVE: if (!lex_directive()) plain(at_ + 1); break;
+                    case DOLLAR: if (!lex_variable()) plain(at_ + 1); break;
+                    case AT: if (!lex_decorator()) plain(at_ + 1); break;
+                }
+                // Drop the starts the token covered. A token that ends inside
+                // a word (the "abc" of shell's "$1abc") leaves one more start.
+                const size_t lexed = static_cast<size_t>(at_ - window);
+                if (lexed >= WINDOW) break;
+                tokens &= ~uint64_t{0} << lexed;
+                tokens |= word_bits_ & (uint64_t{1} << lexed);
+            }
+        }
+        at_ = end_;
+        flush_plain();
+    }
+
+private:
+    uint8_t action(char c) const { return language_.actions[static_cast<unsigned char>(c)]; }
+    bool has_role(char c, uint8_t role) const { return (language_.roles[static_cast<unsigned char>(c)] & role) != 0; }
+
+    // --- Token Windows ---
+    // The code is lexed 64 bytes at a time through two bit masks: the
+    // IDENT_PART bytes, and the bytes where a token may start (the first byte
+    // of each word, and the characters in action_chars). Tokens are taken
+    // from the mask in order, so plain text between them is never looked at
+    // byte by byte, and a word's start does not wait for the previous word's
+    // end to be found.
+
+    static constexpr size_t WINDOW = 64;
+
+    void classify(const char* from) {
+        window_ = from;
+        word_bits_ = 0;
+        uint64_t action_bits = 0;
+#if SYNTAX_HIGHLIGHT_X86
+        if (static_cast<size_t>(end_ - from) >= WINDOW) {
+            for (size_t i = 0; i < WINDOW; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + i));
+                word_bits_ |= static_cast<uint64_t>(identifier_mask(bytes)) << i;
+                action_bits |= static_cast<uint64_t>(any_of_mask(bytes, action_chars_)) << i;
+            }
+            token_bits_ = (word_bits_ & ~(word_bits_ << 1)) | action_bits;
+            return;
+        }
+#endif
+        const size_t size = std::min(static_cast<size_t>(end_ - from), WINDOW);
+        for (size_t i = 0; i < size; ++i) {
+            const uint8_t act = action(from[i]);
+            word_bits_ |= static_cast<uint64_t>(has_flag(from[i], IDENT_PART)) << i;
+            action_bits |= static_cast<uint64_t>(act != PLAIN && act != IDENTIFIER && act != NUMBER) << i;
+        }
+        token_bits_ = (word_bits_ & ~(word_bits_ << 1)) | action_bits;
+    }
+
+    // End of the IDENT_PART run starting at from, a byte in the window.
+    const char* word_end(const char* from) const {
+        const uint64_t rest = ~word_bits_ >> (from - window_);
+        if (rest != 0) return from + __builtin_ctzll(rest);
+        return identifier_run_end(window_ + WINDOW, end_);
+    }
+
+    bool starts_with(std::string_view text) const {
+        return !text.empty() && static_cast<size_t>(end_ - at_) >= text.size() &&
+               std::memcmp(at_, text.data(), text.size()) == 0;
+    }
+
+    // Text that needs no escaping is not copied token by token: it is left
+    // in place up to the next span or entity, then copied as one run.
+    void plain(const char* token_end) { at_ = token_end; }
+
+    void flush_plain() { out_.append(plain_from_, static_cast<size_t>(at_ - plain_from_)); }
+
+    void emit(TokenClass token_class, const char* token_end, bool escape) {
+        flush_plain();
+        out_.append(SPAN_OPEN[token_class]);
+        if (escape) append_escaped(out_, at_, token_end);
+        else out_.append(at_, static_cast<size_t>(token_end - at_));
+        out_.append(SPAN_CLOSE);
+        at_ = plain_from_ = token_end;
+    }
+
+    const char* line_end() const {
+        const void* newline = std::memchr(at_, '\n', static_cast<size_t>(end_ - at_));
+        return newline ? static_cast<const char*>(newline) : end_;
+    }
+
+    bool lex_comment() {
+        if (starts_with(spec_.line_comment)) {
+            char before = at_ > begin_ ? at_[-1] : '\n';
+            if (spec_.comment_at_word_start && before != ' ' && before != '\t' && before != '\n') return false;
+            emit(COMMENT_TEXT, line_end(), true);
+            return true;
+        }
+        if (starts_with(spec_.block_comment_open)) {
+            std::string_view rest(at_ + spec_.block_comment_open.size(),
+                                  static_cast<size_t>(end_ - at_) - spec_.block_comment_open.size());
+            size_t close = rest.find(spec_.block_comment_close);
+            emit(COMMENT_TEXT, close == std::string_view::npos ? end_ : rest.data() + close + spec_.block_comment_close.size(), true);
+            return true;
+        }
+        return false;
+    }
+
+    // C preprocessor: "#include", "# define" at the start of a line.
+    bool lex_directive() {
+        for (const char* before = at_; before > begin_ && before[-1] != '\n'; --before) {
+            if (before[-1] != ' ' && before[-1] != '\t') return false;
+        }
+        const char* token_end = at_ + 1;
+        while (token_end < end_ && (*token_end == ' ' || *token_end == '\t')) ++token_end;
+        while (token_end < end_ && has_flag(*token_end, IDENT_PART)) ++token_end;
+        emit(KEYWORD, token_end, false);
+        return true;
+    }
+
+    // quote: the opening quote. Returns one past the closing quote (or the end
+    // of the line/code for an unterminated string).
+    const char* string_end(const char* quote_at) const {
+        const char quote = *quote_at;
+        auto triple_at = [&](const char* at) { return end_ - at >= 3 && at[0] == quote && at[1] == quote && at[2] == quote; };
+        if (spec_.triple_quotes && triple_at(quote_at)) {
+            for (const char* at = quote_at + 3; at < end_; ++at) {
+                if (triple_at(at)) return at + 3;
+            }
+            return end_;
+        }
+        const bool multiline = has_role(quote, ROLE_MULTILINE_QUOTE);
+        const bool raw = has_role(quote, ROLE_RAW_QUOTE);
+        for (const char* at = quote_at + 1; at < end_; ++at) {
+            if (*at == quote) return at + 1;
+            if (*at == '\n' && !multiline) return at;
+            if (*at == '\\' && !raw && at + 1 < end_) ++at;
+        }
+        return end_;
+    }
+
+    const char* number_end() const {
+        const char* at = at_;
+        while (at < end_) {
+            char c = *at;
+            if (!has_flag(c, IDENT_PART) && c != '.' && c != '\'') break;
+            // Exponent signs: 1e-9, 0x1p+3
+            if ((c == 'e' || c == 'E' || c == 'p' || c == 'P') && at + 1 < end_ && (at[1] == '+' || at[1] == '-')) ++at;
+            ++at;
+        }
+        // A trailing quote opens a char literal; it is not a digit separator.
+        while (at > at_ + 1 && at[-1] == '\'') --at;
+        return at;
+    }
+
+    bool lex_variable() {
+        if (at_ + 1 >= end_) return false;
+        const char next = at_[1];
+        const char* token_end;
+        if (next == '{') {
+            const void* close = std::memchr(at_ + 2, '}', static_cast<size_t>(end_ - at_ - 2));
+            if (!close) return false;
+            token_end = static_cast<const char*>(close) + 1;
+        } else if (has_flag(next, IDENT_START)) {
+            token_end = at_ + 2;
+            while (token_end < end_ && has_flag(*token_end, IDENT_PART)) ++token_end;
+        } else if (has_flag(next, DIGIT) || std::strchr("?@#*$!-", next)) {
+            token_end = at_ + 2;
+        } else {
+            return false;
+        }
+        emit(VARIABLE, token_end, true);
+        return true;
+    }
+
+    bool lex_decorator() {
+        if (at_ + 1 >= end_ || !has_flag(at_[1], IDENT_START)) return false;
+        const char* token_end = at_ + 1;
+        while (token_end < end_ && (has_flag(*token_end, IDENT_PART) || *token_end == '.')) ++token_end;
+        emit(FUNCTION, token_end, false);
+        return true;
+    }
+
+    // An identifier that is one word. Returns false, having done nothing, if
+    // lex_identifier must look further: a quote after the word may make it a
+    // string prefix, and identifier_extras may continue it.
+    bool lex_word() {
+        const char* token_end = word_end(at_);
+        if (token_end < end_ && has_role(*token_end, ROLE_IDENT_PART | ROLE_QUOTE)) return false;
+        if (is_keyword(*spec_.keywords, at_, static_cast<size_t>(token_end - at_), end_)) {
+            emit(KEYWORD, token_end, false);
+        } else if (token_end < end_ && *token_end == '(') {
+            emit(FUNCTION, token_end, false);
+        } else {
+            plain(token_end);
+        }
+        return true;
+    }
+
+    void lex_identifier() {
+        const char* token_end = word_end(at_);
+        while (token_end < end_ && has_role(*token_end, ROLE_IDENT_PART)) { // identifier_extras
+            token_end = identifier_run_end(token_end + 1, end_);
+        }
+        const size_t length = static_cast<size_t>(token_end - at_);
+
+        // r"...", f'...', L"...", u8"..."
+        if (token_end < end_ && has_role(*token_end, ROLE_QUOTE) && length <= 2 && has_role(at_[0], ROLE_STRING_PREFIX) &&
+            (length == 1 || has_role(at_[1], ROLE_STRING_PREFIX))) {
+            emit(STRING, string_end(token_end), true);
+        } else if (is_keyword(*spec_.keywords, at_, length, end_)) {
+            emit(KEYWORD, token_end, false);
+        } else if (token_end < end_ && *token_end == '(') {
+            emit(FUNCTION, token_end, false);
+        } else {
+            plain(token_end);
+        }
+    }
+
+    const Language& language_;
+    const LanguageSpec& spec_;
+    const char* const begin_;
+    const char* const end_;
+    const char* at_;
+    const char* plain_from_; // Start of the text plain() has not copied yet
+    std::string& out_;
+    const char* window_ = nullptr; // The masks cover [window_, window_ + WINDOW)
+    uint64_t word_bits_ = 0;
+    uint64_t token_bits_ = 0;      // Where a token may start
+#if SYNTAX_HIGHLIGHT_X86
+    __m128i action_chars_[MAX_ACTION_CHARS];
+#endif
+};
+
+} // namespace
+
+void append_code_escaped(std::string& out, std::string_view text) {
+    append_escaped(out, text.data(), text.data() + text.size());
+}
+
+bool can_highlight(std::string_view fence_language) {
+    return find_language(fence_language) != nullptr;
+}
+
+bool highlight_code(std::string_view fence_language, std::string_view code, std::string& out) {
+    const Language* language = find_language(fence_language);
+    if (!language) return false;
+    out.reserve(out.size() + code.size() * 2);
+    Lexer(*language, code, out).run();
+    return true;
+}
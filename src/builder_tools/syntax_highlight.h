@@ -0,0 +1,32 @@
+#ifndef SYNTAX_HIGHLIGHT_H
+#define SYNTAX_HIGHLIGHT_H
+
+#include <string>
+#include <string_view>
+
+// --- Syntax Highlighting ---
+// Build-time highlighting of fenced code blocks (what the awk pass in
+// build.sh's process_markdown does with regexes). Each language is a table
+// built at compile time: a hashed keyword set, comment and string delimiters,
+// identifier rules and a 256-entry "what starts at this byte" action map. One
+// lexer walks any of them in a single pass over the code, copying runs of
+// plain text at once.
+//
+// Tokens are wrapped in the classes post.css styles: kw, fn (identifier
+// directly followed by '('), str, com, num and var (shell variables). All
+// other text is HTML-escaped exactly like cmark escapes code, so a block in an
+// unsupported language, or a token no table knows, renders as before.
+//
+// Fence languages: c, cpp, c++, cc, cxx, h, hpp; js, javascript, jsx, mjs, ts,
+// typescript; py, python, python3; sh, bash, shell, zsh, console; json;
+// ex, exs, elixir.
+
+// Whether fence_language (first word of the info string) has a lexer.
+bool can_highlight(std::string_view fence_language);
+// Appends code to out with every token wrapped in its span. Returns false
+// (appending nothing) for a language without a lexer.
+bool highlight_code(std::string_view fence_language, std::string_view code, std::string& out);
+// Appends text HTML-escaped like cmark's code blocks (& < > ").
+void append_code_escaped(std::string& out, std::string_view text);
+
+#endif // SYNTAX_HIGHLIGHT_H
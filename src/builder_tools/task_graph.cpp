@@ -0,0 +1,104 @@
+#include "task_graph.h"
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::add_task(std::string name, std::function<bool()> fn,
+                                      const std::vector<TaskId>& dependencies, int priority) {
+    TaskId id = tasks_.size();
+    Task task;
+    task.name = std::move(name);
+    task.fn = std::move(fn);
+    task.priority = priority;
+    task.pending_dependencies = dependencies.size();
+    tasks_.push_back(std::move(task));
+    for (TaskId dependency : dependencies) {
+        tasks_[dependency].dependents.push_back(id);
+    }
+    return id;
+}
+
+bool TaskGraph::run(unsigned jobs) {
+    if (jobs == 0) jobs = 1;
+
+    // Highest priority first, then lowest id (insertion order).
+    auto compare = [this](TaskId a, TaskId b) {
+        if (tasks_[a].priority != tasks_[b].priority) return tasks_[a].priority < tasks_[b].priority;
+        return a > b;
+    };
+    std::priority_queue<TaskId, std::vector<TaskId>, decltype(compare)> ready(compare);
+
+    std::mutex mutex;
+    std::condition_variable ready_cv;
+    size_t finished = 0; // Completed, failed or skipped
+    size_t running = 0;
+    bool failed = false;
+
+    for (TaskId id = 0; id < tasks_.size(); ++id) {
+        if (tasks_[id].pending_dependencies == 0) ready.push(id);
+    }
+
+    // Marks a failed task's dependents (transitively) as finished without running them.
+    // Called with the mutex held.
+    std::function<void(TaskId)> skip_dependents = [&](TaskId id) {
+        for (TaskId dependent : tasks_[id].dependents) {
+            Task& task = tasks_[dependent];
+            if (task.skipped) continue; // Already skipped via another path
+            task.skipped = true;
+            ++finished;
+            skip_dependents(dependent);
+        }
+    };
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready_cv.wait(lock, [&] { return !ready.empty() || running == 0; });
+            if (ready.empty()) {
+                // Nothing left to run and nothing running that could produce more work
+                ready_cv.notify_all();
+                return;
+            }
+            TaskId id = ready.top();
+            ready.pop();
+            ++running;
+            lock.unlock();
+
+            bool ok = false;
+            try {
+                ok = tasks_[id].fn();
+            } catch (const std::exception& e) {
+                std::cerr << "Error: Task '" << tasks_[id].name << "' threw: " << e.what() << std::endl;
+            }
+
+            lock.lock();
+            --running;
+            ++finished;
+            if (ok) {
+                for (TaskId dependent : tasks_[id].dependents) {
+                    Task& task = tasks_[dependent];
+                    if (!task.skipped && --task.pending_dependencies == 0) ready.push(dependent);
+                }
+            } else {
+                std::cerr << "Error: Task '" << tasks_[id].name << "' failed." << std::endl;
+                failed = true;
+                skip_dependents(id);
+            }
+            ready_cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; ++i) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+
+    return !failed && finished == tasks_.size();
+}
+
+unsigned default_job_count() {
+    unsigned hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads == 0 ? 1 : hardware_threads;
+}
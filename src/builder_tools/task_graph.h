@@ -0,0 +1,47 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// --- Task Graph ---
+// A small dependency-driven scheduler over a fixed pool of worker threads.
+// A task becomes ready once all of its dependencies have finished successfully.
+// Among ready tasks the one with the highest priority runs first (ties go to the
+// task added first), so giving later pipeline stages a higher priority lets
+// compression of post N-1, rendering of post N and parsing of post N+1 overlap
+// instead of every post being parsed before anything is written.
+// A task that returns false fails the graph; tasks depending on it are skipped.
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    TaskId add_task(std::string name, std::function<bool()> fn,
+                    const std::vector<TaskId>& dependencies = {}, int priority = 0);
+
+    // Runs every task on `jobs` threads (the calling thread counts as one).
+    // Returns false if any task failed. A graph can only be run once.
+    bool run(unsigned jobs);
+
+    // For graphs of millions of tasks: spares the copies of a growing task list.
+    void reserve(size_t task_count) { tasks_.reserve(task_count); }
+    size_t size() const { return tasks_.size(); }
+
+private:
+    struct Task {
+        std::string name;
+        std::function<bool()> fn;
+        std::vector<TaskId> dependents;
+        size_t pending_dependencies = 0;
+        int priority = 0;
+        bool skipped = false;
+    };
+    std::vector<Task> tasks_;
+};
+
+// Number of worker threads to use when --jobs is not given.
+unsigned default_job_count();
+
+#endif // TASK_GRAPH_H
@@ -0,0 +1,91 @@
+#include "template_engine.h"
+#include "common_utils.h"
+#include <algorithm>
+#include <iostream>
+
+static size_t line_number_at(const std::string& text, size_t offset) {
+    return 1 + static_cast<size_t>(std::count(text.begin(), text.begin() + offset, '\n'));
+}
+
+bool CompiledTemplate::compile(const std::string& template_name, const std::string& template_text,
+                               const std::vector<std::string>& slot_names) {
+    name_ = template_name;
+    source_hash_ = hash_content(template_text);
+    literals_.clear();
+    segments_.clear();
+
+    std::vector<bool> slot_used(slot_names.size(), false);
+    bool ok = true;
+
+    auto add_literal = [&](size_t begin, size_t end) {
+        if (begin == end) return;
+        Segment segment;
+        segment.literal_offset = literals_.size();
+        segment.literal_length = end - begin;
+        literals_.append(template_text, begin, end - begin);
+        segments_.push_back(segment);
+    };
+
+    size_t position = 0;
+    while (position < template_text.size()) {
+        size_t open = template_text.find("{{", position);
+        if (open == std::string::npos) break;
+        size_t close = template_text.find("}}", open + 2);
+        if (close == std::string::npos) {
+            std::cerr << "Error: " << template_name << ":" << line_number_at(template_text, open)
+                      << ": unterminated placeholder" << std::endl;
+            return false;
+        }
+
+        std::string slot_name = template_text.substr(open + 2, close - open - 2);
+        auto it = std::find(slot_names.begin(), slot_names.end(), slot_name);
+        if (it == slot_names.end()) {
+            std::cerr << "Error: " << template_name << ":" << line_number_at(template_text, open)
+                      << ": unknown placeholder {{" << slot_name << "}}" << std::endl;
+            ok = false;
+            position = close + 2;
+            continue;
+        }
+
+        add_literal(position, open);
+        Segment segment;
+        segment.slot = static_cast<int>(it - slot_names.begin());
+        segments_.push_back(segment);
+        slot_used[segment.slot] = true;
+        position = close + 2;
+    }
+    add_literal(position, template_text.size());
+
+    for (size_t i = 0; i < slot_names.size(); ++i) {
+        if (!slot_used[i]) {
+            std::cerr << "Warning: " << template_name << ": placeholder {{" << slot_names[i]
+                      << "}} is never used" << std::endl;
+        }
+    }
+    return ok;
+}
+
+std::string CompiledTemplate::render(const std::vector<std::string_view>& values) const {
+    std::string out;
+    render_to(out, values);
+    return out;
+}
+
+void CompiledTemplate::render_to(std::string& out, const std::vector<std::string_view>& values) const {
+    // Size the buffer once: all literals plus every slot occurrence.
+    size_t total_size = out.size() + literals_.size();
+    for (const Segment& segment : segments_) {
+        if (segment.slot >= 0 && static_cast<size_t>(segment.slot) < values.size()) {
+            total_size += values[segment.slot].size();
+        }
+    }
+    out.reserve(total_size);
+
+    for (const Segment& segment : segments_) {
+        if (segment.slot < 0) {
+            out.append(literals_, segment.literal_offset, segment.literal_length);
+        } else if (static_cast<size_t>(segment.slot) < values.size()) {
+            out.append(values[segment.slot].data(), values[segment.slot].size());
+        }
+    }
+}
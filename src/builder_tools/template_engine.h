@@ -0,0 +1,49 @@
+#ifndef TEMPLATE_ENGINE_H
+#define TEMPLATE_ENGINE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Compiled Templates ---
+// A template is parsed once into a list of literal and slot segments. Slots are
+// {{NAME}} placeholders; the set of valid names is fixed per template kind, so a
+// typo such as {{POST_TITEL}} is reported when the template is loaded instead of
+// leaking into every generated page.
+//
+// Rendering is a single pass into one buffer sized up front. Values are copied
+// verbatim: unlike std::regex_replace, a body containing "$&" or "$1" is not
+// treated as a substitution pattern, and a value containing "{{...}}" is never
+// expanded again.
+class CompiledTemplate {
+public:
+    // Parses template_text. slot_names lists the placeholders this template kind
+    // supports; values passed to render() use the same order.
+    // Returns false (and prints file/line) on an unknown or unterminated
+    // placeholder. Supported slots that never appear only produce a warning.
+    bool compile(const std::string& template_name, const std::string& template_text,
+                 const std::vector<std::string>& slot_names);
+
+    // values[i] fills every occurrence of slot_names[i].
+    std::string render(const std::vector<std::string_view>& values) const;
+    // Same, appending to out.
+    void render_to(std::string& out, const std::vector<std::string_view>& values) const;
+
+    const std::string& name() const { return name_; }
+    // hash_content() of the template source, for incremental builds.
+    const std::string& source_hash() const { return source_hash_; }
+
+private:
+    struct Segment {
+        size_t literal_offset = 0; // Into literals_ (when slot < 0)
+        size_t literal_length = 0;
+        int slot = -1;             // Index into the slot_names given to compile()
+    };
+
+    std::string name_;
+    std::string source_hash_;
+    std::string literals_;
+    std::vector<Segment> segments_;
+};
+
+#endif // TEMPLATE_ENGINE_H
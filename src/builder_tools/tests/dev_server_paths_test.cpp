@@ -0,0 +1,49 @@
+// Request paths the dev server must map below public/, and ones it must refuse.
+#include "build_stages.h"
+#include "dev_server.h"
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+void expect_file(const std::string& target, const fs::path& expected) {
+    std::string decoded;
+    fs::path file_path;
+    if (!percent_decode(target, decoded) || !public_file_path(decoded, file_path) || file_path != expected) {
+        std::cerr << "Error: " << target << " should map to " << expected << ", got " << file_path << std::endl;
+        ++failures;
+    }
+}
+
+void expect_refused(const std::string& target) {
+    std::string decoded;
+    fs::path file_path;
+    if (percent_decode(target, decoded) && public_file_path(decoded, file_path)) {
+        std::cerr << "Error: " << target << " escaped public/ as " << file_path << std::endl;
+        ++failures;
+    }
+}
+
+} // namespace
+
+int main() {
+    expect_file("/", PUBLIC_DIR / "");
+    expect_file("/index.html", PUBLIC_DIR / "index.html");
+    expect_file("/posts/a%20b.html", PUBLIC_DIR / "posts" / "a b.html");
+    expect_file("/posts/../css/style.css", PUBLIC_DIR / "css" / "style.css");
+    expect_file("/./%2Fcss/style.css", PUBLIC_DIR / "css" / "style.css"); // Not first: just a doubled slash
+
+    expect_refused("/../etc/passwd");
+    expect_refused("/posts/../../etc/passwd");
+    expect_refused("/%2E%2E/etc/passwd");
+    expect_refused("//etc/hostname");
+    expect_refused("/%2Fetc/passwd");
+    expect_refused("/%2F%2Fetc/passwd");
+    expect_refused("etc/passwd");
+
+    if (failures == 0) std::cout << "✅ dev server request paths" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
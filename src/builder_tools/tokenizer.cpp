@@ -0,0 +1,322 @@
+#include "tokenizer.h"
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+const char SEARCH_STOPWORDS[] =
+    "a an and are as at be but by for if in into is it no not of on or such "
+    "that the their then there these they this to was will with";
+
+std::string tokenizer_signature(const TokenizerOptions& options) {
+    return std::string("stopwords=") + (options.remove_stopwords ? "1" : "0") + ",stem=" + (options.stem ? "1" : "0");
+}
+
+// --- Helpers ---
+
+static bool is_stopword(std::string_view word) {
+    // Sorted copy of SEARCH_STOPWORDS for binary search.
+    static const std::string_view stopwords[] = {
+        "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "if", "in", "into", "is", "it", "no",
+        "not", "of", "on", "or", "such", "that", "the", "their", "then", "there", "these", "they", "this",
+        "to", "was", "will", "with",
+    };
+    return std::binary_search(std::begin(stopwords), std::end(stopwords), word);
+}
+
+static bool ends_with(const std::string& word, std::string_view suffix) {
+    return word.size() >= suffix.size() && word.compare(word.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool starts_with_ci(std::string_view text, size_t offset, std::string_view lowercase_prefix) {
+    if (text.size() - offset < lowercase_prefix.size()) return false;
+    for (size_t i = 0; i < lowercase_prefix.size(); ++i) {
+        char c = text[offset + i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != lowercase_prefix[i]) return false;
+    }
+    return true;
+}
+
+// Named character references that show up in rendered posts. Everything else
+// that cmark emits is numeric or one of the first four.
+struct NamedReference {
+    const char* name;
+    uint32_t code_point;
+};
+static const NamedReference NAMED_REFERENCES[] = {
+    {"amp", '&'}, {"lt", '<'}, {"gt", '>'}, {"quot", '"'}, {"apos", '\''}, {"nbsp", 0xA0},
+    {"ndash", 0x2013}, {"mdash", 0x2014}, {"hellip", 0x2026}, {"lsquo", 0x2018}, {"rsquo", 0x2019},
+    {"ldquo", 0x201C}, {"rdquo", 0x201D}, {"copy", 0xA9}, {"reg", 0xAE}, {"trade", 0x2122},
+    {"times", 0xD7}, {"eacute", 0xE9}, {"egrave", 0xE8}, {"agrave", 0xE0}, {"ouml", 0xF6},
+    {"uuml", 0xFC}, {"auml", 0xE4}, {"szlig", 0xDF}, {"ccedil", 0xE7},
+};
+
+// --- SearchTokenizer ---
+
+SearchTokenizer::SearchTokenizer(std::string_view text, TextKind kind, const TokenizerOptions& options,
+                                 uint32_t first_position)
+    : text_(text), kind_(kind), options_(options), first_position_(first_position), position_(first_position) {
+    buffer_.reserve(64);
+}
+
+bool SearchTokenizer::next(std::string_view& token, uint32_t& position) {
+    while (true) {
+        buffer_.clear();
+        size_t length = 0; // In code points
+        bool ideograph = false;
+        bool at_end = false;
+
+        if (has_pending_) {
+            has_pending_ = false;
+            append_folded(pending_code_point_);
+            length = 1;
+            ideograph = true;
+        }
+        while (!ideograph) {
+            uint32_t code_point = 0;
+            CharKind kind = next_char(code_point);
+            if (kind == CharKind::End) {
+                at_end = true;
+                break;
+            }
+            if (kind == CharKind::Separator || kind == CharKind::Boundary) {
+                if (length > 0) break;
+                continue;
+            }
+            if (kind == CharKind::Ideograph) {
+                if (length > 0) { // Finish the current word first
+                    has_pending_ = true;
+                    pending_code_point_ = code_point;
+                    break;
+                }
+                ideograph = true;
+            }
+            append_folded(code_point);
+            ++length;
+        }
+        if (length == 0) {
+            if (at_end) return false;
+            continue;
+        }
+
+        position = position_++;
+        if (!ideograph && length < SEARCH_MIN_TERM_LENGTH) continue;
+        if (options_.remove_stopwords && is_stopword(buffer_)) {
+            ++stopwords_removed_;
+            continue;
+        }
+        if (options_.stem) stem();
+        token = buffer_;
+        return true;
+    }
+}
+
+SearchTokenizer::CharKind SearchTokenizer::next_char(uint32_t& code_point) {
+    while (offset_ < text_.size()) {
+        char c = text_[offset_];
+        if (kind_ == TextKind::Html && c == '<') {
+            if (skip_markup()) return CharKind::Boundary;
+        } else if (kind_ == TextKind::Html && c == '&') {
+            code_point = decode_reference();
+            return classify(code_point);
+        }
+        if (static_cast<unsigned char>(c) < 0x80) {
+            ++offset_;
+            code_point = static_cast<unsigned char>(c);
+            return classify(code_point);
+        }
+        code_point = decode_utf8();
+        return classify(code_point);
+    }
+    return CharKind::End;
+}
+
+// At '<': skips a tag, comment or script/style element and returns true, or
+// returns false if the '<' is just text.
+bool SearchTokenizer::skip_markup() {
+    size_t start = offset_;
+    if (starts_with_ci(text_, offset_, "<!--")) {
+        size_t end = text_.find("-->", offset_ + 4);
+        offset_ = end == std::string_view::npos ? text_.size() : end + 3;
+        markup_bytes_skipped_ += offset_ - start;
+        return true;
+    }
+    if (offset_ + 1 >= text_.size()) return false;
+    char next = text_[offset_ + 1];
+    bool tag_like = std::isalpha(static_cast<unsigned char>(next)) || next == '/' || next == '!' || next == '?';
+    if (!tag_like) return false;
+
+    // Skip to the closing '>', honoring quoted attribute values.
+    auto skip_tag = [&]() {
+        char quote = 0;
+        while (offset_ < text_.size()) {
+            char c = text_[offset_++];
+            if (quote) {
+                if (c == quote) quote = 0;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '>') {
+                return;
+            }
+        }
+    };
+
+    const char* raw_text_end = nullptr;
+    if (starts_with_ci(text_, offset_, "<script")) raw_text_end = "</script";
+    else if (starts_with_ci(text_, offset_, "<style")) raw_text_end = "</style";
+    skip_tag();
+    if (raw_text_end) {
+        // Script and style bodies are not text.
+        size_t search_from = offset_;
+        while (true) {
+            size_t end = text_.find('<', search_from);
+            if (end == std::string_view::npos) {
+                offset_ = text_.size();
+                break;
+            }
+            if (starts_with_ci(text_, end, raw_text_end)) {
+                offset_ = end;
+                skip_tag();
+                break;
+            }
+            search_from = end + 1;
+        }
+    }
+    markup_bytes_skipped_ += offset_ - start;
+    return true;
+}
+
+// At '&': decodes a character reference, or consumes just the '&'.
+uint32_t SearchTokenizer::decode_reference() {
+    size_t start = offset_ + 1;
+    size_t end = start;
+    while (end < text_.size() && end - start < 32 && std::isalnum(static_cast<unsigned char>(text_[end]))) ++end;
+    if (end < text_.size() && text_[end] == '#' && end == start) {
+        // Numeric: &#123; or &#x7B;
+        size_t digits = end + 1;
+        bool hex = digits < text_.size() && (text_[digits] == 'x' || text_[digits] == 'X');
+        if (hex) ++digits;
+        uint32_t value = 0;
+        size_t i = digits;
+        while (i < text_.size() && i - digits < 8 && std::isxdigit(static_cast<unsigned char>(text_[i]))) {
+            char c = text_[i];
+            if (!hex && !std::isdigit(static_cast<unsigned char>(c))) break;
+            int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : (std::tolower(c) - 'a' + 10);
+            value = value * (hex ? 16 : 10) + static_cast<uint32_t>(digit);
+            ++i;
+        }
+        if (i > digits && i < text_.size() && text_[i] == ';') {
+            offset_ = i + 1;
+            return value <= 0x10FFFF ? value : 0xFFFD;
+        }
+    } else if (end > start && end < text_.size() && text_[end] == ';') {
+        std::string_view name = text_.substr(start, end - start);
+        for (const NamedReference& reference : NAMED_REFERENCES) {
+            if (name == reference.name) {
+                offset_ = end + 1;
+                return reference.code_point;
+            }
+        }
+    }
+    ++offset_;
+    return '&';
+}
+
+uint32_t SearchTokenizer::decode_utf8() {
+    unsigned char lead = static_cast<unsigned char>(text_[offset_]);
+    size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    uint32_t code_point = length == 4 ? (lead & 0x07) : length == 3 ? (lead & 0x0F) : (lead & 0x1F);
+    if (length == 1 || lead >= 0xF8 || offset_ + length > text_.size()) {
+        ++offset_; // Stray continuation byte or truncated sequence
+        return 0xFFFD;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        unsigned char continuation = static_cast<unsigned char>(text_[offset_ + i]);
+        if ((continuation & 0xC0) != 0x80) {
+            ++offset_;
+            return 0xFFFD;
+        }
+        code_point = (code_point << 6) | (continuation & 0x3F);
+    }
+    offset_ += length;
+    return code_point;
+}
+
+SearchTokenizer::CharKind SearchTokenizer::classify(uint32_t cp) const {
+    if (cp < 0x80) {
+        return std::isalnum(static_cast<int>(cp)) ? CharKind::Word : CharKind::Separator;
+    }
+    // Han (incl. extensions and compatibility), hiragana and katakana.
+    if ((cp >= 0x3040 && cp <= 0x30FF) || (cp >= 0x3400 && cp <= 0x4DBF) || (cp >= 0x4E00 && cp <= 0x9FFF) ||
+        (cp >= 0xF900 && cp <= 0xFAFF) || (cp >= 0x20000 && cp <= 0x3FFFF)) {
+        return CharKind::Ideograph;
+    }
+    // Punctuation, symbols, spaces and emoji; everything else counts as a letter.
+    if (cp <= 0xBF) {
+        return (cp == 0xAA || cp == 0xB5 || cp == 0xBA) ? CharKind::Word : CharKind::Separator;
+    }
+    if (cp == 0xD7 || cp == 0xF7 || cp == 0xFFFD) return CharKind::Separator;
+    if ((cp >= 0x2000 && cp <= 0x2BFF) ||   // General punctuation .. misc symbols and arrows
+        (cp >= 0x2E00 && cp <= 0x2E7F) ||   // Supplemental punctuation
+        (cp >= 0x3000 && cp <= 0x303F) ||   // CJK symbols and punctuation
+        (cp >= 0xFE00 && cp <= 0xFE0F) ||   // Variation selectors
+        (cp >= 0xFE30 && cp <= 0xFE6F) ||   // CJK compatibility forms, small forms
+        (cp >= 0xFF00 && cp <= 0xFF0F) || (cp >= 0xFF1A && cp <= 0xFF20) ||
+        (cp >= 0xFF3B && cp <= 0xFF40) || (cp >= 0xFF5B && cp <= 0xFF65) || // Fullwidth punctuation
+        (cp >= 0x1F000 && cp <= 0x1FAFF) || // Emoji and pictographs
+        (cp >= 0xE0000)) {                  // Tags, private use
+        return CharKind::Separator;
+    }
+    return CharKind::Word;
+}
+
+void SearchTokenizer::append_folded(uint32_t cp) {
+    if (cp >= 'A' && cp <= 'Z') {
+        cp += 0x20;
+    } else if (cp >= 0xC0 && cp <= 0xDE && cp != 0xD7) {
+        cp += 0x20; // Latin-1
+    } else if (cp >= 0x100 && cp <= 0x17F) {
+        // Latin Extended-A alternates upper/lower, with a phase shift at U+0139..U+0148 and U+0179..U+017E.
+        bool odd_upper = (cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E);
+        if (cp == 0x178) cp = 0xFF;
+        else if (cp != 0x130 && cp != 0x138 && cp != 0x149 && (cp % 2 == 1) == odd_upper) cp += 1;
+    } else if (cp >= 0x391 && cp <= 0x3A9 && cp != 0x3A2) {
+        cp += 0x20; // Greek
+    } else if (cp >= 0x410 && cp <= 0x42F) {
+        cp += 0x20; // Cyrillic
+    } else if (cp >= 0x400 && cp <= 0x40F) {
+        cp += 0x50;
+    } else if (cp >= 0x531 && cp <= 0x556) {
+        cp += 0x30; // Armenian
+    }
+
+    if (cp < 0x80) {
+        buffer_ += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        buffer_ += static_cast<char>(0xC0 | (cp >> 6));
+        buffer_ += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        buffer_ += static_cast<char>(0xE0 | (cp >> 12));
+        buffer_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        buffer_ += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        buffer_ += static_cast<char>(0xF0 | (cp >> 18));
+        buffer_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        buffer_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        buffer_ += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Harman's S-stemmer, skipped for words of three bytes or fewer ("has", "its").
+// "ies" -> "y" also needs a longer word, so "lies" becomes "lie", not "ly".
+void SearchTokenizer::stem() {
+    if (buffer_.size() <= 3) return;
+    if (buffer_.size() > 4 && ends_with(buffer_, "ies") && !ends_with(buffer_, "eies") && !ends_with(buffer_, "aies")) {
+        buffer_.replace(buffer_.size() - 3, 3, "y");
+    } else if (ends_with(buffer_, "es") && !ends_with(buffer_, "aes") && !ends_with(buffer_, "ees") &&
+               !ends_with(buffer_, "oes")) {
+        buffer_.pop_back();
+    } else if (ends_with(buffer_, "s") && !ends_with(buffer_, "us") && !ends_with(buffer_, "ss")) {
+        buffer_.pop_back();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// --- Search Tokenizer ---
+// Splits post text into index terms in one streaming pass:
+//   * Html input skips tags, comments and <script>/<style> bodies, and decodes
+//     character references (&amp;, &#8217;, ...), so markup never becomes a term.
+//   * Text is decoded as UTF-8. Words are runs of letters, digits and combining
+//     marks in any script; punctuation, symbols, spaces and emoji separate them.
+//     Han ideographs and kana (written without spaces) are one term per character.
+//   * Simple case folding for Latin, Greek, Cyrillic and Armenian.
+//   * Optionally drops English stopwords and applies a light plural stemmer
+//     (Harman's S-stemmer: "libraries" -> "library", "posts" -> "post").
+// Words shorter than SEARCH_MIN_TERM_LENGTH code points are not indexed, but
+// like stopwords they still take a position, so phrase offsets stay exact.
+//
+// search-logic.js.source mirrors these rules for queries (case folding via
+// toLowerCase, the same stopwords and stemmer); keep them in sync.
+
+constexpr size_t SEARCH_MIN_TERM_LENGTH = 3;
+
+enum class TextKind {
+    PlainText,
+    Html,
+};
+
+struct TokenizerOptions {
+    bool remove_stopwords = true;
+    bool stem = true;
+};
+// "stopwords=1,stem=1": saved beside state derived from tokenized text.
+std::string tokenizer_signature(const TokenizerOptions& options);
+
+// Space-separated stopword list (also written to the search manifest).
+extern const char SEARCH_STOPWORDS[];
+
+class SearchTokenizer {
+public:
+    SearchTokenizer(std::string_view text, TextKind kind, const TokenizerOptions& options, uint32_t first_position = 0);
+
+    // Advances to the next indexable term. token points into an internal buffer
+    // reused for every term (no allocation per token) and stays valid until the
+    // next call. Returns false at the end of the text.
+    bool next(std::string_view& token, uint32_t& position);
+
+    // Position the next word would get (to continue numbering in another field).
+    uint32_t next_position() const { return position_; }
+
+    size_t markup_bytes_skipped() const { return markup_bytes_skipped_; }
+    size_t words_seen() const { return position_ - first_position_; }
+    size_t stopwords_removed() const { return stopwords_removed_; }
+
+private:
+    enum class CharKind {
+        Separator,
+        Word,
+        Ideograph,
+        Boundary, // A tag or comment: ends the current word
+        End,
+    };
+    CharKind next_char(uint32_t& code_point);
+    CharKind classify(uint32_t code_point) const;
+    bool skip_markup();
+    uint32_t decode_reference();
+    uint32_t decode_utf8();
+    void append_folded(uint32_t code_point);
+    void stem();
+
+    std::string_view text_;
+    size_t offset_ = 0;
+    TextKind kind_;
+    TokenizerOptions options_;
+    uint32_t first_position_;
+    uint32_t position_;
+    std::string buffer_;
+    bool has_pending_ = false; // An ideograph read while finishing the previous word
+    uint32_t pending_code_point_ = 0;
+    size_t markup_bytes_skipped_ = 0;
+    size_t stopwords_removed_ = 0;
+};
+
+#endif // TOKENIZER_H
@@ -0,0 +1,209 @@
+#include "trace.h"
+#include "file_io.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+bool tracing_enabled_flag = false;
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* parent_name; // nullptr for top-level spans
+    std::string item;
+    bool own_item;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    size_t bytes_in;
+    size_t bytes_out;
+};
+
+// Events of one thread. Owned by the registry so they outlive the thread.
+struct ThreadTrace {
+    long tid = 0;
+    std::vector<TraceEvent> events;
+};
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadTrace>> thread_traces;
+thread_local ThreadTrace* current_thread_trace = nullptr;
+thread_local TraceSpan* current_span = nullptr;
+std::chrono::steady_clock::time_point trace_start;
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - trace_start).count());
+}
+
+ThreadTrace& this_thread_trace() {
+    if (!current_thread_trace) {
+        auto trace = std::make_unique<ThreadTrace>();
+        trace->tid = static_cast<long>(::syscall(SYS_gettid));
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        current_thread_trace = trace.get();
+        thread_traces.push_back(std::move(trace));
+    }
+    return *current_thread_trace;
+}
+
+// Microseconds with nanosecond precision, as trace viewers expect.
+void append_microseconds(std::string& out, uint64_t ns) {
+    out += std::to_string(ns / 1000);
+    char fraction[8];
+    std::snprintf(fraction, sizeof(fraction), ".%03u", static_cast<unsigned>(ns % 1000));
+    out += fraction;
+}
+
+double milliseconds(uint64_t ns) { return static_cast<double>(ns) / 1e6; }
+
+struct SpanTotals {
+    std::string key;
+    size_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    size_t bytes_in = 0;
+    size_t bytes_out = 0;
+    std::string slowest_stage; // Per-post summaries only
+};
+
+void print_summary(std::vector<SpanTotals> totals, size_t top_n, const char* title, const char* key_header) {
+    std::sort(totals.begin(), totals.end(), [](const SpanTotals& a, const SpanTotals& b) {
+        if (a.total_ns != b.total_ns) return a.total_ns > b.total_ns;
+        return a.key < b.key;
+    });
+    if (totals.size() > top_n) totals.resize(top_n);
+    if (totals.empty()) return;
+
+    std::cout << "📊 " << title << std::endl;
+    std::cout << "  " << std::left << std::setw(32) << key_header << std::right << std::setw(8) << "spans"
+              << std::setw(12) << "total ms" << std::setw(10) << "max ms" << std::setw(12) << "KB in"
+              << std::setw(12) << "KB out" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    for (const auto& entry : totals) {
+        std::string key = entry.key.size() > 31 ? entry.key.substr(0, 28) + "..." : entry.key;
+        std::cout << "  " << std::left << std::setw(32) << key << std::right << std::setw(8) << entry.count
+                  << std::setw(12) << milliseconds(entry.total_ns) << std::setw(10) << milliseconds(entry.max_ns)
+                  << std::setw(12) << static_cast<double>(entry.bytes_in) / 1024.0
+                  << std::setw(12) << static_cast<double>(entry.bytes_out) / 1024.0;
+        if (!entry.slowest_stage.empty()) std::cout << "  (mostly " << entry.slowest_stage << ")";
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout << std::setprecision(6);
+}
+
+} // namespace
+
+// --- Spans ---
+
+void TraceSpan::begin(const char* name) {
+    active_ = true;
+    name_ = name;
+    parent_ = current_span;
+    current_span = this;
+    start_ns_ = now_ns();
+}
+
+void TraceSpan::end() {
+    uint64_t end_ns = now_ns();
+    current_span = parent_;
+    if (!own_item_) {
+        for (const TraceSpan* ancestor = parent_; ancestor; ancestor = ancestor->parent_) {
+            if (ancestor->own_item_) {
+                item_ = ancestor->item_;
+                break;
+            }
+        }
+    }
+    this_thread_trace().events.push_back({name_, parent_ ? parent_->name_ : nullptr, std::move(item_), own_item_,
+                                          start_ns_, end_ns - start_ns_, bytes_in_, bytes_out_});
+}
+
+// --- Trace Output ---
+
+void start_tracing() {
+    trace_start = std::chrono::steady_clock::now();
+    tracing_enabled_flag = true;
+}
+
+bool finish_tracing(const fs::path& output_path, size_t top_n) {
+    if (!tracing_enabled()) return true;
+    tracing_enabled_flag = false;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const long pid = static_cast<long>(::getpid());
+    size_t event_count = 0;
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid) + ",\"args\":{\"name\":\"blog_builder\"}}";
+    std::map<std::string, SpanTotals, std::less<>> stage_totals;
+    std::map<std::string, SpanTotals, std::less<>> item_totals;
+    // Self time (children subtracted) per post and stage, to name each post's slowest stage.
+    std::map<std::string, std::map<std::string, int64_t>, std::less<>> item_stage_ns;
+
+    for (const auto& thread_trace : thread_traces) {
+        const std::string thread_fields = ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(thread_trace->tid);
+        for (const TraceEvent& event : thread_trace->events) {
+            json += ",{\"name\":\"";
+            json += event.name;
+            json += "\",\"cat\":\"build\",\"ph\":\"X\",\"ts\":";
+            append_microseconds(json, event.start_ns);
+            json += ",\"dur\":";
+            append_microseconds(json, event.duration_ns);
+            json += thread_fields;
+            json += ",\"args\":{";
+            if (!event.item.empty()) {
+                json += "\"item\":\"";
+                append_json_escaped(json, event.item);
+                json += "\",";
+            }
+            json += "\"bytesIn\":" + std::to_string(event.bytes_in) + ",\"bytesOut\":" + std::to_string(event.bytes_out) + "}}";
+            ++event_count;
+
+            SpanTotals& stage = stage_totals[event.name];
+            stage.key = event.name;
+            ++stage.count;
+            stage.total_ns += event.duration_ns;
+            stage.max_ns = std::max(stage.max_ns, event.duration_ns);
+            stage.bytes_in += event.bytes_in;
+            stage.bytes_out += event.bytes_out;
+            if (event.item.empty()) continue;
+            auto& stage_ns = item_stage_ns[event.item];
+            stage_ns[event.name] += static_cast<int64_t>(event.duration_ns);
+            if (!event.own_item) stage_ns[event.parent_name] -= static_cast<int64_t>(event.duration_ns);
+            if (event.own_item) {
+                SpanTotals& item = item_totals[event.item];
+                item.key = event.item;
+                ++item.count;
+                item.total_ns += event.duration_ns;
+                item.max_ns = std::max(item.max_ns, event.duration_ns);
+                item.bytes_in += event.bytes_in;
+                item.bytes_out += event.bytes_out;
+            }
+        }
+    }
+    json += "]}\n";
+    // Threads keep pointers to their buffers, so empty them rather than freeing.
+    for (auto& thread_trace : thread_traces) thread_trace->events.clear();
+
+    std::vector<SpanTotals> stages;
+    for (auto& entry : stage_totals) stages.push_back(std::move(entry.second));
+    std::vector<SpanTotals> items;
+    for (auto& entry : item_totals) {
+        const auto& per_stage = item_stage_ns[entry.first];
+        entry.second.slowest_stage = std::max_element(per_stage.begin(), per_stage.end(),
+            [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+        items.push_back(std::move(entry.second));
+    }
+    print_summary(std::move(stages), top_n, "Slowest stages (nested spans are also counted in their parent):", "stage");
+    print_summary(std::move(items), top_n, "Slowest posts:", "post");
+
+    if (!write_file(output_path, json) || !flush_output_files()) return false;
+    std::cout << "📊 Trace with " << event_count << " spans written to " << output_path.string() << std::endl;
+    return true;
+}
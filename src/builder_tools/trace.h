@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common_utils.h"
+#include <cstdint>
+
+// --- Build Tracing ---
+// Opt-in spans for every stage and post (blog_builder --trace out.json),
+// written in the Chrome trace-event format (load in Perfetto or
+// chrome://tracing). A TraceSpan times its own scope on the current thread and
+// carries the post it worked on and the bytes it consumed and produced.
+//
+// While tracing is off a span is one test of a global flag, so spans can stay
+// in the hot paths. Each thread appends to its own buffer; buffers are merged
+// when the trace is written.
+
+// Set once by start_tracing(), before any worker thread starts.
+extern bool tracing_enabled_flag;
+inline bool tracing_enabled() { return tracing_enabled_flag; }
+
+// Enables tracing for the rest of the process.
+void start_tracing();
+// Writes every recorded span to output_path and prints the top_n slowest
+// stages and posts. Call after the build, once no span is open.
+bool finish_tracing(const fs::path& output_path, size_t top_n);
+
+class TraceSpan {
+public:
+    // name must be a string literal (it is stored, not copied).
+    explicit TraceSpan(const char* name) {
+        if (tracing_enabled()) begin(name);
+    }
+    ~TraceSpan() {
+        if (active_) end();
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    // The post the span belongs to; summed per post in the summary. Spans
+    // nested in it (on the same thread) inherit it.
+    void set_item(std::string_view item) {
+        if (active_) {
+            item_.assign(item);
+            own_item_ = true;
+        }
+    }
+    void set_bytes(size_t bytes_in, size_t bytes_out) {
+        bytes_in_ = bytes_in;
+        bytes_out_ = bytes_out;
+    }
+
+private:
+    void begin(const char* name);
+    void end();
+
+    bool active_ = false;
+    bool own_item_ = false;
+    const char* name_ = nullptr;
+    TraceSpan* parent_ = nullptr; // Enclosing span on this thread
+    uint64_t start_ns_ = 0;
+    size_t bytes_in_ = 0;
+    size_t bytes_out_ = 0;
+    std::string item_;
+};
+
+#endif // TRACE_H